@@ -0,0 +1,75 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// How much listener churn aging removes: generator scans with each AP
+// dropped at random, as flaky drivers do, fed through the ager at several
+// max_missed_scans settings. raw_changes counts scans whose BSSID set
+// differed from the previous one (what listeners would hear without the
+// ager), aged_changes the scans that changed the aged set.
+//
+//   accessPointAger_bench [scans]
+
+#include "wifi_accessPointAger.h"
+#include "wifi_radioEnvironment.h"
+#include "test.h"
+#include <stdlib.h>
+
+namespace {
+void Run(double omit_probability, uint32_t max_missed_scans, int scans) {
+  RadioEnvironmentOptions environment;
+  environment.seed = 34;
+  // A receiver that stays put and a stable AP population, so all the churn
+  // left is the driver's.
+  environment.receiver_speed_mps = 0;
+  environment.noise_stddev_db = 0;
+  environment.appear_probability = 0;
+  environment.disappear_probability = 0;
+  RadioEnvironmentGenerator generator(environment);
+  RadioRandom random(34);
+  AccessPointAger::Options options;
+  options.max_missed_scans = max_missed_scans;
+  AccessPointAger ager(options);
+
+  std::vector<AccessPoint> all;
+  std::vector<AccessPoint> scan;
+  AccessPointChanges changes;
+  double update_s = 0;
+  size_t reported = 0;
+  for (int i = 0; i < scans; ++i) {
+    generator.Step();
+    generator.GetAccessPoints(all);
+    scan.clear();
+    for (size_t a = 0; a < all.size(); ++a) {
+      if (random.NextDouble() >= omit_probability) {
+        scan.push_back(all[a]);
+      }
+    }
+    reported += scan.size();
+    double start = NowSeconds();
+    ager.Update(scan, i * 10000, &changes);
+    update_s += NowSeconds() - start;
+  }
+
+  const AccessPointAger::Stats& stats = ager.GetStats();
+  printf("omit %4.0f%%  max_missed_scans %u  %6.1f APs/scan  raw_changes %5llu  "
+         "aged_changes %5llu  (%5.1f%% of scans)  %6.2f us/update\n",
+         omit_probability * 100, max_missed_scans,
+         static_cast<double>(reported) / scans,
+         static_cast<unsigned long long>(stats.raw_changes),
+         static_cast<unsigned long long>(stats.aged_changes),
+         100.0 * stats.aged_changes / scans, update_s * 1e6 / scans);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int scans = argc > 1 ? atoi(argv[1]) : 5000;
+  const double omissions[] = { 0.01, 0.05, 0.2 };
+  const uint32_t missed[] = { 1, 2, 4 };
+  for (size_t o = 0; o < sizeof(omissions) / sizeof(omissions[0]); ++o) {
+    for (size_t m = 0; m < sizeof(missed) / sizeof(missed[0]); ++m) {
+      Run(omissions[o], missed[m], scans);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,153 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_accessPointAger.h"
+#include "test.h"
+#include <stdio.h>
+
+namespace {
+AccessPoint Ap(uint32_t id, int rssi = -60) {
+  char mac[13];
+  snprintf(mac, sizeof(mac), "0200%08x", id);
+  AccessPoint access_point;
+  access_point.mac_address = mac;
+  access_point.radio_signal_strength = rssi;
+  access_point.ssid = "net";
+  return access_point;
+}
+
+// APs first..first+count-1.
+std::vector<AccessPoint> Scan(uint32_t first, int count) {
+  std::vector<AccessPoint> scan;
+  for (int i = 0; i < count; ++i) {
+    scan.push_back(Ap(first + i));
+  }
+  return scan;
+}
+
+// An AP the driver leaves out of every other poll never reaches listeners.
+void TestFlappingApIsQuiet() {
+  AccessPointAger::Options options;
+  options.max_missed_scans = 2;
+  AccessPointAger ager(options);
+  AccessPointChanges changes;
+  std::vector<AccessPoint> with = Scan(0, 5);
+  std::vector<AccessPoint> without = Scan(0, 4);
+  EXPECT(ager.Update(with, 0, &changes));
+  EXPECT_EQ(5u, changes.appeared.size());
+  for (int i = 1; i < 20; ++i) {
+    EXPECT(!ager.Update(i % 2 ? without : with, i * 1000, &changes));
+    EXPECT(changes.appeared.empty());
+    EXPECT(changes.disappeared.empty());
+  }
+  EXPECT_EQ(5u, ager.Size());
+  EXPECT_EQ(20u, ager.GetStats().raw_changes);
+  EXPECT_EQ(1u, ager.GetStats().aged_changes);
+}
+
+void TestExpiresAfterMissedScans() {
+  AccessPointAger::Options options;
+  options.max_missed_scans = 2;
+  AccessPointAger ager(options);
+  AccessPointChanges changes;
+  ager.Update(Scan(0, 2), 0, &changes);
+  std::vector<AccessPoint> only_first = Scan(0, 1);
+  EXPECT(!ager.Update(only_first, 1000, &changes));
+  EXPECT(!ager.Update(only_first, 2000, &changes));
+  EXPECT(ager.Update(only_first, 3000, &changes));
+  EXPECT_EQ(1u, changes.disappeared.size());
+  EXPECT_EQ(Ap(1).mac_address, changes.disappeared[0].mac_address);
+  EXPECT_EQ(1u, ager.Size());
+}
+
+void TestExpiresAfterMaxAge() {
+  AccessPointAger::Options options;
+  options.max_missed_scans = 0;
+  options.max_age_ms = 5000;
+  AccessPointAger ager(options);
+  AccessPointChanges changes;
+  ager.Update(Scan(0, 2), 0, &changes);
+  std::vector<AccessPoint> only_first = Scan(0, 1);
+  // However many scans it misses, only time counts.
+  for (int i = 1; i <= 50; ++i) {
+    EXPECT(!ager.Update(only_first, i * 100, &changes));
+  }
+  EXPECT(!ager.Update(only_first, 5000, &changes));
+  EXPECT(ager.Update(only_first, 5001, &changes));
+  EXPECT_EQ(1u, changes.disappeared.size());
+}
+
+// An AP listed twice in one scan, e.g. by two interfaces, is one AP with
+// the stronger reading.
+void TestDuplicateBssidInOneScan() {
+  AccessPointAger ager((AccessPointAger::Options()));
+  AccessPointChanges changes;
+  std::vector<AccessPoint> scan;
+  scan.push_back(Ap(7, -80));
+  scan.push_back(Ap(7, -50));
+  scan.push_back(Ap(7, -70));
+  EXPECT(ager.Update(scan, 0, &changes));
+  EXPECT_EQ(1u, changes.appeared.size());
+  EXPECT_EQ(1u, ager.Size());
+  std::vector<AgedAccessPoint> aged;
+  ager.GetAccessPoints(0, aged);
+  EXPECT_EQ(1u, aged.size());
+  EXPECT_EQ(-50, aged[0].access_point.radio_signal_strength);
+
+  EXPECT(!ager.Update(scan, 1000, &changes));
+  EXPECT_EQ(1u, ager.GetStats().raw_changes);
+}
+
+void TestReportsAgesAndMissedScans() {
+  AccessPointAger::Options options;
+  options.max_missed_scans = 5;
+  AccessPointAger ager(options);
+  AccessPointChanges changes;
+  ager.Update(Scan(0, 2), 0, &changes);
+  ager.Update(Scan(1, 1), 1000, &changes);
+  ager.Update(Scan(1, 1), 2000, &changes);
+  std::vector<AgedAccessPoint> aged;
+  ager.GetAccessPoints(2500, aged);
+  EXPECT_EQ(2u, aged.size());
+  // Most recently seen first.
+  EXPECT_EQ(Ap(1).mac_address, aged[0].access_point.mac_address);
+  EXPECT_EQ(500, aged[0].age_ms);
+  EXPECT_EQ(0u, aged[0].missed_scans);
+  EXPECT_EQ(Ap(0).mac_address, aged[1].access_point.mac_address);
+  EXPECT_EQ(2500, aged[1].age_ms);
+  EXPECT_EQ(2u, aged[1].missed_scans);
+}
+
+// Scans that expire nothing look at one entry, however many are tracked;
+// a scan that expires n looks at n + 1 at most.
+void TestExpiryCostFollowsExpired() {
+  AccessPointAger::Options options;
+  options.max_missed_scans = 100;
+  AccessPointAger ager(options);
+  AccessPointChanges changes;
+  const int kTracked = 10000;
+  ager.Update(Scan(0, kTracked), 0, &changes);
+  std::vector<AccessPoint> one = Scan(kTracked, 1);
+  for (int i = 1; i <= 100; ++i) {
+    uint64_t before = ager.GetStats().expiry_checks;
+    ager.Update(one, i * 1000, &changes);
+    EXPECT_EQ(1u, ager.GetStats().expiry_checks - before);
+  }
+  uint64_t before = ager.GetStats().expiry_checks;
+  EXPECT(ager.Update(one, 101000, &changes));
+  EXPECT_EQ(static_cast<size_t>(kTracked), changes.disappeared.size());
+  EXPECT(ager.GetStats().expiry_checks - before <= kTracked + 1u);
+  EXPECT_EQ(1u, ager.Size());
+}
+}  // namespace
+
+int main() {
+  TestFlappingApIsQuiet();
+  TestExpiresAfterMissedScans();
+  TestExpiresAfterMaxAge();
+  TestDuplicateBssidInOneScan();
+  TestReportsAgesAndMissedScans();
+  TestExpiryCostFollowsExpired();
+  return TestExitCode();
+}
@@ -0,0 +1,102 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Keeping the result array in step with each scan against rebuilding it,
+// over generator walks of increasing density: objects allocated, AddRef and
+// Release calls, and time per scan. The refcounted objects are the fakes from
+// trackedAccessPoints.h, so the times leave out XPCOM's own costs.
+//
+//   accessPointTracker_bench [scans]
+
+#include "wifi_accessPointTracker.h"
+#include "wifi_radioEnvironment.h"
+#include "bssIdLists.h"
+#include "trackedAccessPoints.h"
+#include "test.h"
+#include <stdlib.h>
+
+namespace {
+struct Totals {
+  Totals() : allocated(0), refcounts(0), seconds(0) {}
+  uint64_t allocated;
+  uint64_t refcounts;
+  double seconds;
+};
+
+std::vector<std::vector<char> > Walk(int access_points, int scans) {
+  RadioEnvironmentOptions options;
+  options.seed = 29;
+  options.access_point_count = access_points;
+  options.appear_probability = 0.05;
+  options.disappear_probability = 0.05;
+  RadioEnvironmentGenerator generator(options);
+  std::vector<std::vector<char> > lists(scans);
+  for (int i = 0; i < scans; ++i) {
+    generator.Step();
+    generator.GetBssIdList(lists[i]);
+  }
+  return lists;
+}
+
+Totals Track(const std::vector<std::vector<char> >& lists) {
+  FakeAccessPointArray array;
+  AccessPointTracker tracker;
+  Totals totals;
+  for (size_t i = 0; i < lists.size(); ++i) {
+    double start = NowSeconds();
+    bool changed = false;
+    tracker.BeginScan(array, array.Stats(), &changed);
+    tracker.Merge(BssIdListBuilder::AsList(lists[i]),
+                  static_cast<int>(lists[i].size()), array, &changed);
+    tracker.EndScan(array, false, &changed);
+    totals.seconds += NowSeconds() - start;
+    const AccessPointUpdateStats& stats = *array.Stats();
+    totals.allocated += stats.allocated;
+    totals.refcounts += stats.addrefs + stats.releases;
+  }
+  return totals;
+}
+
+// What UpdateAccessPointData did before: the caller clears the array and
+// every entry gets a new object.
+Totals Rebuild(const std::vector<std::vector<char> >& lists) {
+  FakeAccessPointArray array;
+  Totals totals;
+  for (size_t i = 0; i < lists.size(); ++i) {
+    double start = NowSeconds();
+    totals.refcounts += array.Count();
+    array.Clear();
+    const NDIS_802_11_BSSID_LIST& list = BssIdListBuilder::AsList(lists[i]);
+    const char* entry = reinterpret_cast<const char*>(&list.Bssid[0]);
+    for (ULONG n = 0; n < list.NumberOfItems; ++n) {
+      const NDIS_WLAN_BSSID* bssid = reinterpret_cast<const NDIS_WLAN_BSSID*>(entry);
+      array.Append(*bssid);
+      entry += bssid->Length;
+    }
+    totals.seconds += NowSeconds() - start;
+    totals.refcounts += array.Count();
+  }
+  totals.allocated = array.Stats()->allocated;
+  return totals;
+}
+
+void Print(const char* label, int access_points, int scans, const Totals& totals) {
+  printf("%5d APs  %-8s %8.1f allocated/scan  %8.1f AddRef+Release/scan  "
+         "%8.2f us/scan\n",
+         access_points, label, static_cast<double>(totals.allocated) / scans,
+         static_cast<double>(totals.refcounts) / scans,
+         totals.seconds * 1e6 / scans);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int scans = argc > 1 ? atoi(argv[1]) : 500;
+  const int densities[] = { 50, 500, 5000 };
+  for (size_t d = 0; d < sizeof(densities) / sizeof(densities[0]); ++d) {
+    std::vector<std::vector<char> > lists = Walk(densities[d], scans);
+    Print("tracked", densities[d], scans, Track(lists));
+    Print("rebuilt", densities[d], scans, Rebuild(lists));
+  }
+  return 0;
+}
@@ -0,0 +1,254 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_accessPointTracker.h"
+#include "wifi_bssIdList.h"
+#include "wifi_radioEnvironment.h"
+#include "bssIdLists.h"
+#include "trackedAccessPoints.h"
+#include "test.h"
+#include <algorithm>
+#include <string>
+#include <utility>
+
+namespace {
+// Two SSIDs of the same length whose FNV-1a hashes collide, so only the byte
+// comparison can tell them apart.
+const char kCollidingSsidA[] = "net162789";
+const char kCollidingSsidB[] = "net379192";
+
+void Merge(AccessPointTracker& tracker, FakeAccessPointArray& array,
+           BssIdListBuilder& builder, bool* changed) {
+  const std::vector<char>& list = builder.List();
+  tracker.Merge(BssIdListBuilder::AsList(list), builder.Size(), array, changed);
+}
+
+// One single-interface scan of |builder|'s list; returns whether the array
+// changed. The scan's counts are left in array.Stats().
+bool RunScan(AccessPointTracker& tracker, FakeAccessPointArray& array,
+             BssIdListBuilder& builder) {
+  bool changed = false;
+  tracker.BeginScan(array, array.Stats(), &changed);
+  Merge(tracker, array, builder, &changed);
+  tracker.EndScan(array, false, &changed);
+  return changed;
+}
+
+typedef std::pair<std::string, std::pair<int, std::string> > Row;
+
+// The array's contents in a comparable form: BSSID, signal and SSID, sorted.
+std::vector<Row> Rows(const FakeAccessPointArray& array) {
+  std::vector<Row> rows;
+  for (size_t i = 0; i < array.Count(); ++i) {
+    rows.push_back(Row(FormatBssid(array.At(i)->bssid),
+                       std::make_pair(array.At(i)->signal, array.At(i)->ssid)));
+  }
+  std::sort(rows.begin(), rows.end());
+  return rows;
+}
+
+std::vector<Row> Rows(const std::vector<AccessPoint>& access_points) {
+  std::vector<Row> rows;
+  for (size_t i = 0; i < access_points.size(); ++i) {
+    rows.push_back(Row(access_points[i].mac_address,
+                       std::make_pair(access_points[i].radio_signal_strength,
+                                      access_points[i].ssid)));
+  }
+  std::sort(rows.begin(), rows.end());
+  return rows;
+}
+
+void TestUnchangedScanTouchesNothing() {
+  FakeAccessPointArray array;
+  const AccessPointUpdateStats& stats = *array.Stats();
+  AccessPointTracker tracker;
+  BssIdListBuilder builder;
+  for (int i = 0; i < 10; ++i) {
+    builder.Add(0x020000000000ull + i, -50 - i, "office");
+  }
+  EXPECT(RunScan(tracker, array, builder));
+  EXPECT_EQ(10u, stats.allocated);
+  EXPECT_EQ(10u, array.Count());
+
+  EXPECT(!RunScan(tracker, array, builder));
+  EXPECT_EQ(10u, stats.unchanged);
+  EXPECT_EQ(0u, stats.allocated);
+  EXPECT_EQ(0u, stats.addrefs);
+  EXPECT_EQ(0u, stats.releases);
+
+  builder.Entry(3).Rssi = -20;
+  EXPECT(RunScan(tracker, array, builder));
+  EXPECT_EQ(1u, stats.updated);
+  EXPECT_EQ(9u, stats.unchanged);
+  EXPECT_EQ(0, array.SsidSets());
+}
+
+// An array other than the one the tracker filled, even of the same length,
+// is refilled rather than patched.
+void TestForeignArrayIsRefilled() {
+  FakeAccessPointArray array;
+  FakeAccessPointArray other;
+  AccessPointTracker tracker;
+  BssIdListBuilder builder;
+  for (int i = 0; i < 4; ++i) {
+    builder.Add(0x020000000000ull + i, -60, "cafe");
+  }
+  RunScan(tracker, array, builder);
+  EXPECT(RunScan(tracker, other, builder));
+  EXPECT_EQ(4u, other.Stats()->allocated);
+  EXPECT_EQ(Rows(array), Rows(other));
+
+  // The tracked array, but with a slot replaced behind the tracker's back.
+  other.RemoveAt(0);
+  BssIdListBuilder stranger;
+  stranger.Add(0x0a0000000000ull, -40, "stranger");
+  std::vector<char> list = stranger.List();
+  other.Append(BssIdListBuilder::AsList(list).Bssid[0]);
+  EXPECT(RunScan(tracker, other, builder));
+  EXPECT_EQ(4u, other.Stats()->releases);
+  EXPECT_EQ(Rows(array), Rows(other));
+}
+
+// An SSID change is caught even when the new SSID hashes the same.
+void TestSsidChangeWithCollidingHash() {
+  FakeAccessPointArray array;
+  AccessPointTracker tracker;
+  BssIdListBuilder builder;
+  builder.Add(0x020000000001ull, -55, kCollidingSsidA);
+  RunScan(tracker, array, builder);
+
+  BssIdListBuilder renamed;
+  renamed.Add(0x020000000001ull, -55, kCollidingSsidB);
+  EXPECT(RunScan(tracker, array, renamed));
+  EXPECT_EQ(1u, array.Stats()->updated);
+  EXPECT_EQ(1, array.SsidSets());
+  EXPECT_EQ(std::string(kCollidingSsidB), array.At(0)->ssid);
+}
+
+// A vanished AP's object is reused for the next new one, unless a listener
+// still holds it.
+void TestRecyclesOnlyUnsharedObjects() {
+  FakeAccessPointArray array;
+  const AccessPointUpdateStats& stats = *array.Stats();
+  AccessPointTracker tracker;
+  BssIdListBuilder all;
+  for (int i = 0; i < 3; ++i) {
+    all.Add(0x020000000000ull + i, -60, "home");
+  }
+  RunScan(tracker, array, all);
+
+  BssIdListBuilder without_first;
+  without_first.Add(0x020000000001ull, -60, "home");
+  without_first.Add(0x020000000002ull, -60, "home");
+  RunScan(tracker, array, without_first);
+  EXPECT_EQ(1u, stats.removed);
+  EXPECT_EQ(1u, array.Recyclable());
+  EXPECT_EQ(2u, array.Count());
+
+  without_first.Add(0x020000000009ull, -70, "new");
+  RunScan(tracker, array, without_first);
+  EXPECT_EQ(1u, stats.recycled);
+  EXPECT_EQ(0u, stats.allocated);
+  EXPECT_EQ(0u, array.Recyclable());
+
+  // Held by a listener: removed from the array but not reused.
+  size_t held_slot = 0;
+  while (array.At(held_slot)->bssid != 0x020000000009ull) {
+    ++held_slot;
+  }
+  FakeAccessPoint* held = array.Hold(held_slot);
+  RunScan(tracker, array, all);
+  EXPECT_EQ(1u, stats.removed);
+  EXPECT_EQ(0u, array.Recyclable());
+  EXPECT_EQ(1, held->refs);
+  EXPECT_EQ(-70, held->signal);
+  ReleaseFakeAccessPoint(held);
+  EXPECT_EQ(3u, array.Count());
+}
+
+void TestFailedScanKeepsResult() {
+  FakeAccessPointArray array;
+  AccessPointTracker tracker;
+  BssIdListBuilder builder;
+  builder.Add(0x020000000001ull, -60, "home");
+  builder.Add(0x020000000002ull, -61, "home");
+  RunScan(tracker, array, builder);
+
+  bool changed = false;
+  tracker.BeginScan(array, array.Stats(), &changed);
+  tracker.EndScan(array, true, &changed);
+  EXPECT(!changed);
+  EXPECT_EQ(2u, array.Count());
+  EXPECT_EQ(0u, array.Stats()->removed);
+
+  // A successful scan that saw nothing does clear it.
+  BssIdListBuilder empty;
+  EXPECT(RunScan(tracker, array, empty));
+  EXPECT_EQ(0u, array.Count());
+}
+
+void TestDuplicateAcrossInterfacesKeepsStrongest() {
+  FakeAccessPointArray array;
+  AccessPointTracker tracker;
+  BssIdListBuilder first;
+  first.Add(0x020000000001ull, -70, "home");
+  BssIdListBuilder second;
+  second.Add(0x020000000001ull, -50, "home");
+  second.Add(0x020000000001ull, -80, "home");
+  bool changed = false;
+  tracker.BeginScan(array, array.Stats(), &changed);
+  Merge(tracker, array, first, &changed);
+  Merge(tracker, array, second, &changed);
+  tracker.EndScan(array, false, &changed);
+  EXPECT_EQ(1u, array.Count());
+  EXPECT_EQ(-50, array.At(0)->signal);
+  EXPECT_EQ(1u, tracker.Size());
+}
+
+// Over a generator walk, the tracked array always holds what rebuilding it
+// from the same list would.
+void TestMatchesRebuildOverWalk() {
+  RadioEnvironmentOptions options;
+  options.seed = 29;
+  options.access_point_count = 400;
+  options.appear_probability = 0.1;
+  options.disappear_probability = 0.1;
+  RadioEnvironmentGenerator generator(options);
+  FakeAccessPointArray array;
+  AccessPointTracker tracker;
+  std::vector<char> list;
+  std::vector<AccessPoint> rebuilt;
+  int mismatches = 0;
+  uint32_t recycled = 0;
+  for (int scan = 0; scan < 200; ++scan) {
+    generator.Step();
+    generator.GetBssIdList(list);
+    bool changed = false;
+    tracker.BeginScan(array, array.Stats(), &changed);
+    tracker.Merge(BssIdListBuilder::AsList(list), static_cast<int>(list.size()),
+                  array, &changed);
+    tracker.EndScan(array, false, &changed);
+    recycled += array.Stats()->recycled;
+    rebuilt.clear();
+    GetDataFromBssIdList(BssIdListBuilder::AsList(list),
+                         static_cast<int>(list.size()), rebuilt);
+    mismatches += Rows(array) != Rows(rebuilt);
+  }
+  EXPECT_EQ(0, mismatches);
+  EXPECT(recycled > 0);
+  EXPECT(tracker.MemoryUsage() > 0);
+}
+}  // namespace
+
+int main() {
+  TestUnchangedScanTouchesNothing();
+  TestForeignArrayIsRefilled();
+  TestSsidChangeWithCollidingHash();
+  TestRecyclesOnlyUnsharedObjects();
+  TestFailedScanKeepsResult();
+  TestDuplicateAcrossInterfacesKeepsStrongest();
+  TestMatchesRebuildOverWalk();
+  EXPECT_EQ(0, FakeAccessPoint::Live());
+  return TestExitCode();
+}
@@ -0,0 +1,87 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Allocations per scan on the parse path by tag, and what profiling costs
+// at different sample intervals. Built with WIFI_ALLOCATION_PROFILER; compare
+// the scans/s against scanPipeline_bench or radioEnvironment_bench for the
+// unprofiled build.
+//
+//   allocationProfiler_bench [seconds per case]
+
+#include "wifi_allocationProfiler.h"
+#include "wifi_bssIdList.h"
+#include "wifi_radioEnvironment.h"
+#include "test.h"
+#include <stdlib.h>
+
+namespace {
+double Run(const std::vector<std::vector<char> >& lists, int interval,
+           double seconds, AllocationReport* cumulative) {
+  AllocationProfiler::SetSampleInterval(interval);
+  std::vector<AccessPoint> aps;
+  AllocationReport report;
+  uint64_t sampled_before = AllocationProfiler::SampledScans();
+  uint64_t scans = 0;
+  double start = NowSeconds();
+  double elapsed;
+  do {
+    for (size_t i = 0; i < lists.size(); ++i, ++scans) {
+      AllocationProfiler::BeginScan();
+      aps.clear();
+      GetDataFromBssIdList(
+          *reinterpret_cast<const NDIS_802_11_BSSID_LIST*>(&lists[i][0]),
+          static_cast<int>(lists[i].size()), aps);
+      AllocationProfiler::EndScan(&report);
+    }
+    elapsed = NowSeconds() - start;
+  } while (elapsed < seconds);
+  printf("sample 1/%-5d %9.0f scans/s  %llu sampled\n", interval, scans / elapsed,
+         static_cast<unsigned long long>(AllocationProfiler::SampledScans() -
+                                         sampled_before));
+  AllocationProfiler::GetCumulative(cumulative);
+  return scans / elapsed;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+  RadioEnvironmentOptions options;
+  options.access_point_count = 5000;
+  options.width_m = 300;
+  options.height_m = 300;
+  RadioEnvironmentGenerator generator(options);
+  std::vector<std::vector<char> > lists(32);
+  size_t visible = 0;
+  for (size_t i = 0; i < lists.size(); ++i) {
+    generator.Step();
+    generator.GetBssIdList(lists[i]);
+    visible += generator.VisibleCount();
+  }
+  printf("parsing %zu lists of ~%zu APs\n", lists.size(), visible / lists.size());
+
+  AllocationReport cumulative;
+  const int kIntervals[] = { 1000, 100, 10, 1 };
+  for (size_t i = 0; i < sizeof(kIntervals) / sizeof(kIntervals[0]); ++i) {
+    Run(lists, kIntervals[i], seconds, &cumulative);
+  }
+
+  uint64_t sampled = AllocationProfiler::SampledScans();
+  if (!sampled) {
+    printf("\nbuilt without WIFI_ALLOCATION_PROFILER; nothing was recorded\n");
+    return 0;
+  }
+  printf("\nper sampled scan, averaged over %llu scans:\n",
+         static_cast<unsigned long long>(sampled));
+  for (size_t i = 0; i < cumulative.entries.size(); ++i) {
+    AllocationReport::Entry& entry = cumulative.entries[i];
+    entry.counters.allocations /= sampled;
+    entry.counters.bytes /= sampled;
+    entry.counters.frees /= sampled;
+  }
+  cumulative.total.allocations /= sampled;
+  cumulative.total.bytes /= sampled;
+  cumulative.total.frees /= sampled;
+  printf("%s", cumulative.ToString().c_str());
+  return 0;
+}
@@ -0,0 +1,157 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Built with WIFI_ALLOCATION_PROFILER; see the Makefile.
+
+#include "wifi_allocationProfiler.h"
+#include "wifi_bssIdList.h"
+#include "wifi_radioEnvironment.h"
+#include "test.h"
+#include <thread>
+
+namespace {
+const AllocationCounters* Find(const AllocationReport& report, const char* tag) {
+  for (size_t i = 0; i < report.entries.size(); ++i) {
+    if (report.entries[i].tag == tag) {
+      return &report.entries[i].counters;
+    }
+  }
+  return NULL;
+}
+
+// Keeps the compiler from eliding a new/delete pair.
+char* volatile g_sink;
+
+void TestScopesChargeTheirTag() {
+  EXPECT(AllocationProfiler::Enabled());
+  AllocationProfiler::SetSampleInterval(1);
+  AllocationReport report;
+  EXPECT(AllocationProfiler::BeginScan());
+  {
+    WIFI_ALLOCATION_SCOPE("outer");
+    g_sink = new char[1000];
+    delete[] g_sink;
+    {
+      WIFI_ALLOCATION_SCOPE("inner");
+      g_sink = new char[300];
+      delete[] g_sink;
+    }
+    g_sink = new char[24];
+    delete[] g_sink;
+  }
+  AllocationProfiler::EndScan(&report);
+
+  const AllocationCounters* outer = Find(report, "outer");
+  const AllocationCounters* inner = Find(report, "inner");
+  EXPECT(outer && inner);
+  if (outer && inner) {
+    EXPECT_EQ(2u, outer->allocations);
+    EXPECT_EQ(1024u, outer->bytes);
+    EXPECT_EQ(2u, outer->frees);
+    EXPECT_EQ(1000, outer->peak_live_bytes);
+    EXPECT_EQ(1u, inner->allocations);
+    EXPECT_EQ(300u, inner->bytes);
+  }
+  EXPECT(report.total.bytes >= 1324u);
+  // Sorted by bytes.
+  EXPECT_EQ(std::string("outer"), report.entries[0].tag);
+}
+
+void TestSampleInterval() {
+  AllocationProfiler::SetSampleInterval(3);
+  AllocationReport report;
+  uint64_t sampled_before = AllocationProfiler::SampledScans();
+  int sampled = 0;
+  for (int scan = 0; scan < 9; ++scan) {
+    bool tracked = AllocationProfiler::BeginScan();
+    sampled += tracked;
+    {
+      WIFI_ALLOCATION_SCOPE("sampled");
+      g_sink = new char[64];
+      delete[] g_sink;
+    }
+    AllocationProfiler::EndScan(&report);
+    EXPECT_EQ(tracked, Find(report, "sampled") != NULL);
+  }
+  EXPECT_EQ(3, sampled);
+  EXPECT_EQ(sampled_before + 3, AllocationProfiler::SampledScans());
+  AllocationProfiler::SetSampleInterval(1);
+}
+
+// A block allocated during a sampled scan and freed after it is released
+// against its tag, so it does not count as live in the next scan.
+void TestBlocksOutlivingTheScan() {
+  AllocationReport report;
+  AllocationProfiler::BeginScan();
+  char* kept;
+  {
+    WIFI_ALLOCATION_SCOPE("kept");
+    kept = new char[5000];
+  }
+  AllocationProfiler::EndScan(&report);
+  const AllocationCounters* counters = Find(report, "kept");
+  EXPECT(counters && counters->frees == 0 && counters->peak_live_bytes == 5000);
+  delete[] kept;
+
+  AllocationProfiler::BeginScan();
+  {
+    WIFI_ALLOCATION_SCOPE("kept");
+    g_sink = new char[100];
+    delete[] g_sink;
+  }
+  AllocationProfiler::EndScan(&report);
+  counters = Find(report, "kept");
+  EXPECT(counters && counters->peak_live_bytes == 100);
+}
+
+// Scopes are per thread: another thread's allocations go to its own scope.
+void TestScopesArePerThread() {
+  AllocationReport report;
+  AllocationProfiler::BeginScan();
+  {
+    WIFI_ALLOCATION_SCOPE("main thread");
+    std::thread worker([] {
+      WIFI_ALLOCATION_SCOPE("worker thread");
+      g_sink = new char[777];
+      delete[] g_sink;
+    });
+    worker.join();
+  }
+  AllocationProfiler::EndScan(&report);
+  const AllocationCounters* worker = Find(report, "worker thread");
+  EXPECT(worker && worker->bytes == 777);
+}
+
+// The tagged scan path shows up when parsing a real list.
+void TestParseIsAttributed() {
+  RadioEnvironmentOptions options;
+  options.access_point_count = 2000;
+  RadioEnvironmentGenerator generator(options);
+  std::vector<char> list;
+  generator.GetBssIdList(list);
+  std::vector<AccessPoint> aps;
+  AllocationReport report;
+  AllocationProfiler::BeginScan();
+  GetDataFromBssIdList(*reinterpret_cast<const NDIS_802_11_BSSID_LIST*>(&list[0]),
+                       static_cast<int>(list.size()), aps);
+  AllocationProfiler::EndScan(&report);
+  EXPECT(!aps.empty());
+  const AllocationCounters* parse = Find(report, "BSSID list parse");
+  EXPECT(parse && parse->allocations > 0);
+  uint64_t sum = 0;
+  for (size_t i = 0; i < report.entries.size(); ++i) {
+    sum += report.entries[i].counters.bytes;
+  }
+  EXPECT_EQ(report.total.bytes, sum);
+}
+}  // namespace
+
+int main() {
+  TestScopesChargeTheirTag();
+  TestSampleInterval();
+  TestBlocksOutlivingTheScan();
+  TestScopesArePerThread();
+  TestParseIsAttributed();
+  return TestExitCode();
+}
@@ -0,0 +1,71 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// What indexing costs a consumer that only wants MAC/RSSI/SSID, compared
+// with the plain parser, and what decoding every entry's IEs adds.
+//
+//   bssIdListIndex_bench [seconds per case]
+
+#include "wifi_bssIdListIndex.h"
+#include "wifi_radioEnvironment.h"
+#include "test.h"
+#include <stdlib.h>
+
+namespace {
+enum Mode { PLAIN_PARSE, INDEX_BUILD, INDEX_DECODE_ALL, MODE_COUNT };
+
+void Run(int access_points, Mode mode, double seconds) {
+  RadioEnvironmentOptions options;
+  options.access_point_count = access_points;
+  options.width_m = 150;
+  options.height_m = 150;
+  RadioEnvironmentGenerator generator(options);
+  std::vector<char> source;
+  generator.GetBssIdList(source);
+
+  BssIdListIndex index;
+  std::vector<char> list;
+  std::vector<AccessPoint> aps;
+  uint64_t scans = 0;
+  uint64_t checksum = 0;
+  double start = NowSeconds();
+  double elapsed;
+  do {
+    for (int i = 0; i < 16; ++i, ++scans) {
+      aps.clear();
+      // Both start from a freshly filled query buffer, as after a real query.
+      list.assign(source.begin(), source.end());
+      if (mode == PLAIN_PARSE) {
+        GetDataFromBssIdList(
+            *reinterpret_cast<const NDIS_802_11_BSSID_LIST*>(&list[0]),
+            static_cast<int>(list.size()), aps, 1);
+      } else {
+        index.Build(list, &aps);
+        if (mode == INDEX_DECODE_ALL) {
+          for (size_t e = 0; e < index.Count(); ++e) {
+            checksum += index.Security(e).rsn_akm_suites;
+          }
+        }
+      }
+      checksum += aps.size();
+    }
+    elapsed = NowSeconds() - start;
+  } while (elapsed < seconds);
+  static const char* const kModes[] = { "plain parse", "index build", "build + decode all" };
+  printf("%6d APs  %5zu entries  %-19s %9.0f scans/s  (%llu)\n", access_points,
+         aps.size(), kModes[mode], scans / elapsed,
+         static_cast<unsigned long long>(checksum % 10));
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+  const int kSizes[] = { 200, 2000, 10000 };
+  for (size_t s = 0; s < sizeof(kSizes) / sizeof(kSizes[0]); ++s) {
+    for (int mode = 0; mode < MODE_COUNT; ++mode) {
+      Run(kSizes[s], static_cast<Mode>(mode), seconds);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,128 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_bssIdListIndex.h"
+#include "wifi_radioEnvironment.h"
+#include "test.h"
+#include <string.h>
+#include <thread>
+
+namespace {
+std::vector<char> MakeList(uint64_t seed, int access_points) {
+  RadioEnvironmentOptions options;
+  options.seed = seed;
+  options.access_point_count = access_points;
+  options.width_m = 120;
+  options.height_m = 120;
+  RadioEnvironmentGenerator generator(options);
+  std::vector<char> list;
+  generator.GetBssIdList(list);
+  return list;
+}
+
+void TestFrequencyTables() {
+  EXPECT_EQ(1, FrequencyToChannel(2412000));
+  EXPECT_EQ(13, FrequencyToChannel(2472));
+  EXPECT_EQ(14, FrequencyToChannel(2484000));
+  EXPECT_EQ(BAND_2_4_GHZ, FrequencyToBand(2484000));
+  EXPECT_EQ(36, FrequencyToChannel(5180000));
+  EXPECT_EQ(177, FrequencyToChannel(5885000));
+  EXPECT_EQ(BAND_5_GHZ, FrequencyToBand(5885000));
+  // 6 GHz channel 2 lies below channel 1 and must not read as 5 GHz 187.
+  EXPECT_EQ(2, FrequencyToChannel(5935000));
+  EXPECT_EQ(BAND_6_GHZ, FrequencyToBand(5935));
+  EXPECT_EQ(1, FrequencyToChannel(5955000));
+  EXPECT_EQ(233, FrequencyToChannel(7115000));
+  EXPECT_EQ(BAND_6_GHZ, FrequencyToBand(7115000));
+  EXPECT_EQ(0, FrequencyToChannel(5945000));
+  EXPECT_EQ(BAND_UNKNOWN, FrequencyToBand(5945000));
+  EXPECT_EQ(BAND_UNKNOWN, FrequencyToBand(7120000));
+}
+
+void TestBuildFillsAccessPoints() {
+  std::vector<char> list = MakeList(1, 500);
+  std::vector<AccessPoint> expected;
+  GetDataFromBssIdList(*reinterpret_cast<const NDIS_802_11_BSSID_LIST*>(&list[0]),
+                       static_cast<int>(list.size()), expected);
+  BssIdListIndex index;
+  std::vector<AccessPoint> built;
+  EXPECT_EQ(static_cast<int>(expected.size()), index.Build(list, &built));
+  EXPECT_EQ(expected.size(), built.size());
+  for (size_t i = 0; i < expected.size() && i < built.size(); ++i) {
+    EXPECT(expected[i].mac_address == built[i].mac_address);
+    EXPECT(expected[i].ssid == built[i].ssid);
+  }
+}
+
+bool SameSecurity(const BssSecurityInfo& a, const BssSecurityInfo& b) {
+  return a.privacy == b.privacy && a.has_rsn == b.has_rsn &&
+         a.has_wpa == b.has_wpa && a.rsn_group_cipher == b.rsn_group_cipher &&
+         a.rsn_pairwise_ciphers == b.rsn_pairwise_ciphers &&
+         a.rsn_akm_suites == b.rsn_akm_suites &&
+         a.rsn_capabilities == b.rsn_capabilities &&
+         a.wpa_group_cipher == b.wpa_group_cipher &&
+         a.wpa_pairwise_ciphers == b.wpa_pairwise_ciphers &&
+         a.wpa_akm_suites == b.wpa_akm_suites;
+}
+
+// Readers racing to decode the same entries must all see the same result as
+// a single-threaded decode, across rebuilds.
+void TestConcurrentDecode() {
+  const int kReaders = 4;
+  BssIdListIndex reference;
+  BssIdListIndex shared;
+  for (int round = 0; round < 20; ++round) {
+    std::vector<char> list = MakeList(100 + round, 1500);
+    std::vector<char> copy = list;
+    reference.Build(list, NULL);
+    shared.Build(copy, NULL);
+
+    int mismatches[kReaders] = { 0 };
+    std::vector<std::thread> readers;
+    for (int r = 0; r < kReaders; ++r) {
+      readers.push_back(std::thread([&shared, &reference, &mismatches, r]() {
+        const BssIdListIndex& index = shared;
+        for (size_t k = 0; k < index.Count(); ++k) {
+          size_t i = (k * (r + 1)) % index.Count();
+          if (!SameSecurity(index.Security(i), reference.Security(i)) ||
+              index.VendorIes(i).size() != reference.VendorIes(i).size()) {
+            ++mismatches[r];
+          }
+        }
+      }));
+    }
+    for (size_t t = 0; t < readers.size(); ++t) {
+      readers[t].join();
+    }
+    for (int r = 0; r < kReaders; ++r) {
+      EXPECT_EQ(0, mismatches[r]);
+    }
+  }
+}
+
+void TestRebuildInvalidatesCache() {
+  BssIdListIndex index;
+  std::vector<char> first = MakeList(5, 300);
+  index.Build(first, NULL);
+  for (size_t i = 0; i < index.Count(); ++i) {
+    index.Security(i);
+  }
+  std::vector<char> second = MakeList(6, 300);
+  std::vector<char> copy = second;
+  index.Build(second, NULL);
+  BssIdListIndex fresh;
+  fresh.Build(copy, NULL);
+  for (size_t i = 0; i < index.Count(); ++i) {
+    EXPECT(SameSecurity(fresh.Security(i), index.Security(i)));
+  }
+}
+}  // namespace
+
+int main() {
+  TestFrequencyTables();
+  TestBuildFillsAccessPoints();
+  TestConcurrentDecode();
+  TestRebuildInvalidatesCache();
+  return TestExitCode();
+}
@@ -0,0 +1,111 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Where converting a BSSID list on several threads starts to pay: parse
+// time per list for a sweep of entry counts and thread counts, and the
+// smallest entry count at which each thread count beat one thread. Threads
+// are started and joined on every call, so the sweep also prints what an
+// empty std::thread costs here and, from that and the per-entry conversion
+// time, where each thread count breaks even on idle cores; with fewer cores
+// than threads only that estimate means anything.
+//
+//   bssIdList_bench [seconds per case]
+
+#include "wifi_bssIdList.h"
+#include "wifi_radioEnvironment.h"
+#include "test.h"
+#include <stdlib.h>
+#include <thread>
+
+namespace {
+const int kThreads[] = { 1, 2, 4, 8 };
+const size_t kThreadCounts = sizeof(kThreads) / sizeof(kThreads[0]);
+
+double ThreadStartSeconds() {
+  const int kRounds = 2000;
+  double start = NowSeconds();
+  for (int i = 0; i < kRounds; ++i) {
+    std::thread worker([] {});
+    worker.join();
+  }
+  return (NowSeconds() - start) / kRounds;
+}
+
+double ParseSeconds(const std::vector<char>& list, int threads, double seconds,
+                    size_t* entries) {
+  std::vector<AccessPoint> aps;
+  uint64_t parses = 0;
+  double start = NowSeconds();
+  double elapsed;
+  do {
+    for (int i = 0; i < 8; ++i, ++parses) {
+      aps.clear();
+      GetDataFromBssIdList(*reinterpret_cast<const NDIS_802_11_BSSID_LIST*>(&list[0]),
+                           static_cast<int>(list.size()), aps, threads);
+    }
+    elapsed = NowSeconds() - start;
+  } while (elapsed < seconds);
+  *entries = aps.size();
+  return elapsed / parses;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const double seconds = argc > 1 ? atof(argv[1]) : 0.2;
+  const int sizes[] = { 64, 256, 512, 1024, 2048, 4096, 8192, 32768 };
+  const size_t size_count = sizeof(sizes) / sizeof(sizes[0]);
+  const double thread_s = ThreadStartSeconds();
+  printf("%u hardware threads; starting and joining a thread costs %.1f us\n",
+         std::thread::hardware_concurrency(), thread_s * 1e6);
+
+  int crossover[kThreadCounts] = { 0 };
+  double entry_s = 0;
+  for (size_t s = 0; s < size_count; ++s) {
+    RadioEnvironmentOptions options;
+    options.seed = 37;
+    options.access_point_count = sizes[s];
+    options.width_m = 50;
+    options.height_m = 50;
+    RadioEnvironmentGenerator generator(options);
+    generator.Step();
+    std::vector<char> list;
+    generator.GetBssIdList(list);
+
+    size_t entries = 0;
+    double one = 0;
+    printf("%6d APs", sizes[s]);
+    for (size_t t = 0; t < kThreadCounts; ++t) {
+      double parse_s = ParseSeconds(list, kThreads[t], seconds, &entries);
+      if (t == 0) {
+        one = parse_s;
+        printf("  %5zu entries", entries);
+      } else if (parse_s < one && !crossover[t]) {
+        crossover[t] = static_cast<int>(entries);
+      }
+      printf("  %d thread%s %8.1f us", kThreads[t], kThreads[t] > 1 ? "s" : " ",
+             parse_s * 1e6);
+    }
+    printf("\n");
+    entry_s = one / entries;
+  }
+
+  printf("conversion costs %.0f ns per entry\n", entry_s * 1e9);
+  for (size_t t = 1; t < kThreadCounts; ++t) {
+    // On idle cores, t threads save (1 - 1/t) of the conversion and pay for
+    // t - 1 thread starts.
+    int estimate = static_cast<int>((kThreads[t] - 1) * thread_s /
+                                    ((1 - 1.0 / kThreads[t]) * entry_s));
+    if (static_cast<unsigned>(kThreads[t]) > std::thread::hardware_concurrency()) {
+      printf("%d threads: more than the cores here; estimated break-even on "
+             "idle cores %d entries\n", kThreads[t], estimate);
+    } else if (crossover[t]) {
+      printf("%d threads: beat one thread from %d entries; estimated break-even "
+             "on idle cores %d entries\n", kThreads[t], crossover[t], estimate);
+    } else {
+      printf("%d threads: never beat one thread here; estimated break-even "
+             "on idle cores %d entries\n", kThreads[t], estimate);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,112 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_bssIdList.h"
+#include "wifi_radioEnvironment.h"
+#include "bssIdLists.h"
+#include "test.h"
+
+namespace {
+bool SameAccessPoints(const std::vector<AccessPoint>& a,
+                      const std::vector<AccessPoint>& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i].mac_address != b[i].mac_address || a[i].ssid != b[i].ssid ||
+        a[i].radio_signal_strength != b[i].radio_signal_strength) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int Parse(const std::vector<char>& list, int list_size, int threads,
+          std::vector<AccessPoint>& out) {
+  return GetDataFromBssIdList(BssIdListBuilder::AsList(list), list_size, out,
+                              threads);
+}
+
+// Every thread count gives the sequential result, in list order, for both
+// record layouts and for lists smaller than the thread count.
+void TestThreadsMatchSequential() {
+  const int kSizes[] = { 3, 500, 5000 };
+  const int kThreads[] = { 2, 4, 8 };
+  for (int with_ies = 0; with_ies < 2; ++with_ies) {
+    for (size_t s = 0; s < sizeof(kSizes) / sizeof(kSizes[0]); ++s) {
+      RadioEnvironmentOptions options;
+      options.seed = 37 + s;
+      options.access_point_count = kSizes[s];
+      options.width_m = 50;
+      options.height_m = 50;
+      options.include_ies = with_ies != 0;
+      RadioEnvironmentGenerator generator(options);
+      generator.Step();
+      std::vector<char> list;
+      generator.GetBssIdList(list);
+
+      std::vector<AccessPoint> sequential;
+      int count = Parse(list, static_cast<int>(list.size()), 1, sequential);
+      EXPECT_EQ(generator.VisibleCount(), static_cast<size_t>(count));
+      for (size_t t = 0; t < sizeof(kThreads) / sizeof(kThreads[0]); ++t) {
+        std::vector<AccessPoint> parallel(1);
+        parallel[0].ssid = "kept";
+        EXPECT_EQ(count, Parse(list, static_cast<int>(list.size()), kThreads[t],
+                               parallel));
+        // Appended after what was already there.
+        EXPECT_EQ(std::string("kept"), parallel[0].ssid);
+        parallel.erase(parallel.begin());
+        EXPECT(SameAccessPoints(sequential, parallel));
+      }
+    }
+  }
+}
+
+// NumberOfItems is only an upper bound: the walk stops at the end of the
+// buffer, however many entries the header claims.
+void TestNumberOfItemsOverclaim() {
+  BssIdListBuilder builder;
+  for (int i = 0; i < 5; ++i) {
+    builder.Add(0x020000000000ull + i, -60, "net");
+  }
+  std::vector<char> list = builder.List(1000);
+  for (int threads = 1; threads <= 8; threads *= 2) {
+    std::vector<AccessPoint> out;
+    EXPECT_EQ(5, Parse(list, builder.Size(), threads, out));
+    EXPECT_EQ(5u, out.size());
+  }
+  // A list_size shorter than the buffer cuts the walk there too.
+  std::vector<AccessPoint> out;
+  EXPECT_EQ(2, Parse(list, builder.Size() - 3 * sizeof(NDIS_WLAN_BSSID), 4, out));
+}
+
+// A record with a bad Length ends the list: the entries before it are
+// returned, in order, and nothing after it is read.
+void TestBadLengthMidway() {
+  for (int bad = 0; bad < 2; ++bad) {
+    BssIdListBuilder builder;
+    for (int i = 0; i < 3000; ++i) {
+      builder.Add(0x020000000000ull + i, -60, "net");
+    }
+    // Too short to be a record, or running past the end of the buffer.
+    builder.Entry(1700).Length = bad ? 0x7fffffff : 8;
+    std::vector<char> list = builder.List();
+    std::vector<AccessPoint> sequential;
+    EXPECT_EQ(1700, Parse(list, builder.Size(), 1, sequential));
+    for (int threads = 2; threads <= 8; threads *= 2) {
+      std::vector<AccessPoint> parallel;
+      EXPECT_EQ(1700, Parse(list, builder.Size(), threads, parallel));
+      EXPECT(SameAccessPoints(sequential, parallel));
+    }
+    EXPECT_EQ(std::string("0200000006a3"), sequential.back().mac_address);
+  }
+}
+}  // namespace
+
+int main() {
+  TestThreadsMatchSequential();
+  TestNumberOfItemsOverclaim();
+  TestBadLengthMidway();
+  return TestExitCode();
+}
@@ -0,0 +1,61 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Hand-built OID_802_11_BSSID_LIST responses, for tests that need exact
+// contents or deliberately broken records; the generator's are random and
+// always well formed.
+#pragma once
+
+#include <windows.h>
+#include <ntddndis.h>
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "wifi_bssid.h"
+
+class BssIdListBuilder {
+public:
+  BssIdListBuilder() : list_(offsetof(NDIS_802_11_BSSID_LIST, Bssid)) {}
+
+  // Appends a bare NDIS_WLAN_BSSID record and returns its index.
+  size_t Add(PackedBssid bssid, int rssi, const std::string& ssid) {
+    size_t offset = list_.size();
+    list_.resize(offset + sizeof(NDIS_WLAN_BSSID));
+    NDIS_WLAN_BSSID* entry = reinterpret_cast<NDIS_WLAN_BSSID*>(&list_[offset]);
+    memset(entry, 0, sizeof(*entry));
+    entry->Length = sizeof(*entry);
+    UnpackBssid(bssid, entry->MacAddress);
+    entry->Rssi = rssi;
+    entry->Ssid.SsidLength = static_cast<ULONG>(ssid.size());
+    memcpy(entry->Ssid.Ssid, ssid.data(), ssid.size());
+    offsets_.push_back(offset);
+    return offsets_.size() - 1;
+  }
+
+  NDIS_WLAN_BSSID& Entry(size_t i) {
+    return *reinterpret_cast<NDIS_WLAN_BSSID*>(&list_[offsets_[i]]);
+  }
+
+  // The finished list. NumberOfItems is the number of records added unless
+  // |claimed_items| overrides it.
+  const std::vector<char>& List(int claimed_items = -1) {
+    Header().NumberOfItems = claimed_items < 0 ? static_cast<ULONG>(offsets_.size())
+                                               : static_cast<ULONG>(claimed_items);
+    return list_;
+  }
+  int Size() const { return static_cast<int>(list_.size()); }
+
+  static const NDIS_802_11_BSSID_LIST& AsList(const std::vector<char>& list) {
+    return *reinterpret_cast<const NDIS_802_11_BSSID_LIST*>(&list[0]);
+  }
+
+private:
+  NDIS_802_11_BSSID_LIST& Header() {
+    return *reinterpret_cast<NDIS_802_11_BSSID_LIST*>(&list_[0]);
+  }
+
+  std::vector<char> list_;
+  std::vector<size_t> offsets_;
+};
@@ -0,0 +1,110 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// A slow fake device query and a set of client threads that each ask a
+// ScanCoalescer for results at their own cadence and maximum age, for the
+// coalescer's test and benchmark.
+#pragma once
+
+#include "wifi_scanCoalescer.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+class FakeAccessPointQuery : public AccessPointQuery {
+public:
+  explicit FakeAccessPointQuery(int delay_ms)
+      : delay_ms_(delay_ms), fail_(false), calls_(0), running_(0),
+        overlapped_(0) {}
+
+  bool QueryAccessPoints(std::vector<AccessPoint>& outData) {
+    int call = ++calls_;
+    if (++running_ > 1) {
+      ++overlapped_;
+    }
+    if (delay_ms_) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms_));
+    }
+    --running_;
+    outData.clear();
+    if (fail_.load()) {
+      return false;
+    }
+    // The signal numbers the query, so callers can tell results apart.
+    AccessPoint ap;
+    ap.mac_address = "00:11:22:33:44:55";
+    ap.radio_signal_strength = call;
+    ap.ssid = "fake";
+    outData.push_back(ap);
+    return true;
+  }
+
+  void SetFail(bool fail) { fail_.store(fail); }
+  int Calls() const { return calls_.load(); }
+  // Queries that started while another was still running; always 0 if the
+  // coalescer serializes them.
+  int Overlapped() const { return overlapped_.load(); }
+
+private:
+  const int delay_ms_;
+  std::atomic<bool> fail_;
+  std::atomic<int> calls_;
+  std::atomic<int> running_;
+  std::atomic<int> overlapped_;
+};
+
+// One simulated component: asks for results no older than |max_age_ms|
+// every |period_ms|.
+struct CoalescerClient {
+  int max_age_ms;
+  int period_ms;
+};
+
+struct CoalescerClientStats {
+  int requests;
+  // Results issued longer than max_age_ms before the request was made.
+  int too_old;
+  int failed;
+};
+
+// Runs one thread per client against |coalescer| for |duration_ms| and
+// returns each client's counts, in the order given.
+inline std::vector<CoalescerClientStats> RunCoalescerClients(
+    ScanCoalescer* coalescer, const std::vector<CoalescerClient>& clients,
+    int duration_ms) {
+  typedef ScanCoalescer::Clock Clock;
+  std::vector<CoalescerClientStats> stats(clients.size());
+  std::vector<std::thread> threads;
+  const Clock::time_point end =
+      Clock::now() + std::chrono::milliseconds(duration_ms);
+  for (size_t c = 0; c < clients.size(); ++c) {
+    threads.push_back(std::thread([&clients, &stats, coalescer, end, c]() {
+      const CoalescerClient& client = clients[c];
+      CoalescerClientStats& out = stats[c];
+      out.requests = out.too_old = out.failed = 0;
+      Clock::time_point next = Clock::now();
+      while (next < end) {
+        Clock::time_point asked = Clock::now();
+        std::shared_ptr<const ScanCoalescer::Result> result =
+            coalescer->Request(client.max_age_ms);
+        ++out.requests;
+        if (!result->succeeded) {
+          ++out.failed;
+        }
+        if (asked - result->issued > std::chrono::milliseconds(client.max_age_ms)) {
+          ++out.too_old;
+        }
+        // A client held up by a query skips the requests it missed rather
+        // than sending them in a burst.
+        next = std::max(next + std::chrono::milliseconds(client.period_ms),
+                        Clock::now());
+        std::this_thread::sleep_until(next);
+      }
+    }));
+  }
+  for (size_t c = 0; c < threads.size(); ++c) {
+    threads[c].join();
+  }
+  return stats;
+}
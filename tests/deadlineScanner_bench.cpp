@@ -0,0 +1,54 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Scan latency with occasional driver hangs, waiting for every interface
+// versus returning at a deadline with cached data for late ones.
+//
+//   deadlineScanner_bench [scans per case]
+
+#include "wifi_deadlineScanner.h"
+#include "fakeScanBackend.h"
+#include "test.h"
+#include <stdlib.h>
+#include <algorithm>
+
+namespace {
+const size_t kInterfaces = 3;
+const int kQueryMs = 2;
+const int kHangMs = 300;
+const double kHangProbability = 0.02;
+
+void Run(const char* label, int deadline_ms, int scans) {
+  std::shared_ptr<FakeScanBackend> backend(new FakeScanBackend(kInterfaces));
+  for (size_t i = 0; i < kInterfaces; ++i) {
+    backend->SetDelay(i, kQueryMs);
+    backend->SetRandomHang(i, kHangProbability, kHangMs);
+  }
+  DeadlineScanner scanner(backend);
+  DeadlineScanResult result;
+  std::vector<double> latencies;
+  int stale = 0;
+  for (int i = 0; i < scans; ++i) {
+    double start = NowSeconds();
+    scanner.Scan(deadline_ms, &result);
+    latencies.push_back((NowSeconds() - start) * 1000);
+    stale += !result.fresh;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  printf("%-22s p50 %7.1f ms  p99 %7.1f ms  max %7.1f ms  stale %5.1f%%\n",
+         label, latencies[latencies.size() / 2],
+         latencies[latencies.size() * 99 / 100], latencies.back(),
+         100.0 * stale / scans);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  int scans = argc > 1 ? atoi(argv[1]) : 300;
+  printf("%zu interfaces, %d ms queries, %.0f%% hang for %d ms\n", kInterfaces,
+         kQueryMs, kHangProbability * 100, kHangMs);
+  Run("wait for all", 60 * 1000, scans);
+  Run("deadline 20 ms", 20, scans);
+  Run("deadline 50 ms", 50, scans);
+  return 0;
+}
@@ -0,0 +1,156 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_deadlineScanner.h"
+#include "fakeScanBackend.h"
+#include "test.h"
+#include <algorithm>
+
+namespace {
+const int kDeadlineMs = 50;
+// Scheduling slack allowed on top of the deadline on a loaded machine.
+const double kSlackSeconds = 0.2;
+
+bool Contains(const std::vector<std::string>& names, const std::string& name) {
+  return std::find(names.begin(), names.end(), name) != names.end();
+}
+
+int SignalOf(const DeadlineScanResult& result, const std::string& mac) {
+  for (size_t i = 0; i < result.access_points.size(); ++i) {
+    if (result.access_points[i].mac_address == mac) {
+      return result.access_points[i].radio_signal_strength;
+    }
+  }
+  return -1;
+}
+
+void TestAllAnswer() {
+  std::shared_ptr<FakeScanBackend> backend(new FakeScanBackend(3));
+  DeadlineScanner scanner(backend);
+  DeadlineScanResult result;
+  EXPECT(scanner.Scan(1000, &result));
+  EXPECT(result.fresh);
+  EXPECT_EQ(0, result.age_ms);
+  EXPECT_EQ(3u, result.access_points.size());
+  EXPECT(result.timed_out_interfaces.empty());
+  EXPECT(result.failed_interfaces.empty());
+}
+
+// A hung interface is reported late and stood in for by its last good data,
+// is not queried again while hung, and is fresh again once it returns.
+void TestHungInterfaceFallsBackToCache() {
+  std::shared_ptr<FakeScanBackend> backend(new FakeScanBackend(3));
+  DeadlineScanner scanner(backend);
+  DeadlineScanResult result;
+  EXPECT(scanner.Scan(1000, &result));
+  EXPECT_EQ(1, SignalOf(result, "if1"));
+
+  backend->SetHang(1, true);
+  double start = NowSeconds();
+  EXPECT(scanner.Scan(kDeadlineMs, &result));
+  double elapsed = NowSeconds() - start;
+  EXPECT(elapsed < kDeadlineMs / 1000.0 + kSlackSeconds);
+  EXPECT(!result.fresh);
+  EXPECT(Contains(result.timed_out_interfaces, "if1"));
+  EXPECT_EQ(1u, result.timed_out_interfaces.size());
+  EXPECT_EQ(3u, result.access_points.size());
+  EXPECT_EQ(1, SignalOf(result, "if1"));
+  EXPECT_EQ(2, SignalOf(result, "if0"));
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT(scanner.Scan(kDeadlineMs, &result));
+  EXPECT(!result.fresh);
+  EXPECT(result.age_ms >= 20);
+  EXPECT_EQ(2, backend->Calls(1));
+
+  backend->SetHang(1, false);
+  for (int i = 0; i < 20 && !result.fresh; ++i) {
+    scanner.Scan(1000, &result);
+  }
+  EXPECT(result.fresh);
+  EXPECT(SignalOf(result, "if1") >= 2);
+}
+
+void TestFailures() {
+  std::shared_ptr<FakeScanBackend> backend(new FakeScanBackend(2));
+  backend->SetFail(0, true);
+  backend->SetFail(1, true);
+  DeadlineScanner scanner(backend);
+  DeadlineScanResult result;
+  // Nothing cached and everything failed.
+  EXPECT(!scanner.Scan(1000, &result));
+  EXPECT_EQ(2u, result.failed_interfaces.size());
+
+  backend->SetFail(0, false);
+  EXPECT(scanner.Scan(1000, &result));
+  EXPECT(!result.fresh);
+  EXPECT(Contains(result.failed_interfaces, "if1"));
+  EXPECT_EQ(1u, result.access_points.size());
+}
+
+// The destructor gives up on a hung query; the worker finishes later
+// against the backend it still holds.
+void TestShutdownAbandonsHungWorker() {
+  std::shared_ptr<FakeScanBackend> backend(new FakeScanBackend(2));
+  backend->SetHang(0, true);
+  double start = NowSeconds();
+  {
+    DeadlineScanner scanner(backend);
+    DeadlineScanResult result;
+    scanner.Scan(kDeadlineMs, &result);
+    EXPECT(Contains(result.timed_out_interfaces, "if0"));
+  }
+  EXPECT(NowSeconds() - start < 1.0);
+  EXPECT_EQ(1, backend->Hung(0));
+  backend->SetHang(0, false);
+  for (int i = 0; i < 100 && backend.use_count() > 1; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  EXPECT_EQ(1, backend.use_count());
+}
+
+// Latencies() may be read while other threads scan.
+void TestLatenciesWhileScanning() {
+  std::shared_ptr<FakeScanBackend> backend(new FakeScanBackend(2));
+  DeadlineScanner scanner(backend);
+  const int kScans = 200;
+  std::thread scanning([&scanner]() {
+    DeadlineScanResult result;
+    for (int i = 0; i < kScans; ++i) {
+      scanner.Scan(1000, &result);
+    }
+  });
+  uint64_t last = 0;
+  while (last < static_cast<uint64_t>(kScans)) {
+    LatencyHistogram latencies = scanner.Latencies();
+    EXPECT(latencies.Count() >= last);
+    last = latencies.Count();
+    std::this_thread::yield();
+  }
+  scanning.join();
+  EXPECT(scanner.Latencies().PercentileMicros(0.99) > 0);
+}
+
+void TestHistogram() {
+  LatencyHistogram histogram;
+  EXPECT_EQ(0, histogram.PercentileMicros(0.99));
+  for (int i = 0; i < 99; ++i) {
+    histogram.Record(100);
+  }
+  histogram.Record(100000);
+  EXPECT_EQ(128, histogram.PercentileMicros(0.5));
+  EXPECT_EQ(128, histogram.PercentileMicros(0.98));
+  EXPECT_EQ(131072, histogram.PercentileMicros(0.999));
+}
+}  // namespace
+
+int main() {
+  TestHistogram();
+  TestAllAnswer();
+  TestHungInterfaceFallsBackToCache();
+  TestFailures();
+  TestShutdownAbandonsHungWorker();
+  TestLatenciesWhileScanning();
+  return TestExitCode();
+}
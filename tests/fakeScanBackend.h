@@ -0,0 +1,110 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// InterfaceScanBackend whose interfaces answer after a configurable delay,
+// fail, or hang until released, for exercising DeadlineScanner.
+#pragma once
+
+#include "wifi_deadlineScanner.h"
+#include <stdio.h>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+
+class FakeScanBackend : public InterfaceScanBackend {
+public:
+  explicit FakeScanBackend(size_t interfaces)
+      : interfaces_(interfaces), random_(1) {}
+
+  size_t InterfaceCount() const { return interfaces_.size(); }
+
+  std::string InterfaceName(size_t index) const {
+    char name[16];
+    snprintf(name, sizeof(name), "if%zu", index);
+    return name;
+  }
+
+  bool ScanInterface(size_t index, std::vector<AccessPoint>& outData) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Interface& it = interfaces_[index];
+    ++it.calls;
+    int delay_ms = it.delay_ms;
+    if (it.hang_probability > 0 &&
+        std::uniform_real_distribution<double>(0, 1)(random_) < it.hang_probability) {
+      delay_ms = it.hang_ms;
+    }
+    if (it.hang) {
+      ++it.hung;
+      released_cv_.wait(lock, [&it] { return !it.hang; });
+      --it.hung;
+    }
+    bool ok = !it.fail;
+    int answer = ++it.answers;
+    lock.unlock();
+
+    if (delay_ms) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+    }
+    outData.clear();
+    if (ok) {
+      // One AP per interface whose signal counts this interface's answers,
+      // so a test can tell fresh data from cached data.
+      AccessPoint ap;
+      ap.mac_address = InterfaceName(index);
+      ap.radio_signal_strength = answer;
+      ap.ssid = "fake";
+      outData.push_back(ap);
+    }
+    return ok;
+  }
+
+  // Blocks every later query on |index| until SetHang(index, false).
+  void SetHang(size_t index, bool hang) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    interfaces_[index].hang = hang;
+    released_cv_.notify_all();
+  }
+  void SetFail(size_t index, bool fail) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    interfaces_[index].fail = fail;
+  }
+  void SetDelay(size_t index, int delay_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    interfaces_[index].delay_ms = delay_ms;
+  }
+  // Each query on |index| takes |hang_ms| instead with |probability|.
+  void SetRandomHang(size_t index, double probability, int hang_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    interfaces_[index].hang_probability = probability;
+    interfaces_[index].hang_ms = hang_ms;
+  }
+  int Calls(size_t index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return interfaces_[index].calls;
+  }
+  int Hung(size_t index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return interfaces_[index].hung;
+  }
+
+private:
+  struct Interface {
+    Interface()
+        : delay_ms(0), hang_ms(0), hang_probability(0), hang(false),
+          fail(false), calls(0), hung(0), answers(0) {}
+    int delay_ms;
+    int hang_ms;
+    double hang_probability;
+    bool hang;
+    bool fail;
+    int calls;
+    int hung;
+    int answers;
+  };
+
+  std::mutex mutex_;
+  std::condition_variable released_cv_;
+  std::vector<Interface> interfaces_;
+  std::mt19937 random_;
+};
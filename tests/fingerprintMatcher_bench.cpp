@@ -0,0 +1,118 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Accuracy and throughput of k-NN matching against a synthetic survey of
+// 1M fingerprints: position error of the k nearest, agreement with an
+// exhaustive search, single-query latency, and batch throughput on one
+// thread and on every core.
+//
+//   fingerprintMatcher_bench [fingerprints] [queries] [exhaustive queries]
+
+#include "wifi_fingerprintMatcher.h"
+#include "fingerprintScenes.h"
+#include "test.h"
+#include <stdlib.h>
+#include <thread>
+
+namespace {
+const size_t kK = 4;
+const float kNoiseDb = 3;
+
+struct Queries {
+  std::vector<SparseFingerprint> scans;
+  std::vector<float> x;
+  std::vector<float> y;
+  // Exhaustive top k for the first few scans.
+  std::vector<std::vector<FingerprintNeighbor> > exact;
+};
+
+float Percentile(std::vector<float> values, size_t percent) {
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1, values.size() * percent / 100)];
+}
+
+void Run(const char* label, const SurveyScene& scene,
+         const FingerprintMatcherOptions& options, const Queries& queries) {
+  FingerprintMatcher matcher(options);
+  double start = NowSeconds();
+  AddSurvey(scene, &matcher);
+  double build_s = NowSeconds() - start;
+
+  std::vector<FingerprintNeighbor> neighbors;
+  std::vector<float> latencies;
+  std::vector<float> errors;
+  for (size_t q = 0; q < queries.scans.size(); ++q) {
+    start = NowSeconds();
+    matcher.Query(queries.scans[q], kK, &neighbors);
+    latencies.push_back(static_cast<float>((NowSeconds() - start) * 1e6));
+    errors.push_back(NeighborError(matcher, neighbors, queries.x[q], queries.y[q]));
+  }
+
+  // Share of the exhaustive top k found, by distance, so near ties that
+  // swap ids still count.
+  size_t found = 0;
+  size_t wanted = 0;
+  for (size_t q = 0; q < queries.exact.size(); ++q) {
+    matcher.Query(queries.scans[q], kK, &neighbors);
+    const std::vector<FingerprintNeighbor>& exact = queries.exact[q];
+    wanted += exact.size();
+    for (size_t i = 0; i < exact.size() && i < neighbors.size(); ++i) {
+      found += neighbors[i].distance <= exact[i].distance * 1.0001f;
+    }
+  }
+
+  std::vector<std::vector<FingerprintNeighbor> > batch;
+  start = NowSeconds();
+  matcher.QueryBatch(queries.scans, kK, &batch, 1);
+  double one_thread_qps = queries.scans.size() / (NowSeconds() - start);
+  start = NowSeconds();
+  matcher.QueryBatch(queries.scans, kK, &batch, 0);
+  double all_threads_qps = queries.scans.size() / (NowSeconds() - start);
+
+  printf("%-18s build %5.1f s  latency p50 %7.1f us  p99 %7.1f us  "
+         "error p50 %4.2f m  p90 %4.2f m  recall %5.1f%%  "
+         "batch %7.0f q/s (1 thread)  %7.0f q/s (%u threads)\n",
+         label, build_s, Percentile(latencies, 50), Percentile(latencies, 99),
+         Percentile(errors, 50), Percentile(errors, 90),
+         wanted ? 100.0 * found / wanted : 100.0, one_thread_qps,
+         all_threads_qps, std::max(1u, std::thread::hardware_concurrency()));
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  int fingerprints = argc > 1 ? atoi(argv[1]) : 1000000;
+  int count = argc > 2 ? atoi(argv[2]) : 2000;
+  int exhaustive = argc > 3 ? atoi(argv[3]) : 10;
+  SurveyScene scene = MakeSurveyScene(static_cast<int>(sqrtf(fingerprints)));
+
+  Queries queries;
+  std::mt19937 random(41);
+  queries.scans.resize(count);
+  queries.x.resize(count);
+  queries.y.resize(count);
+  double aps = 0;
+  for (int q = 0; q < count; ++q) {
+    LiveScan(scene, kNoiseDb, random, &queries.scans[q], &queries.x[q],
+             &queries.y[q]);
+    aps += queries.scans[q].Size();
+  }
+  FingerprintMatcherOptions defaults;
+  queries.exact.resize(std::min(exhaustive, count));
+  for (size_t q = 0; q < queries.exact.size(); ++q) {
+    ExhaustiveNeighbors(scene, queries.scans[q], kK, defaults.missing_rssi_dbm, 1,
+                        &queries.exact[q]);
+  }
+
+  printf("%u fingerprints over %d m x %d m, %.1f APs per scan, %d dB noise, "
+         "k = %zu, recall over %zu exhaustive queries\n",
+         SurveyPointCount(scene), scene.side, scene.side, aps / count,
+         static_cast<int>(kNoiseDb), kK, queries.exact.size());
+  FingerprintMatcherOptions options;
+  Run("all candidates", scene, options, queries);
+  options.max_candidates = 2000;
+  Run("2000 candidates", scene, options, queries);
+  options.max_candidates = 200;
+  Run("200 candidates", scene, options, queries);
+  return 0;
+}
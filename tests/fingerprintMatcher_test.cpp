@@ -0,0 +1,162 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_fingerprintMatcher.h"
+#include "fingerprintScenes.h"
+#include "test.h"
+
+namespace {
+const int kSide = 50;
+const size_t kK = 5;
+const int kQueries = 60;
+
+bool SameDistances(const std::vector<FingerprintNeighbor>& expected,
+                   const std::vector<FingerprintNeighbor>& actual) {
+  if (expected.size() != actual.size()) {
+    return false;
+  }
+  // Ids may swap between near ties, since the matcher sums in a different
+  // order; the distances at each rank must agree.
+  for (size_t i = 0; i < expected.size(); ++i) {
+    if (fabsf(expected[i].distance - actual[i].distance) >
+        1e-3f * std::max(1.0f, expected[i].distance)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void TestSparseFingerprint() {
+  SparseFingerprint fingerprint;
+  fingerprint.Add(3, -70);
+  fingerprint.Add(1, -60);
+  fingerprint.Add(3, -50);
+  fingerprint.Sort();
+  EXPECT_EQ(2u, fingerprint.Size());
+  EXPECT_EQ(1u, fingerprint.bssids[0]);
+  EXPECT_EQ(3u, fingerprint.bssids[1]);
+  EXPECT_EQ(-50.0f, fingerprint.rssi[1]);
+
+  std::vector<AccessPoint> scan(3);
+  scan[0].mac_address = "00:00:00:00:00:02";
+  scan[0].radio_signal_strength = -40;
+  scan[1].mac_address = "not a mac";
+  scan[2].mac_address = "000000000001";
+  scan[2].radio_signal_strength = -45;
+  BuildSparseFingerprint(scan, &fingerprint);
+  EXPECT_EQ(2u, fingerprint.Size());
+  EXPECT_EQ(1u, fingerprint.bssids[0]);
+  EXPECT_EQ(-40.0f, fingerprint.rssi[1]);
+}
+
+// Without a candidate cap, pruning by the inverted index and the distance
+// bound loses nothing: the answer is the exhaustive top k.
+void TestMatchesExhaustiveSearch() {
+  SurveyScene scene = MakeSurveyScene(kSide);
+  FingerprintMatcherOptions options;
+  FingerprintMatcher matcher(options);
+  AddSurvey(scene, &matcher);
+  EXPECT_EQ(SurveyPointCount(scene), matcher.Size());
+
+  std::mt19937 random(17);
+  SparseFingerprint scan;
+  std::vector<FingerprintNeighbor> neighbors;
+  std::vector<FingerprintNeighbor> expected;
+  int mismatches = 0;
+  for (int q = 0; q < kQueries; ++q) {
+    float x;
+    float y;
+    LiveScan(scene, 3, random, &scan, &x, &y);
+    matcher.Query(scan, kK, &neighbors);
+    ExhaustiveNeighbors(scene, scan, kK, options.missing_rssi_dbm,
+                        std::min<uint32_t>(options.min_common_aps,
+                                           static_cast<uint32_t>(scan.Size())),
+                        &expected);
+    mismatches += !SameDistances(expected, neighbors);
+  }
+  EXPECT_EQ(0, mismatches);
+}
+
+void TestBatchMatchesSingleQueries() {
+  SurveyScene scene = MakeSurveyScene(kSide);
+  FingerprintMatcherOptions options;
+  options.max_candidates = 200;
+  FingerprintMatcher matcher(options);
+  AddSurvey(scene, &matcher);
+
+  std::mt19937 random(23);
+  std::vector<SparseFingerprint> scans(kQueries);
+  float x;
+  float y;
+  for (int q = 0; q < kQueries; ++q) {
+    LiveScan(scene, 3, random, &scans[q], &x, &y);
+  }
+  std::vector<std::vector<FingerprintNeighbor> > batch;
+  matcher.QueryBatch(scans, kK, &batch, 3);
+  EXPECT_EQ(scans.size(), batch.size());
+  std::vector<FingerprintNeighbor> single;
+  int mismatches = 0;
+  for (int q = 0; q < kQueries; ++q) {
+    matcher.Query(scans[q], kK, &single);
+    bool same = single.size() == batch[q].size();
+    for (size_t i = 0; same && i < single.size(); ++i) {
+      same = single[i].id == batch[q][i].id &&
+             single[i].distance == batch[q][i].distance;
+    }
+    mismatches += !same;
+  }
+  EXPECT_EQ(0, mismatches);
+}
+
+// Scans taken anywhere in the surveyed area land near where they were
+// taken.
+void TestLocatesScans() {
+  SurveyScene scene = MakeSurveyScene(kSide);
+  FingerprintMatcherOptions options;
+  FingerprintMatcher matcher(options);
+  AddSurvey(scene, &matcher);
+
+  std::mt19937 random(29);
+  SparseFingerprint scan;
+  std::vector<FingerprintNeighbor> neighbors;
+  std::vector<float> errors;
+  for (int q = 0; q < kQueries; ++q) {
+    float x;
+    float y;
+    LiveScan(scene, 3, random, &scan, &x, &y);
+    matcher.Query(scan, kK, &neighbors);
+    errors.push_back(NeighborError(matcher, neighbors, x, y));
+  }
+  std::sort(errors.begin(), errors.end());
+  EXPECT(errors[errors.size() / 2] < 2.5f);
+  EXPECT(errors[errors.size() * 9 / 10] < 5.0f);
+}
+
+void TestEmptyQueries() {
+  FingerprintMatcherOptions options;
+  FingerprintMatcher matcher(options);
+  SparseFingerprint fingerprint;
+  fingerprint.Add(1, -50);
+  ReferencePoint point = { 0, 0, 0 };
+  matcher.Add(point, fingerprint);
+  matcher.BuildIndex();
+  std::vector<FingerprintNeighbor> neighbors(1);
+  matcher.Query(SparseFingerprint(), kK, &neighbors);
+  EXPECT(neighbors.empty());
+  matcher.Query(fingerprint, 0, &neighbors);
+  EXPECT(neighbors.empty());
+  matcher.Query(fingerprint, kK, &neighbors);
+  EXPECT_EQ(1u, neighbors.size());
+  EXPECT_EQ(0.0f, neighbors[0].distance);
+}
+}  // namespace
+
+int main() {
+  TestSparseFingerprint();
+  TestMatchesExhaustiveSearch();
+  TestBatchMatchesSingleQueries();
+  TestLocatesScans();
+  TestEmptyQueries();
+  return TestExitCode();
+}
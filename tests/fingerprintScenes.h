@@ -0,0 +1,206 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// A synthetic survey: reference points on a 1 m grid, APs on a coarser grid,
+// RSSI from a log-distance path loss plus shadowing that is fixed per AP over
+// each 5 m block, so a live scan resembles the fingerprints around it. Survey
+// fingerprints are recomputed from their id rather than stored, so a
+// million-point survey costs no memory outside the matcher.
+#pragma once
+
+#include "wifi_fingerprintMatcher.h"
+#include <math.h>
+#include <algorithm>
+#include <random>
+
+struct SurveyScene {
+  // Reference points per row and column, 1 m apart.
+  int side;
+  float ap_spacing_m;
+  int ap_side;
+  float shadowing_db;
+};
+
+namespace survey {
+const float kRssiAt1mDbm = -40;
+const float kPathLossExponent = 3;
+// Quietest AP a scan reports.
+const float kFloorDbm = -90;
+const float kRangeM = 60;
+const int kShadowingBlockM = 5;
+
+inline float Unit(uint64_t h) {
+  h *= 0x9E3779B97F4A7C15ULL;
+  h ^= h >> 31;
+  h *= 0xBF58476D1CE4E5B9ULL;
+  h ^= h >> 29;
+  return static_cast<float>(h >> 40) / static_cast<float>(1 << 24);
+}
+
+inline uint32_t ShadowingBlock(const SurveyScene& scene, int x, int y) {
+  int per_row = scene.side / kShadowingBlockM + 1;
+  return static_cast<uint32_t>(y / kShadowingBlockM * per_row + x / kShadowingBlockM);
+}
+
+// Roughly Gaussian, fixed for a given block and AP.
+inline float Shadowing(const SurveyScene& scene, uint32_t block, uint32_t ap) {
+  uint64_t key = (static_cast<uint64_t>(block) << 32) | ap;
+  float sum = Unit(key) + Unit(key ^ 0x1111) + Unit(key ^ 0x2222) +
+              Unit(key ^ 0x3333) - 2;
+  return sum * 1.732f * scene.shadowing_db;
+}
+
+inline PackedBssid ApBssid(uint32_t ap) {
+  return 0x020000000000ULL | ap;
+}
+
+// Fills |out| with the APs heard at (x, y), with the shadowing of |block|
+// and |noise| added to each.
+template <typename Noise>
+void HearAps(const SurveyScene& scene, float x, float y, uint32_t block,
+             Noise noise, SparseFingerprint* out) {
+  out->Clear();
+  int ax0 = std::max(0, static_cast<int>((x - kRangeM) / scene.ap_spacing_m));
+  int ax1 = std::min(scene.ap_side - 1,
+                     static_cast<int>((x + kRangeM) / scene.ap_spacing_m) + 1);
+  int ay0 = std::max(0, static_cast<int>((y - kRangeM) / scene.ap_spacing_m));
+  int ay1 = std::min(scene.ap_side - 1,
+                     static_cast<int>((y + kRangeM) / scene.ap_spacing_m) + 1);
+  for (int ay = ay0; ay <= ay1; ++ay) {
+    for (int ax = ax0; ax <= ax1; ++ax) {
+      float dx = (ax + 0.5f) * scene.ap_spacing_m - x;
+      float dy = (ay + 0.5f) * scene.ap_spacing_m - y;
+      float d = std::max(sqrtf(dx * dx + dy * dy), 1.0f);
+      uint32_t ap = static_cast<uint32_t>(ay * scene.ap_side + ax);
+      float rssi = kRssiAt1mDbm - 10 * kPathLossExponent * log10f(d) +
+                   Shadowing(scene, block, ap) + noise();
+      if (rssi >= kFloorDbm) {
+        out->Add(ApBssid(ap), roundf(rssi));
+      }
+    }
+  }
+  out->Sort();
+}
+
+inline float NoNoise() { return 0; }
+}  // namespace survey
+
+inline SurveyScene MakeSurveyScene(int side) {
+  SurveyScene scene;
+  scene.side = side;
+  scene.ap_spacing_m = 15;
+  scene.ap_side = static_cast<int>(side / scene.ap_spacing_m) + 1;
+  scene.shadowing_db = 4;
+  return scene;
+}
+
+inline uint32_t SurveyPointCount(const SurveyScene& scene) {
+  return static_cast<uint32_t>(scene.side) * scene.side;
+}
+
+inline ReferencePoint SurveyPoint(const SurveyScene& scene, uint32_t id) {
+  ReferencePoint point;
+  point.x = static_cast<float>(id % scene.side);
+  point.y = static_cast<float>(id / scene.side);
+  point.floor = 0;
+  return point;
+}
+
+inline void SurveyFingerprint(const SurveyScene& scene, uint32_t id,
+                              SparseFingerprint* out) {
+  ReferencePoint point = SurveyPoint(scene, id);
+  survey::HearAps(scene, point.x, point.y,
+                  survey::ShadowingBlock(scene, id % scene.side, id / scene.side),
+                  survey::NoNoise, out);
+}
+
+inline void AddSurvey(const SurveyScene& scene, FingerprintMatcher* matcher) {
+  SparseFingerprint fingerprint;
+  for (uint32_t id = 0; id < SurveyPointCount(scene); ++id) {
+    SurveyFingerprint(scene, id, &fingerprint);
+    matcher->Add(SurveyPoint(scene, id), fingerprint);
+  }
+  matcher->BuildIndex();
+}
+
+// A live scan at a random spot of the surveyed area: the shadowing of the
+// nearest point's block plus |noise_db| of measurement noise per AP.
+inline void LiveScan(const SurveyScene& scene, float noise_db,
+                     std::mt19937& random, SparseFingerprint* out, float* x,
+                     float* y) {
+  std::uniform_real_distribution<float> position(0, scene.side - 1.0f);
+  std::normal_distribution<float> noise(0, noise_db);
+  *x = position(random);
+  *y = position(random);
+  uint32_t block = survey::ShadowingBlock(scene, static_cast<int>(roundf(*x)),
+                                         static_cast<int>(roundf(*y)));
+  survey::HearAps(scene, *x, *y, block, [&] { return noise(random); }, out);
+}
+
+// The matcher's distance, computed directly over the union of APs.
+inline float ExactDistance(const SparseFingerprint& a, const SparseFingerprint& b,
+                           float missing_rssi_dbm, uint32_t* common) {
+  float sum = 0;
+  size_t i = 0;
+  size_t j = 0;
+  *common = 0;
+  while (i < a.Size() || j < b.Size()) {
+    float d;
+    if (j == b.Size() || (i < a.Size() && a.bssids[i] < b.bssids[j])) {
+      d = a.rssi[i++] - missing_rssi_dbm;
+    } else if (i == a.Size() || b.bssids[j] < a.bssids[i]) {
+      d = b.rssi[j++] - missing_rssi_dbm;
+    } else {
+      d = a.rssi[i++] - b.rssi[j++];
+      ++*common;
+    }
+    sum += d * d;
+  }
+  return sqrtf(sum);
+}
+
+// The |k| closest survey fingerprints sharing at least |min_common| APs with
+// |scan|, found by scoring every one of them.
+inline void ExhaustiveNeighbors(const SurveyScene& scene,
+                                const SparseFingerprint& scan, size_t k,
+                                float missing_rssi_dbm, uint32_t min_common,
+                                std::vector<FingerprintNeighbor>* neighbors) {
+  neighbors->clear();
+  SparseFingerprint fingerprint;
+  for (uint32_t id = 0; id < SurveyPointCount(scene); ++id) {
+    SurveyFingerprint(scene, id, &fingerprint);
+    FingerprintNeighbor neighbor;
+    neighbor.id = id;
+    neighbor.distance =
+        ExactDistance(scan, fingerprint, missing_rssi_dbm, &neighbor.common_aps);
+    if (neighbor.common_aps && neighbor.common_aps >= min_common) {
+      neighbors->push_back(neighbor);
+    }
+  }
+  size_t keep = std::min(k, neighbors->size());
+  std::partial_sort(neighbors->begin(), neighbors->begin() + keep, neighbors->end(),
+                    [](const FingerprintNeighbor& a, const FingerprintNeighbor& b) {
+                      return a.distance != b.distance ? a.distance < b.distance
+                                                      : a.id < b.id;
+                    });
+  neighbors->resize(keep);
+}
+
+// Distance from (x, y) to the mean position of |neighbors|.
+inline float NeighborError(const FingerprintMatcher& matcher,
+                           const std::vector<FingerprintNeighbor>& neighbors,
+                           float x, float y) {
+  if (neighbors.empty()) {
+    return INFINITY;
+  }
+  float mx = 0;
+  float my = 0;
+  for (size_t i = 0; i < neighbors.size(); ++i) {
+    mx += matcher.Point(neighbors[i].id).x;
+    my += matcher.Point(neighbors[i].id).y;
+  }
+  mx = mx / neighbors.size() - x;
+  my = my / neighbors.size() - y;
+  return sqrtf(mx * mx + my * my);
+}
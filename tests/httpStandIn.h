@@ -0,0 +1,215 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// A loopback HTTP server standing in for the report collector, which can be
+// told to fail in the ways a real one does, and a SpoolUploadTransport that
+// POSTs batches to it. POSIX only, like the rest of the harness.
+#pragma once
+
+#include "wifi_scanSpool.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class StandInHttpServer {
+public:
+  enum Mode {
+    // 200, and the reports are recorded.
+    SERVE,
+    // 503 after reading the request.
+    UNAVAILABLE,
+    // Connection closed without a response.
+    DROP
+  };
+
+  StandInHttpServer() : listen_fd_(-1), port_(0), mode_(SERVE), requests_(0) {}
+  ~StandInHttpServer() { Stop(); }
+
+  bool Start() {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) {
+      return false;
+    }
+    int one = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) ||
+        listen(listen_fd_, 64) ||
+        getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &length)) {
+      close(listen_fd_);
+      listen_fd_ = -1;
+      return false;
+    }
+    port_ = ntohs(address.sin_port);
+    thread_ = std::thread(&StandInHttpServer::AcceptLoop, this);
+    return true;
+  }
+
+  void Stop() {
+    if (listen_fd_ >= 0) {
+      shutdown(listen_fd_, SHUT_RDWR);
+      close(listen_fd_);
+      listen_fd_ = -1;
+    }
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  int Port() const { return port_; }
+  void SetMode(Mode mode) { mode_.store(mode); }
+  int Requests() const { return requests_.load(); }
+
+  // Sequence numbers of every report accepted, in arrival order.
+  std::vector<uint64_t> Received() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return received_;
+  }
+
+private:
+  void AcceptLoop() {
+    while (true) {
+      int fd = accept(listen_fd_, NULL, NULL);
+      if (fd < 0) {
+        return;
+      }
+      Handle(fd);
+      close(fd);
+    }
+  }
+
+  void Handle(int fd) {
+    ++requests_;
+    Mode mode = static_cast<Mode>(mode_.load());
+    if (mode == DROP) {
+      return;
+    }
+    std::string request;
+    char chunk[16384];
+    size_t body_start = std::string::npos;
+    size_t content_length = 0;
+    while (body_start == std::string::npos ||
+           request.size() < body_start + content_length) {
+      ssize_t n = read(fd, chunk, sizeof(chunk));
+      if (n <= 0) {
+        return;
+      }
+      request.append(chunk, n);
+      if (body_start == std::string::npos) {
+        size_t end = request.find("\r\n\r\n");
+        if (end != std::string::npos) {
+          body_start = end + 4;
+          const char* header = strstr(request.c_str(), "Content-Length: ");
+          content_length = header ? strtoul(header + 16, NULL, 10) : 0;
+        }
+      }
+    }
+    const char* response;
+    if (mode == UNAVAILABLE) {
+      response = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n"
+                 "Connection: close\r\n\r\n";
+    } else {
+      Record(request.c_str() + body_start, content_length);
+      response = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    }
+    ssize_t ignored = write(fd, response, strlen(response));
+    (void)ignored;
+  }
+
+  // The body holds one "sequence timestamp count" line per report.
+  void Record(const char* body, size_t length) {
+    std::string text(body, length);
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t line = 0;
+    while (line < text.size()) {
+      received_.push_back(strtoull(text.c_str() + line, NULL, 10));
+      size_t next = text.find('\n', line);
+      line = next == std::string::npos ? text.size() : next + 1;
+    }
+  }
+
+  int listen_fd_;
+  int port_;
+  std::atomic<int> mode_;
+  std::atomic<int> requests_;
+  std::mutex mutex_;
+  std::vector<uint64_t> received_;
+  std::thread thread_;
+};
+
+// Posts each batch as one request; anything but a 2xx is a failure.
+class HttpUploadTransport : public SpoolUploadTransport {
+public:
+  explicit HttpUploadTransport(int port) : port_(port) {}
+
+  bool Upload(const std::vector<SpooledReport>& batch) {
+    std::string body;
+    char line[96];
+    for (size_t i = 0; i < batch.size(); ++i) {
+      snprintf(line, sizeof(line), "%llu %lld %zu\n",
+               static_cast<unsigned long long>(batch[i].sequence),
+               static_cast<long long>(batch[i].timestamp_ms),
+               batch[i].access_points.size());
+      body += line;
+    }
+    char header[160];
+    snprintf(header, sizeof(header),
+             "POST /reports HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+             "Content-Length: %zu\r\nConnection: close\r\n\r\n", body.size());
+    std::string request = header + body;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+      return false;
+    }
+    timeval timeout = { 2, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(port_));
+    bool ok = false;
+    if (!connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) &&
+        WriteAll(fd, request)) {
+      char status[64];
+      ssize_t n = read(fd, status, sizeof(status) - 1);
+      if (n > 12) {
+        status[n] = '\0';
+        ok = !strncmp(status, "HTTP/1.1 2", 10);
+      }
+    }
+    close(fd);
+    return ok;
+  }
+
+private:
+  static bool WriteAll(int fd, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+      ssize_t n = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+      if (n <= 0) {
+        return false;
+      }
+      written += n;
+    }
+    return true;
+  }
+
+  int port_;
+};
@@ -0,0 +1,95 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Ingest throughput against thread count on a synthetic report stream, next
+// to a single-threaded map keyed by MAC string like the one it replaces.
+//
+//   ingestEngine_bench [reports] [max threads]
+
+#include "wifi_ingestEngine.h"
+#include "wifi_radioEnvironment.h"
+#include "test.h"
+#include <stdlib.h>
+#include <string>
+#include <unordered_map>
+
+namespace {
+const size_t kBatchSize = 64;
+
+std::vector<ScanReport> MakeStream(int reports) {
+  // Many clients in one large venue, so BSSIDs repeat across reports.
+  RadioEnvironmentOptions options;
+  options.access_point_count = 20000;
+  options.width_m = 1000;
+  options.height_m = 1000;
+  options.scan_interval_s = 60;
+  std::vector<ScanReport> stream(reports);
+  const int kClients = 64;
+  for (int c = 0; c < kClients; ++c) {
+    options.seed = 1000 + c;
+    RadioEnvironmentGenerator generator(options);
+    for (int r = c; r < reports; r += kClients) {
+      generator.Step();
+      generator.GetAccessPoints(stream[r]);
+    }
+  }
+  return stream;
+}
+
+double RunEngine(const std::vector<ScanReport>& stream, int threads) {
+  ScanIngestEngine::Options options;
+  options.parser_threads = threads;
+  options.shard_count = threads;
+  ScanIngestEngine engine(options);
+  // Batches are copied up front so only ingestion is timed.
+  std::vector<std::vector<ScanReport> > batches;
+  for (size_t r = 0; r < stream.size(); r += kBatchSize) {
+    batches.push_back(std::vector<ScanReport>(
+        stream.begin() + r, stream.begin() + std::min(stream.size(), r + kBatchSize)));
+  }
+  double start = NowSeconds();
+  for (size_t b = 0; b < batches.size(); ++b) {
+    engine.Submit(batches[b]);
+  }
+  engine.Flush();
+  return NowSeconds() - start;
+}
+
+double RunStringMap(const std::vector<ScanReport>& stream) {
+  struct Stats {
+    uint64_t observations;
+    int64_t rssi_sum;
+  };
+  std::unordered_map<std::string, Stats> map;
+  double start = NowSeconds();
+  for (size_t r = 0; r < stream.size(); ++r) {
+    for (size_t i = 0; i < stream[r].size(); ++i) {
+      Stats& stats = map[stream[r][i].mac_address];
+      ++stats.observations;
+      stats.rssi_sum += stream[r][i].radio_signal_strength;
+    }
+  }
+  return NowSeconds() - start;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  int reports = argc > 1 ? atoi(argv[1]) : 40000;
+  int max_threads = argc > 2 ? atoi(argv[2]) : 8;
+  std::vector<ScanReport> stream = MakeStream(reports);
+  size_t observations = 0;
+  for (size_t r = 0; r < stream.size(); ++r) {
+    observations += stream[r].size();
+  }
+  printf("%d reports, %zu observations, %u hardware threads\n", reports,
+         observations, std::thread::hardware_concurrency());
+  double baseline = RunStringMap(stream);
+  printf("string map, 1 thread     %8.2f M obs/s\n", observations / baseline / 1e6);
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    double elapsed = RunEngine(stream, threads);
+    printf("engine, %2d parser + %2d shard threads  %8.2f M obs/s\n", threads,
+           threads, observations / elapsed / 1e6);
+  }
+  return 0;
+}
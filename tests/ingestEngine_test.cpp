@@ -0,0 +1,146 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_ingestEngine.h"
+#include "wifi_radioEnvironment.h"
+#include "test.h"
+#include <map>
+#include <thread>
+
+namespace {
+struct Reference {
+  uint64_t observations;
+  int64_t rssi_sum;
+  int rssi_min;
+  int rssi_max;
+};
+
+// Scan reports from |clients| simulated devices, |scans| each.
+std::vector<ScanReport> MakeReports(int clients, int scans, uint64_t seed) {
+  std::vector<ScanReport> reports;
+  for (int c = 0; c < clients; ++c) {
+    RadioEnvironmentOptions options;
+    options.seed = seed + c;
+    options.access_point_count = 400;
+    RadioEnvironmentGenerator generator(options);
+    for (int s = 0; s < scans; ++s) {
+      generator.Step();
+      reports.push_back(ScanReport());
+      generator.GetAccessPoints(reports.back());
+    }
+  }
+  return reports;
+}
+
+void AddToReference(const std::vector<ScanReport>& reports,
+                    std::map<PackedBssid, Reference>& reference) {
+  for (size_t r = 0; r < reports.size(); ++r) {
+    for (size_t i = 0; i < reports[r].size(); ++i) {
+      PackedBssid bssid = ParseBssid(reports[r][i].mac_address);
+      int rssi = reports[r][i].radio_signal_strength;
+      std::map<PackedBssid, Reference>::iterator it = reference.find(bssid);
+      if (it == reference.end()) {
+        Reference first = { 1, rssi, rssi, rssi };
+        reference[bssid] = first;
+        continue;
+      }
+      ++it->second.observations;
+      it->second.rssi_sum += rssi;
+      it->second.rssi_min = std::min(it->second.rssi_min, rssi);
+      it->second.rssi_max = std::max(it->second.rssi_max, rssi);
+    }
+  }
+}
+
+void ExpectMatches(const IngestSnapshot& snapshot,
+                   const std::map<PackedBssid, Reference>& reference) {
+  EXPECT_EQ(reference.size(), snapshot.entries.size());
+  for (std::map<PackedBssid, Reference>::const_iterator it = reference.begin();
+       it != reference.end(); ++it) {
+    const BssidStats* stats = snapshot.Find(it->first);
+    EXPECT(stats != NULL);
+    if (!stats) {
+      continue;
+    }
+    EXPECT_EQ(it->second.observations, stats->observations);
+    EXPECT_EQ(it->second.rssi_sum, stats->rssi_sum);
+    EXPECT_EQ(it->second.rssi_min, stats->rssi_min);
+    EXPECT_EQ(it->second.rssi_max, stats->rssi_max);
+  }
+}
+
+void TestAggregatesLikeReference() {
+  std::vector<ScanReport> reports = MakeReports(8, 60, 100);
+  std::map<PackedBssid, Reference> reference;
+  AddToReference(reports, reference);
+
+  ScanIngestEngine::Options options;
+  options.parser_threads = 3;
+  options.shard_count = 4;
+  options.route_batch_size = 64;
+  ScanIngestEngine engine(options);
+  // Several submitters at once, in small batches.
+  const int kSubmitters = 4;
+  std::vector<std::thread> submitters;
+  for (int t = 0; t < kSubmitters; ++t) {
+    submitters.push_back(std::thread([&reports, t] (ScanIngestEngine* engine) {
+      for (size_t r = 10 * t; r < reports.size(); r += 10 * kSubmitters) {
+        std::vector<ScanReport> batch;
+        for (size_t k = r; k < std::min(reports.size(), r + 10); ++k) {
+          batch.push_back(reports[k]);
+        }
+        engine->Submit(batch);
+      }
+    }, &engine));
+  }
+  for (size_t t = 0; t < submitters.size(); ++t) {
+    submitters[t].join();
+  }
+  std::shared_ptr<const IngestSnapshot> snapshot = engine.TakeSnapshot();
+  EXPECT_EQ(reports.size(), snapshot->reports);
+  EXPECT_EQ(reports.size(), engine.ReportsIngested());
+  ExpectMatches(*snapshot, reference);
+}
+
+void TestSnapshotCoversExactlyPriorReports() {
+  std::vector<ScanReport> reports = MakeReports(2, 100, 7);
+  ScanIngestEngine::Options options;
+  options.parser_threads = 2;
+  options.shard_count = 3;
+  ScanIngestEngine engine(options);
+  std::map<PackedBssid, Reference> reference;
+  for (size_t r = 0; r < reports.size(); r += 25) {
+    std::vector<ScanReport> batch(reports.begin() + r, reports.begin() + r + 25);
+    AddToReference(batch, reference);
+    engine.Submit(batch);
+    std::shared_ptr<const IngestSnapshot> snapshot = engine.TakeSnapshot();
+    EXPECT_EQ(r + 25, snapshot->reports);
+    ExpectMatches(*snapshot, reference);
+    EXPECT(engine.LatestSnapshot() == snapshot);
+  }
+}
+
+void TestMalformedMacsAreCounted() {
+  ScanIngestEngine::Options options;
+  options.parser_threads = 1;
+  options.shard_count = 1;
+  ScanIngestEngine engine(options);
+  std::vector<ScanReport> batch(1);
+  AccessPoint good = { "0011223344aa", -60, "x" };
+  AccessPoint bad = { "not a mac", -60, "x" };
+  batch[0].push_back(good);
+  batch[0].push_back(bad);
+  engine.Submit(batch);
+  engine.Flush();
+  EXPECT_EQ(1u, engine.MalformedBssids());
+  EXPECT_EQ(1u, engine.TakeSnapshot()->entries.size());
+}
+}  // namespace
+
+int main() {
+  TestAggregatesLikeReference();
+  TestSnapshotCoversExactlyPriorReports();
+  TestMalformedMacsAreCounted();
+  return TestExitCode();
+}
@@ -0,0 +1,106 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_interfaceRegistry.h"
+#include "test.h"
+#include <stdio.h>
+#include <thread>
+
+namespace {
+const int kReaders = 4;
+const int kHotPlugRounds = 2000;
+
+void TestIncrementalChanges() {
+  FakeInterfaceChangeSource source;
+  source.Plug("wlan0");
+  InterfaceRegistry registry(&source);
+  EXPECT(registry.Start());
+  EXPECT_EQ(1, source.EnumerationCount());
+
+  std::shared_ptr<const InterfaceList> cached;
+  EXPECT(registry.Sync(&cached));
+  EXPECT_EQ(1u, cached->names.size());
+  EXPECT(!registry.Sync(&cached));
+
+  source.Plug("wlan1");
+  source.Unplug("wlan0");
+  EXPECT(registry.Sync(&cached));
+  EXPECT_EQ(1u, cached->names.size());
+  EXPECT(cached->names[0] == "wlan1");
+  // Single changes never enumerate again.
+  EXPECT_EQ(1, source.EnumerationCount());
+  EXPECT_EQ(2u, registry.GetStats().incremental_changes);
+
+  std::vector<std::string> names;
+  names.push_back("wlan2");
+  names.push_back("wlan3");
+  source.Replace(names);
+  EXPECT_EQ(2, source.EnumerationCount());
+  EXPECT(registry.Current()->names == names);
+  EXPECT_EQ(registry.Version(), registry.Current()->version);
+}
+
+// A list a reader holds never changes under it, however often the registry
+// publishes, so indexing it by its own size is always safe.
+void TestPinnedListsSurviveHotPlug() {
+  FakeInterfaceChangeSource source;
+  InterfaceRegistry registry(&source);
+  EXPECT(registry.Start());
+
+  std::atomic<bool> done(false);
+  std::atomic<int> torn(0);
+  std::vector<std::thread> readers;
+  for (int r = 0; r < kReaders; ++r) {
+    readers.push_back(std::thread([&registry, &done, &torn, r]() {
+      std::shared_ptr<const InterfaceList> cached;
+      while (!done.load()) {
+        // Half the readers sync a cached list, as scans do; the rest load
+        // the current one, as per-interface queries do.
+        std::shared_ptr<const InterfaceList> list;
+        if (r % 2) {
+          list = registry.Current();
+        } else {
+          registry.Sync(&cached);
+          list = cached;
+        }
+        size_t count = list->names.size();
+        for (size_t i = 0; i < count; ++i) {
+          if (list->names[i].compare(0, 4, "wlan") != 0) {
+            ++torn;
+          }
+        }
+        if (list->names.size() != count) {
+          ++torn;
+        }
+      }
+    }));
+  }
+
+  char name[16];
+  for (int i = 0; i < kHotPlugRounds; ++i) {
+    snprintf(name, sizeof(name), "wlan%d", i % 8);
+    if (i % 3 == 2) {
+      source.Unplug(name);
+    } else {
+      source.Plug(name);
+    }
+  }
+  done.store(true);
+  for (size_t r = 0; r < readers.size(); ++r) {
+    readers[r].join();
+  }
+  EXPECT_EQ(0, torn.load());
+
+  std::shared_ptr<const InterfaceList> cached;
+  EXPECT(registry.Sync(&cached));
+  EXPECT_EQ(registry.Version(), cached->version);
+  EXPECT_EQ(registry.GetStats().versions_published + 1, cached->version);
+}
+}  // namespace
+
+int main() {
+  TestIncrementalChanges();
+  TestPinnedListsSurviveHotPlug();
+  return TestExitCode();
+}
@@ -0,0 +1,136 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Notification cost with many listeners: how long Publish() holds up the
+// scan thread and how long until every listener has the scan, against
+// calling every listener in turn on the scan thread.
+//
+//   listenerFanout_bench [scans per case]
+
+#include "wifi_listenerFanout.h"
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+
+namespace {
+const int kAccessPoints = 40;
+
+class CountingListener : public ScanUpdateListener {
+public:
+  CountingListener(std::atomic<int>* delivered, int work_us)
+      : delivered_(delivered), work_us_(work_us) {}
+  void OnScanUpdate(const std::vector<AccessPoint>& accessPoints) {
+    // Stand-in for a listener doing something with the scan.
+    double until = NowSeconds() + work_us_ * 1e-6;
+    size_t strongest = 0;
+    do {
+      for (size_t i = 1; i < accessPoints.size(); ++i) {
+        if (accessPoints[i].radio_signal_strength >
+            accessPoints[strongest].radio_signal_strength) {
+          strongest = i;
+        }
+      }
+    } while (NowSeconds() < until);
+    sink_ = strongest;
+    delivered_->fetch_add(1);
+  }
+
+private:
+  std::atomic<int>* delivered_;
+  int work_us_;
+  volatile size_t sink_;
+};
+
+std::vector<AccessPoint> MakeScan(int scan) {
+  std::vector<AccessPoint> aps(kAccessPoints);
+  for (int i = 0; i < kAccessPoints; ++i) {
+    char mac[16];
+    snprintf(mac, sizeof(mac), "%04x%08x", scan & 0xffff, i);
+    aps[i].mac_address = mac;
+    aps[i].radio_signal_strength = -40 - (i * 7 + scan) % 50;
+    aps[i].ssid = "bench";
+  }
+  return aps;
+}
+
+double Percentile(std::vector<double>& values, double fraction) {
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1,
+                         static_cast<size_t>(fraction * values.size()))];
+}
+
+void Run(int listener_count, int work_us, int workers, int scans) {
+  std::atomic<int> delivered(0);
+  std::vector<std::unique_ptr<CountingListener> > listeners;
+  for (int i = 0; i < listener_count; ++i) {
+    listeners.push_back(std::unique_ptr<CountingListener>(
+        new CountingListener(&delivered, work_us)));
+  }
+  std::vector<std::vector<AccessPoint> > inputs;
+  for (int s = 0; s < scans; ++s) {
+    inputs.push_back(MakeScan(s));
+  }
+
+  std::vector<double> publish_us, all_notified_us;
+  if (!workers) {
+    // Baseline: every listener called in turn on the scan thread.
+    for (int s = 0; s < scans; ++s) {
+      double start = NowSeconds();
+      for (int i = 0; i < listener_count; ++i) {
+        listeners[i]->OnScanUpdate(inputs[s]);
+      }
+      double done = (NowSeconds() - start) * 1e6;
+      publish_us.push_back(done);
+      all_notified_us.push_back(done);
+    }
+  } else {
+    ListenerFanout fanout(workers);
+    ListenerPolicy policy;
+    policy.change_threshold = 0;
+    for (int i = 0; i < listener_count; ++i) {
+      fanout.AddListener(listeners[i].get(), policy);
+    }
+    for (int s = 0; s < scans; ++s) {
+      delivered.store(0);
+      double start = NowSeconds();
+      fanout.Publish(inputs[s]);
+      publish_us.push_back((NowSeconds() - start) * 1e6);
+      while (delivered.load() < listener_count) {
+        std::this_thread::yield();
+      }
+      all_notified_us.push_back((NowSeconds() - start) * 1e6);
+    }
+    for (int i = 0; i < listener_count; ++i) {
+      fanout.RemoveListener(listeners[i].get());
+    }
+  }
+
+  char mode[24];
+  if (workers) {
+    snprintf(mode, sizeof(mode), "fan-out, %d workers", workers);
+  } else {
+    snprintf(mode, sizeof(mode), "inline loop");
+  }
+  printf("%5d listeners %4d us each  %-20s publish p50 %8.1f us p99 %8.1f us"
+         "  all notified p50 %9.1f us p99 %9.1f us\n",
+         listener_count, work_us, mode, Percentile(publish_us, 0.5),
+         Percentile(publish_us, 0.99), Percentile(all_notified_us, 0.5),
+         Percentile(all_notified_us, 0.99));
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  int scans = argc > 1 ? atoi(argv[1]) : 200;
+  const int kListeners[] = { 100, 1000 };
+  const int kWorkUs[] = { 0, 20 };
+  for (int l = 0; l < 2; ++l) {
+    for (int w = 0; w < 2; ++w) {
+      Run(kListeners[l], kWorkUs[w], 0, scans);
+      Run(kListeners[l], kWorkUs[w], 2, scans);
+    }
+  }
+  return 0;
+}
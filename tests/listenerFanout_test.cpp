@@ -0,0 +1,146 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_listenerFanout.h"
+#include "test.h"
+#include <stdio.h>
+#include <atomic>
+
+namespace {
+class RecordingListener : public ScanUpdateListener {
+public:
+  RecordingListener() : calls(0), last_size(0), delay_ms(0) {}
+  void OnScanUpdate(const std::vector<AccessPoint>& accessPoints) {
+    if (delay_ms) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+    }
+    last_size.store(static_cast<int>(accessPoints.size()));
+    ++calls;
+  }
+  std::atomic<int> calls;
+  std::atomic<int> last_size;
+  int delay_ms;
+};
+
+// |count| APs with BSSIDs first, first + 1, ...
+std::vector<AccessPoint> MakeScan(int first, int count) {
+  std::vector<AccessPoint> scan(count);
+  for (int i = 0; i < count; ++i) {
+    char mac[16];
+    snprintf(mac, sizeof(mac), "0000%08x", first + i);
+    scan[i].mac_address = mac;
+    scan[i].radio_signal_strength = -50;
+  }
+  return scan;
+}
+
+template <typename Predicate>
+bool WaitFor(Predicate predicate) {
+  for (int i = 0; i < 400; ++i) {
+    if (predicate()) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  return predicate();
+}
+
+void TestEveryListenerGetsLatest() {
+  const int kListeners = 150;
+  ListenerFanout fanout(4);
+  std::vector<std::unique_ptr<RecordingListener> > listeners;
+  ListenerPolicy policy;
+  policy.change_threshold = 0;
+  for (int i = 0; i < kListeners; ++i) {
+    listeners.push_back(std::unique_ptr<RecordingListener>(new RecordingListener()));
+    fanout.AddListener(listeners.back().get(), policy);
+  }
+  for (int scan = 1; scan <= 20; ++scan) {
+    fanout.Publish(MakeScan(0, scan));
+  }
+  EXPECT(WaitFor([&] {
+    for (int i = 0; i < kListeners; ++i) {
+      if (listeners[i]->last_size.load() != 20) {
+        return false;
+      }
+    }
+    return true;
+  }));
+  ListenerFanout::Stats stats = fanout.GetStats();
+  EXPECT_EQ(20u, stats.published);
+  // Every listener saw or skipped every scan, and nothing was delivered twice.
+  EXPECT_EQ(20u * kListeners, stats.delivered + stats.coalesced);
+  for (int i = 0; i < kListeners; ++i) {
+    fanout.RemoveListener(listeners[i].get());
+  }
+}
+
+void TestChangeThreshold() {
+  ListenerFanout fanout(1);
+  RecordingListener listener;
+  ListenerPolicy policy;
+  policy.change_threshold = 3;
+  fanout.AddListener(&listener, policy);
+  fanout.Publish(MakeScan(0, 10));
+  EXPECT(WaitFor([&] { return listener.calls.load() == 1; }));
+  // Two BSSIDs swapped for two others: four changes.
+  fanout.Publish(MakeScan(2, 10));
+  EXPECT(WaitFor([&] { return listener.calls.load() == 2; }));
+  // One more AP: below the threshold.
+  fanout.Publish(MakeScan(2, 11));
+  EXPECT(WaitFor([&] { return fanout.GetStats().below_threshold == 1; }));
+  EXPECT_EQ(2, listener.calls.load());
+  fanout.RemoveListener(&listener);
+}
+
+void TestRateLimitCoalesces() {
+  ListenerFanout fanout(2);
+  RecordingListener listener;
+  ListenerPolicy policy;
+  policy.change_threshold = 0;
+  policy.min_interval_ms = 100;
+  fanout.AddListener(&listener, policy);
+  double start = NowSeconds();
+  for (int i = 1; i <= 30; ++i) {
+    fanout.Publish(MakeScan(0, i));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  EXPECT(WaitFor([&] { return listener.last_size.load() == 30; }));
+  double elapsed = NowSeconds() - start;
+  // At most one delivery per interval, plus the first.
+  EXPECT(listener.calls.load() <= 2 + static_cast<int>(elapsed * 10));
+  EXPECT(fanout.GetStats().coalesced > 0);
+  fanout.RemoveListener(&listener);
+}
+
+// A slow listener holds up neither Publish() nor the other listeners.
+void TestSlowListenerDoesNotBlock() {
+  ListenerFanout fanout(2);
+  RecordingListener slow;
+  slow.delay_ms = 300;
+  RecordingListener fast;
+  ListenerPolicy policy;
+  policy.change_threshold = 0;
+  fanout.AddListener(&slow, policy);
+  fanout.AddListener(&fast, policy);
+  double start = NowSeconds();
+  for (int i = 1; i <= 5; ++i) {
+    fanout.Publish(MakeScan(0, i));
+  }
+  EXPECT(NowSeconds() - start < 0.1);
+  EXPECT(WaitFor([&] { return fast.last_size.load() == 5; }));
+  EXPECT(NowSeconds() - start < 0.3);
+  fanout.RemoveListener(&fast);
+  fanout.RemoveListener(&slow);
+  EXPECT(slow.calls.load() >= 1);
+}
+}  // namespace
+
+int main() {
+  TestEveryListenerGetsLatest();
+  TestChangeThreshold();
+  TestRateLimitCoalesces();
+  TestSlowListenerDoesNotBlock();
+  return TestExitCode();
+}
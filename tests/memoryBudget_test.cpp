@@ -0,0 +1,320 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_memoryBudget.h"
+#include "wifi_accessPointAger.h"
+#include "wifi_scanCoalescer.h"
+#include "wifi_scanLocationCache.h"
+#include "test.h"
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+
+namespace {
+const size_t kLimit = 4 << 20;
+// Dense scans: thousands of APs each, drawn from a pool that keeps sliding,
+// so the history and the cache grow without bound unless the budget trims.
+const int kApsPerScan = 3000;
+const int kNewApsPerScan = 600;
+const int kScans = 60;
+
+// Frees what it is asked for straight away, with an optional delay so a
+// reclaim can be caught in flight.
+class FakeComponent : public MemoryBudgetClient {
+public:
+  FakeComponent(MemoryBudget* budget, int priority, int delay_ms)
+      : budget_(budget), delay_ms_(delay_ms), bytes_(0), releasing_(false),
+        released_(0) {
+    id_ = budget_->Register("fake", priority, this);
+  }
+  ~FakeComponent() { budget_->Unregister(id_); }
+
+  void Set(size_t bytes) {
+    bytes_ = bytes;
+    budget_->Report(id_, bytes);
+  }
+  int Id() const { return id_; }
+  size_t Bytes() const { return bytes_.load(); }
+  bool Releasing() const { return releasing_.load(); }
+  size_t Released() const { return released_.load(); }
+
+  size_t ReleaseMemory(size_t bytes) {
+    releasing_.store(true);
+    if (delay_ms_) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms_));
+    }
+    size_t freed = std::min(bytes, bytes_.load());
+    bytes_ -= freed;
+    released_ += freed;
+    budget_->Report(id_, bytes_.load());
+    return freed;
+  }
+
+private:
+  MemoryBudget* budget_;
+  const int delay_ms_;
+  int id_;
+  std::atomic<size_t> bytes_;
+  std::atomic<bool> releasing_;
+  std::atomic<size_t> released_;
+};
+
+// The query buffer: grows to fit each scan after reserving the room, and
+// is never reclaimed itself.
+class FakeQueryBuffer : public MemoryBudgetClient {
+public:
+  explicit FakeQueryBuffer(MemoryBudget* budget)
+      : budget_(budget), denied_(0) {
+    id_ = budget_->Register("query buffer", MemoryBudget::PRIORITY_QUERY_BUFFER,
+                            this);
+  }
+  ~FakeQueryBuffer() { budget_->Unregister(id_); }
+
+  void Fit(size_t bytes) {
+    if (bytes > buffer_.capacity()) {
+      if (!budget_->Reserve(id_, bytes - buffer_.capacity())) {
+        ++denied_;
+        return;
+      }
+      buffer_.reserve(bytes);
+    }
+    budget_->Report(id_, buffer_.capacity());
+  }
+  int Denied() const { return denied_; }
+
+  size_t ReleaseMemory(size_t bytes) {
+    (void)bytes;
+    return 0;
+  }
+
+private:
+  MemoryBudget* budget_;
+  int id_;
+  std::vector<char> buffer_;
+  int denied_;
+};
+
+class DenseQuery : public AccessPointQuery {
+public:
+  DenseQuery() : next_(0) {}
+  bool QueryAccessPoints(std::vector<AccessPoint>& outData) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    outData.clear();
+    for (int i = 0; i < kApsPerScan; ++i) {
+      uint32_t ap = next_ + i;
+      char mac[18];
+      snprintf(mac, sizeof(mac), "02:00:%02x:%02x:%02x:%02x", (ap >> 24) & 0xff,
+               (ap >> 16) & 0xff, (ap >> 8) & 0xff, ap & 0xff);
+      AccessPoint access_point;
+      access_point.mac_address = mac;
+      access_point.radio_signal_strength = -30 - static_cast<int>(ap % 60);
+      access_point.ssid = ap % 4 ? "dense-venue-guest-network" : "venue";
+      outData.push_back(access_point);
+    }
+    next_ += kNewApsPerScan;
+    return true;
+  }
+
+private:
+  std::mutex mutex_;
+  uint32_t next_;
+};
+
+CachedPosition PositionFor(int scan) {
+  CachedPosition position = { 51.0 + scan * 1e-4, -0.1, 20 };
+  return position;
+}
+
+void TestReclaimsLowestPriorityFirst() {
+  MemoryBudget budget(1000);
+  FakeComponent cache(&budget, MemoryBudget::PRIORITY_CACHE, 0);
+  FakeComponent history(&budget, MemoryBudget::PRIORITY_HISTORY, 0);
+  FakeComponent results(&budget, MemoryBudget::PRIORITY_RESULTS, 0);
+  cache.Set(300);
+  history.Set(400);
+  results.Set(200);
+  results.Set(500);
+  EXPECT_EQ(100u, cache.Bytes());
+  EXPECT_EQ(400u, history.Bytes());
+  EXPECT_EQ(500u, results.Bytes());
+  results.Set(900);
+  EXPECT_EQ(100u, history.Bytes());
+  EXPECT(budget.Used() <= budget.Limit());
+  EXPECT_EQ(0u, budget.GetStats().over_budget);
+
+  // A reservation only reclaims from lower priorities.
+  EXPECT(!budget.Reserve(history.Id(), 200));
+  EXPECT_EQ(100u, history.Bytes());
+  EXPECT(budget.Reserve(results.Id(), 100));
+  EXPECT_EQ(0u, history.Bytes());
+}
+
+// A reservation arriving while another thread reclaims waits for it, and
+// gets the room it freed, rather than being refused.
+void TestReserveWaitsForReclaimInFlight() {
+  MemoryBudget budget(1000);
+  FakeComponent cache(&budget, MemoryBudget::PRIORITY_CACHE, 200);
+  FakeComponent history(&budget, MemoryBudget::PRIORITY_HISTORY, 0);
+  FakeComponent buffer(&budget, MemoryBudget::PRIORITY_QUERY_BUFFER, 0);
+  cache.Set(600);
+  std::thread grower([&history] { history.Set(800); });
+  while (!cache.Releasing()) {
+    std::this_thread::yield();
+  }
+  EXPECT(budget.Reserve(buffer.Id(), 100));
+  grower.join();
+  EXPECT_EQ(0u, budget.GetStats().denied_reservations);
+  EXPECT(budget.Used() <= budget.Limit());
+}
+
+// A reservation counts against the limit until the component reports, so
+// two growers cannot both take the last room; a report of what it actually
+// holds gives back what it did not use.
+void TestReservationHeldUntilReport() {
+  MemoryBudget budget(1000);
+  FakeComponent first(&budget, MemoryBudget::PRIORITY_QUERY_BUFFER, 0);
+  // Lower priority, so its reservations cannot reclaim from the first.
+  FakeComponent second(&budget, MemoryBudget::PRIORITY_RESULTS, 0);
+  first.Set(200);
+  EXPECT(budget.Reserve(first.Id(), 500));
+  EXPECT_EQ(700u, budget.Used());
+  EXPECT(!budget.Reserve(second.Id(), 500));
+  EXPECT(budget.Reserve(second.Id(), 300));
+  EXPECT_EQ(1000u, budget.Used());
+
+  // The first grew by less than it reserved, the second not at all.
+  first.Set(400);
+  second.Set(0);
+  EXPECT_EQ(400u, budget.Used());
+  EXPECT(budget.Reserve(second.Id(), 600));
+}
+
+// The ager and cache only free memory on the thread that drives them. A
+// reclaim started elsewhere is promised, counted as freed, and carried out
+// at their next call.
+void TestDefersReleaseToOwningThread() {
+  MemoryBudget budget(kLimit);
+  AccessPointAger::Options options;
+  options.max_missed_scans = 1000;
+  AccessPointAger ager(options);
+  ager.AttachMemoryBudget(&budget);
+  DenseQuery query;
+  std::vector<AccessPoint> scan;
+  AccessPointChanges changes;
+  for (int i = 0; i < 20; ++i) {
+    query.QueryAccessPoints(scan);
+    ager.Update(scan, i * 1000, &changes);
+  }
+  size_t history = ager.MemoryUsage();
+  EXPECT(history > kLimit / 2);
+
+  FakeComponent results(&budget, MemoryBudget::PRIORITY_RESULTS, 0);
+  std::thread other([&results] { results.Set(kLimit / 2); });
+  other.join();
+  EXPECT(budget.GetStats().deferred_bytes > 0);
+  EXPECT_EQ(0u, budget.GetStats().over_budget);
+  EXPECT_EQ(history, ager.MemoryUsage());
+
+  query.QueryAccessPoints(scan);
+  ager.Update(scan, 20000, &changes);
+  EXPECT(ager.MemoryUsage() < history);
+  EXPECT(budget.Used() <= budget.Limit());
+}
+
+// Dense scans through the history, the location cache, the coalesced
+// results and the query buffer on one thread: every step ends within the
+// limit, with the older history and cached places given up to stay there.
+void TestHoldsUnderDenseScans() {
+  MemoryBudget budget(kLimit);
+  AccessPointAger::Options ager_options;
+  ager_options.max_missed_scans = 1000;
+  AccessPointAger ager(ager_options);
+  ScanLocationCache::Options cache_options;
+  ScanLocationCache cache(cache_options);
+  DenseQuery query;
+  ScanCoalescer coalescer(&query);
+  FakeQueryBuffer buffer(&budget);
+  ager.AttachMemoryBudget(&budget);
+  cache.AttachMemoryBudget(&budget);
+  coalescer.AttachMemoryBudget(&budget);
+
+  AccessPointChanges changes;
+  size_t worst = 0;
+  for (int i = 0; i < kScans; ++i) {
+    std::shared_ptr<const ScanCoalescer::Result> result = coalescer.Request(0);
+    buffer.Fit(result->access_points.size() * 40);
+    worst = std::max(worst, budget.Used());
+    ager.Update(result->access_points, i * 1000, &changes);
+    worst = std::max(worst, budget.Used());
+    CachedPosition position;
+    if (!cache.Lookup(result->access_points, &position, NULL)) {
+      cache.Insert(result->access_points, PositionFor(i));
+    }
+    worst = std::max(worst, budget.Used());
+  }
+  MemoryBudget::Stats stats = budget.GetStats();
+  EXPECT(worst <= kLimit);
+  EXPECT(stats.reclaims > 0);
+  EXPECT_EQ(0u, stats.over_budget);
+  EXPECT_EQ(0u, stats.denied_reservations);
+  EXPECT_EQ(0, buffer.Denied());
+  // Without the budget the history would hold every AP ever seen.
+  EXPECT(ager.Size() < static_cast<size_t>(kApsPerScan + kNewApsPerScan * kScans));
+  EXPECT(ager.Size() >= static_cast<size_t>(kApsPerScan) / 2);
+}
+
+// The same load split across threads: results are requested on one, the
+// history and cache are driven on another. Reclaims from the results thread
+// are deferred, so usage may run over between calls, but it is back within
+// the limit once the owning thread has run.
+void TestHoldsAcrossThreads() {
+  MemoryBudget budget(kLimit);
+  AccessPointAger::Options ager_options;
+  ager_options.max_missed_scans = 1000;
+  AccessPointAger ager(ager_options);
+  ScanLocationCache::Options cache_options;
+  ScanLocationCache cache(cache_options);
+  DenseQuery query;
+  ScanCoalescer coalescer(&query);
+  ager.AttachMemoryBudget(&budget);
+  cache.AttachMemoryBudget(&budget);
+  coalescer.AttachMemoryBudget(&budget);
+
+  std::atomic<bool> done(false);
+  std::thread requester([&coalescer, &done] {
+    for (int i = 0; i < kScans; ++i) {
+      coalescer.Request(0);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    done.store(true);
+  });
+  AccessPointChanges changes;
+  int64_t now_ms = 0;
+  bool last = false;
+  while (!last) {
+    last = done.load();
+    std::shared_ptr<const ScanCoalescer::Result> result = coalescer.Latest();
+    if (!result) {
+      std::this_thread::yield();
+      continue;
+    }
+    now_ms += 1000;
+    ager.Update(result->access_points, now_ms, &changes);
+    cache.Insert(result->access_points, PositionFor(static_cast<int>(now_ms)));
+  }
+  requester.join();
+  EXPECT(budget.Used() <= budget.Limit());
+  EXPECT_EQ(0u, budget.GetStats().over_budget);
+}
+}  // namespace
+
+int main() {
+  TestReclaimsLowestPriorityFirst();
+  TestReserveWaitsForReclaimInFlight();
+  TestReservationHeldUntilReport();
+  TestDefersReleaseToOwningThread();
+  TestHoldsUnderDenseScans();
+  TestHoldsAcrossThreads();
+  return TestExitCode();
+}
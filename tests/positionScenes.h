@@ -0,0 +1,50 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Synthetic positioning scenes: APs scattered over a square, RSSI from the
+// solver's own path-loss model plus Gaussian noise, and optionally a share
+// of outliers whose RSSI is off by tens of dB (moved APs, reflections).
+#pragma once
+
+#include "wifi_positionSolver.h"
+#include <math.h>
+#include <random>
+
+struct PositionScene {
+  RssiObservations observations;
+  float true_x;
+  float true_y;
+};
+
+inline void MakePositionScene(std::mt19937& random, int aps, float width_m,
+                              float noise_db, float outlier_fraction,
+                              PositionScene* scene) {
+  PositionSolverOptions model;
+  std::uniform_real_distribution<float> position(0, width_m);
+  std::uniform_real_distribution<float> unit(0, 1);
+  std::normal_distribution<float> noise(0, noise_db);
+  scene->true_x = position(random);
+  scene->true_y = position(random);
+  scene->observations.Clear();
+  for (int i = 0; i < aps; ++i) {
+    float x = position(random);
+    float y = position(random);
+    float dx = x - scene->true_x;
+    float dy = y - scene->true_y;
+    float d = std::max(sqrtf(dx * dx + dy * dy), 1.0f);
+    float rssi = model.rssi_at_1m_dbm -
+                 10 * model.path_loss_exponent * log10f(d) + noise(random);
+    if (unit(random) < outlier_fraction) {
+      rssi += unit(random) < 0.5f ? 25 : -25;
+    }
+    scene->observations.Add(x, y, rssi);
+  }
+}
+
+inline float PositionError(const PositionScene& scene,
+                           const PositionEstimate& estimate) {
+  float dx = estimate.x - scene.true_x;
+  float dy = estimate.y - scene.true_y;
+  return sqrtf(dx * dx + dy * dy);
+}
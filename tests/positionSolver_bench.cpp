@@ -0,0 +1,64 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Solves per second and position error for the centroid and trilateration,
+// with and without outlier rejection, on synthetic scenes.
+//
+//   positionSolver_bench [scenes]
+
+#include "wifi_positionSolver.h"
+#include "positionScenes.h"
+#include "test.h"
+#include <stdlib.h>
+#include <algorithm>
+
+namespace {
+void Run(const char* label, PositionSolver::Method method, int outlier_rounds,
+         int aps, float outlier_fraction, int scene_count) {
+  PositionSolverOptions options;
+  options.outlier_rounds = outlier_rounds;
+  PositionSolver solver(options);
+  std::mt19937 random(42);
+  std::vector<PositionScene> scenes(scene_count);
+  std::vector<RssiObservations> observations(scene_count);
+  for (int s = 0; s < scene_count; ++s) {
+    MakePositionScene(random, aps, 100, 4, outlier_fraction, &scenes[s]);
+    observations[s] = scenes[s].observations;
+  }
+
+  std::vector<PositionEstimate> estimates;
+  int rounds = 0;
+  double start = NowSeconds();
+  double elapsed;
+  do {
+    solver.SolveBatch(method, observations, &estimates, 1);
+    ++rounds;
+    elapsed = NowSeconds() - start;
+  } while (elapsed < 0.5);
+
+  std::vector<float> errors;
+  for (int s = 0; s < scene_count; ++s) {
+    errors.push_back(PositionError(scenes[s], estimates[s]));
+  }
+  std::sort(errors.begin(), errors.end());
+  printf("%-24s %3d APs %3.0f%% outliers  %9.0f solves/s  median %5.1f m  p90 %5.1f m\n",
+         label, aps, outlier_fraction * 100, rounds * scene_count / elapsed,
+         errors[errors.size() / 2], errors[errors.size() * 9 / 10]);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  int scenes = argc > 1 ? atoi(argv[1]) : 2000;
+  const int kAps[] = { 8, 32 };
+  const float kOutliers[] = { 0, 0.2f };
+  for (int a = 0; a < 2; ++a) {
+    for (int o = 0; o < 2; ++o) {
+      Run("centroid", PositionSolver::WEIGHTED_CENTROID, 0, kAps[a], kOutliers[o], scenes);
+      Run("trilateration", PositionSolver::TRILATERATION, 0, kAps[a], kOutliers[o], scenes);
+      Run("trilateration + reject", PositionSolver::TRILATERATION,
+          PositionSolverOptions().outlier_rounds, kAps[a], kOutliers[o], scenes);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,120 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_positionSolver.h"
+#include "positionScenes.h"
+#include "test.h"
+#include <algorithm>
+
+namespace {
+// Without noise nothing is an outlier, and nearly every solve lands on the
+// true position; the rest stop at the iteration limit or a local minimum.
+void TestNoiselessTrilaterationIsExact() {
+  PositionSolver solver((PositionSolverOptions()));
+  std::mt19937 random(1);
+  const int kScenes = 100;
+  int exact = 0;
+  for (int s = 0; s < kScenes; ++s) {
+    PositionScene scene;
+    MakePositionScene(random, 9, 60, 0, 0, &scene);
+    PositionEstimate estimate;
+    EXPECT(solver.Trilaterate(scene.observations, &estimate));
+    EXPECT(estimate.valid);
+    EXPECT_EQ(9, estimate.inliers);
+    exact += PositionError(scene, estimate) < 0.5f;
+  }
+  EXPECT(exact >= kScenes * 9 / 10);
+}
+
+// A single grossly wrong AP listed first must be the one rejected; with
+// index-order rejection the good APs its pull pushed over the limit went too.
+void TestRejectsWorstOutlierFirst() {
+  PositionSolverOptions options;
+  PositionSolver solver(options);
+  RssiObservations observations;
+  const float kTrueX = 20, kTrueY = 20;
+  // Claims to be 1 m away from an AP 40 m off.
+  observations.Add(60, 20, options.rssi_at_1m_dbm);
+  const float kAps[][2] = { { 0, 0 }, { 40, 0 }, { 0, 40 }, { 40, 40 },
+                            { 20, 0 }, { 0, 20 }, { 20, 40 }, { 10, 30 } };
+  for (size_t i = 0; i < sizeof(kAps) / sizeof(kAps[0]); ++i) {
+    float dx = kAps[i][0] - kTrueX;
+    float dy = kAps[i][1] - kTrueY;
+    float d = sqrtf(dx * dx + dy * dy);
+    observations.Add(kAps[i][0], kAps[i][1],
+                     options.rssi_at_1m_dbm - 10 * options.path_loss_exponent * log10f(d));
+  }
+  PositionEstimate estimate;
+  EXPECT(solver.Trilaterate(observations, &estimate));
+  EXPECT_EQ(static_cast<int>(observations.Size()) - 1, estimate.inliers);
+  float dx = estimate.x - kTrueX;
+  float dy = estimate.y - kTrueY;
+  EXPECT(sqrtf(dx * dx + dy * dy) < 0.5f);
+}
+
+void TestOutlierRejectionImprovesAccuracy() {
+  PositionSolverOptions no_rejection;
+  no_rejection.outlier_rounds = 0;
+  PositionSolver plain(no_rejection);
+  PositionSolver robust((PositionSolverOptions()));
+  std::mt19937 random(2);
+  std::vector<float> plain_errors, robust_errors;
+  for (int s = 0; s < 300; ++s) {
+    PositionScene scene;
+    MakePositionScene(random, 12, 80, 2, 0.15f, &scene);
+    PositionEstimate a, b;
+    plain.Trilaterate(scene.observations, &a);
+    robust.Trilaterate(scene.observations, &b);
+    plain_errors.push_back(PositionError(scene, a));
+    robust_errors.push_back(PositionError(scene, b));
+  }
+  std::sort(plain_errors.begin(), plain_errors.end());
+  std::sort(robust_errors.begin(), robust_errors.end());
+  size_t median = plain_errors.size() / 2;
+  EXPECT(robust_errors[median] < plain_errors[median]);
+}
+
+void TestBatchMatchesSingle() {
+  PositionSolver solver((PositionSolverOptions()));
+  std::mt19937 random(3);
+  std::vector<RssiObservations> scenes(200);
+  for (size_t s = 0; s < scenes.size(); ++s) {
+    PositionScene scene;
+    MakePositionScene(random, 3 + s % 20, 50, 4, 0.1f, &scene);
+    scenes[s] = scene.observations;
+  }
+  std::vector<PositionEstimate> batch;
+  solver.SolveBatch(PositionSolver::TRILATERATION, scenes, &batch, 3);
+  EXPECT_EQ(scenes.size(), batch.size());
+  for (size_t s = 0; s < scenes.size() && s < batch.size(); ++s) {
+    PositionEstimate single;
+    solver.Trilaterate(scenes[s], &single);
+    EXPECT_EQ(single.x, batch[s].x);
+    EXPECT_EQ(single.y, batch[s].y);
+    EXPECT_EQ(single.inliers, batch[s].inliers);
+  }
+}
+
+void TestTooFewObservations() {
+  PositionSolver solver((PositionSolverOptions()));
+  RssiObservations observations;
+  PositionEstimate estimate;
+  EXPECT(!solver.Trilaterate(observations, &estimate));
+  EXPECT(!estimate.valid);
+  observations.Add(3, 4, -60);
+  observations.Add(5, 4, -60);
+  EXPECT(solver.Trilaterate(observations, &estimate));
+  EXPECT_EQ(4.0f, estimate.x);
+  EXPECT_EQ(4.0f, estimate.y);
+}
+}  // namespace
+
+int main() {
+  TestNoiselessTrilaterationIsExact();
+  TestRejectsWorstOutlierFirst();
+  TestOutlierRejectionImprovesAccuracy();
+  TestBatchMatchesSingle();
+  TestTooFewObservations();
+  return TestExitCode();
+}
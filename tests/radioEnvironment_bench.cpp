@@ -0,0 +1,54 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Generator throughput at increasing AP density, as AccessPoint vectors and
+// as raw BSSID lists with and without IEs.
+//
+//   radioEnvironment_bench [seconds per case]
+
+#include "wifi_radioEnvironment.h"
+#include "test.h"
+#include <stdlib.h>
+
+namespace {
+void Run(int access_points, double width_m, int mode, double seconds) {
+  RadioEnvironmentOptions options;
+  options.access_point_count = access_points;
+  options.width_m = width_m;
+  options.height_m = width_m;
+  options.include_ies = mode == 2;
+  RadioEnvironmentGenerator generator(options);
+  std::vector<AccessPoint> aps;
+  std::vector<char> list;
+  size_t visible = 0;
+  uint64_t scans = 0;
+  double start = NowSeconds();
+  double elapsed;
+  do {
+    for (int i = 0; i < 16; ++i, ++scans) {
+      generator.Step();
+      if (mode == 0) {
+        generator.GetAccessPoints(aps);
+      } else {
+        generator.GetBssIdList(list);
+      }
+      visible += generator.VisibleCount();
+    }
+    elapsed = NowSeconds() - start;
+  } while (elapsed < seconds);
+  static const char* const kModes[] = { "AccessPoint", "BSSID list", "BSSID_EX + IEs" };
+  printf("%6d APs  %6.0f visible  %-15s %10.0f scans/min\n", access_points,
+         static_cast<double>(visible) / scans, kModes[mode], scans / elapsed * 60);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+  for (int mode = 0; mode < 3; ++mode) {
+    Run(200, 200, mode, seconds);
+    Run(5000, 300, mode, seconds);
+    Run(20000, 150, mode, seconds);
+  }
+  return 0;
+}
@@ -0,0 +1,164 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_radioEnvironment.h"
+#include "wifi_bssIdList.h"
+#include "wifi_bssIdListIndex.h"
+#include "test.h"
+#include <string.h>
+
+namespace {
+const uint32_t kMicrosoftOui = 0x0050F2;
+const uint32_t kCcmpBit = 1 << 4;
+const uint32_t kTkipBit = 1 << 2;
+
+RadioEnvironmentOptions SmallOptions(uint64_t seed) {
+  RadioEnvironmentOptions options;
+  options.seed = seed;
+  options.access_point_count = 300;
+  options.width_m = 120;
+  options.height_m = 120;
+  options.appear_probability = 0.05;
+  options.disappear_probability = 0.05;
+  return options;
+}
+
+void TestSameSeedSameScans() {
+  RadioEnvironmentGenerator a(SmallOptions(7));
+  RadioEnvironmentGenerator b(SmallOptions(7));
+  RadioEnvironmentGenerator c(SmallOptions(8));
+  bool differs_from_other_seed = false;
+  for (int step = 0; step < 50; ++step) {
+    std::vector<char> list_a, list_b, list_c;
+    a.GetBssIdList(list_a);
+    b.GetBssIdList(list_b);
+    c.GetBssIdList(list_c);
+    EXPECT(list_a == list_b);
+    differs_from_other_seed |= list_a != list_c;
+    a.Step();
+    b.Step();
+    c.Step();
+  }
+  EXPECT(differs_from_other_seed);
+}
+
+void TestListMatchesAccessPoints() {
+  RadioEnvironmentGenerator generator(SmallOptions(3));
+  for (int step = 0; step < 20; ++step, generator.Step()) {
+    std::vector<AccessPoint> expected;
+    generator.GetAccessPoints(expected);
+    std::vector<char> list;
+    generator.GetBssIdList(list);
+    std::vector<AccessPoint> parsed;
+    GetDataFromBssIdList(*reinterpret_cast<const NDIS_802_11_BSSID_LIST*>(&list[0]),
+                         static_cast<int>(list.size()), parsed);
+    EXPECT_EQ(expected.size(), parsed.size());
+    for (size_t i = 0; i < expected.size() && i < parsed.size(); ++i) {
+      EXPECT(expected[i].mac_address == parsed[i].mac_address);
+      EXPECT_EQ(expected[i].radio_signal_strength, parsed[i].radio_signal_strength);
+      EXPECT(expected[i].ssid == parsed[i].ssid);
+    }
+  }
+}
+
+// Looks an AP up by MAC in the ground truth.
+const RadioEnvironmentGenerator::SimulatedAccessPoint* FindAp(
+    const RadioEnvironmentGenerator& generator, const unsigned char* mac) {
+  const std::vector<RadioEnvironmentGenerator::SimulatedAccessPoint>& aps =
+      generator.AccessPoints();
+  for (size_t i = 0; i < aps.size(); ++i) {
+    if (!memcmp(aps[i].mac, mac, 6)) {
+      return &aps[i];
+    }
+  }
+  return NULL;
+}
+
+void TestIesDecodeToGroundTruth() {
+  RadioEnvironmentOptions options = SmallOptions(11);
+  options.access_point_count = 2000;
+  RadioEnvironmentGenerator generator(options);
+  std::vector<char> list;
+  generator.GetBssIdList(list);
+  BssIdListIndex index;
+  EXPECT_EQ(static_cast<int>(generator.VisibleCount()), index.Build(list, NULL));
+
+  int seen[SIM_SECURITY_COUNT] = { 0 };
+  for (size_t i = 0; i < index.Count(); ++i) {
+    const RadioEnvironmentGenerator::SimulatedAccessPoint* ap =
+        FindAp(generator, index.Entry(i).MacAddress);
+    EXPECT(ap != NULL);
+    if (!ap) {
+      continue;
+    }
+    ++seen[ap->security];
+    EXPECT_EQ(ap->frequency_khz, index.FrequencyKhz(i));
+    EXPECT_EQ(FrequencyToChannel(ap->frequency_khz), index.Channel(i));
+
+    size_t ie_length;
+    EXPECT(index.IeData(i, &ie_length) != NULL);
+    EXPECT_EQ(ap->ies.size(), ie_length);
+
+    const BssSecurityInfo& security = index.Security(i);
+    EXPECT_EQ(ap->security != SIM_SECURITY_OPEN, security.privacy);
+    EXPECT_EQ(ap->security != SIM_SECURITY_OPEN, security.has_rsn);
+    EXPECT_EQ(ap->security == SIM_SECURITY_WPA_WPA2_MIXED, security.has_wpa);
+    switch (ap->security) {
+      case SIM_SECURITY_WPA2_PSK:
+        EXPECT_EQ(1u << 2, security.rsn_akm_suites);
+        EXPECT_EQ(kCcmpBit, security.rsn_pairwise_ciphers);
+        break;
+      case SIM_SECURITY_WPA2_ENTERPRISE:
+        EXPECT_EQ(1u << 1, security.rsn_akm_suites);
+        break;
+      case SIM_SECURITY_WPA3_SAE:
+        EXPECT_EQ(1u << 8, security.rsn_akm_suites);
+        EXPECT(security.rsn_capabilities & (1 << 6));
+        break;
+      case SIM_SECURITY_WPA_WPA2_MIXED:
+        EXPECT_EQ(kTkipBit, security.rsn_group_cipher);
+        EXPECT_EQ(kTkipBit, security.wpa_pairwise_ciphers);
+        break;
+      default:
+        break;
+    }
+
+    bool has_wmm = false;
+    const std::vector<VendorIe>& vendor = index.VendorIes(i);
+    for (size_t v = 0; v < vendor.size(); ++v) {
+      has_wmm |= vendor[v].oui == kMicrosoftOui && vendor[v].length > 0 &&
+                 vendor[v].data[0] == 2;
+    }
+    EXPECT(has_wmm);
+  }
+  for (int s = 0; s < SIM_SECURITY_COUNT; ++s) {
+    EXPECT(seen[s] > 0);
+  }
+}
+
+void TestBareRecordsWithoutIes() {
+  RadioEnvironmentOptions options = SmallOptions(5);
+  options.include_ies = false;
+  RadioEnvironmentGenerator generator(options);
+  std::vector<char> list;
+  generator.GetBssIdList(list);
+  EXPECT_EQ(offsetof(NDIS_802_11_BSSID_LIST, Bssid) +
+                generator.VisibleCount() * sizeof(NDIS_WLAN_BSSID),
+            list.size());
+  BssIdListIndex index;
+  index.Build(list, NULL);
+  for (size_t i = 0; i < index.Count(); ++i) {
+    size_t ie_length;
+    EXPECT(index.IeData(i, &ie_length) == NULL);
+  }
+}
+}  // namespace
+
+int main() {
+  TestSameSeedSameScans();
+  TestListMatchesAccessPoints();
+  TestIesDecodeToGroundTruth();
+  TestBareRecordsWithoutIes();
+  return TestExitCode();
+}
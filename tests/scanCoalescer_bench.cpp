@@ -0,0 +1,72 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Device queries issued versus requests served when several components with
+// different cadences and freshness needs share one ScanCoalescer. Without
+// it every request would be a device query.
+//
+//   scanCoalescer_bench [milliseconds per case]
+
+#include "wifi_scanCoalescer.h"
+#include "coalescerClients.h"
+#include "test.h"
+#include <stdlib.h>
+
+namespace {
+const int kQueryMs = 30;
+
+void AddClients(std::vector<CoalescerClient>& clients, int count,
+                int max_age_ms, int period_ms) {
+  CoalescerClient client;
+  client.max_age_ms = max_age_ms;
+  client.period_ms = period_ms;
+  clients.insert(clients.end(), count, client);
+}
+
+void Run(const char* label, const std::vector<CoalescerClient>& clients,
+         int duration_ms) {
+  FakeAccessPointQuery query(kQueryMs);
+  ScanCoalescer coalescer(&query);
+  std::vector<CoalescerClientStats> stats =
+      RunCoalescerClients(&coalescer, clients, duration_ms);
+  int too_old = 0;
+  for (size_t c = 0; c < stats.size(); ++c) {
+    too_old += stats[c].too_old;
+  }
+  ScanCoalescer::Stats totals = coalescer.GetStats();
+  printf("%-28s %6llu requests  %5llu queries (%5.1f%%)  cache %6llu  "
+         "joined %5llu  too old %d\n",
+         label, static_cast<unsigned long long>(totals.requests),
+         static_cast<unsigned long long>(totals.device_queries),
+         100.0 * totals.device_queries / totals.requests,
+         static_cast<unsigned long long>(totals.served_from_cache),
+         static_cast<unsigned long long>(totals.joined_in_flight), too_old);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  int duration_ms = argc > 1 ? atoi(argv[1]) : 3000;
+  printf("%d ms device queries, %d ms per case\n", kQueryMs, duration_ms);
+
+  std::vector<CoalescerClient> clients;
+  AddClients(clients, 1, 1000, 100);
+  AddClients(clients, 1, 5000, 250);
+  AddClients(clients, 1, 200, 50);
+  Run("3 clients, mixed", clients, duration_ms);
+
+  clients.clear();
+  AddClients(clients, 10, 1000, 20);
+  Run("10 clients, 1 s max age", clients, duration_ms);
+
+  clients.clear();
+  AddClients(clients, 10, 0, 20);
+  Run("10 clients, no max age", clients, duration_ms);
+
+  clients.clear();
+  AddClients(clients, 4, 100, 10);
+  AddClients(clients, 8, 2000, 100);
+  AddClients(clients, 20, 10000, 500);
+  Run("32 clients, mixed", clients, duration_ms);
+  return 0;
+}
@@ -0,0 +1,139 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_scanCoalescer.h"
+#include "coalescerClients.h"
+#include "test.h"
+
+namespace {
+const int kQueryMs = 20;
+
+int SignalOf(const std::shared_ptr<const ScanCoalescer::Result>& result) {
+  return result->access_points.empty()
+             ? -1
+             : result->access_points[0].radio_signal_strength;
+}
+
+void TestCachedResultIsReused() {
+  FakeAccessPointQuery query(0);
+  ScanCoalescer coalescer(&query);
+  std::shared_ptr<const ScanCoalescer::Result> first = coalescer.Request(60000);
+  std::shared_ptr<const ScanCoalescer::Result> second = coalescer.Request(60000);
+  EXPECT_EQ(1, query.Calls());
+  EXPECT(first == second);
+  // Nothing is young enough for a zero max age.
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  std::shared_ptr<const ScanCoalescer::Result> third = coalescer.Request(0);
+  EXPECT_EQ(2, query.Calls());
+  EXPECT_EQ(2, SignalOf(third));
+  EXPECT(coalescer.Latest() == third);
+
+  ScanCoalescer::Stats stats = coalescer.GetStats();
+  EXPECT_EQ(3u, stats.requests);
+  EXPECT_EQ(1u, stats.served_from_cache);
+  EXPECT_EQ(2u, stats.device_queries);
+}
+
+// Callers arriving while a query runs wait for it instead of starting their
+// own.
+void TestConcurrentRequestsShareOneQuery() {
+  FakeAccessPointQuery query(kQueryMs);
+  ScanCoalescer coalescer(&query);
+  const int kCallers = 8;
+  std::vector<int> signals(kCallers);
+  std::vector<std::thread> callers;
+  for (int i = 0; i < kCallers; ++i) {
+    callers.push_back(std::thread([&coalescer, &signals, i]() {
+      signals[i] = SignalOf(coalescer.Request(1000));
+    }));
+  }
+  for (int i = 0; i < kCallers; ++i) {
+    callers[i].join();
+  }
+  EXPECT_EQ(1, query.Calls());
+  for (int i = 0; i < kCallers; ++i) {
+    EXPECT_EQ(1, signals[i]);
+  }
+  ScanCoalescer::Stats stats = coalescer.GetStats();
+  EXPECT_EQ(static_cast<uint64_t>(kCallers),
+            stats.served_from_cache + stats.joined_in_flight +
+                stats.device_queries);
+}
+
+void TestFailedQuery() {
+  FakeAccessPointQuery query(0);
+  ScanCoalescer coalescer(&query);
+  std::shared_ptr<const ScanCoalescer::Result> good = coalescer.Request(0);
+  query.SetFail(true);
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  std::shared_ptr<const ScanCoalescer::Result> bad = coalescer.Request(0);
+  EXPECT(!bad->succeeded);
+  EXPECT(bad->access_points.empty());
+  EXPECT(coalescer.Latest() == good);
+  EXPECT_EQ(1u, coalescer.GetStats().failed_queries);
+}
+
+void TestRestore() {
+  FakeAccessPointQuery query(0);
+  ScanCoalescer coalescer(&query);
+  std::vector<AccessPoint> saved(1);
+  saved[0].mac_address = "saved";
+  coalescer.Restore(saved, 5000);
+  EXPECT(coalescer.Latest()->restored);
+  // Too old for this caller, so a real query runs and replaces it.
+  std::shared_ptr<const ScanCoalescer::Result> result = coalescer.Request(1000);
+  EXPECT(!result->restored);
+  EXPECT_EQ(1, query.Calls());
+
+  std::vector<AccessPoint> late(1);
+  coalescer.Restore(late, 0);
+  EXPECT(coalescer.Latest() == result);
+}
+
+// Components at different cadences: every result meets its caller's max
+// age, queries never overlap, and far fewer queries run than requests.
+void TestMultiClientSimulation() {
+  FakeAccessPointQuery query(kQueryMs / 4);
+  ScanCoalescer coalescer(&query);
+  std::vector<CoalescerClient> clients;
+  CoalescerClient client;
+  client.max_age_ms = 50;
+  client.period_ms = 10;
+  clients.push_back(client);
+  clients.push_back(client);
+  client.max_age_ms = 200;
+  client.period_ms = 25;
+  clients.push_back(client);
+  client.max_age_ms = 1000;
+  client.period_ms = 5;
+  clients.push_back(client);
+  clients.push_back(client);
+  std::vector<CoalescerClientStats> stats =
+      RunCoalescerClients(&coalescer, clients, 500);
+
+  int requests = 0;
+  for (size_t c = 0; c < stats.size(); ++c) {
+    EXPECT(stats[c].requests > 0);
+    EXPECT_EQ(0, stats[c].too_old);
+    EXPECT_EQ(0, stats[c].failed);
+    requests += stats[c].requests;
+  }
+  EXPECT_EQ(0, query.Overlapped());
+  ScanCoalescer::Stats totals = coalescer.GetStats();
+  EXPECT_EQ(static_cast<uint64_t>(requests), totals.requests);
+  EXPECT_EQ(static_cast<uint64_t>(query.Calls()), totals.device_queries);
+  // The 50 ms clients need a query at most every 50 ms; allow for
+  // scheduling on a loaded machine.
+  EXPECT(query.Calls() * 4 < requests);
+}
+}  // namespace
+
+int main() {
+  TestCachedResultIsReused();
+  TestConcurrentRequestsShareOneQuery();
+  TestFailedQuery();
+  TestRestore();
+  TestMultiClientSimulation();
+  return TestExitCode();
+}
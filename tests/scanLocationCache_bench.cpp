@@ -0,0 +1,74 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Replays generator walks through the cache the way a geolocation provider
+// would use it: look each scan up, and on a miss insert it at the true
+// position. Prints the hit rate, LSH candidates compared per lookup, time
+// per lookup and how far a hit's cached position is from the receiver.
+//
+//   scanLocationCache_bench [scans]
+
+#include "wifi_scanLocationCache.h"
+#include "wifi_radioEnvironment.h"
+#include "test.h"
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+
+namespace {
+void Run(const char* label, int access_points, double area_m,
+         const ScanLocationCache::Options& options, int scans) {
+  RadioEnvironmentOptions environment;
+  environment.seed = 32;
+  environment.access_point_count = access_points;
+  environment.width_m = area_m;
+  environment.height_m = area_m;
+  RadioEnvironmentGenerator generator(environment);
+  ScanLocationCache cache(options);
+
+  std::vector<AccessPoint> scan;
+  std::vector<double> errors;
+  double lookup_s = 0;
+  for (int i = 0; i < scans; ++i) {
+    generator.Step();
+    generator.GetAccessPoints(scan);
+    CachedPosition position;
+    double start = NowSeconds();
+    bool hit = cache.Lookup(scan, &position, NULL);
+    lookup_s += NowSeconds() - start;
+    if (hit) {
+      errors.push_back(hypot(position.latitude - generator.ReceiverX(),
+                             position.longitude - generator.ReceiverY()));
+    } else {
+      CachedPosition truth = { generator.ReceiverX(), generator.ReceiverY(), 10 };
+      cache.Insert(scan, truth);
+    }
+  }
+
+  const ScanLocationCache::Stats& stats = cache.GetStats();
+  std::sort(errors.begin(), errors.end());
+  double median = errors.empty() ? 0 : errors[errors.size() / 2];
+  printf("%-24s %5d APs  hit rate %5.1f%%  %6.1f candidates/lookup  "
+         "%7.0f ns/lookup  hit error p50 %5.1f m  %5zu places  %6llu evictions\n",
+         label, access_points, 100.0 * stats.hits / std::max<uint64_t>(1, stats.lookups),
+         static_cast<double>(stats.candidates_compared) /
+             std::max<uint64_t>(1, stats.lookups),
+         lookup_s * 1e9 / scans, median, cache.Size(),
+         static_cast<unsigned long long>(stats.evictions));
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int scans = argc > 1 ? atoi(argv[1]) : 20000;
+  ScanLocationCache::Options options;
+  Run("default", 200, 200, options, scans);
+  Run("default", 2000, 600, options, scans);
+  options.weight_by_rssi = true;
+  Run("weight_by_rssi", 200, 200, options, scans);
+  Run("weight_by_rssi", 2000, 600, options, scans);
+  options.weight_by_rssi = false;
+  options.capacity = 256;
+  Run("capacity 256", 2000, 600, options, scans);
+  return 0;
+}
@@ -0,0 +1,159 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_scanLocationCache.h"
+#include "test.h"
+#include <stdio.h>
+
+namespace {
+// A scan of APs first..first+count-1, all at |rssi|.
+std::vector<AccessPoint> Scan(uint32_t first, int count, int rssi = -60) {
+  std::vector<AccessPoint> scan;
+  for (int i = 0; i < count; ++i) {
+    char mac[13];
+    snprintf(mac, sizeof(mac), "0200%08x", first + i);
+    AccessPoint access_point;
+    access_point.mac_address = mac;
+    access_point.radio_signal_strength = rssi;
+    access_point.ssid = "net";
+    scan.push_back(access_point);
+  }
+  return scan;
+}
+
+CachedPosition Place(double latitude) {
+  CachedPosition position = { latitude, 10.0, 25 };
+  return position;
+}
+
+void TestNearIdenticalScanHits() {
+  ScanLocationCache cache((ScanLocationCache::Options()));
+  cache.Insert(Scan(0, 30), Place(1));
+  cache.Insert(Scan(1000, 30), Place(2));
+
+  // One AP of thirty gone and one new: Jaccard similarity 29/31.
+  std::vector<AccessPoint> scan = Scan(1, 30);
+  CachedPosition position;
+  double similarity = 0;
+  EXPECT(cache.Lookup(scan, &position, &similarity));
+  EXPECT_EQ(1.0, position.latitude);
+  EXPECT(similarity > 0.8);
+  EXPECT_EQ(1u, cache.GetStats().hits);
+}
+
+void TestDisjointScanMisses() {
+  ScanLocationCache cache((ScanLocationCache::Options()));
+  cache.Insert(Scan(0, 30), Place(1));
+  CachedPosition position;
+  double similarity = 1;
+  EXPECT(!cache.Lookup(Scan(5000, 30), &position, &similarity));
+  EXPECT(similarity < 0.2);
+  EXPECT(!cache.Lookup(std::vector<AccessPoint>(), &position, &similarity));
+  EXPECT_EQ(0.0, similarity);
+  EXPECT_EQ(0u, cache.GetStats().hits);
+  EXPECT_EQ(2u, cache.GetStats().lookups);
+}
+
+// A place is returned at exactly the threshold and not just above it.
+void TestThresholdBoundary() {
+  ScanLocationCache::Options options;
+  options.similarity_threshold = 0;
+  ScanLocationCache probe(options);
+  probe.Insert(Scan(0, 30), Place(1));
+  CachedPosition position;
+  double similarity = 0;
+  probe.Lookup(Scan(10, 30), &position, &similarity);
+  EXPECT(similarity > 0 && similarity < 1);
+
+  options.similarity_threshold = similarity;
+  ScanLocationCache at(options);
+  at.Insert(Scan(0, 30), Place(1));
+  EXPECT(at.Lookup(Scan(10, 30), &position, NULL));
+
+  options.similarity_threshold = similarity + 1e-9;
+  ScanLocationCache above(options);
+  above.Insert(Scan(0, 30), Place(1));
+  EXPECT(!above.Lookup(Scan(10, 30), &position, NULL));
+}
+
+// Past capacity the least recently used place goes, where a lookup counts
+// as a use.
+void TestEvictsLeastRecentlyUsed() {
+  ScanLocationCache::Options options;
+  options.capacity = 3;
+  ScanLocationCache cache(options);
+  cache.Insert(Scan(0, 20), Place(0));
+  cache.Insert(Scan(100, 20), Place(1));
+  cache.Insert(Scan(200, 20), Place(2));
+  CachedPosition position;
+  EXPECT(cache.Lookup(Scan(0, 20), &position, NULL));
+
+  cache.Insert(Scan(300, 20), Place(3));
+  EXPECT_EQ(3u, cache.Size());
+  EXPECT_EQ(1u, cache.GetStats().evictions);
+  EXPECT(!cache.Lookup(Scan(100, 20), &position, NULL));
+  EXPECT(cache.Lookup(Scan(0, 20), &position, NULL));
+  EXPECT_EQ(0.0, position.latitude);
+  EXPECT(cache.Lookup(Scan(200, 20), &position, NULL));
+  EXPECT(cache.Lookup(Scan(300, 20), &position, NULL));
+}
+
+// Evicting a place takes it out of every bucket, and buckets left empty are
+// dropped, so churning through places does not grow the index.
+void TestEvictionEmptiesBuckets() {
+  ScanLocationCache::Options options;
+  options.capacity = 4;
+  ScanLocationCache cache(options);
+  for (int i = 0; i < 4; ++i) {
+    cache.Insert(Scan(i * 100, 20), Place(i));
+  }
+  size_t full = cache.BucketCount();
+  EXPECT(full > 0);
+  EXPECT(full <= static_cast<size_t>(4 * options.bands));
+  for (int i = 4; i < 200; ++i) {
+    cache.Insert(Scan(i * 100, 20), Place(i));
+    EXPECT(cache.BucketCount() <= static_cast<size_t>(4 * options.bands));
+  }
+  EXPECT_EQ(4u, cache.Size());
+  EXPECT_EQ(196u, cache.GetStats().evictions);
+
+  // Re-inserting the same place after it was evicted leaves no stale ids.
+  ScanLocationCache::Options one;
+  one.capacity = 1;
+  ScanLocationCache single(one);
+  single.Insert(Scan(0, 20), Place(0));
+  size_t buckets = single.BucketCount();
+  single.Insert(Scan(100, 20), Place(1));
+  single.Insert(Scan(0, 20), Place(2));
+  EXPECT_EQ(buckets, single.BucketCount());
+  CachedPosition position;
+  EXPECT(single.Lookup(Scan(0, 20), &position, NULL));
+  EXPECT_EQ(2.0, position.latitude);
+}
+
+// A signature computed with other Options is refused rather than read past
+// its end.
+void TestRejectsWrongSignatureSize() {
+  ScanLocationCache cache((ScanLocationCache::Options()));
+  cache.Insert(Scan(0, 20), Place(0));
+  ScanLocationCache::Signature short_signature(3, 0);
+  CachedPosition position;
+  double similarity = 1;
+  EXPECT(!cache.Lookup(short_signature, &position, &similarity));
+  EXPECT_EQ(0.0, similarity);
+  cache.Insert(short_signature, Place(1));
+  EXPECT_EQ(1u, cache.Size());
+  EXPECT(!cache.Lookup(ScanLocationCache::Signature(), &position, NULL));
+}
+}  // namespace
+
+int main() {
+  TestNearIdenticalScanHits();
+  TestDisjointScanMisses();
+  TestThresholdBoundary();
+  TestEvictsLeastRecentlyUsed();
+  TestEvictionEmptiesBuckets();
+  TestRejectsWrongSignatureSize();
+  return TestExitCode();
+}
@@ -0,0 +1,104 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// End-to-end pipeline throughput with a fake scan source, and how a slow
+// listener affects the query stage under each overflow policy.
+//
+//   scanPipeline_bench [scans]
+
+#include "wifi_scanPipeline.h"
+#include "wifi_bssIdList.h"
+#include "test.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+class FakeScanSource : public ScanSource {
+public:
+  explicit FakeScanSource(int aps) {
+    const size_t header = offsetof(NDIS_802_11_BSSID_LIST, Bssid);
+    list_.resize(header + aps * sizeof(NDIS_WLAN_BSSID));
+    reinterpret_cast<NDIS_802_11_BSSID_LIST*>(&list_[0])->NumberOfItems = aps;
+    for (int i = 0; i < aps; ++i) {
+      NDIS_WLAN_BSSID* entry =
+          reinterpret_cast<NDIS_WLAN_BSSID*>(&list_[header + i * sizeof(NDIS_WLAN_BSSID)]);
+      memset(entry, 0, sizeof(*entry));
+      entry->Length = sizeof(*entry);
+      entry->MacAddress[4] = static_cast<UCHAR>(i >> 8);
+      entry->MacAddress[5] = static_cast<UCHAR>(i);
+      entry->Rssi = -40 - i % 50;
+      entry->Ssid.SsidLength = 8;
+      memcpy(entry->Ssid.Ssid, "benchnet", 8);
+    }
+  }
+  virtual bool QueryBssIdLists(std::vector<std::vector<char> >& outLists) {
+    outLists.push_back(list_);
+    return true;
+  }
+
+private:
+  std::vector<char> list_;
+};
+
+class SleepyListener : public ScanPipelineListener {
+public:
+  explicit SleepyListener(int delay_us) : delay_us_(delay_us) {}
+  virtual void OnScanAvailable(const ScanBatch&) {
+    if (delay_us_) {
+      std::this_thread::sleep_for(std::chrono::microseconds(delay_us_));
+    }
+  }
+
+private:
+  int delay_us_;
+};
+
+void Run(const char* label, int aps, int listener_delay_us,
+         ScanPipeline::BatchQueue::OverflowPolicy policy, uint64_t scans) {
+  FakeScanSource source(aps);
+  SleepyListener listener(listener_delay_us);
+  ScanPipeline::Options options;
+  options.overflow_policy = policy;
+  options.polling_interval_ms = 0;
+  options.max_scans = scans;
+  ScanPipeline pipeline(&source, &listener, options);
+  double start = NowSeconds();
+  pipeline.Start();
+  pipeline.WaitUntilIdle();
+  double elapsed = NowSeconds() - start;
+
+  uint64_t dropped = 0;
+  uint64_t waits = 0;
+  size_t max_depth = 0;
+  for (int stage = 0; stage < ScanPipeline::STAGE_COUNT; ++stage) {
+    SpscQueueStats stats = pipeline.GetQueueStats(static_cast<ScanPipeline::Stage>(stage));
+    dropped += stats.dropped;
+    waits += stats.producer_waits;
+    max_depth = std::max(max_depth, stats.max_depth);
+  }
+  printf("%-28s %5d APs  %8.0f scans/s  delivered %6llu  dropped %6llu  "
+         "waits %6llu  max depth %zu\n",
+         label, aps, scans / elapsed,
+         static_cast<unsigned long long>(pipeline.ScansDelivered()),
+         static_cast<unsigned long long>(dropped),
+         static_cast<unsigned long long>(waits), max_depth);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  uint64_t scans = argc > 1 ? strtoull(argv[1], NULL, 10) : 20000;
+  const int kApCounts[] = { 50, 500, 2000 };
+  for (size_t i = 0; i < sizeof(kApCounts) / sizeof(kApCounts[0]); ++i) {
+    Run("fast listener", kApCounts[i], 0, ScanPipeline::BatchQueue::BACKPRESSURE,
+        scans / (1 + kApCounts[i] / 100));
+  }
+  // A listener taking 200us per scan: backpressure paces the device query
+  // to it, drop-oldest keeps querying at full rate.
+  Run("slow listener, backpressure", 50, 200, ScanPipeline::BatchQueue::BACKPRESSURE,
+      scans / 10);
+  Run("slow listener, drop-oldest", 50, 200, ScanPipeline::BatchQueue::DROP_OLDEST,
+      scans / 10);
+  return 0;
+}
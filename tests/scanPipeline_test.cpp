@@ -0,0 +1,194 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_scanPipeline.h"
+#include "wifi_bssIdList.h"
+#include "test.h"
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+namespace {
+// Two interfaces that both see APs 0..overlap-1; interface 1 hears them
+// 5 dB louder.
+class FakeScanSource : public ScanSource {
+public:
+  FakeScanSource(int aps_per_interface, int overlap)
+      : aps_(aps_per_interface), overlap_(overlap), fail_(false) {}
+
+  void SetFailing(bool fail) { fail_ = fail; }
+
+  virtual bool QueryBssIdLists(std::vector<std::vector<char> >& outLists) {
+    if (fail_) {
+      return false;
+    }
+    outLists.push_back(BuildList(0));
+    outLists.push_back(BuildList(1));
+    return true;
+  }
+
+  size_t DistinctAps() const { return 2 * aps_ - overlap_; }
+
+private:
+  std::vector<char> BuildList(int interface_index) const {
+    const size_t header = offsetof(NDIS_802_11_BSSID_LIST, Bssid);
+    std::vector<char> list(header + aps_ * sizeof(NDIS_WLAN_BSSID));
+    NDIS_802_11_BSSID_LIST* bssid_list =
+        reinterpret_cast<NDIS_802_11_BSSID_LIST*>(&list[0]);
+    bssid_list->NumberOfItems = aps_;
+    for (int i = 0; i < aps_; ++i) {
+      NDIS_WLAN_BSSID* entry =
+          reinterpret_cast<NDIS_WLAN_BSSID*>(&list[header + i * sizeof(NDIS_WLAN_BSSID)]);
+      memset(entry, 0, sizeof(*entry));
+      entry->Length = sizeof(*entry);
+      int id = i;
+      if (interface_index == 1 && i >= overlap_) {
+        id = aps_ + (i - overlap_);
+      }
+      entry->MacAddress[4] = static_cast<UCHAR>(id >> 8);
+      entry->MacAddress[5] = static_cast<UCHAR>(id);
+      entry->Rssi = -70 + 5 * interface_index;
+      entry->Ssid.SsidLength = 4;
+      memcpy(entry->Ssid.Ssid, "test", 4);
+    }
+    return list;
+  }
+
+  int aps_;
+  int overlap_;
+  bool fail_;
+};
+
+class RecordingListener : public ScanPipelineListener {
+public:
+  explicit RecordingListener(int delay_ms)
+      : delay_ms_(delay_ms), raw_lists_left_(0), errors_(0), out_of_order_(0),
+        last_sequence_(0), first_(true) {}
+
+  virtual void OnScanAvailable(const ScanBatch& batch) {
+    if (delay_ms_) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms_));
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!first_ && batch.sequence <= last_sequence_) {
+      ++out_of_order_;
+    }
+    first_ = false;
+    last_sequence_ = batch.sequence;
+    sizes_.push_back(batch.access_points.size());
+    int strongest = -1000;
+    for (size_t i = 0; i < batch.access_points.size(); ++i) {
+      strongest = std::max(strongest, batch.access_points[i].radio_signal_strength);
+    }
+    strongest_.push_back(strongest);
+    raw_lists_left_ += batch.bss_id_lists.size();
+  }
+  virtual void OnScanError() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++errors_;
+  }
+
+  int delay_ms_;
+  std::mutex mutex_;
+  std::vector<size_t> sizes_;
+  std::vector<int> strongest_;
+  size_t raw_lists_left_;
+  int errors_;
+  int out_of_order_;
+  uint64_t last_sequence_;
+  bool first_;
+};
+
+uint64_t Dropped(const ScanPipeline& pipeline) {
+  uint64_t dropped = 0;
+  for (int stage = 0; stage < ScanPipeline::STAGE_COUNT; ++stage) {
+    dropped += pipeline.GetQueueStats(static_cast<ScanPipeline::Stage>(stage)).dropped;
+  }
+  return dropped;
+}
+
+void TestBackpressureDeliversEveryScan() {
+  FakeScanSource source(40, 10);
+  RecordingListener listener(0);
+  ScanPipeline::Options options;
+  options.queue_capacity = 2;
+  options.overflow_policy = ScanPipeline::BatchQueue::BACKPRESSURE;
+  options.polling_interval_ms = 0;
+  options.max_scans = 300;
+  ScanPipeline pipeline(&source, &listener, options);
+  pipeline.Start();
+  pipeline.WaitUntilIdle();
+
+  EXPECT_EQ(300u, pipeline.ScansQueried());
+  EXPECT_EQ(300u, pipeline.ScansDelivered());
+  EXPECT_EQ(0u, Dropped(pipeline));
+  EXPECT_EQ(300u, listener.sizes_.size());
+  EXPECT_EQ(0, listener.out_of_order_);
+  EXPECT_EQ(0u, listener.raw_lists_left_);
+  for (size_t i = 0; i < listener.sizes_.size(); ++i) {
+    // Duplicates across interfaces are merged, keeping the louder reading.
+    EXPECT_EQ(source.DistinctAps(), listener.sizes_[i]);
+    EXPECT_EQ(-65, listener.strongest_[i]);
+  }
+  SpscQueueStats stats = pipeline.GetQueueStats(ScanPipeline::STAGE_PARSE);
+  EXPECT(stats.max_depth <= 2);
+  EXPECT_EQ(300u, stats.pushed);
+}
+
+void TestDropOldestKeepsQueryingPastSlowListener() {
+  FakeScanSource source(20, 0);
+  RecordingListener listener(2);
+  ScanPipeline::Options options;
+  options.queue_capacity = 2;
+  options.overflow_policy = ScanPipeline::BatchQueue::DROP_OLDEST;
+  options.polling_interval_ms = 0;
+  options.max_scans = 400;
+  ScanPipeline pipeline(&source, &listener, options);
+  pipeline.Start();
+  pipeline.WaitUntilIdle();
+
+  EXPECT_EQ(400u, pipeline.ScansQueried());
+  EXPECT(Dropped(pipeline) > 0);
+  EXPECT_EQ(pipeline.ScansQueried(), pipeline.ScansDelivered() + Dropped(pipeline));
+  // Dropping never reorders what does get through.
+  EXPECT_EQ(0, listener.out_of_order_);
+  EXPECT_EQ(399u, listener.last_sequence_);
+}
+
+void TestFailedQueryReportsError() {
+  FakeScanSource source(5, 0);
+  source.SetFailing(true);
+  RecordingListener listener(0);
+  ScanPipeline::Options options;
+  options.polling_interval_ms = 0;
+  options.max_scans = 3;
+  ScanPipeline pipeline(&source, &listener, options);
+  pipeline.Start();
+  pipeline.WaitUntilIdle();
+  EXPECT_EQ(3, listener.errors_);
+  EXPECT(listener.sizes_.empty());
+}
+
+void TestWaitUntilIdleReturnsWithoutMaxScans() {
+  FakeScanSource source(5, 0);
+  RecordingListener listener(0);
+  ScanPipeline::Options options;
+  options.polling_interval_ms = 1;
+  ScanPipeline pipeline(&source, &listener, options);
+  pipeline.Start();
+  pipeline.WaitUntilIdle();  // Must not block.
+  pipeline.Stop();
+  EXPECT_EQ(pipeline.ScansQueried(), pipeline.ScansDelivered() + Dropped(pipeline));
+}
+}  // namespace
+
+int main() {
+  TestBackpressureDeliversEveryScan();
+  TestDropOldestKeepsQueryingPastSlowListener();
+  TestFailedQueryReportsError();
+  TestWaitUntilIdleReturnsWithoutMaxScans();
+  return TestExitCode();
+}
@@ -0,0 +1,126 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Query mixes against a ScanResult versus what callers did before it:
+// sorting a copy or filtering the AP vector on every query. Each case
+// builds a fresh result and runs |queries| queries against it, so index
+// construction is included.
+//
+//   scanResult_bench [seconds per case]
+
+#include "wifi_scanResult.h"
+#include "wifi_radioEnvironment.h"
+#include "test.h"
+#include <stdlib.h>
+#include <algorithm>
+
+namespace {
+struct Input {
+  std::vector<char> list;
+  std::vector<std::string> ssids;
+};
+
+// One query of the mix: the strongest five, one SSID, one channel.
+size_t LinearQueries(const std::vector<AccessPoint>& aps,
+                     const BssIdListIndex& index, const std::string& ssid,
+                     int channel, std::vector<uint32_t>& scratch) {
+  size_t hits = 0;
+  scratch.resize(aps.size());
+  for (size_t i = 0; i < aps.size(); ++i) {
+    scratch[i] = static_cast<uint32_t>(i);
+  }
+  size_t top = std::min<size_t>(5, aps.size());
+  std::partial_sort(scratch.begin(), scratch.begin() + top, scratch.end(),
+                    [&aps](uint32_t a, uint32_t b) {
+                      return aps[a].radio_signal_strength > aps[b].radio_signal_strength;
+                    });
+  hits += scratch[0];
+  for (size_t i = 0; i < aps.size(); ++i) {
+    hits += aps[i].ssid == ssid;
+  }
+  for (size_t i = 0; i < aps.size(); ++i) {
+    uint32_t frequency = index.FrequencyKhz(i);
+    hits += FrequencyToBand(frequency) == BAND_5_GHZ &&
+            FrequencyToChannel(frequency) == channel;
+  }
+  return hits;
+}
+
+size_t IndexedQueries(const ScanResult& result, const std::string& ssid,
+                      int channel) {
+  size_t count;
+  size_t hits = *result.Strongest(5, &count);
+  result.WithSsid(ssid, &count);
+  hits += count;
+  result.OnChannel(BAND_5_GHZ, channel, &count);
+  return hits + count;
+}
+
+void Run(int access_points, int queries, double seconds) {
+  RadioEnvironmentOptions options;
+  options.access_point_count = access_points;
+  options.width_m = 150;
+  options.height_m = 150;
+  RadioEnvironmentGenerator generator(options);
+  Input input;
+  generator.GetBssIdList(input.list);
+  std::vector<AccessPoint> source;
+  generator.GetAccessPoints(source);
+  for (size_t i = 0; i < source.size(); i += 7) {
+    input.ssids.push_back(source[i].ssid);
+  }
+  const int kChannels[] = { 36, 44, 100, 149 };
+
+  double rates[2];
+  size_t visible = 0;
+  for (int indexed = 0; indexed < 2; ++indexed) {
+    BssIdListIndex index;
+    std::vector<char> list;
+    std::vector<AccessPoint> aps;
+    std::vector<uint32_t> scratch;
+    size_t hits = 0;
+    uint64_t results = 0;
+    double start = NowSeconds();
+    double elapsed;
+    do {
+      list = input.list;
+      aps.clear();
+      index.Build(list, &aps);
+      visible = aps.size();
+      if (indexed) {
+        ScanResult result(aps, &index);
+        for (int q = 0; q < queries; ++q) {
+          hits += IndexedQueries(result, input.ssids[q % input.ssids.size()],
+                                 kChannels[q % 4]);
+        }
+      } else {
+        for (int q = 0; q < queries; ++q) {
+          hits += LinearQueries(aps, index, input.ssids[q % input.ssids.size()],
+                                kChannels[q % 4], scratch);
+        }
+      }
+      ++results;
+      elapsed = NowSeconds() - start;
+    } while (elapsed < seconds);
+    rates[indexed] = results * queries / elapsed;
+    if (hits == 42) {
+      printf(" ");
+    }
+  }
+  printf("%6zu APs  %4d queries/scan  linear %10.0f mixes/s  ScanResult %10.0f mixes/s  %5.1fx\n",
+         visible, queries, rates[0], rates[1], rates[1] / rates[0]);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  double seconds = argc > 1 ? atof(argv[1]) : 0.3;
+  const int kAps[] = { 200, 2000, 20000 };
+  const int kQueries[] = { 1, 10, 100 };
+  for (int a = 0; a < 3; ++a) {
+    for (int q = 0; q < 3; ++q) {
+      Run(kAps[a], kQueries[q], seconds);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,157 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_scanResult.h"
+#include "wifi_radioEnvironment.h"
+#include "test.h"
+#include <algorithm>
+#include <memory>
+#include <thread>
+
+namespace {
+// A generated scan and the index it was parsed with, so channel queries
+// have frequencies to work from.
+std::shared_ptr<const ScanResult> MakeResult(uint64_t seed, int access_points) {
+  RadioEnvironmentOptions options;
+  options.seed = seed;
+  options.access_point_count = access_points;
+  options.width_m = 150;
+  options.height_m = 150;
+  RadioEnvironmentGenerator generator(options);
+  std::vector<char> list;
+  generator.GetBssIdList(list);
+  BssIdListIndex index;
+  std::vector<AccessPoint> aps;
+  index.Build(list, &aps);
+  return std::make_shared<const ScanResult>(aps, &index);
+}
+
+std::vector<uint32_t> AsVector(const uint32_t* entries, size_t count) {
+  return entries ? std::vector<uint32_t>(entries, entries + count)
+                 : std::vector<uint32_t>();
+}
+
+void TestStrongestMatchesFullSort() {
+  std::shared_ptr<const ScanResult> result = MakeResult(1, 3000);
+  const std::vector<AccessPoint>& aps = result->AccessPoints();
+  std::vector<uint32_t> expected(aps.size());
+  for (size_t i = 0; i < aps.size(); ++i) {
+    expected[i] = static_cast<uint32_t>(i);
+  }
+  std::stable_sort(expected.begin(), expected.end(), [&aps](uint32_t a, uint32_t b) {
+    return aps[a].radio_signal_strength > aps[b].radio_signal_strength;
+  });
+  // Growing requests extend the sorted prefix without disturbing it.
+  const size_t kRequests[] = { 1, 5, 3, 40, 41, 200, aps.size(), aps.size() + 10 };
+  for (size_t r = 0; r < sizeof(kRequests) / sizeof(kRequests[0]); ++r) {
+    size_t count;
+    const uint32_t* strongest = result->Strongest(kRequests[r], &count);
+    EXPECT_EQ(std::min(kRequests[r], aps.size()), count);
+    EXPECT(AsVector(strongest, count) ==
+           std::vector<uint32_t>(expected.begin(), expected.begin() + count));
+  }
+}
+
+void TestSsidAndChannelQueriesMatchLinearScans() {
+  std::shared_ptr<const ScanResult> result = MakeResult(2, 3000);
+  const std::vector<AccessPoint>& aps = result->AccessPoints();
+  for (size_t k = 0; k < aps.size(); k += 37) {
+    std::vector<uint32_t> expected;
+    for (size_t i = 0; i < aps.size(); ++i) {
+      if (aps[i].ssid == aps[k].ssid) {
+        expected.push_back(static_cast<uint32_t>(i));
+      }
+    }
+    size_t count;
+    const uint32_t* found = result->WithSsid(aps[k].ssid, &count);
+    EXPECT(AsVector(found, count) == expected);
+  }
+  size_t count;
+  EXPECT(result->WithSsid("not broadcast", &count) == NULL);
+  EXPECT_EQ(0u, count);
+
+  size_t banded = 0;
+  for (int band = BAND_UNKNOWN; band < BAND_COUNT; ++band) {
+    std::vector<uint32_t> on_band;
+    for (int channel = 0; channel < 256; ++channel) {
+      std::vector<uint32_t> expected;
+      for (size_t i = 0; i < aps.size(); ++i) {
+        if (result->Band(i) == band && result->Channel(i) == channel) {
+          expected.push_back(static_cast<uint32_t>(i));
+        }
+      }
+      const uint32_t* found =
+          result->OnChannel(static_cast<WifiBand>(band), channel, &count);
+      EXPECT(AsVector(found, count) == expected);
+      on_band.insert(on_band.end(), expected.begin(), expected.end());
+    }
+    const uint32_t* found = result->OnBand(static_cast<WifiBand>(band), &count);
+    EXPECT(AsVector(found, count) == on_band);
+    if (band != BAND_UNKNOWN) {
+      banded += count;
+    }
+  }
+  // The generator only uses real channels.
+  EXPECT_EQ(aps.size(), banded);
+  EXPECT(result->OnChannel(BAND_5_GHZ, 300, &count) == NULL);
+}
+
+// Readers racing to build the lazy indexes all get the same answers.
+void TestConcurrentQueries() {
+  for (int round = 0; round < 10; ++round) {
+    std::shared_ptr<const ScanResult> result = MakeResult(10 + round, 2000);
+    const std::string ssid = result->AccessPoints()[0].ssid;
+    const int kReaders = 4;
+    std::vector<std::vector<uint32_t> > strongest(kReaders), with_ssid(kReaders),
+        on_band(kReaders);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < kReaders; ++r) {
+      readers.push_back(std::thread([&, r]() {
+        size_t count;
+        for (size_t n = 1; n <= 64; n *= 2) {
+          result->Strongest(n * (r + 1), &count);
+        }
+        const uint32_t* entries = result->Strongest(100, &count);
+        strongest[r] = AsVector(entries, count);
+        entries = result->WithSsid(ssid, &count);
+        with_ssid[r] = AsVector(entries, count);
+        entries = result->OnBand(BAND_5_GHZ, &count);
+        on_band[r] = AsVector(entries, count);
+      }));
+    }
+    for (size_t t = 0; t < readers.size(); ++t) {
+      readers[t].join();
+    }
+    for (int r = 1; r < kReaders; ++r) {
+      EXPECT(strongest[r] == strongest[0]);
+      EXPECT(with_ssid[r] == with_ssid[0]);
+      EXPECT(on_band[r] == on_band[0]);
+    }
+    EXPECT(!with_ssid[0].empty());
+  }
+}
+
+void TestWithoutIndex() {
+  std::vector<AccessPoint> aps(3);
+  aps[0].radio_signal_strength = -70;
+  aps[1].radio_signal_strength = -40;
+  aps[2].radio_signal_strength = -55;
+  ScanResult result(aps, NULL);
+  EXPECT(aps.empty());
+  size_t count;
+  const uint32_t* strongest = result.Strongest(2, &count);
+  EXPECT_EQ(2u, count);
+  EXPECT(strongest && strongest[0] == 1 && strongest[1] == 2);
+  result.OnBand(BAND_UNKNOWN, &count);
+  EXPECT_EQ(3u, count);
+}
+}  // namespace
+
+int main() {
+  TestStrongestMatchesFullSort();
+  TestSsidAndChannelQueriesMatchLinearScans();
+  TestConcurrentQueries();
+  TestWithoutIndex();
+  return TestExitCode();
+}
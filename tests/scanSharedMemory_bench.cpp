@@ -0,0 +1,129 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Reads per second and sequence-lock retries per read for several reader
+// processes while one writer publishes at a fixed rate.
+//
+//   scanSharedMemory_bench [seconds per case]
+
+#include "wifi_scanSharedMemory.h"
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <thread>
+
+namespace {
+const uint32_t kRecords = 64;
+
+std::vector<AccessPoint> MakeScan(uint32_t n) {
+  std::vector<AccessPoint> aps(kRecords);
+  for (uint32_t i = 0; i < kRecords; ++i) {
+    char mac[32];
+    snprintf(mac, sizeof(mac), "%04x%08x", i, n);
+    aps[i].mac_address = mac;
+    aps[i].radio_signal_strength = -40 - static_cast<int>(i % 50);
+    aps[i].ssid = "benchmark";
+  }
+  return aps;
+}
+
+struct ReaderResult {
+  uint64_t reads;
+  uint64_t retries;
+};
+
+void Run(int readers, int publish_interval_us, double seconds) {
+  char name[64];
+  snprintf(name, sizeof(name), "/wifiShmBench%d", static_cast<int>(getpid()));
+  SharedScanWriter writer;
+  if (!writer.Create(name, kRecords)) {
+    printf("cannot create %s\n", name);
+    return;
+  }
+  writer.Publish(MakeScan(0), 0);
+
+  int fds[2];
+  if (pipe(fds)) {
+    return;
+  }
+  std::vector<pid_t> children;
+  for (int r = 0; r < readers; ++r) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(fds[0]);
+      SharedScanReader reader;
+      reader.Open(name);
+      SharedScanSnapshot snapshot;
+      ReaderResult result = { 0, 0 };
+      double end = NowSeconds() + seconds;
+      while (NowSeconds() < end) {
+        for (int i = 0; i < 64; ++i, ++result.reads) {
+          reader.Read(&snapshot);
+        }
+      }
+      result.retries = reader.Retries();
+      ssize_t ignored = write(fds[1], &result, sizeof(result));
+      (void)ignored;
+      _exit(0);
+    }
+    children.push_back(pid);
+  }
+  close(fds[1]);
+
+  std::vector<std::vector<AccessPoint> > scans;
+  for (uint32_t n = 0; n < 16; ++n) {
+    scans.push_back(MakeScan(n));
+  }
+  uint64_t published = 0;
+  double start = NowSeconds();
+  double end = start + seconds;
+  while (NowSeconds() < end) {
+    writer.Publish(scans[published % scans.size()], published);
+    ++published;
+    if (publish_interval_us) {
+      std::this_thread::sleep_for(std::chrono::microseconds(publish_interval_us));
+    }
+  }
+  double elapsed = NowSeconds() - start;
+
+  ReaderResult total = { 0, 0 };
+  for (int r = 0; r < readers; ++r) {
+    ReaderResult result;
+    if (read(fds[0], &result, sizeof(result)) == sizeof(result)) {
+      total.reads += result.reads;
+      total.retries += result.retries;
+    }
+  }
+  close(fds[0]);
+  for (size_t c = 0; c < children.size(); ++c) {
+    waitpid(children[c], NULL, 0);
+  }
+  writer.Close();
+
+  char rate[32];
+  if (publish_interval_us) {
+    snprintf(rate, sizeof(rate), "every %d us", publish_interval_us);
+  } else {
+    snprintf(rate, sizeof(rate), "back to back");
+  }
+  printf("%d readers  publish %-14s %9.0f publishes/s  %10.0f reads/s  "
+         "%.4f retries/read\n",
+         readers, rate, published / elapsed, total.reads / elapsed,
+         total.reads ? static_cast<double>(total.retries) / total.reads : 0.0);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+  const int kReaders[] = { 1, 4 };
+  const int kIntervals[] = { 1000, 0 };
+  for (int r = 0; r < 2; ++r) {
+    for (int i = 0; i < 2; ++i) {
+      Run(kReaders[r], kIntervals[i], seconds);
+    }
+  }
+  return 0;
+}
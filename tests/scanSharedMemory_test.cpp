@@ -0,0 +1,203 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_scanSharedMemory.h"
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <thread>
+
+namespace {
+const uint32_t kRecords = 32;
+
+std::string RegionName(const char* suffix) {
+  char name[64];
+  snprintf(name, sizeof(name), "/wifiShmTest%d%s", static_cast<int>(getpid()), suffix);
+  return name;
+}
+
+// Scan |n| has kRecords APs whose MACs carry their index and n, all with
+// the same RSSI, so a reader can tell a torn copy from a consistent one.
+std::vector<AccessPoint> MakeScan(uint32_t n, uint32_t count) {
+  std::vector<AccessPoint> aps(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    char mac[32];
+    snprintf(mac, sizeof(mac), "%04x%08x", i, n);
+    aps[i].mac_address = mac;
+    aps[i].radio_signal_strength = -static_cast<int>(n % 100);
+    aps[i].ssid = "scan";
+  }
+  return aps;
+}
+
+bool Consistent(const SharedScanSnapshot& snapshot) {
+  uint32_t n = static_cast<uint32_t>(snapshot.scan_number);
+  if (snapshot.access_points.size() != kRecords) {
+    return false;
+  }
+  for (uint32_t i = 0; i < kRecords; ++i) {
+    char mac[32];
+    snprintf(mac, sizeof(mac), "%04x%08x", i, n);
+    const AccessPoint& ap = snapshot.access_points[i];
+    if (ap.mac_address != mac || ap.radio_signal_strength != -static_cast<int>(n % 100)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Child: reads until it has seen scan |last|, exiting non-zero on any torn
+// snapshot or if it never gets there.
+int ReaderProcess(const std::string& name, uint64_t last) {
+  SharedScanReader reader;
+  for (int i = 0; i < 2000 && !reader.Open(name); ++i) {
+    usleep(1000);
+  }
+  SharedScanSnapshot snapshot;
+  snapshot.scan_number = 0;
+  uint64_t previous = 0;
+  double deadline = NowSeconds() + 20;
+  while (snapshot.scan_number < last) {
+    if (NowSeconds() > deadline) {
+      return 2;
+    }
+    if (!reader.Read(&snapshot)) {
+      continue;
+    }
+    if (!Consistent(snapshot) || snapshot.scan_number < previous) {
+      return 1;
+    }
+    previous = snapshot.scan_number;
+  }
+  return 0;
+}
+
+void TestManyReaderProcesses() {
+  const int kReaders = 4;
+  const uint32_t kScans = 20000;
+  std::string name = RegionName("multi");
+  SharedScanWriter writer;
+  EXPECT(writer.Create(name, kRecords));
+
+  std::vector<pid_t> children;
+  for (int r = 0; r < kReaders; ++r) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      _exit(ReaderProcess(name, kScans));
+    }
+    EXPECT(pid > 0);
+    children.push_back(pid);
+  }
+  for (uint32_t n = 1; n <= kScans; ++n) {
+    writer.Publish(MakeScan(n, kRecords), n);
+    if (n % 64 == 0) {
+      std::this_thread::yield();
+    }
+  }
+  for (size_t c = 0; c < children.size(); ++c) {
+    int status = -1;
+    waitpid(children[c], &status, 0);
+    EXPECT(WIFEXITED(status));
+    EXPECT_EQ(0, WEXITSTATUS(status));
+  }
+  writer.Close();
+}
+
+// A second writer taking the region over with a larger capacity grows the
+// object, but a reader mapped before must stay within what it validated.
+void TestTakeoverWithLargerCapacity() {
+  std::string name = RegionName("takeover");
+  SharedScanWriter small;
+  EXPECT(small.Create(name, 4));
+  small.Publish(MakeScan(1, 10), 1);
+  SharedScanReader reader;
+  EXPECT(reader.Open(name));
+  SharedScanSnapshot snapshot;
+  EXPECT(reader.Read(&snapshot));
+  EXPECT_EQ(4u, snapshot.access_points.size());
+  EXPECT_EQ(10u, snapshot.total_count);
+
+  SharedScanWriter large;
+  EXPECT(large.Create(name, 256));
+  large.Publish(MakeScan(2, 256), 2);
+  EXPECT(reader.Read(&snapshot));
+  EXPECT_EQ(4u, snapshot.access_points.size());
+  EXPECT_EQ(256u, snapshot.total_count);
+  EXPECT_EQ(std::string("000000000002"), snapshot.access_points[0].mac_address);
+
+  // A reader opened now sees the new capacity.
+  SharedScanReader fresh;
+  EXPECT(fresh.Open(name));
+  EXPECT(fresh.Read(&snapshot));
+  EXPECT_EQ(256u, snapshot.access_points.size());
+  large.Close();
+  small.Close();
+}
+
+void TestReadBeforePublish() {
+  std::string name = RegionName("empty");
+  SharedScanReader reader;
+  EXPECT(!reader.Open(name));
+  SharedScanWriter writer;
+  EXPECT(writer.Create(name, 8));
+  EXPECT(reader.Open(name));
+  SharedScanSnapshot snapshot;
+  EXPECT(!reader.Read(&snapshot));
+  EXPECT_EQ(0u, reader.LatestScanNumber());
+  writer.Publish(MakeScan(1, 3), 42);
+  EXPECT_EQ(1u, reader.LatestScanNumber());
+  EXPECT(reader.Read(&snapshot));
+  EXPECT_EQ(42, snapshot.timestamp_ms);
+  EXPECT_EQ(3u, snapshot.access_points.size());
+  writer.Close();
+}
+// A writer that dies mid-update leaves the sequence odd. Readers give up
+// after a bounded wait instead of spinning forever, and a new writer taking
+// the region over makes it readable again.
+void TestWriterDiedMidUpdate() {
+  std::string name = RegionName("dead");
+  SharedScanWriter writer;
+  EXPECT(writer.Create(name, 8));
+  writer.Publish(MakeScan(1, 3), 1);
+  SharedScanReader reader;
+  EXPECT(reader.Open(name));
+
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  EXPECT(fd >= 0);
+  SharedScanRegion* region = static_cast<SharedScanRegion*>(
+      mmap(NULL, sizeof(SharedScanRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+  close(fd);
+  EXPECT(region != MAP_FAILED);
+  region->sequence.fetch_add(1);
+
+  double start = NowSeconds();
+  EXPECT_EQ(0u, reader.LatestScanNumber());
+  SharedScanSnapshot snapshot;
+  EXPECT(!reader.Read(&snapshot));
+  EXPECT(NowSeconds() - start < 2);
+  munmap(region, sizeof(SharedScanRegion));
+
+  SharedScanWriter replacement;
+  EXPECT(replacement.Create(name, 8));
+  replacement.Publish(MakeScan(2, 3), 2);
+  reader.Close();
+  EXPECT(reader.Open(name));
+  EXPECT(reader.Read(&snapshot));
+  EXPECT_EQ(2, snapshot.timestamp_ms);
+  replacement.Close();
+  writer.Close();
+}
+}  // namespace
+
+int main() {
+  TestReadBeforePublish();
+  TestTakeoverWithLargerCapacity();
+  TestWriterDiedMidUpdate();
+  TestManyReaderProcesses();
+  return TestExitCode();
+}
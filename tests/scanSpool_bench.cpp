@@ -0,0 +1,104 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Spool append rate and how fast a backlog drains to the loopback stand-in
+// server at different batch sizes.
+//
+//   scanSpool_bench [reports]
+
+#include "wifi_scanSpool.h"
+#include "httpStandIn.h"
+#include "test.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace {
+const int kApsPerReport = 20;
+
+std::vector<AccessPoint> MakeReport(int n) {
+  std::vector<AccessPoint> aps(kApsPerReport);
+  for (int i = 0; i < kApsPerReport; ++i) {
+    char mac[16];
+    snprintf(mac, sizeof(mac), "%04x%08x", i, n);
+    aps[i].mac_address = mac;
+    aps[i].radio_signal_strength = -40 - i;
+    aps[i].ssid = "benchmark-network";
+  }
+  return aps;
+}
+
+std::string TempDir() {
+  char dir[] = "/tmp/scanSpoolBenchXXXXXX";
+  return mkdtemp(dir) ? dir : "/tmp";
+}
+
+void Fill(ScanSpool* spool, int reports, const char* label) {
+  std::vector<AccessPoint> report = MakeReport(0);
+  double start = NowSeconds();
+  for (int i = 0; i < reports; ++i) {
+    spool->Append(report, i);
+  }
+  double elapsed = NowSeconds() - start;
+  if (label) {
+    printf("append %-22s %9.0f reports/s\n", label, reports / elapsed);
+  }
+}
+
+void Drain(const std::string& dir, int reports, size_t batch_records) {
+  StandInHttpServer server;
+  server.Start();
+  HttpUploadTransport transport(server.Port());
+  ScanSpool spool;
+  ScanSpool::Options spool_options;
+  spool_options.capacity_bytes = 64 << 20;
+  spool.Open(dir + "/drain", spool_options);
+  Fill(&spool, reports, NULL);
+
+  SpoolUploader::Options options;
+  options.batch_records = batch_records;
+  SpoolUploader uploader(&spool, &transport, options);
+  double start = NowSeconds();
+  uploader.Start();
+  while (spool.GetStats().records) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  double elapsed = NowSeconds() - start;
+  uploader.Stop();
+  spool.Close();
+  unlink((dir + "/drain").c_str());
+  printf("drain batch %4zu              %9.0f reports/s  %7.0f requests/s\n",
+         batch_records, reports / elapsed, uploader.GetStats().batches / elapsed);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  int reports = argc > 1 ? atoi(argv[1]) : 20000;
+  std::string dir = TempDir();
+  printf("%d reports of %d APs\n", reports, kApsPerReport);
+  {
+    ScanSpool spool;
+    ScanSpool::Options options;
+    options.capacity_bytes = 64 << 20;
+    spool.Open(dir + "/append", options);
+    Fill(&spool, reports, "");
+    spool.Close();
+    unlink((dir + "/append").c_str());
+  }
+  {
+    ScanSpool spool;
+    ScanSpool::Options options;
+    options.capacity_bytes = 64 << 20;
+    options.flush_on_append = true;
+    spool.Open(dir + "/append", options);
+    Fill(&spool, reports / 20, "(flush_on_append)");
+    spool.Close();
+    unlink((dir + "/append").c_str());
+  }
+  const size_t kBatches[] = { 1, 10, 100, 500 };
+  for (size_t b = 0; b < sizeof(kBatches) / sizeof(kBatches[0]); ++b) {
+    Drain(dir, kBatches[b] == 1 ? reports / 10 : reports, kBatches[b]);
+  }
+  rmdir(dir.c_str());
+  return 0;
+}
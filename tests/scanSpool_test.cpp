@@ -0,0 +1,178 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_scanSpool.h"
+#include "httpStandIn.h"
+#include "test.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace {
+std::vector<std::string>& SpoolDirs() {
+  static std::vector<std::string> dirs;
+  return dirs;
+}
+
+std::string TempSpoolPath() {
+  char dir[] = "/tmp/scanSpoolXXXXXX";
+  if (!mkdtemp(dir)) {
+    return std::string();
+  }
+  SpoolDirs().push_back(dir);
+  return std::string(dir) + "/spool";
+}
+
+void RemoveSpools() {
+  for (size_t i = 0; i < SpoolDirs().size(); ++i) {
+    unlink((SpoolDirs()[i] + "/spool").c_str());
+    rmdir(SpoolDirs()[i].c_str());
+  }
+}
+
+std::vector<AccessPoint> MakeReport(int n) {
+  std::vector<AccessPoint> aps(5);
+  for (int i = 0; i < 5; ++i) {
+    char mac[32];
+    snprintf(mac, sizeof(mac), "00%02x%08x", i, n);
+    aps[i].mac_address = mac;
+    aps[i].radio_signal_strength = -40 - i;
+    aps[i].ssid = "report";
+  }
+  return aps;
+}
+
+template <typename Predicate>
+bool WaitFor(Predicate predicate, int timeout_ms) {
+  for (int waited = 0; waited < timeout_ms; waited += 5) {
+    if (predicate()) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  return predicate();
+}
+
+// Every report arrived exactly once and in order.
+bool ReceivedInOrder(const std::vector<uint64_t>& received, size_t count) {
+  if (received.size() != count) {
+    return false;
+  }
+  for (size_t i = 1; i < received.size(); ++i) {
+    if (received[i] != received[i - 1] + 1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+SpoolUploader::Options FastRetries() {
+  SpoolUploader::Options options;
+  options.batch_records = 64;
+  options.initial_backoff_ms = 20;
+  options.max_backoff_ms = 80;
+  options.idle_poll_ms = 50;
+  return options;
+}
+
+void TestDrainsThroughHttp() {
+  StandInHttpServer server;
+  EXPECT(server.Start());
+  HttpUploadTransport transport(server.Port());
+  ScanSpool spool;
+  EXPECT(spool.Open(TempSpoolPath(), ScanSpool::Options()));
+  const int kReports = 1000;
+  for (int i = 0; i < kReports; ++i) {
+    EXPECT(spool.Append(MakeReport(i), 1000 + i));
+  }
+  SpoolUploader uploader(&spool, &transport, FastRetries());
+  uploader.Start();
+  uploader.Kick();
+  EXPECT(WaitFor([&] { return spool.GetStats().records == 0; }, 5000));
+  uploader.Stop();
+  EXPECT(ReceivedInOrder(server.Received(), kReports));
+  SpoolUploader::Stats stats = uploader.GetStats();
+  EXPECT_EQ(static_cast<uint64_t>(kReports), stats.reports);
+  EXPECT_EQ(0u, stats.failures);
+  EXPECT_EQ(static_cast<uint64_t>((kReports + 63) / 64), stats.batches);
+}
+
+// 503s and dropped connections leave the reports spooled, are retried with
+// growing backoff rather than in a tight loop, and nothing is lost or
+// duplicated once the server is back.
+void TestOutageBacksOffAndRecovers() {
+  StandInHttpServer server;
+  EXPECT(server.Start());
+  HttpUploadTransport transport(server.Port());
+  ScanSpool spool;
+  EXPECT(spool.Open(TempSpoolPath(), ScanSpool::Options()));
+  SpoolUploader uploader(&spool, &transport, FastRetries());
+
+  server.SetMode(StandInHttpServer::UNAVAILABLE);
+  const int kReports = 300;
+  for (int i = 0; i < kReports; ++i) {
+    spool.Append(MakeReport(i), i);
+  }
+  double start = NowSeconds();
+  uploader.Start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(250));
+  server.SetMode(StandInHttpServer::DROP);
+  std::this_thread::sleep_for(std::chrono::milliseconds(250));
+  double outage = NowSeconds() - start;
+
+  SpoolUploader::Stats stats = uploader.GetStats();
+  EXPECT(stats.failures >= 4);
+  EXPECT_EQ(0u, stats.reports);
+  EXPECT_EQ(80, stats.backoff_ms);
+  // Backoff waits at least half of 20, 40, 80, 80, ... ms between attempts.
+  EXPECT(server.Requests() <= 3 + static_cast<int>(outage * 1000 / 40));
+  EXPECT(server.Received().empty());
+  EXPECT_EQ(static_cast<uint64_t>(kReports), spool.GetStats().records);
+
+  server.SetMode(StandInHttpServer::SERVE);
+  uploader.Kick();
+  EXPECT(WaitFor([&] { return spool.GetStats().records == 0; }, 5000));
+  uploader.Stop();
+  EXPECT(ReceivedInOrder(server.Received(), kReports));
+  EXPECT_EQ(0, uploader.GetStats().backoff_ms);
+}
+
+// Reports spooled during an outage survive the process going away and are
+// delivered by the next one.
+void TestReportsSurviveRestartDuringOutage() {
+  StandInHttpServer server;
+  EXPECT(server.Start());
+  HttpUploadTransport transport(server.Port());
+  std::string path = TempSpoolPath();
+  const int kReports = 200;
+  server.SetMode(StandInHttpServer::UNAVAILABLE);
+  {
+    ScanSpool spool;
+    EXPECT(spool.Open(path, ScanSpool::Options()));
+    SpoolUploader uploader(&spool, &transport, FastRetries());
+    uploader.Start();
+    for (int i = 0; i < kReports; ++i) {
+      spool.Append(MakeReport(i), i);
+    }
+    EXPECT(WaitFor([&] { return uploader.GetStats().failures >= 2; }, 2000));
+  }
+
+  server.SetMode(StandInHttpServer::SERVE);
+  ScanSpool spool;
+  EXPECT(spool.Open(path, ScanSpool::Options()));
+  EXPECT_EQ(static_cast<uint64_t>(kReports), spool.GetStats().recovered);
+  SpoolUploader uploader(&spool, &transport, FastRetries());
+  uploader.Start();
+  EXPECT(WaitFor([&] { return spool.GetStats().records == 0; }, 5000));
+  uploader.Stop();
+  EXPECT(ReceivedInOrder(server.Received(), kReports));
+}
+}  // namespace
+
+int main() {
+  TestDrainsThroughHttp();
+  TestOutageBacksOffAndRecovers();
+  TestReportsSurviveRestartDuringOutage();
+  RemoveSpools();
+  return TestExitCode();
+}
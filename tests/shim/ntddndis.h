@@ -0,0 +1,91 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// The OID_802_11_BSSID_LIST structures from the Windows DDK, laid out as
+// there, for building and feeding the parsers on Linux.
+#pragma once
+
+#include <windows.h>
+
+typedef ULONG NDIS_STATUS;
+typedef UCHAR NDIS_802_11_MAC_ADDRESS[6];
+typedef LONG NDIS_802_11_RSSI;
+typedef UCHAR NDIS_802_11_RATES[8];
+typedef UCHAR NDIS_802_11_RATES_EX[16];
+
+typedef struct _NDIS_802_11_SSID {
+  ULONG SsidLength;
+  UCHAR Ssid[32];
+} NDIS_802_11_SSID;
+
+typedef enum _NDIS_802_11_NETWORK_TYPE {
+  Ndis802_11FH,
+  Ndis802_11DS,
+  Ndis802_11OFDM5,
+  Ndis802_11OFDM24
+} NDIS_802_11_NETWORK_TYPE;
+
+typedef enum _NDIS_802_11_NETWORK_INFRASTRUCTURE {
+  Ndis802_11IBSS,
+  Ndis802_11Infrastructure
+} NDIS_802_11_NETWORK_INFRASTRUCTURE;
+
+typedef struct _NDIS_802_11_CONFIGURATION_FH {
+  ULONG Length;
+  ULONG HopPattern;
+  ULONG HopSet;
+  ULONG DwellTime;
+} NDIS_802_11_CONFIGURATION_FH;
+
+typedef struct _NDIS_802_11_CONFIGURATION {
+  ULONG Length;
+  ULONG BeaconPeriod;
+  ULONG ATIMWindow;
+  ULONG DSConfig;
+  NDIS_802_11_CONFIGURATION_FH FHConfig;
+} NDIS_802_11_CONFIGURATION;
+
+typedef struct _NDIS_WLAN_BSSID {
+  ULONG Length;
+  NDIS_802_11_MAC_ADDRESS MacAddress;
+  UCHAR Reserved[2];
+  NDIS_802_11_SSID Ssid;
+  ULONG Privacy;
+  NDIS_802_11_RSSI Rssi;
+  NDIS_802_11_NETWORK_TYPE NetworkTypeInUse;
+  NDIS_802_11_CONFIGURATION Configuration;
+  NDIS_802_11_NETWORK_INFRASTRUCTURE InfrastructureMode;
+  NDIS_802_11_RATES SupportedRates;
+} NDIS_WLAN_BSSID;
+
+typedef struct _NDIS_WLAN_BSSID_EX {
+  ULONG Length;
+  NDIS_802_11_MAC_ADDRESS MacAddress;
+  UCHAR Reserved[2];
+  NDIS_802_11_SSID Ssid;
+  ULONG Privacy;
+  NDIS_802_11_RSSI Rssi;
+  NDIS_802_11_NETWORK_TYPE NetworkTypeInUse;
+  NDIS_802_11_CONFIGURATION Configuration;
+  NDIS_802_11_NETWORK_INFRASTRUCTURE InfrastructureMode;
+  NDIS_802_11_RATES_EX SupportedRates;
+  ULONG IELength;
+  UCHAR IEs[1];
+} NDIS_WLAN_BSSID_EX;
+
+typedef struct _NDIS_802_11_FIXED_IEs {
+  UCHAR Timestamp[8];
+  USHORT BeaconInterval;
+  USHORT Capabilities;
+} NDIS_802_11_FIXED_IEs;
+
+typedef struct _NDIS_802_11_BSSID_LIST {
+  ULONG NumberOfItems;
+  NDIS_WLAN_BSSID Bssid[1];
+} NDIS_802_11_BSSID_LIST;
+
+typedef struct _NDIS_802_11_BSSID_LIST_EX {
+  ULONG NumberOfItems;
+  NDIS_WLAN_BSSID_EX Bssid[1];
+} NDIS_802_11_BSSID_LIST_EX;
@@ -0,0 +1,24 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Just enough of <windows.h> for the portable modules to build on Linux.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t ULONG;
+typedef int32_t LONG;
+typedef uint32_t DWORD;
+typedef uint16_t USHORT;
+typedef uint8_t UCHAR;
+typedef uint8_t BYTE;
+typedef int BOOL;
+typedef void* HANDLE;
+
+#define TRUE 1
+#define FALSE 0
+#define WINAPI
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+#define ERROR_SUCCESS 0
@@ -0,0 +1,40 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Minimal test support: EXPECT records a failure and carries on, so one run
+// reports every broken check. A test's main() returns TestExitCode().
+#pragma once
+
+#include <stdio.h>
+#include <chrono>
+
+inline int& TestFailureCount() {
+  static int failures = 0;
+  return failures;
+}
+
+#define EXPECT(condition)                                              \
+  do {                                                                 \
+    if (!(condition)) {                                                \
+      fprintf(stderr, "%s:%d: EXPECT(%s) failed\n", __FILE__, __LINE__, \
+              #condition);                                             \
+      ++TestFailureCount();                                            \
+    }                                                                  \
+  } while (0)
+
+#define EXPECT_EQ(expected, actual) EXPECT((expected) == (actual))
+
+inline int TestExitCode() {
+  if (TestFailureCount()) {
+    fprintf(stderr, "%d check(s) failed\n", TestFailureCount());
+    return 1;
+  }
+  return 0;
+}
+
+// Seconds on a monotonic clock, for benchmarks.
+inline double NowSeconds() {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
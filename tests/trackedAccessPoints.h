@@ -0,0 +1,114 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// A refcounted result array standing in for nsCOMArray<nsWifiAccessPoint>,
+// with the same recycling rule as WindowsNdisApi: a removed object is kept
+// for reuse only when the array holds its last reference.
+#pragma once
+
+#include "wifi_accessPointTracker.h"
+#include <string.h>
+#include <string>
+#include <vector>
+
+struct FakeAccessPoint {
+  FakeAccessPoint() : refs(1), bssid(kInvalidBssid), signal(0) { ++Live(); }
+  ~FakeAccessPoint() { --Live(); }
+
+  static int& Live() {
+    static int live = 0;
+    return live;
+  }
+
+  int refs;
+  PackedBssid bssid;
+  int signal;
+  std::string ssid;
+};
+
+inline void ReleaseFakeAccessPoint(FakeAccessPoint* ap) {
+  if (--ap->refs == 0) {
+    delete ap;
+  }
+}
+
+class FakeAccessPointArray : public TrackedAccessPointArray {
+public:
+  FakeAccessPointArray() : ssid_sets_(0) { memset(&stats_, 0, sizeof(stats_)); }
+  ~FakeAccessPointArray() {
+    Clear();
+    for (size_t i = 0; i < free_.size(); ++i) {
+      ReleaseFakeAccessPoint(free_[i]);
+    }
+  }
+
+  size_t Count() const { return objects_.size(); }
+  const void* ObjectAt(size_t i) const { return objects_[i]; }
+  FakeAccessPoint* At(size_t i) const { return objects_[i]; }
+
+  void Clear() {
+    for (size_t i = 0; i < objects_.size(); ++i) {
+      ReleaseFakeAccessPoint(objects_[i]);
+    }
+    objects_.clear();
+  }
+
+  void Append(const NDIS_WLAN_BSSID& entry) {
+    FakeAccessPoint* ap;
+    if (!free_.empty()) {
+      ap = free_.back();
+      free_.pop_back();
+      ++stats_.recycled;
+      ++stats_.releases;
+    } else {
+      ap = new FakeAccessPoint;
+      ++stats_.allocated;
+    }
+    ap->bssid = PackBssid(entry.MacAddress);
+    ap->signal = entry.Rssi;
+    ap->ssid.assign(reinterpret_cast<const char*>(entry.Ssid.Ssid),
+                    entry.Ssid.SsidLength);
+    objects_.push_back(ap);
+  }
+
+  void SetSignal(size_t i, int rssi) { objects_[i]->signal = rssi; }
+
+  void SetSsid(size_t i, const NDIS_802_11_SSID& ssid) {
+    objects_[i]->ssid.assign(reinterpret_cast<const char*>(ssid.Ssid),
+                             ssid.SsidLength);
+    ++ssid_sets_;
+  }
+
+  void RemoveAt(size_t i) {
+    FakeAccessPoint* ap = objects_[i];
+    if (ap->refs == 1 && free_.size() < kMaxRecycled) {
+      ++ap->refs;
+      free_.push_back(ap);
+      ++stats_.addrefs;
+    }
+    objects_[i] = objects_.back();
+    objects_.pop_back();
+    ReleaseFakeAccessPoint(ap);
+  }
+
+  // A listener keeping slot |i|'s object past the next scan.
+  FakeAccessPoint* Hold(size_t i) {
+    ++objects_[i]->refs;
+    return objects_[i];
+  }
+
+  // What to hand AccessPointTracker::BeginScan, so the tracker's counts and
+  // the array's land in one place.
+  AccessPointUpdateStats* Stats() { return &stats_; }
+  size_t Recyclable() const { return free_.size(); }
+  int SsidSets() const { return ssid_sets_; }
+
+private:
+  static const size_t kMaxRecycled = 256;
+
+  AccessPointUpdateStats stats_;
+  std::vector<FakeAccessPoint*> objects_;
+  std::vector<FakeAccessPoint*> free_;
+  int ssid_sets_;
+};
@@ -0,0 +1,120 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Time from startup to the first result consumers can use, starting cold
+// (wait for the first device query) and warm (load the state file and
+// restore its scan while the query runs), plus the cost of loading and
+// saving state files of different sizes.
+//
+//   warmStart_bench [first query ms]
+
+#include "wifi_warmStart.h"
+#include "wifi_scanCoalescer.h"
+#include "coalescerClients.h"
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace {
+const int kRuns = 5;
+const int kFileIterations = 2000;
+
+WarmStartState MakeState(int aps) {
+  WarmStartState state;
+  state.interfaces.push_back("{4D36E972-E325-11CE-BFC1-08002BE10318}");
+  state.query_buffer_size = 65536;
+  state.scan_time_ms = WarmStartNowMs() - 30000;
+  for (int i = 0; i < aps; ++i) {
+    AccessPoint ap;
+    char mac[16];
+    snprintf(mac, sizeof(mac), "0011%08x", i);
+    ap.mac_address = mac;
+    ap.radio_signal_strength = -40 - i % 50;
+    ap.ssid = "corporate-network";
+    state.access_points.push_back(ap);
+  }
+  return state;
+}
+
+// Milliseconds from "startup" until a consumer holds a result: the first
+// live one, or with |path| the restored one. *live_ms gets the time to the
+// first live result either way.
+double TimeToFirstResult(int query_ms, const char* path, double* live_ms) {
+  double start = NowSeconds();
+  FakeAccessPointQuery query(query_ms);
+  ScanCoalescer coalescer(&query);
+  if (path) {
+    WarmStartState state;
+    if (LoadWarmStartState(path, &state)) {
+      coalescer.Restore(state.access_points, state.ScanAgeMs(WarmStartNowMs()));
+    }
+  }
+  std::thread scanner([&coalescer] { coalescer.Request(0); });
+  double first_ms = -1;
+  if (coalescer.Latest()) {
+    first_ms = (NowSeconds() - start) * 1000;
+  }
+  scanner.join();
+  *live_ms = (NowSeconds() - start) * 1000;
+  return first_ms >= 0 ? first_ms : *live_ms;
+}
+
+double Median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  return values[values.size() / 2];
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  int query_ms = argc > 1 ? atoi(argv[1]) : 1500;
+  char path[] = "/tmp/warmStartBenchXXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    return 1;
+  }
+  close(fd);
+
+  printf("first device query takes %d ms, median of %d starts\n", query_ms, kRuns);
+  SaveWarmStartState(path, MakeState(60));
+  std::vector<double> cold;
+  std::vector<double> warm;
+  std::vector<double> cold_live;
+  std::vector<double> warm_live;
+  for (int i = 0; i < kRuns; ++i) {
+    double live;
+    cold.push_back(TimeToFirstResult(query_ms, NULL, &live));
+    cold_live.push_back(live);
+    warm.push_back(TimeToFirstResult(query_ms, path, &live));
+    warm_live.push_back(live);
+  }
+  printf("cold   first result %9.3f ms  first live result %7.1f ms\n",
+         Median(cold), Median(cold_live));
+  printf("warm   first result %9.3f ms  first live result %7.1f ms "
+         "(restored, 60 APs)\n", Median(warm), Median(warm_live));
+
+  int sizes[] = { 10, 60, 500, 5000 };
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    WarmStartState state = MakeState(sizes[s]);
+    double start = NowSeconds();
+    for (int i = 0; i < kFileIterations / 10; ++i) {
+      SaveWarmStartState(path, state);
+    }
+    double save_us = (NowSeconds() - start) * 1e6 / (kFileIterations / 10);
+    FILE* file = fopen(path, "rb");
+    fseek(file, 0, SEEK_END);
+    long bytes = ftell(file);
+    fclose(file);
+    WarmStartState loaded;
+    start = NowSeconds();
+    for (int i = 0; i < kFileIterations; ++i) {
+      LoadWarmStartState(path, &loaded);
+    }
+    double load_us = (NowSeconds() - start) * 1e6 / kFileIterations;
+    printf("%5d APs  %7ld bytes  load %8.1f us  save (with fsync) %8.1f us\n",
+           sizes[s], bytes, load_us, save_us);
+  }
+  unlink(path);
+  return 0;
+}
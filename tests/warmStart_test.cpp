@@ -0,0 +1,144 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_warmStart.h"
+#include "wifi_scanCoalescer.h"
+#include "coalescerClients.h"
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace {
+std::string StatePath() {
+  char path[] = "/tmp/warmStartXXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    return std::string();
+  }
+  close(fd);
+  return path;
+}
+
+WarmStartState MakeState() {
+  WarmStartState state;
+  state.interfaces.push_back("{4D36E972-E325-11CE-BFC1-08002BE10318}");
+  state.interfaces.push_back("E1000");
+  state.query_buffer_size = 65536;
+  state.scan_time_ms = WarmStartNowMs() - 5000;
+  for (int i = 0; i < 40; ++i) {
+    AccessPoint ap;
+    char mac[16];
+    snprintf(mac, sizeof(mac), "0011223344%02x", i);
+    ap.mac_address = mac;
+    ap.radio_signal_strength = -40 - i;
+    ap.ssid = i % 3 ? "office" : "";
+    state.access_points.push_back(ap);
+  }
+  return state;
+}
+
+bool SameState(const WarmStartState& a, const WarmStartState& b) {
+  if (a.interfaces != b.interfaces || a.query_buffer_size != b.query_buffer_size ||
+      a.scan_time_ms != b.scan_time_ms ||
+      a.access_points.size() != b.access_points.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.access_points.size(); ++i) {
+    if (a.access_points[i].mac_address != b.access_points[i].mac_address ||
+        a.access_points[i].radio_signal_strength !=
+            b.access_points[i].radio_signal_strength ||
+        a.access_points[i].ssid != b.access_points[i].ssid) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Overwrite(const std::string& path, long offset, char byte) {
+  FILE* file = fopen(path.c_str(), "r+b");
+  fseek(file, offset, SEEK_SET);
+  fputc(byte, file);
+  fclose(file);
+}
+
+void TestInterfaceNames() {
+  EXPECT(IsValidInterfaceName("{4D36E972-E325-11CE-BFC1-08002BE10318}"));
+  EXPECT(IsValidInterfaceName("NdisWan_1"));
+  EXPECT(!IsValidInterfaceName(""));
+  EXPECT(!IsValidInterfaceName("..\\..\\GLOBAL??\\C:"));
+  EXPECT(!IsValidInterfaceName("a/b"));
+  EXPECT(!IsValidInterfaceName(std::string(65, 'a')));
+}
+
+void TestRoundTrip() {
+  std::string path = StatePath();
+  WarmStartState saved = MakeState();
+  EXPECT(SaveWarmStartState(path, saved));
+  WarmStartState loaded;
+  EXPECT(LoadWarmStartState(path, &loaded));
+  EXPECT(SameState(saved, loaded));
+  EXPECT(loaded.ScanAgeMs(WarmStartNowMs()) >= 5000);
+  // The temporary file was renamed away.
+  EXPECT(access((path + ".tmp").c_str(), F_OK) != 0);
+  unlink(path.c_str());
+}
+
+// A rejected file leaves the caller's state as it was.
+void TestRejectsBadFiles() {
+  std::string path = StatePath();
+  WarmStartState saved = MakeState();
+  WarmStartState kept;
+  kept.query_buffer_size = 7;
+
+  EXPECT(SaveWarmStartState(path, saved));
+  Overwrite(path, 60, 'x');
+  EXPECT(!LoadWarmStartState(path, &kept));
+
+  EXPECT(SaveWarmStartState(path, saved));
+  EXPECT_EQ(0, truncate(path.c_str(), 50));
+  EXPECT(!LoadWarmStartState(path, &kept));
+
+  // Checksummed but naming a path outside \Device\, as a hand-edited or
+  // planted file might.
+  saved.interfaces.push_back("..\\..\\GLOBAL??\\C:");
+  EXPECT(SaveWarmStartState(path, saved));
+  EXPECT(!LoadWarmStartState(path, &kept));
+
+  unlink(path.c_str());
+  EXPECT(!LoadWarmStartState(path, &kept));
+  EXPECT_EQ(7u, kept.query_buffer_size);
+  EXPECT(kept.interfaces.empty());
+}
+
+// A restored scan is available before the first query finishes, marked
+// restored and aged, and only served to callers that accept its age.
+void TestRestoredScanServedFirst() {
+  std::string path = StatePath();
+  EXPECT(SaveWarmStartState(path, MakeState()));
+  WarmStartState state;
+  EXPECT(LoadWarmStartState(path, &state));
+  unlink(path.c_str());
+
+  FakeAccessPointQuery query(0);
+  ScanCoalescer coalescer(&query);
+  coalescer.Restore(state.access_points, state.ScanAgeMs(WarmStartNowMs()));
+  std::shared_ptr<const ScanCoalescer::Result> latest = coalescer.Latest();
+  EXPECT(latest && latest->restored);
+  EXPECT_EQ(40u, latest->access_points.size());
+  EXPECT(coalescer.Request(60000) == latest);
+  EXPECT_EQ(0, query.Calls());
+  std::shared_ptr<const ScanCoalescer::Result> live = coalescer.Request(1000);
+  EXPECT(!live->restored);
+  EXPECT_EQ(1, query.Calls());
+}
+}  // namespace
+
+int main() {
+  TestInterfaceNames();
+  TestRoundTrip();
+  TestRejectsBadFiles();
+  TestRestoredScanServedFirst();
+  return TestExitCode();
+}
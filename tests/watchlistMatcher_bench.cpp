@@ -0,0 +1,88 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Per-scan matching time as the number of watchlists grows to 100k, for the
+// inverted index and for the nested loop over mac_address strings it
+// replaces, plus the cost of adding and removing watchlists.
+//
+//   watchlistMatcher_bench [scans per case]
+
+#include "wifi_watchlistMatcher.h"
+#include "watchlistScenes.h"
+#include "test.h"
+#include <stdlib.h>
+
+namespace {
+const size_t kPoolSize = 500000;
+const size_t kMinSize = 10;
+const size_t kMaxSize = 50;
+const size_t kScanAps = 50;
+// The nested loop gets this many watchlist-scans in total per case, so the
+// 100k case still finishes in seconds.
+const size_t kNaiveBudget = 200000;
+
+void Run(size_t watchlists, int scans) {
+  WatchlistScene scene =
+      MakeWatchlistScene(kPoolSize, watchlists, kMinSize, kMaxSize, 3);
+  WatchlistMatcher matcher;
+  double start = NowSeconds();
+  for (size_t w = 0; w < watchlists; ++w) {
+    matcher.Add(static_cast<WatchlistId>(w), scene.watchlists[w], scene.rules[w]);
+  }
+  double add_us = (NowSeconds() - start) * 1e6 / watchlists;
+
+  std::mt19937 random(5);
+  std::vector<std::vector<AccessPoint> > aps;
+  for (int i = 0; i < scans; ++i) {
+    aps.push_back(MakeWatchlistScan(scene, kScanAps, random));
+  }
+  std::vector<WatchlistMatch> matches;
+  size_t matched = 0;
+  start = NowSeconds();
+  for (int i = 0; i < scans; ++i) {
+    matcher.Match(aps[i], matches);
+    matched += matches.size();
+  }
+  double index_us = (NowSeconds() - start) * 1e6 / scans;
+  double postings = static_cast<double>(matcher.GetStats().postings_visited) / scans;
+
+  // Remove and re-add a tenth of the watchlists, as a config reload would.
+  size_t churn = watchlists / 10;
+  start = NowSeconds();
+  for (size_t w = 0; w < churn; ++w) {
+    matcher.Remove(static_cast<WatchlistId>(w));
+  }
+  for (size_t w = 0; w < churn; ++w) {
+    matcher.Add(static_cast<WatchlistId>(w), scene.watchlists[w], scene.rules[w]);
+  }
+  double churn_us = churn ? (NowSeconds() - start) * 1e6 / churn : 0;
+
+  NaiveWatchlistMatcher naive;
+  for (size_t w = 0; w < watchlists; ++w) {
+    naive.Add(static_cast<WatchlistId>(w), scene.watchlists[w], scene.rules[w]);
+  }
+  int naive_scans = static_cast<int>(
+      std::max<size_t>(1, std::min<size_t>(scans, kNaiveBudget / watchlists)));
+  start = NowSeconds();
+  for (int i = 0; i < naive_scans; ++i) {
+    naive.Match(aps[i], matches);
+  }
+  double naive_us = (NowSeconds() - start) * 1e6 / naive_scans;
+
+  printf("%7zu watchlists  index %8.1f us/scan (%6.0f postings, %5.1f matches)"
+         "  nested loop %11.1f us/scan  add %5.2f us  remove+add %5.2f us\n",
+         watchlists, index_us, postings, static_cast<double>(matched) / scans,
+         naive_us, add_us, churn_us);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  int scans = argc > 1 ? atoi(argv[1]) : 2000;
+  printf("%zu-AP scans, watchlists of %zu-%zu BSSIDs from a pool of %zu\n",
+         kScanAps, kMinSize, kMaxSize, kPoolSize);
+  Run(1000, scans);
+  Run(10000, scans);
+  Run(100000, scans);
+  return 0;
+}
@@ -0,0 +1,145 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_watchlistMatcher.h"
+#include "watchlistScenes.h"
+#include "test.h"
+
+namespace {
+AccessPoint MakeAp(PackedBssid bssid, int rssi) {
+  AccessPoint ap;
+  ap.mac_address = BssidString(bssid);
+  ap.radio_signal_strength = rssi;
+  return ap;
+}
+
+bool SameMatches(const std::vector<WatchlistMatch>& a,
+                 const std::vector<WatchlistMatch>& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i].id != b[i].id || a[i].hits != b[i].hits ||
+        a[i].strongest_rssi != b[i].strongest_rssi) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void TestRules() {
+  WatchlistMatcher matcher;
+  std::vector<PackedBssid> bssids;
+  bssids.push_back(1);
+  bssids.push_back(2);
+  bssids.push_back(2);
+  bssids.push_back(kInvalidBssid);
+  bssids.push_back(3);
+  WatchlistRule any;
+  WatchlistRule two;
+  two.min_hits = 2;
+  WatchlistRule strong;
+  strong.min_rssi = -60;
+  EXPECT(matcher.Add(10, bssids, any));
+  EXPECT(matcher.Add(20, bssids, two));
+  EXPECT(matcher.Add(30, bssids, strong));
+  EXPECT(!matcher.Add(10, bssids, any));
+  EXPECT_EQ(3u, matcher.Size());
+
+  std::vector<AccessPoint> scan;
+  scan.push_back(MakeAp(2, -70));
+  // A repeated BSSID counts once, at its strongest.
+  scan.push_back(MakeAp(2, -50));
+  scan.push_back(MakeAp(9, -40));
+  std::vector<WatchlistMatch> matches;
+  matcher.Match(scan, matches);
+  EXPECT_EQ(2u, matches.size());
+  EXPECT_EQ(10u, matches[0].id);
+  EXPECT_EQ(1u, matches[0].hits);
+  EXPECT_EQ(-50, matches[0].strongest_rssi);
+  EXPECT_EQ(30u, matches[1].id);
+
+  scan.push_back(MakeAp(3, -65));
+  matcher.Match(scan, matches);
+  EXPECT_EQ(3u, matches.size());
+  EXPECT_EQ(20u, matches[1].id);
+  EXPECT_EQ(2u, matches[1].hits);
+  // -65 is below watchlist 30's minimum, so only BSSID 2 counts there.
+  EXPECT_EQ(1u, matches[2].hits);
+
+  EXPECT(matcher.Remove(20));
+  EXPECT(!matcher.Remove(20));
+  matcher.Match(scan, matches);
+  EXPECT_EQ(2u, matches.size());
+  EXPECT(matches[0].id == 10 && matches[1].id == 30);
+}
+
+// A slot reused after removal must not inherit the old watchlist's hits.
+void TestSlotReuse() {
+  WatchlistMatcher matcher;
+  std::vector<PackedBssid> first(1, 1);
+  std::vector<PackedBssid> second(1, 2);
+  WatchlistRule rule;
+  matcher.Add(1, first, rule);
+  std::vector<AccessPoint> scan(1, MakeAp(1, -50));
+  std::vector<WatchlistMatch> matches;
+  matcher.Match(scan, matches);
+  EXPECT_EQ(1u, matches.size());
+  matcher.Remove(1);
+  matcher.Add(2, second, rule);
+  matcher.Match(scan, matches);
+  EXPECT(matches.empty());
+  scan.push_back(MakeAp(2, -50));
+  matcher.Match(scan, matches);
+  EXPECT_EQ(1u, matches.size());
+  EXPECT_EQ(2u, matches[0].id);
+  EXPECT_EQ(1u, matches[0].hits);
+}
+
+// Random watchlists added and removed between scans match exactly what the
+// nested string loop finds.
+void TestAgreesWithNestedLoop() {
+  WatchlistScene scene = MakeWatchlistScene(2000, 500, 1, 40, 7);
+  WatchlistMatcher matcher;
+  NaiveWatchlistMatcher naive;
+  for (size_t w = 0; w < scene.watchlists.size(); ++w) {
+    matcher.Add(static_cast<WatchlistId>(w), scene.watchlists[w], scene.rules[w]);
+    naive.Add(static_cast<WatchlistId>(w), scene.watchlists[w], scene.rules[w]);
+  }
+  std::mt19937 random(11);
+  std::vector<WatchlistMatch> matches;
+  std::vector<WatchlistMatch> expected;
+  int mismatches = 0;
+  size_t matched = 0;
+  for (int scan = 0; scan < 200; ++scan) {
+    if (scan % 10 == 9) {
+      for (int i = 0; i < 20; ++i) {
+        WatchlistId id = static_cast<WatchlistId>(random() % scene.watchlists.size());
+        if (matcher.Remove(id)) {
+          naive.Remove(id);
+        } else {
+          matcher.Add(id, scene.watchlists[id], scene.rules[id]);
+          naive.Add(id, scene.watchlists[id], scene.rules[id]);
+        }
+      }
+    }
+    std::vector<AccessPoint> aps = MakeWatchlistScan(scene, 60, random);
+    matcher.Match(aps, matches);
+    naive.Match(aps, expected);
+    mismatches += !SameMatches(expected, matches);
+    matched += matches.size();
+  }
+  EXPECT_EQ(0, mismatches);
+  // The scene is dense enough that the comparison means something.
+  EXPECT(matched > 200);
+  EXPECT_EQ(200u, matcher.GetStats().scans);
+}
+}  // namespace
+
+int main() {
+  TestRules();
+  TestSlotReuse();
+  TestAgreesWithNestedLoop();
+  return TestExitCode();
+}
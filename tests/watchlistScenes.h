@@ -0,0 +1,148 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Random watchlists and scans drawn from a shared pool of BSSIDs, and the
+// nested loop over mac_address strings that WatchlistMatcher replaces, as a
+// reference for its test and benchmark.
+#pragma once
+
+#include "wifi_watchlistMatcher.h"
+#include <stdio.h>
+#include <algorithm>
+#include <random>
+#include <string>
+
+inline std::string BssidString(PackedBssid bssid) {
+  char text[16];
+  snprintf(text, sizeof(text), "%012llx", static_cast<unsigned long long>(bssid));
+  return text;
+}
+
+struct WatchlistScene {
+  std::vector<PackedBssid> pool;
+  std::vector<std::vector<PackedBssid> > watchlists;
+  std::vector<WatchlistRule> rules;
+};
+
+// |watchlists| lists of |min_size|..|max_size| BSSIDs from a pool of
+// |pool_size|. Rules ask for 1 to 3 hits, and a quarter of them also set a
+// minimum RSSI.
+inline WatchlistScene MakeWatchlistScene(size_t pool_size, size_t watchlists,
+                                         size_t min_size, size_t max_size,
+                                         uint32_t seed) {
+  std::mt19937 random(seed);
+  WatchlistScene scene;
+  scene.pool.reserve(pool_size);
+  for (size_t i = 0; i < pool_size; ++i) {
+    scene.pool.push_back((static_cast<PackedBssid>(random()) << 16 ^ random()) &
+                         0xFFFFFFFFFFFFULL);
+  }
+  std::uniform_int_distribution<size_t> size(min_size, max_size);
+  std::uniform_int_distribution<size_t> pick(0, pool_size - 1);
+  scene.watchlists.resize(watchlists);
+  scene.rules.resize(watchlists);
+  for (size_t w = 0; w < watchlists; ++w) {
+    size_t count = size(random);
+    for (size_t i = 0; i < count; ++i) {
+      scene.watchlists[w].push_back(scene.pool[pick(random)]);
+    }
+    scene.rules[w].min_hits = 1 + random() % 3;
+    if (random() % 4 == 0) {
+      scene.rules[w].min_rssi = -80 + static_cast<int>(random() % 30);
+    }
+  }
+  return scene;
+}
+
+// |aps| APs, about half from the pool and the rest unknown, with an
+// occasional BSSID reported twice.
+inline std::vector<AccessPoint> MakeWatchlistScan(const WatchlistScene& scene,
+                                                  size_t aps,
+                                                  std::mt19937& random) {
+  std::vector<AccessPoint> scan;
+  std::uniform_int_distribution<size_t> pick(0, scene.pool.size() - 1);
+  for (size_t i = 0; i < aps; ++i) {
+    AccessPoint ap;
+    PackedBssid bssid = random() % 2
+                            ? scene.pool[pick(random)]
+                            : (static_cast<PackedBssid>(random()) << 16) & 0xFFFFFFFFFFFFULL;
+    ap.mac_address = BssidString(bssid);
+    ap.radio_signal_strength = -95 + static_cast<int>(random() % 65);
+    ap.ssid = "scene";
+    scan.push_back(ap);
+    if (random() % 10 == 0) {
+      ap.radio_signal_strength -= 5;
+      scan.push_back(ap);
+    }
+  }
+  return scan;
+}
+
+// The nested loop: every watchlist compared against every AP by string.
+class NaiveWatchlistMatcher {
+public:
+  void Add(WatchlistId id, const std::vector<PackedBssid>& bssids,
+           const WatchlistRule& rule) {
+    Entry entry;
+    entry.id = id;
+    entry.rule = rule;
+    for (size_t i = 0; i < bssids.size(); ++i) {
+      std::string text = BssidString(bssids[i]);
+      if (std::find(entry.macs.begin(), entry.macs.end(), text) == entry.macs.end()) {
+        entry.macs.push_back(text);
+      }
+    }
+    entries_.push_back(entry);
+  }
+
+  void Remove(WatchlistId id) {
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      if (entries_[i].id == id) {
+        entries_.erase(entries_.begin() + i);
+        return;
+      }
+    }
+  }
+
+  void Match(const std::vector<AccessPoint>& scan,
+             std::vector<WatchlistMatch>& matches) const {
+    matches.clear();
+    for (size_t w = 0; w < entries_.size(); ++w) {
+      const Entry& entry = entries_[w];
+      WatchlistMatch match = { entry.id, 0, 0 };
+      for (size_t m = 0; m < entry.macs.size(); ++m) {
+        bool hit = false;
+        int strongest = 0;
+        for (size_t i = 0; i < scan.size(); ++i) {
+          if (scan[i].mac_address == entry.macs[m] &&
+              scan[i].radio_signal_strength >= entry.rule.min_rssi) {
+            strongest = hit ? std::max(strongest, scan[i].radio_signal_strength)
+                            : scan[i].radio_signal_strength;
+            hit = true;
+          }
+        }
+        if (hit) {
+          match.strongest_rssi = match.hits ? std::max(match.strongest_rssi, strongest)
+                                            : strongest;
+          ++match.hits;
+        }
+      }
+      if (match.hits && match.hits >= entry.rule.min_hits) {
+        matches.push_back(match);
+      }
+    }
+    std::sort(matches.begin(), matches.end(),
+              [](const WatchlistMatch& a, const WatchlistMatch& b) {
+                return a.id < b.id;
+              });
+  }
+
+private:
+  struct Entry {
+    WatchlistId id;
+    WatchlistRule rule;
+    std::vector<std::string> macs;
+  };
+  std::vector<Entry> entries_;
+};
@@ -0,0 +1,36 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// Plain access point record, as produced by the Chromium scanner. Unlike
+// nsWifiAccessPoint it is not refcounted, so it can be handed between threads
+// and processes freely.
+struct AccessPoint {
+  std::string mac_address;
+  int radio_signal_strength;
+  std::string ssid;
+};
+
+// Estimated heap bytes held by |access_points|, for memory budgets. Strings
+// are counted only once they outgrow the inline storage common to the
+// standard libraries we build with.
+inline size_t AccessPointsMemoryUsage(const std::vector<AccessPoint>& access_points) {
+  const size_t kInlineStringCapacity = 15;
+  size_t bytes = access_points.capacity() * sizeof(AccessPoint);
+  for (size_t i = 0; i < access_points.size(); ++i) {
+    const AccessPoint& ap = access_points[i];
+    if (ap.mac_address.capacity() > kInlineStringCapacity) {
+      bytes += ap.mac_address.capacity() + 1;
+    }
+    if (ap.ssid.capacity() > kInlineStringCapacity) {
+      bytes += ap.ssid.capacity() + 1;
+    }
+  }
+  return bytes;
+}
@@ -0,0 +1,146 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_accessPointAger.h"
+#include <string.h>
+#include <algorithm>
+
+AccessPointAger::Options::Options()
+    : max_missed_scans(2),
+      max_age_ms(0) {
+}
+
+AccessPointAger::AccessPointAger(const Options& options)
+    : options_(options),
+      scan_number_(0),
+      previous_seen_(0) {
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+AccessPointAger::~AccessPointAger() {
+  AttachMemoryBudget(NULL);
+}
+
+void AccessPointAger::AttachMemoryBudget(MemoryBudget* budget) {
+  AttachBudget(budget, "ap history", MemoryBudget::PRIORITY_HISTORY);
+}
+
+size_t AccessPointAger::MemoryUsage() const {
+  return entries_.size() *
+             (kMemoryNodeOverhead + sizeof(PackedBssid) + sizeof(Entry)) +
+         entries_.bucket_count() * sizeof(void*) +
+         recency_.size() * (kMemoryNodeOverhead + sizeof(PackedBssid));
+}
+
+size_t AccessPointAger::ReclaimableMemory() const {
+  return recency_.empty() ? 0 : MemoryUsage();
+}
+
+void AccessPointAger::FreeMemory(size_t bytes) {
+  size_t per_entry =
+      kMemoryNodeOverhead * 2 + sizeof(PackedBssid) * 2 + sizeof(Entry);
+  size_t forget = std::min(recency_.size(), (bytes + per_entry - 1) / per_entry);
+  for (size_t i = 0; i < forget; ++i) {
+    entries_.erase(recency_.back());
+    recency_.pop_back();
+  }
+  if (entries_.empty()) {
+    std::unordered_map<PackedBssid, Entry>().swap(entries_);
+  }
+}
+
+bool AccessPointAger::Expired(const Entry& entry, int64_t now_ms) const {
+  if (options_.max_missed_scans &&
+      scan_number_ - entry.last_seen_scan > options_.max_missed_scans) {
+    return true;
+  }
+  return options_.max_age_ms && now_ms - entry.last_seen_ms > options_.max_age_ms;
+}
+
+bool AccessPointAger::Update(const std::vector<AccessPoint>& scan,
+                             int64_t now_ms, AccessPointChanges* changes) {
+  ClaimOwnership();
+  changes->appeared.clear();
+  changes->disappeared.clear();
+  ++scan_number_;
+  ++stats_.scans;
+
+  size_t seen = 0;
+  size_t seen_again = 0;
+  bool raw_new = false;
+  for (size_t i = 0; i < scan.size(); ++i) {
+    PackedBssid bssid = ParseBssid(scan[i].mac_address);
+    if (bssid == kInvalidBssid) {
+      continue;
+    }
+    std::pair<std::unordered_map<PackedBssid, Entry>::iterator, bool> inserted =
+        entries_.insert(std::make_pair(bssid, Entry()));
+    Entry& entry = inserted.first->second;
+    if (inserted.second) {
+      changes->appeared.push_back(scan[i]);
+      raw_new = true;
+    } else if (entry.last_seen_scan == scan_number_) {
+      // Listed twice in one scan (e.g. by two interfaces).
+      if (scan[i].radio_signal_strength > entry.access_point.radio_signal_strength) {
+        entry.access_point = scan[i];
+      }
+      continue;
+    } else {
+      if (entry.last_seen_scan == scan_number_ - 1) {
+        ++seen_again;
+      } else {
+        raw_new = true;
+      }
+      recency_.erase(entry.recency_position);
+    }
+    entry.access_point = scan[i];
+    entry.last_seen_scan = scan_number_;
+    entry.last_seen_ms = now_ms;
+    recency_.push_front(bssid);
+    entry.recency_position = recency_.begin();
+    ++seen;
+  }
+
+  // Everything seen this scan sits at the front, so the walk stops at the
+  // first entry that has not expired.
+  while (!recency_.empty()) {
+    std::unordered_map<PackedBssid, Entry>::iterator oldest =
+        entries_.find(recency_.back());
+    ++stats_.expiry_checks;
+    if (!Expired(oldest->second, now_ms)) {
+      break;
+    }
+    changes->disappeared.push_back(oldest->second.access_point);
+    entries_.erase(oldest);
+    recency_.pop_back();
+  }
+
+  if (raw_new || seen_again != previous_seen_) {
+    ++stats_.raw_changes;
+  }
+  previous_seen_ = seen;
+  stats_.appeared += changes->appeared.size();
+  stats_.disappeared += changes->disappeared.size();
+  bool changed = !changes->appeared.empty() || !changes->disappeared.empty();
+  if (changed) {
+    ++stats_.aged_changes;
+  }
+  ReportMemory();
+  return changed;
+}
+
+void AccessPointAger::GetAccessPoints(int64_t now_ms,
+                                      std::vector<AgedAccessPoint>& outData) const {
+  outData.clear();
+  outData.reserve(recency_.size());
+  for (std::list<PackedBssid>::const_iterator it = recency_.begin();
+       it != recency_.end(); ++it) {
+    const Entry& entry = entries_.find(*it)->second;
+    AgedAccessPoint aged;
+    aged.access_point = entry.access_point;
+    aged.age_ms = now_ms - entry.last_seen_ms;
+    aged.missed_scans = static_cast<uint32_t>(scan_number_ - entry.last_seen_scan);
+    outData.push_back(aged);
+  }
+}
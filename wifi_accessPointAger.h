@@ -0,0 +1,105 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stdint.h>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include "wifi_accessPoint.h"
+#include "wifi_bssid.h"
+#include "wifi_memoryBudget.h"
+
+struct AgedAccessPoint {
+  // Values from the most recent scan that included this AP.
+  AccessPoint access_point;
+  int64_t age_ms;
+  uint32_t missed_scans;
+};
+
+struct AccessPointChanges {
+  std::vector<AccessPoint> appeared;
+  std::vector<AccessPoint> disappeared;
+};
+
+// Smooths over drivers that leave APs out of alternate BSSID list polls.
+//
+// An AP stays in the aged set until it has been missing for more than
+// |max_missed_scans| scans or |max_age_ms| milliseconds (whichever limits
+// are non-zero), so listeners only hear about real appearances and
+// disappearances. Entries are kept in last-seen order, which makes expiry
+// pop from the oldest end: its cost is proportional to what expires, not to
+// the number of tracked APs.
+class AccessPointAger : private DeferredReleaseClient {
+public:
+  struct Options {
+    Options();
+    uint32_t max_missed_scans;
+    int64_t max_age_ms;
+  };
+
+  struct Stats {
+    uint64_t scans;
+    // Scans whose raw BSSID set differed from the previous scan's.
+    uint64_t raw_changes;
+    // Scans that changed the aged set, i.e. would notify listeners.
+    uint64_t aged_changes;
+    uint64_t appeared;
+    uint64_t disappeared;
+    // Entries looked at for expiry: what expired, plus at most one per scan.
+    uint64_t expiry_checks;
+  };
+
+  explicit AccessPointAger(const Options& options);
+  ~AccessPointAger();
+
+  // Accounts the aged set against |budget| as PRIORITY_HISTORY. When the
+  // budget is short the least recently seen APs are forgotten without being
+  // reported as disappeared; if they are seen again they appear anew. A
+  // reclaim on the thread calling Update() forgets at once; one on another
+  // thread is served at the end of the next Update(). NULL detaches.
+  void AttachMemoryBudget(MemoryBudget* budget);
+  // Estimated heap bytes held. SSIDs longer than the string's inline
+  // storage are not counted.
+  size_t MemoryUsage() const;
+
+  // Folds in one scan taken at |now_ms| (any monotonic clock; replayed
+  // captures pass their recorded times). Fills |changes| and returns true if
+  // the aged set gained or lost an AP.
+  bool Update(const std::vector<AccessPoint>& scan, int64_t now_ms,
+              AccessPointChanges* changes);
+
+  // The aged set as of the last Update, most recently seen first.
+  void GetAccessPoints(int64_t now_ms, std::vector<AgedAccessPoint>& outData) const;
+  size_t Size() const { return entries_.size(); }
+  const Stats& GetStats() const { return stats_; }
+
+private:
+  struct Entry {
+    AccessPoint access_point;
+    uint64_t last_seen_scan;
+    int64_t last_seen_ms;
+    // Position in recency_, oldest at the back.
+    std::list<PackedBssid>::iterator recency_position;
+  };
+
+  bool Expired(const Entry& entry, int64_t now_ms) const;
+
+  // DeferredReleaseClient:
+  size_t ReclaimableMemory() const;
+  void FreeMemory(size_t bytes);
+
+  AccessPointAger(const AccessPointAger&);
+  AccessPointAger& operator=(const AccessPointAger&);
+
+  const Options options_;
+  std::unordered_map<PackedBssid, Entry> entries_;
+  std::list<PackedBssid> recency_;
+  // Number of the scan being folded in; entries seen by it carry this value.
+  uint64_t scan_number_;
+  // How many entries the previous scan saw, for raw churn accounting.
+  size_t previous_seen_;
+  Stats stats_;
+};
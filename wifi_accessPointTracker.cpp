@@ -0,0 +1,175 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_accessPointTracker.h"
+#include <string.h>
+#include "wifi_memoryBudget.h"
+
+namespace {
+ULONG SsidLength(const NDIS_802_11_SSID& ssid) {
+  return ssid.SsidLength < sizeof(ssid.Ssid) ? ssid.SsidLength : sizeof(ssid.Ssid);
+}
+
+bool SameSsid(const uint8_t* ssid, uint32_t ssid_length,
+              const NDIS_802_11_SSID& other) {
+  ULONG length = SsidLength(other);
+  return ssid_length == length && memcmp(ssid, other.Ssid, length) == 0;
+}
+
+void CopySsid(const NDIS_802_11_SSID& from, uint8_t* ssid, uint32_t* ssid_length) {
+  ULONG length = SsidLength(from);
+  memcpy(ssid, from.Ssid, length);
+  *ssid_length = length;
+}
+
+uint32_t HashSsid(const NDIS_802_11_SSID& ssid) {
+  // FNV-1a; only used to notice that a known BSSID changed its SSID.
+  uint32_t hash = 2166136261u;
+  ULONG length = SsidLength(ssid);
+  for (ULONG i = 0; i < length; ++i) {
+    hash = (hash ^ ssid.Ssid[i]) * 16777619u;
+  }
+  return hash;
+}
+}  // namespace
+
+AccessPointTracker::AccessPointTracker()
+    : stats_(NULL) {
+}
+
+size_t AccessPointTracker::MemoryUsage() const {
+  return tracked_.capacity() * sizeof(TrackedAccessPoint) +
+         tracked_index_.size() *
+             (kMemoryNodeOverhead + sizeof(PackedBssid) + sizeof(int)) +
+         tracked_index_.bucket_count() * sizeof(void*);
+}
+
+bool AccessPointTracker::IsTrackedArray(const TrackedAccessPointArray& array) const {
+  if (tracked_.size() != array.Count()) {
+    return false;
+  }
+  for (size_t i = 0; i < tracked_.size(); ++i) {
+    if (array.ObjectAt(i) != tracked_[i].object) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void AccessPointTracker::BeginScan(TrackedAccessPointArray& array,
+                                   AccessPointUpdateStats* stats, bool* changed) {
+  stats_ = stats;
+  memset(stats_, 0, sizeof(*stats_));
+  if (!IsTrackedArray(array)) {
+    // Not the array we filled last time; start from scratch.
+    stats_->releases += static_cast<uint32_t>(array.Count());
+    array.Clear();
+    tracked_.clear();
+    tracked_index_.clear();
+    *changed = true;
+  }
+
+  for (size_t i = 0; i < tracked_.size(); ++i) {
+    tracked_[i].seen = false;
+  }
+}
+
+void AccessPointTracker::Merge(const NDIS_802_11_BSSID_LIST& bss_id_list,
+                               int list_size, TrackedAccessPointArray& array,
+                               bool* changed) {
+  const uint8_t* iterator = reinterpret_cast<const uint8_t*>(&bss_id_list.Bssid[0]);
+  const uint8_t* end_of_buffer =
+      reinterpret_cast<const uint8_t*>(&bss_id_list) + list_size;
+  for (int i = 0; i < static_cast<int>(bss_id_list.NumberOfItems); ++i) {
+    const NDIS_WLAN_BSSID *bss_id =
+        reinterpret_cast<const NDIS_WLAN_BSSID*>(iterator);
+    if (bss_id->Length < sizeof(NDIS_WLAN_BSSID) ||
+        iterator + bss_id->Length > end_of_buffer) {
+      break;
+    }
+    iterator += bss_id->Length;
+
+    PackedBssid bssid = PackBssid(bss_id->MacAddress);
+    uint32_t ssid_hash = HashSsid(bss_id->Ssid);
+    std::unordered_map<PackedBssid, int>::iterator found =
+        tracked_index_.find(bssid);
+
+    if (found != tracked_index_.end()) {
+      const size_t slot = found->second;
+      TrackedAccessPoint& tracked = tracked_[slot];
+      if (tracked.seen) {
+        // Reported by more than one interface; keep the strongest signal.
+        if (bss_id->Rssi > tracked.signal) {
+          tracked.signal = bss_id->Rssi;
+          array.SetSignal(slot, bss_id->Rssi);
+        }
+        continue;
+      }
+      tracked.seen = true;
+      // The hash only rules out a change cheaply; equal hashes still need
+      // the bytes compared.
+      bool same_ssid = tracked.ssid_hash == ssid_hash &&
+                       SameSsid(tracked.ssid, tracked.ssid_length, bss_id->Ssid);
+      if (tracked.signal == bss_id->Rssi && same_ssid) {
+        ++stats_->unchanged;
+        continue;
+      }
+      if (!same_ssid) {
+        array.SetSsid(slot, bss_id->Ssid);
+        tracked.ssid_hash = ssid_hash;
+        CopySsid(bss_id->Ssid, tracked.ssid, &tracked.ssid_length);
+      }
+      array.SetSignal(slot, bss_id->Rssi);
+      tracked.signal = bss_id->Rssi;
+      ++stats_->updated;
+      *changed = true;
+      continue;
+    }
+
+    array.Append(*bss_id);
+    ++stats_->addrefs;
+
+    TrackedAccessPoint tracked;
+    tracked.bssid = bssid;
+    tracked.object = array.ObjectAt(array.Count() - 1);
+    tracked.signal = bss_id->Rssi;
+    tracked.ssid_hash = ssid_hash;
+    CopySsid(bss_id->Ssid, tracked.ssid, &tracked.ssid_length);
+    tracked.seen = true;
+    tracked_index_[bssid] = static_cast<int>(tracked_.size());
+    tracked_.push_back(tracked);
+    *changed = true;
+  }
+}
+
+void AccessPointTracker::EndScan(TrackedAccessPointArray& array, bool failed,
+                                 bool* changed) {
+  if (failed) {
+    for (size_t i = 0; i < tracked_.size(); ++i) {
+      tracked_[i].seen = true;
+    }
+    return;
+  }
+
+  // Drop APs that were not seen. Walking backwards, everything after i has
+  // already been kept, so the last entry can be moved into the hole.
+  for (int i = static_cast<int>(tracked_.size()) - 1; i >= 0; --i) {
+    if (tracked_[i].seen) {
+      continue;
+    }
+    size_t last = tracked_.size() - 1;
+    tracked_index_.erase(tracked_[i].bssid);
+    if (static_cast<size_t>(i) != last) {
+      tracked_[i] = tracked_[last];
+      tracked_index_[tracked_[i].bssid] = i;
+      ++stats_->addrefs;
+      ++stats_->releases;
+    }
+    array.RemoveAt(i);
+    tracked_.pop_back();
+    ++stats_->releases;
+    ++stats_->removed;
+    *changed = true;
+  }
+}
@@ -0,0 +1,94 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <windows.h>
+#include <ntddndis.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+#include "wifi_bssid.h"
+
+// Per-scan object and refcount traffic, for comparing the two ways of
+// filling a result array. AddRefs and Releases count only calls made through
+// the array; a rebuild leaves the Release of the previous scan's objects to
+// the caller's Clear().
+struct AccessPointUpdateStats {
+  uint32_t allocated;
+  uint32_t recycled;
+  uint32_t updated;
+  uint32_t unchanged;
+  uint32_t removed;
+  uint32_t addrefs;
+  uint32_t releases;
+};
+
+// The caller's array of refcounted result objects, as AccessPointTracker
+// drives it. The tracker counts the array's own AddRefs and Releases; an
+// implementation counts allocations and recycling in the stats it is given.
+class TrackedAccessPointArray {
+public:
+  virtual ~TrackedAccessPointArray() {}
+  virtual size_t Count() const = 0;
+  // Identity of the object in slot |i|; only compared, never dereferenced.
+  virtual const void* ObjectAt(size_t i) const = 0;
+  virtual void Clear() = 0;
+  // Appends an object describing |entry|, reusing a recycled one if any.
+  virtual void Append(const NDIS_WLAN_BSSID& entry) = 0;
+  virtual void SetSignal(size_t i, int rssi) = 0;
+  virtual void SetSsid(size_t i, const NDIS_802_11_SSID& ssid) = 0;
+  // Keeps slot |i|'s object for reuse if nobody else holds it, moves the
+  // last slot's object into |i| and drops the last slot.
+  virtual void RemoveAt(size_t i) = 0;
+};
+
+// Keeps a result array in step with successive scans instead of rebuilding
+// it: APs seen last time are matched by BSSID and updated in place, only new
+// APs are appended, and vanished ones are removed. A scan is BeginScan(),
+// one Merge() per interface's OID_802_11_BSSID_LIST response, and EndScan().
+class AccessPointTracker {
+public:
+  AccessPointTracker();
+
+  // Starts a scan of |array| and zeroes |stats|, which the scan fills. Any
+  // array other than the one the last scan left, unmodified, is noticed and
+  // refilled from scratch.
+  void BeginScan(TrackedAccessPointArray& array, AccessPointUpdateStats* stats,
+                 bool* changed);
+  // Folds in one interface's list of |list_size| bytes. An AP reported by
+  // more than one interface keeps its strongest signal.
+  void Merge(const NDIS_802_11_BSSID_LIST& bss_id_list, int list_size,
+             TrackedAccessPointArray& array, bool* changed);
+  // Drops the APs no interface reported. With |failed|, because every query
+  // failed, the previous result is kept instead of reported as gone.
+  void EndScan(TrackedAccessPointArray& array, bool failed, bool* changed);
+
+  size_t Size() const { return tracked_.size(); }
+  // Estimated heap bytes held.
+  size_t MemoryUsage() const;
+
+private:
+  // What the tracker knows about array slot i, kept in step with it.
+  // |object| lets a foreign array of the same length be told apart from the
+  // one filled last time.
+  struct TrackedAccessPoint {
+    PackedBssid bssid;
+    const void* object;
+    int signal;
+    uint32_t ssid_hash;
+    uint32_t ssid_length;
+    uint8_t ssid[32];
+    bool seen;
+  };
+
+  bool IsTrackedArray(const TrackedAccessPointArray& array) const;
+
+  AccessPointTracker(const AccessPointTracker&);
+  AccessPointTracker& operator=(const AccessPointTracker&);
+
+  std::vector<TrackedAccessPoint> tracked_;
+  std::unordered_map<PackedBssid, int> tracked_index_;
+  AccessPointUpdateStats* stats_;
+};
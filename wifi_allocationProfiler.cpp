@@ -0,0 +1,291 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_allocationProfiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define WIFI_THREAD_LOCAL __declspec(thread)
+#else
+#define WIFI_THREAD_LOCAL thread_local
+#endif
+
+namespace {
+const int kMaxTags = 64;
+// Index of the all-tags counters in g_counters.
+const int kTotal = kMaxTags;
+const uint32_t kUntracked = 0xFFFFFFFFu;
+
+struct LiveCounters {
+  std::atomic<uint64_t> allocations;
+  std::atomic<uint64_t> bytes;
+  std::atomic<uint64_t> frees;
+  std::atomic<int64_t> live_bytes;
+  std::atomic<int64_t> peak_live_bytes;
+};
+
+// Keeps malloc's 16-byte alignment for the block that follows.
+struct BlockHeader {
+  uint64_t size;
+  uint32_t tag;
+  uint32_t reserved;
+};
+
+// Zero-initialized before any dynamic initialization, so allocations made
+// by other static constructors are safe.
+LiveCounters g_counters[kMaxTags + 1];
+std::atomic<bool> g_active;
+WIFI_THREAD_LOCAL int t_current_tag = 0;
+
+// Everything below is only touched by RegisterTag, BeginScan and EndScan.
+std::mutex& ProfilerMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+const char* g_tag_names[kMaxTags] = { "(untagged)" };
+int g_tag_count = 1;
+int g_sample_interval = 1;
+uint64_t g_scans = 0;
+uint64_t g_sampled_scans = 0;
+bool g_scan_sampled = false;
+AllocationCounters g_scan_start[kMaxTags + 1];
+int64_t g_scan_start_live[kMaxTags + 1];
+AllocationCounters g_cumulative[kMaxTags + 1];
+
+void AddCounters(const AllocationCounters& from, AllocationCounters* to) {
+  to->allocations += from.allocations;
+  to->bytes += from.bytes;
+  to->frees += from.frees;
+  to->peak_live_bytes = std::max(to->peak_live_bytes, from.peak_live_bytes);
+}
+
+void FillReport(const AllocationCounters* counters, AllocationReport* report) {
+  report->entries.clear();
+  for (int i = 0; i < g_tag_count; ++i) {
+    if (counters[i].allocations || counters[i].frees) {
+      AllocationReport::Entry entry;
+      entry.tag = g_tag_names[i];
+      entry.counters = counters[i];
+      report->entries.push_back(entry);
+    }
+  }
+  std::sort(report->entries.begin(), report->entries.end(),
+            [](const AllocationReport::Entry& a, const AllocationReport::Entry& b) {
+              return a.counters.bytes > b.counters.bytes;
+            });
+  report->total = counters[kTotal];
+}
+
+#ifdef WIFI_ALLOCATION_PROFILER
+void RaisePeak(std::atomic<int64_t>& peak, int64_t live) {
+  int64_t current = peak.load(std::memory_order_relaxed);
+  while (live > current &&
+         !peak.compare_exchange_weak(current, live, std::memory_order_relaxed)) {
+  }
+}
+
+void Charge(LiveCounters& counters, uint64_t size) {
+  counters.allocations.fetch_add(1, std::memory_order_relaxed);
+  counters.bytes.fetch_add(size, std::memory_order_relaxed);
+  int64_t live = counters.live_bytes.fetch_add(static_cast<int64_t>(size),
+                                               std::memory_order_relaxed) + size;
+  RaisePeak(counters.peak_live_bytes, live);
+}
+
+void Release(LiveCounters& counters, uint64_t size) {
+  counters.frees.fetch_add(1, std::memory_order_relaxed);
+  counters.live_bytes.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+}
+
+void* TrackedAllocate(size_t size) {
+  BlockHeader* header = static_cast<BlockHeader*>(malloc(sizeof(BlockHeader) + size));
+  if (!header) {
+    return NULL;
+  }
+  header->size = size;
+  header->tag = kUntracked;
+  if (g_active.load(std::memory_order_relaxed)) {
+    int tag = t_current_tag;
+    header->tag = tag;
+    Charge(g_counters[tag], size);
+    Charge(g_counters[kTotal], size);
+  }
+  return header + 1;
+}
+
+void TrackedFree(void* block) {
+  if (!block) {
+    return;
+  }
+  BlockHeader* header = static_cast<BlockHeader*>(block) - 1;
+  // Blocks from sampled scans are released even after the scan has ended,
+  // so live bytes stay right for blocks that outlive it.
+  if (header->tag != kUntracked) {
+    Release(g_counters[header->tag], header->size);
+    Release(g_counters[kTotal], header->size);
+  }
+  free(header);
+}
+#endif
+}  // namespace
+
+std::string AllocationReport::ToString() const {
+  std::string result;
+  char line[160];
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const AllocationCounters& c = entries[i].counters;
+    snprintf(line, sizeof(line), "%-24s %8llu allocs %10llu bytes %8llu frees %10lld peak\n",
+             entries[i].tag.c_str(), static_cast<unsigned long long>(c.allocations),
+             static_cast<unsigned long long>(c.bytes),
+             static_cast<unsigned long long>(c.frees),
+             static_cast<long long>(c.peak_live_bytes));
+    result += line;
+  }
+  snprintf(line, sizeof(line), "%-24s %8llu allocs %10llu bytes %8llu frees %10lld peak\n",
+           "total", static_cast<unsigned long long>(total.allocations),
+           static_cast<unsigned long long>(total.bytes),
+           static_cast<unsigned long long>(total.frees),
+           static_cast<long long>(total.peak_live_bytes));
+  result += line;
+  return result;
+}
+
+bool AllocationProfiler::Enabled() {
+#ifdef WIFI_ALLOCATION_PROFILER
+  return true;
+#else
+  return false;
+#endif
+}
+
+void AllocationProfiler::SetSampleInterval(int interval) {
+  std::lock_guard<std::mutex> lock(ProfilerMutex());
+  g_sample_interval = std::max(1, interval);
+}
+
+bool AllocationProfiler::BeginScan() {
+  std::lock_guard<std::mutex> lock(ProfilerMutex());
+  g_scan_sampled = Enabled() && g_scans++ % g_sample_interval == 0;
+  if (!g_scan_sampled) {
+    return false;
+  }
+  for (int i = 0; i <= kMaxTags; ++i) {
+    LiveCounters& counters = g_counters[i];
+    g_scan_start[i].allocations = counters.allocations.load();
+    g_scan_start[i].bytes = counters.bytes.load();
+    g_scan_start[i].frees = counters.frees.load();
+    // Peaks are measured from what was live when the scan began.
+    g_scan_start_live[i] = counters.live_bytes.load();
+    counters.peak_live_bytes.store(g_scan_start_live[i]);
+  }
+  g_active.store(true);
+  return true;
+}
+
+void AllocationProfiler::EndScan(AllocationReport* report) {
+  std::lock_guard<std::mutex> lock(ProfilerMutex());
+  g_active.store(false);
+  if (!g_scan_sampled) {
+    report->entries.clear();
+    memset(&report->total, 0, sizeof(report->total));
+    return;
+  }
+  g_scan_sampled = false;
+  ++g_sampled_scans;
+  AllocationCounters scan[kMaxTags + 1];
+  for (int i = 0; i <= kMaxTags; ++i) {
+    LiveCounters& counters = g_counters[i];
+    scan[i].allocations = counters.allocations.load() - g_scan_start[i].allocations;
+    scan[i].bytes = counters.bytes.load() - g_scan_start[i].bytes;
+    scan[i].frees = counters.frees.load() - g_scan_start[i].frees;
+    scan[i].peak_live_bytes = counters.peak_live_bytes.load() - g_scan_start_live[i];
+    AddCounters(scan[i], &g_cumulative[i]);
+  }
+  FillReport(scan, report);
+}
+
+void AllocationProfiler::GetCumulative(AllocationReport* report) {
+  std::lock_guard<std::mutex> lock(ProfilerMutex());
+  FillReport(g_cumulative, report);
+}
+
+uint64_t AllocationProfiler::SampledScans() {
+  std::lock_guard<std::mutex> lock(ProfilerMutex());
+  return g_sampled_scans;
+}
+
+int AllocationProfiler::RegisterTag(const char* name) {
+  std::lock_guard<std::mutex> lock(ProfilerMutex());
+  for (int i = 0; i < g_tag_count; ++i) {
+    if (!strcmp(g_tag_names[i], name)) {
+      return i;
+    }
+  }
+  if (g_tag_count == kMaxTags) {
+    return 0;
+  }
+  g_tag_names[g_tag_count] = name;
+  return g_tag_count++;
+}
+
+ScopedAllocationTag::ScopedAllocationTag(int tag)
+    : previous_(t_current_tag) {
+  t_current_tag = tag;
+}
+
+ScopedAllocationTag::~ScopedAllocationTag() {
+  t_current_tag = previous_;
+}
+
+#ifdef WIFI_ALLOCATION_PROFILER
+void* operator new(size_t size) {
+  void* block = TrackedAllocate(size);
+  if (!block) {
+    throw std::bad_alloc();
+  }
+  return block;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return TrackedAllocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return TrackedAllocate(size);
+}
+
+void operator delete(void* block) noexcept {
+  TrackedFree(block);
+}
+
+void operator delete[](void* block) noexcept {
+  TrackedFree(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+  TrackedFree(block);
+}
+
+void operator delete[](void* block, size_t) noexcept {
+  TrackedFree(block);
+}
+
+void operator delete(void* block, const std::nothrow_t&) noexcept {
+  TrackedFree(block);
+}
+
+void operator delete[](void* block, const std::nothrow_t&) noexcept {
+  TrackedFree(block);
+}
+#endif
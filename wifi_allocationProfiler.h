@@ -0,0 +1,83 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Attributes heap allocations on the scan path to tagged phases.
+//
+// Only compiled in with WIFI_ALLOCATION_PROFILER defined, which replaces the
+// global operator new and delete with versions that keep a 16-byte header
+// recording each block's size and tag. Without it every call below is a
+// no-op and WIFI_ALLOCATION_SCOPE expands to nothing.
+//
+// Usage: bracket a scan cycle with BeginScan() and EndScan(), and mark code
+// with WIFI_ALLOCATION_SCOPE("name"). Allocations made during a sampled scan
+// are charged to the innermost scope on the allocating thread, or to
+// "(untagged)". With a sample interval of N only every Nth scan is tracked,
+// and the others pay just for the header.
+
+struct AllocationCounters {
+  uint64_t allocations;
+  uint64_t bytes;
+  uint64_t frees;
+  // High-water mark of bytes allocated under the tag and not yet freed.
+  int64_t peak_live_bytes;
+};
+
+struct AllocationReport {
+  struct Entry {
+    std::string tag;
+    AllocationCounters counters;
+  };
+  // Tags with any allocations, most bytes first.
+  std::vector<Entry> entries;
+  AllocationCounters total;
+
+  std::string ToString() const;
+};
+
+class AllocationProfiler {
+public:
+  static bool Enabled();
+
+  // Track one scan in every |interval| (1 = every scan).
+  static void SetSampleInterval(int interval);
+
+  // Returns true if this scan is sampled.
+  static bool BeginScan();
+  // Fills |report| for the scan just ended; empty if it was not sampled.
+  static void EndScan(AllocationReport* report);
+  // Totals over every sampled scan so far. Peaks are the highest per scan.
+  static void GetCumulative(AllocationReport* report);
+  static uint64_t SampledScans();
+
+  // Returns the id for |name|, which must be a string literal. Ids are
+  // handed out once per call site by WIFI_ALLOCATION_SCOPE.
+  static int RegisterTag(const char* name);
+};
+
+class ScopedAllocationTag {
+public:
+  explicit ScopedAllocationTag(int tag);
+  ~ScopedAllocationTag();
+
+private:
+  int previous_;
+};
+
+#ifdef WIFI_ALLOCATION_PROFILER
+#define WIFI_ALLOCATION_CONCAT_INNER(a, b) a##b
+#define WIFI_ALLOCATION_CONCAT(a, b) WIFI_ALLOCATION_CONCAT_INNER(a, b)
+#define WIFI_ALLOCATION_SCOPE(name)                                          \
+  static const int WIFI_ALLOCATION_CONCAT(allocation_tag_, __LINE__) =       \
+      AllocationProfiler::RegisterTag(name);                                 \
+  ScopedAllocationTag WIFI_ALLOCATION_CONCAT(allocation_scope_, __LINE__)(   \
+      WIFI_ALLOCATION_CONCAT(allocation_tag_, __LINE__))
+#else
+#define WIFI_ALLOCATION_SCOPE(name) do {} while (0)
+#endif
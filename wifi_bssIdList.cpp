@@ -0,0 +1,135 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_bssIdList.h"
+#include "wifi_allocationProfiler.h"
+#include "wifi_bssid.h"
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+#define uint8 unsigned char
+
+std::string MacAddressAsString(const unsigned char macAsNumber[MAC_AS_NUM_LEN])
+{
+  WIFI_ALLOCATION_SCOPE("MacAddressAsString");
+  return FormatBssid(macAsNumber);
+}
+
+bool ConvertToAccessPointData(const NDIS_WLAN_BSSID& data, AccessPoint& access_point_data)
+{
+  access_point_data.mac_address = MacAddressAsString(data.MacAddress);
+  access_point_data.radio_signal_strength = data.Rssi;
+  // Note that _NDIS_802_11_SSID::Ssid::Ssid is not null-terminated.
+  const unsigned char* ssid = data.Ssid.Ssid;
+  size_t len = data.Ssid.SsidLength;
+  WIFI_ALLOCATION_SCOPE("SSID copy");
+  access_point_data.ssid = std::string(reinterpret_cast<const char*>(ssid), len);
+  return true;
+}
+
+// Records the offset of each entry whose Length is sane, stopping at the
+// first one that is not. Returns the number of entries found.
+static int FindBssIdEntries(const NDIS_802_11_BSSID_LIST& bss_id_list,
+                            int list_size,
+                            std::vector<size_t>& offsets)
+{
+  offsets.clear();
+  const uint8* start = reinterpret_cast<const uint8*>(&bss_id_list);
+  const uint8* iterator = reinterpret_cast<const uint8*>(&bss_id_list.Bssid[0]);
+  const uint8* end_of_buffer = start + list_size;
+  for (int i = 0; i < static_cast<int>(bss_id_list.NumberOfItems); ++i) {
+    const NDIS_WLAN_BSSID *bss_id =
+        reinterpret_cast<const NDIS_WLAN_BSSID*>(iterator);
+    // Check that the length of this BSS ID is reasonable.
+    if (bss_id->Length < sizeof(NDIS_WLAN_BSSID) ||
+        iterator + bss_id->Length > end_of_buffer) {
+      break;
+    }
+    offsets.push_back(iterator - start);
+    // Move to the next BSS ID.
+    iterator += bss_id->Length;
+  }
+  return static_cast<int>(offsets.size());
+}
+
+static void ConvertBssIdEntries(const uint8* start,
+                                const std::vector<size_t>& offsets,
+                                size_t begin, size_t end,
+                                AccessPoint* out, char* converted)
+{
+  for (size_t i = begin; i < end; ++i) {
+    const NDIS_WLAN_BSSID* bss_id =
+        reinterpret_cast<const NDIS_WLAN_BSSID*>(start + offsets[i]);
+    converted[i] = ConvertToAccessPointData(*bss_id, out[i]);
+  }
+}
+
+// Threads are started and joined on every call. tests/bssIdList_bench puts
+// that at about 14 us against 75 ns per converted entry, so a thread breaks
+// even on an idle core at about 190 entries; each thread is given at least
+// half this many, which leaves room for cores that are busy.
+const int kParallelParseMinEntries = 1024;
+
+int GetDataFromBssIdList(const NDIS_802_11_BSSID_LIST& bss_id_list,
+                         int list_size,
+                         std::vector<AccessPoint>& outData)
+{
+  // NumberOfItems is an unvalidated upper bound, good enough for sizing.
+  int items = static_cast<int>(bss_id_list.NumberOfItems);
+  int threads = 1;
+  if (items >= kParallelParseMinEntries) {
+    threads = std::min(static_cast<int>(std::thread::hardware_concurrency()),
+                       items / (kParallelParseMinEntries / 2));
+  }
+  return GetDataFromBssIdList(bss_id_list, list_size, outData,
+                              std::max(1, threads));
+}
+
+int GetDataFromBssIdList(const NDIS_802_11_BSSID_LIST& bss_id_list,
+                         int list_size,
+                         std::vector<AccessPoint>& outData,
+                         int threads)
+{
+  WIFI_ALLOCATION_SCOPE("BSSID list parse");
+  std::vector<size_t> offsets;
+  const size_t count = FindBssIdEntries(bss_id_list, list_size, offsets);
+  if (!count) {
+    return 0;
+  }
+
+  const uint8* start = reinterpret_cast<const uint8*>(&bss_id_list);
+  const size_t base = outData.size();
+  outData.resize(base + count);
+  std::vector<char> converted(count);
+  AccessPoint* out = &outData[base];
+
+  const size_t chunks = std::max<size_t>(1, std::min<size_t>(threads, count));
+  const size_t chunk_size = (count + chunks - 1) / chunks;
+  std::vector<std::thread> workers;
+  for (size_t c = 1; c < chunks; ++c) {
+    size_t begin = c * chunk_size;
+    size_t end = std::min(count, begin + chunk_size);
+    workers.push_back(std::thread(ConvertBssIdEntries, start, std::cref(offsets),
+                                  begin, end, out, &converted[0]));
+  }
+  ConvertBssIdEntries(start, offsets, 0, std::min(count, chunk_size), out,
+                      &converted[0]);
+  for (size_t i = 0; i < workers.size(); ++i) {
+    workers[i].join();
+  }
+
+  // Drop entries that failed to convert, keeping the order of the rest.
+  size_t found = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (converted[i]) {
+      if (found != i) {
+        std::swap(out[found], out[i]);
+      }
+      ++found;
+    }
+  }
+  outData.resize(base + found);
+  return static_cast<int>(found);
+}
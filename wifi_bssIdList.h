@@ -0,0 +1,38 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <windows.h>
+#include <ntddndis.h>
+#include <string>
+#include <vector>
+#include "wifi_accessPoint.h"
+
+#define MAC_AS_NUM_LEN 6
+
+// Formats a MAC address as 12 lower case hex digits.
+std::string MacAddressAsString(const unsigned char macAsNumber[MAC_AS_NUM_LEN]);
+
+bool ConvertToAccessPointData(const NDIS_WLAN_BSSID& data, AccessPoint& access_point_data);
+
+// Walks an OID_802_11_BSSID_LIST response of |list_size| bytes and appends
+// one AccessPoint per valid entry. Returns the number of entries appended.
+// Lists of at least kParallelParseMinEntries entries are converted on several
+// threads; the result is the same either way.
+int GetDataFromBssIdList(const NDIS_802_11_BSSID_LIST& bss_id_list,
+                         int list_size,
+                         std::vector<AccessPoint>& outData);
+
+// As above, but converting on |threads| threads regardless of list size.
+// A sequential pass first validates each entry's Length and records where it
+// starts; the conversion then fills disjoint ranges of |outData| in place, so
+// the order matches the list. The extra threads are started for the call and
+// joined before it returns.
+int GetDataFromBssIdList(const NDIS_802_11_BSSID_LIST& bss_id_list,
+                         int list_size,
+                         std::vector<AccessPoint>& outData,
+                         int threads);
+
+extern const int kParallelParseMinEntries;
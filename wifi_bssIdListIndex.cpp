@@ -0,0 +1,263 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_bssIdListIndex.h"
+#include <stddef.h>
+#include <string.h>
+#include <utility>
+
+namespace {
+const unsigned char kIeRsn = 48;
+const unsigned char kIeVendor = 221;
+const uint32_t kWpaOui = 0x0050F2;  // Microsoft, used by WPA1
+const unsigned char kWpaOuiType = 1;
+
+// Frequencies at or below this are assumed to be in MHz; some drivers report
+// DSConfig in MHz despite the documentation.
+const uint32_t kMaxMhzValue = 100000;
+
+// Channel 177; everything between it and 6 GHz channel 1 (5955 MHz) except
+// 6 GHz channel 2 is unused.
+const uint32_t k5GhzLastMhz = 5885;
+const uint32_t k6GhzChannel2Mhz = 5935;
+
+uint16_t ReadLe16(const unsigned char* p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t ReadOui(const unsigned char* p) {
+  return (static_cast<uint32_t>(p[0]) << 16) | (p[1] << 8) | p[2];
+}
+
+uint32_t SuiteBit(const unsigned char* suite) {
+  return suite[3] < 32 ? 1u << suite[3] : 0;
+}
+
+// Parses the common body of the RSN IE and the WPA vendor IE, starting at the
+// version field. Missing trailing fields are allowed by the spec.
+void ParseSecurityBody(const unsigned char* p, size_t length,
+                       uint32_t* group, uint32_t* pairwise, uint32_t* akm,
+                       uint16_t* capabilities) {
+  if (length < 2) {
+    return;
+  }
+  p += 2;  // version
+  length -= 2;
+  if (length < 4) {
+    return;
+  }
+  *group = SuiteBit(p);
+  p += 4;
+  length -= 4;
+
+  uint32_t* lists[2] = { pairwise, akm };
+  for (int l = 0; l < 2; ++l) {
+    if (length < 2) {
+      return;
+    }
+    size_t count = ReadLe16(p);
+    p += 2;
+    length -= 2;
+    for (size_t i = 0; i < count && length >= 4; ++i) {
+      *lists[l] |= SuiteBit(p);
+      p += 4;
+      length -= 4;
+    }
+  }
+  if (capabilities && length >= 2) {
+    *capabilities = ReadLe16(p);
+  }
+}
+}  // namespace
+
+int FrequencyToChannel(uint32_t frequency_khz) {
+  uint32_t mhz = frequency_khz > kMaxMhzValue ? frequency_khz / 1000 : frequency_khz;
+  switch (FrequencyToBand(frequency_khz)) {
+    case BAND_2_4_GHZ:
+      return mhz == 2484 ? 14 : (mhz - 2407) / 5;
+    case BAND_5_GHZ:
+      return (mhz - 5000) / 5;
+    case BAND_6_GHZ:
+      return mhz == k6GhzChannel2Mhz ? 2 : (mhz - 5950) / 5;
+    default:
+      return 0;
+  }
+}
+
+WifiBand FrequencyToBand(uint32_t frequency_khz) {
+  uint32_t mhz = frequency_khz > kMaxMhzValue ? frequency_khz / 1000 : frequency_khz;
+  if (mhz >= 2412 && mhz <= 2484) {
+    return BAND_2_4_GHZ;
+  }
+  // 6 GHz channel 2 sits below channel 1, in the gap above the last 5 GHz
+  // channel, so it is checked first.
+  if (mhz == k6GhzChannel2Mhz || (mhz >= 5955 && mhz <= 7115)) {
+    return BAND_6_GHZ;
+  }
+  if (mhz >= 5000 && mhz <= k5GhzLastMhz) {
+    return BAND_5_GHZ;
+  }
+  return BAND_UNKNOWN;
+}
+
+BssIdListIndex::BssIdListIndex()
+    : generation_(0),
+      decoded_capacity_(0) {
+}
+
+int BssIdListIndex::Build(std::vector<char>& buffer,
+                          std::vector<AccessPoint>* outData) {
+  buffer_.swap(buffer);
+  entries_.clear();
+  security_.clear();
+  vendor_ies_.clear();
+  if (++generation_ == 0) {
+    // Wrapped; stale flags could now match, so clear them.
+    for (size_t i = 0; i < decoded_capacity_; ++i) {
+      decoded_[i].store(0, std::memory_order_relaxed);
+    }
+    generation_ = 1;
+  }
+  if (buffer_.size() < sizeof(NDIS_802_11_BSSID_LIST)) {
+    return 0;
+  }
+
+  const NDIS_802_11_BSSID_LIST& bss_id_list =
+      *reinterpret_cast<const NDIS_802_11_BSSID_LIST*>(&buffer_[0]);
+  const unsigned char* start = reinterpret_cast<const unsigned char*>(&buffer_[0]);
+  const unsigned char* iterator =
+      reinterpret_cast<const unsigned char*>(&bss_id_list.Bssid[0]);
+  const unsigned char* end_of_buffer = start + buffer_.size();
+  const size_t ie_header = offsetof(NDIS_WLAN_BSSID_EX, IEs);
+
+  entries_.reserve(bss_id_list.NumberOfItems);
+  for (int i = 0; i < static_cast<int>(bss_id_list.NumberOfItems); ++i) {
+    const NDIS_WLAN_BSSID* bss_id =
+        reinterpret_cast<const NDIS_WLAN_BSSID*>(iterator);
+    if (bss_id->Length < sizeof(NDIS_WLAN_BSSID) ||
+        iterator + bss_id->Length > end_of_buffer) {
+      break;
+    }
+
+    IndexEntry entry;
+    entry.offset = static_cast<uint32_t>(iterator - start);
+    entry.ie_offset = 0;
+    entry.ie_length = 0;
+    // Records long enough to be NDIS_WLAN_BSSID_EX carry IEs; bound them by
+    // the record length rather than trusting IELength alone.
+    if (bss_id->Length >= ie_header) {
+      const NDIS_WLAN_BSSID_EX* ex =
+          reinterpret_cast<const NDIS_WLAN_BSSID_EX*>(iterator);
+      uint32_t available = bss_id->Length - static_cast<uint32_t>(ie_header);
+      uint32_t ie_length = ex->IELength < available ? ex->IELength : available;
+      if (ie_length > sizeof(NDIS_802_11_FIXED_IEs)) {
+        entry.ie_offset = entry.offset + static_cast<uint32_t>(ie_header) +
+                          sizeof(NDIS_802_11_FIXED_IEs);
+        entry.ie_length = ie_length - sizeof(NDIS_802_11_FIXED_IEs);
+      }
+    }
+    entries_.push_back(entry);
+
+    if (outData) {
+      AccessPoint access_point_data;
+      if (ConvertToAccessPointData(*bss_id, access_point_data)) {
+        outData->push_back(std::move(access_point_data));
+      }
+    }
+    iterator += bss_id->Length;
+  }
+
+  if (decoded_capacity_ < entries_.size()) {
+    decoded_capacity_ = entries_.capacity();
+    decoded_.reset(new std::atomic<uint32_t>[decoded_capacity_]);
+    for (size_t i = 0; i < decoded_capacity_; ++i) {
+      decoded_[i].store(0, std::memory_order_relaxed);
+    }
+  }
+  return static_cast<int>(entries_.size());
+}
+
+const NDIS_WLAN_BSSID& BssIdListIndex::Entry(size_t i) const {
+  return *reinterpret_cast<const NDIS_WLAN_BSSID*>(&buffer_[entries_[i].offset]);
+}
+
+uint32_t BssIdListIndex::FrequencyKhz(size_t i) const {
+  uint32_t value = Entry(i).Configuration.DSConfig;
+  return value && value <= kMaxMhzValue ? value * 1000 : value;
+}
+
+int BssIdListIndex::Channel(size_t i) const {
+  return FrequencyToChannel(FrequencyKhz(i));
+}
+
+const unsigned char* BssIdListIndex::IeData(size_t i, size_t* length) const {
+  *length = entries_[i].ie_length;
+  if (!entries_[i].ie_length) {
+    return NULL;
+  }
+  return reinterpret_cast<const unsigned char*>(&buffer_[entries_[i].ie_offset]);
+}
+
+const BssSecurityInfo& BssIdListIndex::Security(size_t i) const {
+  EnsureDecoded(i);
+  return security_[i];
+}
+
+const std::vector<VendorIe>& BssIdListIndex::VendorIes(size_t i) const {
+  EnsureDecoded(i);
+  return vendor_ies_[i];
+}
+
+void BssIdListIndex::EnsureDecoded(size_t i) const {
+  if (decoded_[i].load(std::memory_order_acquire) == generation_) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(decode_mutex_);
+  if (decoded_[i].load(std::memory_order_relaxed) == generation_) {
+    return;
+  }
+  if (security_.size() != entries_.size()) {
+    security_.resize(entries_.size());
+    vendor_ies_.resize(entries_.size());
+  }
+  DecodeIes(i);
+  decoded_[i].store(generation_, std::memory_order_release);
+}
+
+void BssIdListIndex::DecodeIes(size_t i) const {
+
+  BssSecurityInfo& security = security_[i];
+  std::vector<VendorIe>& vendor = vendor_ies_[i];
+  memset(&security, 0, sizeof(security));
+  vendor.clear();
+  security.privacy = Entry(i).Privacy != 0;
+
+  size_t length;
+  const unsigned char* p = IeData(i, &length);
+  while (p && length >= 2) {
+    unsigned char id = p[0];
+    size_t ie_length = p[1];
+    if (ie_length + 2 > length) {
+      break;
+    }
+    const unsigned char* body = p + 2;
+    if (id == kIeRsn) {
+      security.has_rsn = true;
+      ParseSecurityBody(body, ie_length, &security.rsn_group_cipher,
+                        &security.rsn_pairwise_ciphers,
+                        &security.rsn_akm_suites, &security.rsn_capabilities);
+    } else if (id == kIeVendor && ie_length >= 3) {
+      VendorIe ie = { ReadOui(body), body + 3, ie_length - 3 };
+      vendor.push_back(ie);
+      if (ie.oui == kWpaOui && ie.length >= 1 && ie.data[0] == kWpaOuiType) {
+        security.has_wpa = true;
+        ParseSecurityBody(ie.data + 1, ie.length - 1, &security.wpa_group_cipher,
+                          &security.wpa_pairwise_ciphers,
+                          &security.wpa_akm_suites, NULL);
+      }
+    }
+    p += ie_length + 2;
+    length -= ie_length + 2;
+  }
+}
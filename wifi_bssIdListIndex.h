@@ -0,0 +1,114 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "wifi_bssIdList.h"
+
+// Security capabilities decoded from the RSN (WPA2/3) and WPA IEs. Cipher
+// and AKM masks have bit N set for suite type N of the respective OUI,
+// e.g. (1 << 4) for CCMP or (1 << 2) for PSK.
+struct BssSecurityInfo {
+  bool privacy;
+  bool has_rsn;
+  bool has_wpa;
+  uint32_t rsn_group_cipher;
+  uint32_t rsn_pairwise_ciphers;
+  uint32_t rsn_akm_suites;
+  uint16_t rsn_capabilities;
+  uint32_t wpa_group_cipher;
+  uint32_t wpa_pairwise_ciphers;
+  uint32_t wpa_akm_suites;
+};
+
+// A vendor specific (id 221) IE. |data| points into the index's buffer and
+// starts after the OUI.
+struct VendorIe {
+  uint32_t oui;
+  const unsigned char* data;
+  size_t length;
+};
+
+// Index over one OID_802_11_BSSID_LIST response.
+//
+// Build() makes the same single pass over the list as GetDataFromBssIdList
+// and additionally records where each entry and its IEs live. Frequency,
+// channel, security and vendor IEs are only decoded when asked for, and the
+// decoded security and vendor data are cached per entry, so a consumer that
+// only wants MAC/RSSI/SSID pays nothing extra.
+//
+// Once built, every accessor may be called from several threads at once;
+// Build() must not run concurrently with anything else.
+class BssIdListIndex {
+public:
+  BssIdListIndex();
+
+  // Takes the response in |buffer|, indexes it and appends an AccessPoint
+  // per valid entry to |outData| if it is non-NULL. Returns the number of
+  // valid entries. |buffer| gets the index's previous buffer back, so no
+  // allocation is needed in steady state; it may be smaller or empty, so
+  // resize it before the next query.
+  int Build(std::vector<char>& buffer, std::vector<AccessPoint>* outData);
+
+  size_t Count() const { return entries_.size(); }
+  const NDIS_WLAN_BSSID& Entry(size_t i) const;
+
+  // Channel centre frequency in kHz from Configuration.DSConfig, or 0.
+  uint32_t FrequencyKhz(size_t i) const;
+  // IEEE channel number derived from the frequency, or 0 if unknown.
+  int Channel(size_t i) const;
+  const BssSecurityInfo& Security(size_t i) const;
+  const std::vector<VendorIe>& VendorIes(size_t i) const;
+
+  // Raw variable IEs (after the fixed fields) of entry |i|. Empty for drivers
+  // that return plain NDIS_WLAN_BSSID records.
+  const unsigned char* IeData(size_t i, size_t* length) const;
+
+private:
+  struct IndexEntry {
+    uint32_t offset;
+    uint32_t ie_offset;
+    uint32_t ie_length;
+  };
+
+  // Decodes entry |i| into the caches unless this build already has.
+  void EnsureDecoded(size_t i) const;
+  // Walks the IEs of entry |i| once, filling both caches.
+  void DecodeIes(size_t i) const;
+
+  BssIdListIndex(const BssIdListIndex&);
+  BssIdListIndex& operator=(const BssIdListIndex&);
+
+  std::vector<char> buffer_;
+  std::vector<IndexEntry> entries_;
+
+  // decoded_[i] == generation_ once entry i is in the caches. Bumping the
+  // generation in Build() invalidates every entry without touching them.
+  uint32_t generation_;
+  std::unique_ptr<std::atomic<uint32_t>[]> decoded_;
+  size_t decoded_capacity_;
+  // Guards decoding. The caches are grown to entries_.size() under it before
+  // the first entry is published, and never resized again until Build().
+  mutable std::mutex decode_mutex_;
+  mutable std::vector<BssSecurityInfo> security_;
+  mutable std::vector<std::vector<VendorIe> > vendor_ies_;
+};
+
+// Maps a DSConfig style centre frequency (kHz) to an IEEE channel number.
+int FrequencyToChannel(uint32_t frequency_khz);
+
+enum WifiBand {
+  BAND_UNKNOWN = 0,
+  BAND_2_4_GHZ,
+  BAND_5_GHZ,
+  BAND_6_GHZ,
+  BAND_COUNT
+};
+
+WifiBand FrequencyToBand(uint32_t frequency_khz);
@@ -0,0 +1,87 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// A BSSID packed into the low 48 bits of an integer, first octet most
+// significant, so packed keys sort in the same order as their hex strings.
+// Hash tables keyed on these can use kInvalidBssid as the empty marker since
+// no real BSSID sets the top 16 bits.
+typedef uint64_t PackedBssid;
+
+const PackedBssid kInvalidBssid = ~static_cast<PackedBssid>(0);
+
+inline PackedBssid PackBssid(const unsigned char mac[6]) {
+  return (static_cast<PackedBssid>(mac[0]) << 40) |
+         (static_cast<PackedBssid>(mac[1]) << 32) |
+         (static_cast<PackedBssid>(mac[2]) << 24) |
+         (static_cast<PackedBssid>(mac[3]) << 16) |
+         (static_cast<PackedBssid>(mac[4]) << 8) |
+         static_cast<PackedBssid>(mac[5]);
+}
+
+inline void UnpackBssid(PackedBssid bssid, unsigned char mac[6]) {
+  for (int i = 0; i < 6; ++i) {
+    mac[i] = static_cast<unsigned char>(bssid >> (40 - 8 * i));
+  }
+}
+
+// Formats a BSSID as 12 lower case hex digits, the form AccessPoint
+// mac_address strings take.
+inline std::string FormatBssid(const unsigned char mac[6]) {
+  static const char kHex[] = "0123456789abcdef";
+  std::string result(12, '0');
+  for (int i = 0; i < 6; ++i) {
+    result[2 * i] = kHex[mac[i] >> 4];
+    result[2 * i + 1] = kHex[mac[i] & 0x0F];
+  }
+  return result;
+}
+
+inline std::string FormatBssid(PackedBssid bssid) {
+  unsigned char mac[6];
+  UnpackBssid(bssid, mac);
+  return FormatBssid(mac);
+}
+
+// Parses the 12 hex digit form produced by FormatBssid. Colon or dash
+// separated forms are accepted too. Returns kInvalidBssid on bad input.
+inline PackedBssid ParseBssid(const char* text, size_t length) {
+  PackedBssid result = 0;
+  int digits = 0;
+  for (size_t i = 0; i < length; ++i) {
+    char c = text[i];
+    unsigned int nibble;
+    if (c >= '0' && c <= '9') {
+      nibble = c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      nibble = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      nibble = c - 'A' + 10;
+    } else if ((c == ':' || c == '-') && digits % 2 == 0 && digits > 0) {
+      continue;
+    } else {
+      return kInvalidBssid;
+    }
+    if (++digits > 12) {
+      return kInvalidBssid;
+    }
+    result = (result << 4) | nibble;
+  }
+  return digits == 12 ? result : kInvalidBssid;
+}
+
+inline PackedBssid ParseBssid(const std::string& text) {
+  return ParseBssid(text.data(), text.size());
+}
+
+// Mixes a packed BSSID into a well distributed 64-bit hash. Vendor OUIs make
+// the raw high bits highly skewed, so never index a table with them directly.
+inline uint64_t HashBssid(PackedBssid bssid) {
+  uint64_t h = bssid * 0x9E3779B97F4A7C15ULL;
+  return h ^ (h >> 29);
+}
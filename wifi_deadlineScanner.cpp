@@ -0,0 +1,221 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_deadlineScanner.h"
+#include <assert.h>
+#include <string.h>
+
+namespace {
+// How long the destructor waits for in-flight queries before abandoning them.
+const int kShutdownGraceMilliseconds = 100;
+}  // namespace
+
+// LatencyHistogram
+
+LatencyHistogram::LatencyHistogram()
+    : count_(0) {
+  memset(buckets_, 0, sizeof(buckets_));
+}
+
+void LatencyHistogram::Record(int64_t micros) {
+  int bucket = 0;
+  while (bucket < kBuckets - 1 && (static_cast<int64_t>(1) << bucket) < micros) {
+    ++bucket;
+  }
+  ++buckets_[bucket];
+  ++count_;
+}
+
+int64_t LatencyHistogram::PercentileMicros(double fraction) const {
+  if (!count_) {
+    return 0;
+  }
+  uint64_t target = static_cast<uint64_t>(fraction * count_);
+  if (target >= count_) {
+    target = count_ - 1;
+  }
+  uint64_t seen = 0;
+  for (int i = 0; i < kBuckets; ++i) {
+    seen += buckets_[i];
+    if (seen > target) {
+      return static_cast<int64_t>(1) << i;
+    }
+  }
+  return static_cast<int64_t>(1) << (kBuckets - 1);
+}
+
+// DeadlineScanner
+
+DeadlineScanner::DeadlineScanner(
+    const std::shared_ptr<InterfaceScanBackend>& backend)
+    : shared_(new SharedState()),
+      budget_(NULL),
+      budget_id_(-1) {
+  shared_->backend = backend;
+  size_t count = backend->InterfaceCount();
+  for (size_t i = 0; i < count; ++i) {
+    shared_->interfaces.push_back(
+        std::unique_ptr<InterfaceState>(new InterfaceState()));
+  }
+  shared_->running_workers = static_cast<int>(count);
+  for (size_t i = 0; i < count; ++i) {
+    workers_.push_back(std::thread(&DeadlineScanner::WorkerLoop, shared_, i));
+  }
+}
+
+DeadlineScanner::~DeadlineScanner() {
+  AttachMemoryBudget(NULL);
+  {
+    std::unique_lock<std::mutex> lock(shared_->mutex);
+    shared_->stopping = true;
+    for (size_t i = 0; i < shared_->interfaces.size(); ++i) {
+      shared_->interfaces[i]->work_cv.notify_all();
+    }
+    shared_->done_cv.wait_for(
+        lock, std::chrono::milliseconds(kShutdownGraceMilliseconds),
+        [this] { return shared_->running_workers == 0; });
+  }
+  // A worker stuck in the driver cannot be interrupted. It holds its own
+  // reference to the shared state, so detaching it is safe.
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    workers_[i].detach();
+  }
+}
+
+void DeadlineScanner::AttachMemoryBudget(MemoryBudget* budget) {
+  if (budget_) {
+    budget_->Unregister(budget_id_);
+  }
+  budget_ = budget;
+  budget_id_ = -1;
+  if (budget_) {
+    budget_id_ = budget_->Register("interface results",
+                                   MemoryBudget::PRIORITY_RESULTS, this);
+  }
+}
+
+size_t DeadlineScanner::ReleaseMemory(size_t bytes) {
+  (void)bytes;
+  return 0;
+}
+
+void DeadlineScanner::WorkerLoop(std::shared_ptr<SharedState> shared,
+                                 size_t index) {
+  InterfaceState& state = *shared->interfaces[index];
+  std::vector<AccessPoint> access_points;
+  std::unique_lock<std::mutex> lock(shared->mutex);
+  while (true) {
+    while (!shared->stopping && state.requested == state.started) {
+      state.work_cv.wait(lock);
+    }
+    if (shared->stopping) {
+      break;
+    }
+    uint64_t generation = state.requested;
+    state.started = generation;
+    lock.unlock();
+
+    bool ok = shared->backend->ScanInterface(index, access_points);
+
+    lock.lock();
+    state.completed = generation;
+    state.last_ok = ok;
+    if (ok) {
+      state.last_good.swap(access_points);
+      state.last_good_time = Clock::now();
+      state.has_result = true;
+    }
+    shared->done_cv.notify_all();
+  }
+  --shared->running_workers;
+  shared->done_cv.notify_all();
+}
+
+bool DeadlineScanner::Scan(int deadline_ms, DeadlineScanResult* result) {
+  const Clock::time_point start = Clock::now();
+  const Clock::time_point deadline = start + std::chrono::milliseconds(deadline_ms);
+  SharedState& shared = *shared_;
+  const size_t count = shared.interfaces.size();
+  std::vector<uint64_t> targets(count);
+
+  result->access_points.clear();
+  result->fresh = true;
+  result->age_ms = 0;
+  result->timed_out_interfaces.clear();
+  result->failed_interfaces.clear();
+
+  std::unique_lock<std::mutex> lock(shared.mutex);
+  for (size_t i = 0; i < count; ++i) {
+    InterfaceState& state = *shared.interfaces[i];
+    if (state.completed == state.requested) {
+      ++state.requested;
+      state.work_cv.notify_one();
+    }
+    // Otherwise a query from an earlier scan is still out; wait for that one
+    // rather than piling another on a possibly hung driver.
+    targets[i] = state.requested;
+  }
+
+  shared.done_cv.wait_until(lock, deadline, [&] {
+    for (size_t i = 0; i < count; ++i) {
+      if (shared.interfaces[i]->completed < targets[i]) {
+        return false;
+      }
+    }
+    return true;
+  });
+
+  const Clock::time_point now = Clock::now();
+  int failures = 0;
+  bool any_data = false;
+  size_t cached_bytes = 0;
+  for (size_t i = 0; i < count; ++i) {
+    InterfaceState& state = *shared.interfaces[i];
+    cached_bytes += AccessPointsMemoryUsage(state.last_good);
+    bool answered = state.completed >= targets[i];
+    if (answered && state.last_ok) {
+      result->access_points.insert(result->access_points.end(),
+                                   state.last_good.begin(),
+                                   state.last_good.end());
+      any_data = true;
+      continue;
+    }
+
+    result->fresh = false;
+    if (answered) {
+      ++failures;
+      result->failed_interfaces.push_back(shared.backend->InterfaceName(i));
+    } else {
+      result->timed_out_interfaces.push_back(shared.backend->InterfaceName(i));
+    }
+    if (state.has_result) {
+      result->access_points.insert(result->access_points.end(),
+                                   state.last_good.begin(),
+                                   state.last_good.end());
+      int64_t age = std::chrono::duration_cast<std::chrono::milliseconds>(
+          now - state.last_good_time).count();
+      if (age > result->age_ms) {
+        result->age_ms = age;
+      }
+      any_data = true;
+    }
+  }
+  lock.unlock();
+  if (budget_) {
+    budget_->Report(budget_id_, cached_bytes);
+  }
+
+  int64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(
+      Clock::now() - start).count();
+  {
+    std::lock_guard<std::mutex> latencies_lock(latencies_mutex_);
+    latencies_.Record(micros);
+  }
+  return any_data || failures == 0;
+}
+
+LatencyHistogram DeadlineScanner::Latencies() const {
+  std::lock_guard<std::mutex> lock(latencies_mutex_);
+  return latencies_;
+}
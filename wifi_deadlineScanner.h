@@ -0,0 +1,129 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "wifi_accessPoint.h"
+#include "wifi_memoryBudget.h"
+
+// Per-interface scanning backend. ScanInterface may block for an unbounded
+// time (a hung driver); it is called from one dedicated thread per interface,
+// so calls for different interfaces may run concurrently.
+class InterfaceScanBackend {
+public:
+  virtual ~InterfaceScanBackend() {}
+  // Must not change over the backend's lifetime: DeadlineScanner sizes its
+  // per-interface slots and threads from it once.
+  virtual size_t InterfaceCount() const = 0;
+  virtual std::string InterfaceName(size_t index) const = 0;
+  // Replaces |outData| with the APs seen by interface |index|. Returns false
+  // if the query failed.
+  virtual bool ScanInterface(size_t index, std::vector<AccessPoint>& outData) = 0;
+};
+
+struct DeadlineScanResult {
+  std::vector<AccessPoint> access_points;
+  // True if every interface answered within the deadline.
+  bool fresh;
+  // Age of the oldest cached data that had to stand in for a late or failed
+  // interface; 0 when fresh.
+  int64_t age_ms;
+  std::vector<std::string> timed_out_interfaces;
+  std::vector<std::string> failed_interfaces;
+};
+
+// Log2-bucketed latency histogram; cheap enough to record every scan.
+class LatencyHistogram {
+public:
+  LatencyHistogram();
+  void Record(int64_t micros);
+  // Upper bound of the bucket holding the |fraction| quantile, e.g. 0.99.
+  int64_t PercentileMicros(double fraction) const;
+  uint64_t Count() const { return count_; }
+
+private:
+  static const int kBuckets = 40;
+  uint64_t buckets_[kBuckets];
+  uint64_t count_;
+};
+
+// Runs each interface's query on its own worker thread and waits for them
+// only until a deadline. Interfaces that miss it contribute their last good
+// result instead, and the result says how old that is and which interfaces
+// were late. A late query keeps running in the background and refreshes the
+// cache when it finishes; an interface whose query is still outstanding is
+// not queried again until it returns.
+class DeadlineScanner : private MemoryBudgetClient {
+public:
+  explicit DeadlineScanner(const std::shared_ptr<InterfaceScanBackend>& backend);
+  // Waits briefly for in-flight queries, then abandons any that are hung.
+  // Abandoned workers keep the backend alive until they return.
+  ~DeadlineScanner();
+
+  // Accounts the cached per-interface results against |budget| as
+  // PRIORITY_RESULTS, reported after each scan. They stand in for late
+  // interfaces, so they are never released; the budget reclaims from lower
+  // priorities to make room instead. NULL detaches.
+  void AttachMemoryBudget(MemoryBudget* budget);
+
+  // Returns within |deadline_ms| (plus scheduling noise). Returns false only
+  // if no interface produced data, fresh or cached, and at least one failed.
+  bool Scan(int deadline_ms, DeadlineScanResult* result);
+
+  // A copy of the scan latencies so far; safe while other threads scan.
+  LatencyHistogram Latencies() const;
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct InterfaceState {
+    InterfaceState()
+        : requested(0), started(0), completed(0),
+          last_ok(false), has_result(false) {}
+    std::condition_variable work_cv;
+    uint64_t requested;
+    uint64_t started;
+    uint64_t completed;
+    bool last_ok;
+    bool has_result;
+    std::vector<AccessPoint> last_good;
+    Clock::time_point last_good_time;
+  };
+
+  // Everything a worker touches, kept alive by whichever of the scanner and
+  // its workers goes last.
+  struct SharedState {
+    SharedState() : stopping(false), running_workers(0) {}
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    std::vector<std::unique_ptr<InterfaceState> > interfaces;
+    std::shared_ptr<InterfaceScanBackend> backend;
+    bool stopping;
+    int running_workers;
+  };
+
+  static void WorkerLoop(std::shared_ptr<SharedState> shared, size_t index);
+
+  // MemoryBudgetClient:
+  size_t ReleaseMemory(size_t bytes);
+
+  DeadlineScanner(const DeadlineScanner&);
+  DeadlineScanner& operator=(const DeadlineScanner&);
+
+  std::shared_ptr<SharedState> shared_;
+  std::vector<std::thread> workers_;
+  mutable std::mutex latencies_mutex_;
+  LatencyHistogram latencies_;
+
+  MemoryBudget* budget_;
+  int budget_id_;
+};
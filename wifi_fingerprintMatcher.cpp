@@ -0,0 +1,355 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_fingerprintMatcher.h"
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define WIFI_FINGERPRINT_SSE2 1
+#endif
+
+namespace {
+// Queries handed to a batch worker at a time.
+const size_t kBatchChunk = 16;
+
+float SumProducts(const float* a, const float* b, size_t n) {
+  size_t i = 0;
+  float sum = 0;
+#ifdef WIFI_FINGERPRINT_SSE2
+  __m128 acc = _mm_setzero_ps();
+  for (; i + 4 <= n; i += 4) {
+    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, acc);
+  sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+  for (; i < n; ++i) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+bool NeighborLess(const FingerprintNeighbor& a, const FingerprintNeighbor& b) {
+  return a.distance != b.distance ? a.distance < b.distance : a.id < b.id;
+}
+}  // namespace
+
+void SparseFingerprint::Clear() {
+  bssids.clear();
+  rssi.clear();
+}
+
+void SparseFingerprint::Add(PackedBssid bssid, float ap_rssi) {
+  bssids.push_back(bssid);
+  rssi.push_back(ap_rssi);
+}
+
+void SparseFingerprint::Sort() {
+  std::vector<uint32_t> order(bssids.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = static_cast<uint32_t>(i);
+  }
+  std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+    return bssids[a] != bssids[b] ? bssids[a] < bssids[b] : rssi[a] > rssi[b];
+  });
+  std::vector<PackedBssid> sorted_bssids;
+  std::vector<float> sorted_rssi;
+  sorted_bssids.reserve(order.size());
+  sorted_rssi.reserve(order.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    if (!sorted_bssids.empty() && sorted_bssids.back() == bssids[order[i]]) {
+      continue;
+    }
+    sorted_bssids.push_back(bssids[order[i]]);
+    sorted_rssi.push_back(rssi[order[i]]);
+  }
+  bssids.swap(sorted_bssids);
+  rssi.swap(sorted_rssi);
+}
+
+void BuildSparseFingerprint(const std::vector<AccessPoint>& scan,
+                            SparseFingerprint* out) {
+  out->Clear();
+  for (size_t i = 0; i < scan.size(); ++i) {
+    PackedBssid bssid = ParseBssid(scan[i].mac_address);
+    if (bssid != kInvalidBssid) {
+      out->Add(bssid, static_cast<float>(scan[i].radio_signal_strength));
+    }
+  }
+  out->Sort();
+}
+
+FingerprintMatcherOptions::FingerprintMatcherOptions()
+    : missing_rssi_dbm(-100),
+      min_common_aps(3),
+      max_candidates(0) {
+}
+
+struct FingerprintMatcher::Scratch {
+  Scratch() : generation(0) {}
+
+  // common[i] counts the scan's APs in fingerprint i, valid only while
+  // marks[i] == generation.
+  std::vector<uint32_t> marks;
+  std::vector<uint32_t> common;
+  uint32_t generation;
+  // Ordered by common count, most first.
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> sorted;
+  std::vector<uint32_t> bucket_starts;
+  std::vector<float> scan_levels;
+  // unshared_bound[c] is the least the scan-only APs can add to the squared
+  // distance of a fingerprint sharing c APs with the scan.
+  std::vector<float> unshared_bound;
+  // Levels of the APs a candidate shares with the scan, side by side.
+  std::vector<float> shared_scan;
+  std::vector<float> shared_fingerprint;
+  std::vector<FingerprintNeighbor> heap;
+};
+
+FingerprintMatcher::FingerprintMatcher(const FingerprintMatcherOptions& options)
+    : options_(options),
+      offsets_(1, 0),
+      scratch_(new Scratch()) {
+}
+
+FingerprintMatcher::~FingerprintMatcher() {
+}
+
+uint32_t FingerprintMatcher::Add(const ReferencePoint& point,
+                                 const SparseFingerprint& fingerprint) {
+  uint32_t id = static_cast<uint32_t>(points_.size());
+  points_.push_back(point);
+  float norm = 0;
+  for (size_t i = 0; i < fingerprint.Size(); ++i) {
+    float level = fingerprint.rssi[i] - options_.missing_rssi_dbm;
+    bssids_.push_back(fingerprint.bssids[i]);
+    levels_.push_back(level);
+    norm += level * level;
+  }
+  norms_.push_back(norm);
+  offsets_.push_back(static_cast<uint32_t>(bssids_.size()));
+  return id;
+}
+
+void FingerprintMatcher::BuildIndex() {
+  index_bssids_ = bssids_;
+  std::sort(index_bssids_.begin(), index_bssids_.end());
+  index_bssids_.erase(std::unique(index_bssids_.begin(), index_bssids_.end()),
+                      index_bssids_.end());
+  std::vector<PackedBssid>(index_bssids_).swap(index_bssids_);
+
+  // Two passes over the entries: count each BSSID's postings, then place
+  // them. Fingerprint ids come out ascending within each posting list.
+  std::vector<uint32_t> positions(bssids_.size());
+  index_offsets_.assign(index_bssids_.size() + 1, 0);
+  for (size_t e = 0; e < bssids_.size(); ++e) {
+    positions[e] = static_cast<uint32_t>(
+        std::lower_bound(index_bssids_.begin(), index_bssids_.end(), bssids_[e]) -
+        index_bssids_.begin());
+    ++index_offsets_[positions[e] + 1];
+  }
+  for (size_t j = 0; j < index_bssids_.size(); ++j) {
+    index_offsets_[j + 1] += index_offsets_[j];
+  }
+  index_entries_.resize(bssids_.size());
+  std::vector<uint32_t> next(index_offsets_.begin(), index_offsets_.end() - 1);
+  for (uint32_t id = 0; id < points_.size(); ++id) {
+    for (uint32_t e = offsets_[id]; e < offsets_[id + 1]; ++e) {
+      index_entries_[next[positions[e]]++] = id;
+    }
+  }
+}
+
+void FingerprintMatcher::Query(const SparseFingerprint& scan, size_t k,
+                               std::vector<FingerprintNeighbor>* neighbors) {
+  QueryWith(scan, k, scratch_.get(), neighbors);
+}
+
+void FingerprintMatcher::QueryBatch(
+    const std::vector<SparseFingerprint>& scans, size_t k,
+    std::vector<std::vector<FingerprintNeighbor> >* neighbors,
+    int threads) const {
+  neighbors->resize(scans.size());
+  if (threads <= 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  size_t chunks = (scans.size() + kBatchChunk - 1) / kBatchChunk;
+  threads = static_cast<int>(std::min<size_t>(threads, chunks));
+
+  std::atomic<size_t> next_chunk(0);
+  auto worker = [&] {
+    Scratch scratch;
+    size_t chunk;
+    while ((chunk = next_chunk.fetch_add(1)) < chunks) {
+      size_t end = std::min(scans.size(), (chunk + 1) * kBatchChunk);
+      for (size_t i = chunk * kBatchChunk; i < end; ++i) {
+        QueryWith(scans[i], k, &scratch, &(*neighbors)[i]);
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (int t = 1; t < threads; ++t) {
+    pool.push_back(std::thread(worker));
+  }
+  worker();
+  for (size_t t = 0; t < pool.size(); ++t) {
+    pool[t].join();
+  }
+}
+
+void FingerprintMatcher::QueryWith(const SparseFingerprint& scan, size_t k,
+                                   Scratch* scratch,
+                                   std::vector<FingerprintNeighbor>* neighbors) const {
+  neighbors->clear();
+  if (!k || !scan.Size()) {
+    return;
+  }
+  CollectCandidates(scan, scratch);
+
+  float scan_norm = 0;
+  scratch->scan_levels.resize(scan.Size());
+  scratch->shared_scan.resize(scan.Size());
+  scratch->shared_fingerprint.resize(scan.Size());
+  for (size_t i = 0; i < scan.Size(); ++i) {
+    float level = scan.rssi[i] - options_.missing_rssi_dbm;
+    scratch->scan_levels[i] = level;
+    scan_norm += level * level;
+  }
+
+  // The scan-only APs of a fingerprint sharing c APs contribute at least
+  // the n - c smallest squared scan levels.
+  std::vector<float>& bound = scratch->unshared_bound;
+  bound.resize(scan.Size() + 1);
+  for (size_t i = 0; i < scan.Size(); ++i) {
+    bound[i] = scratch->scan_levels[i] * scratch->scan_levels[i];
+  }
+  std::sort(bound.begin(), bound.begin() + scan.Size(), std::greater<float>());
+  bound[scan.Size()] = 0;
+  for (size_t c = scan.Size(); c-- > 0;) {
+    bound[c] += bound[c + 1];
+  }
+
+  // Max-heap on distance holding the best k seen so far. Candidates come
+  // most shared APs first, so once the bound for the current share count
+  // exceeds the kth distance, no remaining candidate can get in.
+  std::vector<FingerprintNeighbor>& heap = scratch->heap;
+  heap.clear();
+  for (size_t c = 0; c < scratch->candidates.size(); ++c) {
+    uint32_t id = scratch->candidates[c];
+    if (heap.size() == k &&
+        bound[scratch->common[id]] > heap.front().distance * heap.front().distance) {
+      break;
+    }
+    float squared = scan_norm + norms_[id] - 2 * DotProduct(scan, id, scratch);
+    FingerprintNeighbor neighbor = { id, sqrtf(std::max(0.0f, squared)),
+                                     scratch->common[id] };
+    if (heap.size() < k) {
+      heap.push_back(neighbor);
+      std::push_heap(heap.begin(), heap.end(), NeighborLess);
+    } else if (NeighborLess(neighbor, heap.front())) {
+      std::pop_heap(heap.begin(), heap.end(), NeighborLess);
+      heap.back() = neighbor;
+      std::push_heap(heap.begin(), heap.end(), NeighborLess);
+    }
+  }
+  std::sort_heap(heap.begin(), heap.end(), NeighborLess);
+  neighbors->assign(heap.begin(), heap.end());
+}
+
+void FingerprintMatcher::CollectCandidates(const SparseFingerprint& scan,
+                                           Scratch* scratch) const {
+  if (scratch->marks.size() != points_.size()) {
+    scratch->marks.assign(points_.size(), 0);
+    scratch->common.resize(points_.size());
+    scratch->generation = 0;
+  }
+  if (++scratch->generation == 0) {
+    std::fill(scratch->marks.begin(), scratch->marks.end(), 0);
+    scratch->generation = 1;
+  }
+  const uint32_t generation = scratch->generation;
+  std::vector<uint32_t>& candidates = scratch->candidates;
+  candidates.clear();
+
+  for (size_t i = 0; i < scan.Size(); ++i) {
+    std::vector<PackedBssid>::const_iterator found = std::lower_bound(
+        index_bssids_.begin(), index_bssids_.end(), scan.bssids[i]);
+    if (found == index_bssids_.end() || *found != scan.bssids[i]) {
+      continue;
+    }
+    size_t j = found - index_bssids_.begin();
+    for (uint32_t p = index_offsets_[j]; p < index_offsets_[j + 1]; ++p) {
+      uint32_t id = index_entries_[p];
+      if (scratch->marks[id] != generation) {
+        scratch->marks[id] = generation;
+        scratch->common[id] = 0;
+        candidates.push_back(id);
+      }
+      ++scratch->common[id];
+    }
+  }
+
+  // Counting sort by common count, most first, dropping those under the
+  // minimum. Ties stay in posting order.
+  const uint32_t required = std::min<uint32_t>(options_.min_common_aps,
+                                               static_cast<uint32_t>(scan.Size()));
+  const std::vector<uint32_t>& common = scratch->common;
+  std::vector<uint32_t>& starts = scratch->bucket_starts;
+  starts.assign(scan.Size() + 2, 0);
+  for (size_t c = 0; c < candidates.size(); ++c) {
+    ++starts[scan.Size() - common[candidates[c]] + 1];
+  }
+  size_t kept = 0;
+  for (size_t b = 0; b <= scan.Size(); ++b) {
+    if (scan.Size() - b >= required) {
+      kept += starts[b + 1];
+    }
+    starts[b + 1] += starts[b];
+  }
+  std::vector<uint32_t>& sorted = scratch->sorted;
+  sorted.resize(candidates.size());
+  for (size_t c = 0; c < candidates.size(); ++c) {
+    sorted[starts[scan.Size() - common[candidates[c]]]++] = candidates[c];
+  }
+  sorted.resize(kept);
+  if (options_.max_candidates && sorted.size() > options_.max_candidates) {
+    sorted.resize(options_.max_candidates);
+  }
+  candidates.swap(sorted);
+}
+
+float FingerprintMatcher::DotProduct(const SparseFingerprint& scan, uint32_t id,
+                                     Scratch* scratch) const {
+  // Gather the shared APs' levels by merging the two sorted BSSID lists,
+  // then sum their products in one vectorized pass.
+  float* shared_scan = &scratch->shared_scan[0];
+  float* shared_fingerprint = &scratch->shared_fingerprint[0];
+  const PackedBssid* scan_bssids = &scan.bssids[0];
+  const float* scan_levels = &scratch->scan_levels[0];
+  size_t shared = 0;
+  size_t i = 0;
+  uint32_t e = offsets_[id];
+  const uint32_t end = offsets_[id + 1];
+  while (i < scan.Size() && e < end) {
+    PackedBssid a = scan_bssids[i];
+    PackedBssid b = bssids_[e];
+    if (a == b) {
+      shared_scan[shared] = scan_levels[i++];
+      shared_fingerprint[shared++] = levels_[e++];
+    } else if (a < b) {
+      ++i;
+    } else {
+      ++e;
+    }
+  }
+  return SumProducts(shared_scan, shared_fingerprint, shared);
+}
@@ -0,0 +1,122 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include "wifi_accessPoint.h"
+#include "wifi_bssid.h"
+
+// RSSI vector over BSSIDs, sorted by packed BSSID with one entry each.
+struct SparseFingerprint {
+  std::vector<PackedBssid> bssids;
+  std::vector<float> rssi;
+
+  void Clear();
+  // Appends in any order; call Sort() before use.
+  void Add(PackedBssid bssid, float ap_rssi);
+  // Sorts by BSSID, keeping the strongest reading of a repeated BSSID.
+  void Sort();
+  size_t Size() const { return bssids.size(); }
+};
+
+// Fills |out| from a scan as returned by GetAccessPointData, skipping
+// unparseable MACs.
+void BuildSparseFingerprint(const std::vector<AccessPoint>& scan,
+                            SparseFingerprint* out);
+
+// Where a survey fingerprint was recorded, in the same local frame as
+// ApLocation.
+struct ReferencePoint {
+  float x;
+  float y;
+  int floor;
+};
+
+struct FingerprintNeighbor {
+  uint32_t id;
+  float distance;
+  uint32_t common_aps;
+};
+
+struct FingerprintMatcherOptions {
+  FingerprintMatcherOptions();
+  // RSSI assumed for an AP that only one of the two fingerprints has.
+  float missing_rssi_dbm;
+  // Only fingerprints sharing at least this many APs with the scan (or all
+  // of them, for smaller scans) are scored.
+  uint32_t min_common_aps;
+  // If non-zero, at most this many candidates are scored: those sharing the
+  // most APs with the scan.
+  uint32_t max_candidates;
+};
+
+// k-nearest-neighbour matching of live scans against a survey database.
+//
+// Distance is Euclidean in dBm over the union of both fingerprints' APs,
+// with missing_rssi_dbm standing in for an AP that one side lacks. Relative
+// to that floor the squared distance is |q|^2 + |f|^2 - 2 q.f, and the
+// norms are known up front, so scoring a candidate only needs the dot
+// product over the APs it shares with the scan. Those are found by merging
+// the two sorted vectors and summed with SSE2 where available.
+//
+// Candidates come from an inverted index from BSSID to fingerprints, so a
+// query only looks at fingerprints that share APs with the scan.
+class FingerprintMatcher {
+public:
+  explicit FingerprintMatcher(const FingerprintMatcherOptions& options);
+  ~FingerprintMatcher();
+
+  // Adds a survey fingerprint, which must be sorted, and returns its id.
+  // Queries see it once BuildIndex() has run again.
+  uint32_t Add(const ReferencePoint& point, const SparseFingerprint& fingerprint);
+  void BuildIndex();
+
+  size_t Size() const { return points_.size(); }
+  const ReferencePoint& Point(uint32_t id) const { return points_[id]; }
+
+  // Fills |neighbors| with the |k| closest fingerprints, closest first.
+  // Uses scratch space kept in the matcher, so calls must not overlap; use
+  // QueryBatch() to run queries in parallel.
+  void Query(const SparseFingerprint& scan, size_t k,
+             std::vector<FingerprintNeighbor>* neighbors);
+  // Runs every query, splitting the work over |threads| threads (0 means
+  // one per core). |neighbors| is resized to match |scans|.
+  void QueryBatch(const std::vector<SparseFingerprint>& scans, size_t k,
+                  std::vector<std::vector<FingerprintNeighbor> >* neighbors,
+                  int threads) const;
+
+private:
+  // Per-thread candidate counters and working arrays.
+  struct Scratch;
+
+  void QueryWith(const SparseFingerprint& scan, size_t k, Scratch* scratch,
+                 std::vector<FingerprintNeighbor>* neighbors) const;
+  void CollectCandidates(const SparseFingerprint& scan, Scratch* scratch) const;
+  float DotProduct(const SparseFingerprint& scan, uint32_t id,
+                   Scratch* scratch) const;
+
+  FingerprintMatcher(const FingerprintMatcher&);
+  FingerprintMatcher& operator=(const FingerprintMatcher&);
+
+  const FingerprintMatcherOptions options_;
+
+  // Fingerprint i is entries [offsets_[i], offsets_[i + 1]) of bssids_ and
+  // levels_; levels are RSSI above missing_rssi_dbm.
+  std::vector<ReferencePoint> points_;
+  std::vector<uint32_t> offsets_;
+  std::vector<PackedBssid> bssids_;
+  std::vector<float> levels_;
+  std::vector<float> norms_;
+
+  // Inverted index: index_bssids_ is sorted, and BSSID j is contained in the
+  // fingerprints index_entries_[index_offsets_[j], index_offsets_[j + 1]).
+  std::vector<PackedBssid> index_bssids_;
+  std::vector<uint32_t> index_offsets_;
+  std::vector<uint32_t> index_entries_;
+
+  std::unique_ptr<Scratch> scratch_;
+};
@@ -0,0 +1,385 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_ingestEngine.h"
+#include <assert.h>
+#include <algorithm>
+#include <chrono>
+
+namespace {
+const size_t kInitialTableSize = 1024;
+const size_t kDefaultRouteBatchSize = 512;
+
+bool BssidLess(const BssidStats& a, const BssidStats& b) {
+  return a.bssid < b.bssid;
+}
+
+int DefaultThreadCount() {
+  int cores = static_cast<int>(std::thread::hardware_concurrency());
+  return cores > 2 ? cores / 2 : 1;
+}
+}  // namespace
+
+// BssidStatsTable
+
+BssidStatsTable::BssidStatsTable()
+    : mask_(kInitialTableSize - 1),
+      size_(0) {
+  BssidStats empty = { kInvalidBssid, 0, 0, 0, 0 };
+  slots_.assign(kInitialTableSize, empty);
+}
+
+BssidStats& BssidStatsTable::Upsert(PackedBssid bssid) {
+  // Keep the load factor at or under one half so probe runs stay short.
+  if ((size_ + 1) * 2 > slots_.size()) {
+    Grow();
+  }
+  size_t i = HashBssid(bssid) & mask_;
+  while (true) {
+    BssidStats& slot = slots_[i];
+    if (slot.bssid == bssid) {
+      return slot;
+    }
+    if (slot.bssid == kInvalidBssid) {
+      slot.bssid = bssid;
+      ++size_;
+      return slot;
+    }
+    i = (i + 1) & mask_;
+  }
+}
+
+const BssidStats* BssidStatsTable::Find(PackedBssid bssid) const {
+  size_t i = HashBssid(bssid) & mask_;
+  while (true) {
+    const BssidStats& slot = slots_[i];
+    if (slot.bssid == bssid) {
+      return &slot;
+    }
+    if (slot.bssid == kInvalidBssid) {
+      return NULL;
+    }
+    i = (i + 1) & mask_;
+  }
+}
+
+void BssidStatsTable::CopyTo(std::vector<BssidStats>& out) const {
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    if (slots_[i].bssid != kInvalidBssid) {
+      out.push_back(slots_[i]);
+    }
+  }
+}
+
+void BssidStatsTable::Grow() {
+  std::vector<BssidStats> old;
+  old.swap(slots_);
+  BssidStats empty = { kInvalidBssid, 0, 0, 0, 0 };
+  slots_.assign(old.size() * 2, empty);
+  mask_ = slots_.size() - 1;
+  for (size_t i = 0; i < old.size(); ++i) {
+    if (old[i].bssid == kInvalidBssid) {
+      continue;
+    }
+    size_t j = HashBssid(old[i].bssid) & mask_;
+    while (slots_[j].bssid != kInvalidBssid) {
+      j = (j + 1) & mask_;
+    }
+    slots_[j] = old[i];
+  }
+}
+
+// IngestSnapshot
+
+const BssidStats* IngestSnapshot::Find(PackedBssid bssid) const {
+  BssidStats key = { bssid, 0, 0, 0, 0 };
+  std::vector<BssidStats>::const_iterator it =
+      std::lower_bound(entries.begin(), entries.end(), key, BssidLess);
+  if (it == entries.end() || it->bssid != bssid) {
+    return NULL;
+  }
+  return &*it;
+}
+
+// ScanIngestEngine
+
+ScanIngestEngine::Options::Options()
+    : parser_threads(DefaultThreadCount()),
+      shard_count(DefaultThreadCount()),
+      route_batch_size(kDefaultRouteBatchSize),
+      snapshot_interval_ms(0) {
+}
+
+ScanIngestEngine::ScanIngestEngine(const Options& options)
+    : options_(options),
+      next_parser_(0),
+      queued_batches_(0),
+      outstanding_(0),
+      latest_snapshot_(new IngestSnapshot()),
+      stopping_(false),
+      reports_submitted_(0),
+      reports_ingested_(0),
+      malformed_(0) {
+  assert(options_.parser_threads > 0 && options_.shard_count > 0);
+  IngestSnapshot* empty = const_cast<IngestSnapshot*>(latest_snapshot_.get());
+  empty->reports = 0;
+  empty->observations = 0;
+
+  for (int i = 0; i < options_.shard_count; ++i) {
+    shards_.push_back(std::unique_ptr<Shard>(new Shard()));
+  }
+  for (int i = 0; i < options_.parser_threads; ++i) {
+    parser_queues_.push_back(std::unique_ptr<ParserQueue>(new ParserQueue()));
+  }
+  for (int i = 0; i < options_.shard_count; ++i) {
+    threads_.push_back(std::thread(&ScanIngestEngine::ShardLoop, this, i));
+  }
+  for (int i = 0; i < options_.parser_threads; ++i) {
+    threads_.push_back(std::thread(&ScanIngestEngine::ParserLoop, this, i));
+  }
+  if (options_.snapshot_interval_ms > 0) {
+    threads_.push_back(std::thread(&ScanIngestEngine::SnapshotLoop, this));
+  }
+}
+
+ScanIngestEngine::~ScanIngestEngine() {
+  Flush();
+  stopping_ = true;
+  {
+    std::lock_guard<std::mutex> lock(work_mutex_);
+    work_cv_.notify_all();
+  }
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    std::lock_guard<std::mutex> lock(shards_[i]->mutex);
+    shards_[i]->cv.notify_all();
+  }
+  {
+    std::lock_guard<std::mutex> lock(snapshot_mutex_);
+    snapshot_cv_.notify_all();
+  }
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    threads_[i].join();
+  }
+}
+
+void ScanIngestEngine::Submit(std::vector<ScanReport>& reports) {
+  if (reports.empty()) {
+    return;
+  }
+  std::vector<ScanReport>* batch = new std::vector<ScanReport>();
+  batch->swap(reports);
+
+  std::lock_guard<std::mutex> intake(intake_mutex_);
+  outstanding_.fetch_add(1);
+  reports_submitted_.fetch_add(batch->size());
+  // Count the batch before it becomes visible, so a parser that takes it
+  // straight away can never bring the count below zero.
+  queued_batches_.fetch_add(1);
+  ParserQueue& queue =
+      *parser_queues_[next_parser_.fetch_add(1) % parser_queues_.size()];
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.batches.push_back(batch);
+  }
+  std::lock_guard<std::mutex> lock(work_mutex_);
+  work_cv_.notify_one();
+}
+
+void ScanIngestEngine::Flush() {
+  std::unique_lock<std::mutex> lock(idle_mutex_);
+  while (outstanding_.load() != 0) {
+    idle_cv_.wait(lock);
+  }
+}
+
+std::shared_ptr<const IngestSnapshot> ScanIngestEngine::TakeSnapshot() {
+  std::lock_guard<std::mutex> intake(intake_mutex_);
+  Flush();
+
+  // Every shard is idle and no new work can arrive until intake_mutex_ is
+  // released, so the tables can be read directly.
+  std::shared_ptr<IngestSnapshot> snapshot(new IngestSnapshot());
+  snapshot->reports = reports_submitted_.load();
+  snapshot->observations = 0;
+  size_t total = 0;
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    total += shards_[i]->table.Size();
+  }
+  snapshot->entries.reserve(total);
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    shards_[i]->table.CopyTo(snapshot->entries);
+    snapshot->observations += shards_[i]->observations;
+  }
+  std::sort(snapshot->entries.begin(), snapshot->entries.end(), BssidLess);
+
+  std::lock_guard<std::mutex> lock(snapshot_mutex_);
+  latest_snapshot_ = snapshot;
+  return latest_snapshot_;
+}
+
+std::shared_ptr<const IngestSnapshot> ScanIngestEngine::LatestSnapshot() const {
+  std::lock_guard<std::mutex> lock(snapshot_mutex_);
+  return latest_snapshot_;
+}
+
+void ScanIngestEngine::SnapshotLoop() {
+  std::unique_lock<std::mutex> lock(snapshot_mutex_);
+  while (!stopping_) {
+    snapshot_cv_.wait_for(lock,
+                          std::chrono::milliseconds(options_.snapshot_interval_ms));
+    if (stopping_) {
+      break;
+    }
+    lock.unlock();
+    TakeSnapshot();
+    lock.lock();
+  }
+}
+
+bool ScanIngestEngine::TakeBatch(int index, std::vector<ScanReport>** batch) {
+  // Own deque first, newest batch first while it is still warm in cache.
+  {
+    ParserQueue& own = *parser_queues_[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.batches.empty()) {
+      *batch = own.batches.back();
+      own.batches.pop_back();
+      return true;
+    }
+  }
+  // Then steal the oldest batch from a sibling.
+  const int count = static_cast<int>(parser_queues_.size());
+  for (int i = 1; i < count; ++i) {
+    ParserQueue& victim = *parser_queues_[(index + i) % count];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.batches.empty()) {
+      *batch = victim.batches.front();
+      victim.batches.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ScanIngestEngine::ParserLoop(int index) {
+  std::vector<ObservationChunk*> routes(shards_.size(), static_cast<ObservationChunk*>(NULL));
+  while (true) {
+    std::vector<ScanReport>* batch = NULL;
+    if (!TakeBatch(index, &batch)) {
+      std::unique_lock<std::mutex> lock(work_mutex_);
+      while (queued_batches_.load() == 0 && !stopping_) {
+        work_cv_.wait(lock);
+      }
+      if (stopping_ && queued_batches_.load() == 0) {
+        return;
+      }
+      continue;
+    }
+    queued_batches_.fetch_sub(1);
+
+    ParseBatch(*batch, routes);
+    reports_ingested_.fetch_add(batch->size());
+    delete batch;
+    FinishWork(1);
+  }
+}
+
+void ScanIngestEngine::ParseBatch(const std::vector<ScanReport>& batch,
+                                  std::vector<ObservationChunk*>& routes) {
+  uint64_t malformed = 0;
+  for (size_t r = 0; r < batch.size(); ++r) {
+    const ScanReport& report = batch[r];
+    for (size_t i = 0; i < report.size(); ++i) {
+      PackedBssid bssid = ParseBssid(report[i].mac_address);
+      if (bssid == kInvalidBssid) {
+        ++malformed;
+        continue;
+      }
+      int shard = ShardFor(bssid);
+      ObservationChunk*& chunk = routes[shard];
+      if (!chunk) {
+        chunk = new ObservationChunk();
+        chunk->reserve(options_.route_batch_size);
+      }
+      Observation observation = { bssid, report[i].radio_signal_strength };
+      chunk->push_back(observation);
+      if (chunk->size() >= options_.route_batch_size) {
+        Route(shard, chunk);
+        chunk = NULL;
+      }
+    }
+  }
+  // Nothing may stay buffered past the end of a batch, otherwise Flush()
+  // could never observe the engine as idle.
+  for (size_t shard = 0; shard < routes.size(); ++shard) {
+    if (routes[shard]) {
+      Route(static_cast<int>(shard), routes[shard]);
+      routes[shard] = NULL;
+    }
+  }
+  if (malformed) {
+    malformed_.fetch_add(malformed);
+  }
+}
+
+void ScanIngestEngine::Route(int shard_index, ObservationChunk* chunk) {
+  outstanding_.fetch_add(1);
+  Shard& shard = *shards_[shard_index];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  shard.inbox.push_back(chunk);
+  if (shard.inbox.size() == 1) {
+    shard.cv.notify_one();
+  }
+}
+
+int ScanIngestEngine::ShardFor(PackedBssid bssid) const {
+  // Tables index with the low hash bits, so pick shards with the high ones.
+  return static_cast<int>((HashBssid(bssid) >> 40) % shards_.size());
+}
+
+void ScanIngestEngine::ShardLoop(int index) {
+  Shard& shard = *shards_[index];
+  std::vector<ObservationChunk*> pending;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(shard.mutex);
+      while (shard.inbox.empty() && !stopping_) {
+        shard.cv.wait(lock);
+      }
+      if (shard.inbox.empty()) {
+        return;
+      }
+      pending.swap(shard.inbox);
+    }
+
+    for (size_t c = 0; c < pending.size(); ++c) {
+      const ObservationChunk& chunk = *pending[c];
+      for (size_t i = 0; i < chunk.size(); ++i) {
+        BssidStats& stats = shard.table.Upsert(chunk[i].bssid);
+        int rssi = chunk[i].rssi;
+        if (stats.observations == 0) {
+          stats.rssi_min = rssi;
+          stats.rssi_max = rssi;
+        } else {
+          stats.rssi_min = std::min(stats.rssi_min, rssi);
+          stats.rssi_max = std::max(stats.rssi_max, rssi);
+        }
+        ++stats.observations;
+        stats.rssi_sum += rssi;
+      }
+      shard.observations += chunk.size();
+      delete pending[c];
+    }
+    uint64_t applied = pending.size();
+    pending.clear();
+    FinishWork(applied);
+  }
+}
+
+void ScanIngestEngine::FinishWork(uint64_t units) {
+  if (outstanding_.fetch_sub(units) == units) {
+    std::lock_guard<std::mutex> lock(idle_mutex_);
+    idle_cv_.notify_all();
+  }
+}
@@ -0,0 +1,162 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "wifi_accessPoint.h"
+#include "wifi_bssid.h"
+
+// A scan as reported by one client.
+typedef std::vector<AccessPoint> ScanReport;
+
+struct BssidStats {
+  PackedBssid bssid;
+  uint64_t observations;
+  int64_t rssi_sum;
+  int rssi_min;
+  int rssi_max;
+
+  double MeanRssi() const {
+    return observations ? static_cast<double>(rssi_sum) / observations : 0;
+  }
+};
+
+// Open-addressing (linear probing) map from packed BSSID to its stats. Only
+// ever touched by the shard worker that owns it.
+class BssidStatsTable {
+public:
+  BssidStatsTable();
+
+  // Returns the entry for |bssid|, inserting a zeroed one if needed.
+  BssidStats& Upsert(PackedBssid bssid);
+  const BssidStats* Find(PackedBssid bssid) const;
+  size_t Size() const { return size_; }
+  // Appends every occupied entry to |out|.
+  void CopyTo(std::vector<BssidStats>& out) const;
+
+private:
+  void Grow();
+
+  std::vector<BssidStats> slots_;
+  size_t mask_;
+  size_t size_;
+};
+
+// Immutable view of all shards at one instant: it includes exactly the
+// reports submitted before the snapshot was requested.
+struct IngestSnapshot {
+  uint64_t reports;
+  uint64_t observations;
+  // Sorted by bssid.
+  std::vector<BssidStats> entries;
+
+  const BssidStats* Find(PackedBssid bssid) const;
+};
+
+// Aggregates fleet scan reports into per-BSSID statistics on many cores.
+//
+// Submitted report batches land in per-parser deques. Parser threads take
+// work from their own deque and steal from the others when idle. They pack
+// each MAC into a 48-bit key and route the observation to the shard that
+// owns that key. Each shard thread owns one BssidStatsTable, so tables are
+// never shared or locked, and throughput grows with the number of shards.
+class ScanIngestEngine {
+public:
+  struct Options {
+    Options();
+    int parser_threads;
+    int shard_count;
+    // Observations a parser buffers per shard before handing them over.
+    size_t route_batch_size;
+    // If non-zero, a snapshot is taken this often in the background.
+    int snapshot_interval_ms;
+  };
+
+  explicit ScanIngestEngine(const Options& options);
+  ~ScanIngestEngine();
+
+  // Queues |reports| for ingestion, taking their contents.
+  void Submit(std::vector<ScanReport>& reports);
+  // Blocks until everything submitted so far has been applied.
+  void Flush();
+  // Pauses intake, waits for in-flight work, copies every shard and publishes
+  // the result as LatestSnapshot().
+  std::shared_ptr<const IngestSnapshot> TakeSnapshot();
+  // The most recent snapshot, or an empty one. Never blocks on ingestion.
+  std::shared_ptr<const IngestSnapshot> LatestSnapshot() const;
+
+  uint64_t ReportsIngested() const { return reports_ingested_.load(); }
+  uint64_t MalformedBssids() const { return malformed_.load(); }
+
+private:
+  struct Observation {
+    PackedBssid bssid;
+    int rssi;
+  };
+  typedef std::vector<Observation> ObservationChunk;
+
+  struct ParserQueue {
+    std::mutex mutex;
+    std::deque<std::vector<ScanReport>*> batches;
+  };
+
+  struct Shard {
+    Shard() : observations(0) {}
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<ObservationChunk*> inbox;
+    BssidStatsTable table;
+    uint64_t observations;
+  };
+
+  void ParserLoop(int index);
+  void ShardLoop(int index);
+  void SnapshotLoop();
+  bool TakeBatch(int index, std::vector<ScanReport>** batch);
+  void ParseBatch(const std::vector<ScanReport>& batch,
+                  std::vector<ObservationChunk*>& routes);
+  void Route(int shard, ObservationChunk* chunk);
+  int ShardFor(PackedBssid bssid) const;
+  void FinishWork(uint64_t units);
+
+  ScanIngestEngine(const ScanIngestEngine&);
+  ScanIngestEngine& operator=(const ScanIngestEngine&);
+
+  const Options options_;
+
+  std::vector<std::unique_ptr<ParserQueue> > parser_queues_;
+  std::vector<std::unique_ptr<Shard> > shards_;
+  std::vector<std::thread> threads_;
+  std::atomic<uint32_t> next_parser_;
+
+  // Parsers sleep here when every deque is empty.
+  std::mutex work_mutex_;
+  std::condition_variable work_cv_;
+  std::atomic<uint64_t> queued_batches_;
+
+  // Submit() takes intake_mutex_ briefly; TakeSnapshot() holds it while it
+  // waits for the engine to go idle, which pauses intake.
+  std::mutex intake_mutex_;
+  // Report batches and observation chunks not yet fully applied.
+  std::atomic<uint64_t> outstanding_;
+  std::mutex idle_mutex_;
+  std::condition_variable idle_cv_;
+
+  mutable std::mutex snapshot_mutex_;
+  std::shared_ptr<const IngestSnapshot> latest_snapshot_;
+  std::condition_variable snapshot_cv_;
+
+  std::atomic<bool> stopping_;
+  std::atomic<uint64_t> reports_submitted_;
+  std::atomic<uint64_t> reports_ingested_;
+  std::atomic<uint64_t> malformed_;
+};
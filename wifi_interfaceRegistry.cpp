@@ -0,0 +1,202 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_interfaceRegistry.h"
+#include <string.h>
+#include <algorithm>
+
+InterfaceRegistry::InterfaceRegistry(InterfaceChangeSource* source)
+    : source_(source),
+      started_(false),
+      version_(1) {
+  memset(&stats_, 0, sizeof(stats_));
+  InterfaceList* list = new InterfaceList();
+  list->version = 1;
+  current_.reset(list);
+}
+
+InterfaceRegistry::~InterfaceRegistry() {
+  Stop();
+}
+
+bool InterfaceRegistry::Start() {
+  if (started_) {
+    return true;
+  }
+  // Listen first, so a change made during the enumeration is not lost; at
+  // worst it is applied twice, and the second time changes nothing.
+  started_ = source_->Start(this);
+  return Refresh();
+}
+
+void InterfaceRegistry::Stop() {
+  if (started_) {
+    source_->Stop();
+    started_ = false;
+  }
+}
+
+std::shared_ptr<const InterfaceList> InterfaceRegistry::Current() const {
+  return std::atomic_load(&current_);
+}
+
+bool InterfaceRegistry::Sync(std::shared_ptr<const InterfaceList>* cached) const {
+  if (*cached && (*cached)->version == version_.load(std::memory_order_acquire)) {
+    return false;
+  }
+  std::shared_ptr<const InterfaceList> current = Current();
+  if (*cached == current) {
+    return false;
+  }
+  cached->swap(current);
+  return true;
+}
+
+bool InterfaceRegistry::Refresh() {
+  std::lock_guard<std::mutex> update(update_mutex_);
+  std::vector<std::string> names;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.enumerations;
+  }
+  if (!source_->Enumerate(names)) {
+    return false;
+  }
+  Publish(names);
+  return true;
+}
+
+InterfaceRegistry::Stats InterfaceRegistry::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void InterfaceRegistry::OnInterfaceAdded(const std::string& name) {
+  std::lock_guard<std::mutex> update(update_mutex_);
+  std::shared_ptr<const InterfaceList> list = Current();
+  std::vector<std::string> names = list->names;
+  if (std::find(names.begin(), names.end(), name) == names.end()) {
+    names.push_back(name);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.incremental_changes;
+  }
+  Publish(names);
+}
+
+void InterfaceRegistry::OnInterfaceRemoved(const std::string& name) {
+  std::lock_guard<std::mutex> update(update_mutex_);
+  std::shared_ptr<const InterfaceList> list = Current();
+  std::vector<std::string> names = list->names;
+  names.erase(std::remove(names.begin(), names.end(), name), names.end());
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.incremental_changes;
+  }
+  Publish(names);
+}
+
+void InterfaceRegistry::OnInterfacesInvalidated() {
+  Refresh();
+}
+
+void InterfaceRegistry::Publish(std::vector<std::string>& names) {
+  // update_mutex_ makes this the only writer, so current_ can be read
+  // directly; readers only ever see it through Current().
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (names == current_->names) {
+    ++stats_.unchanged;
+    return;
+  }
+  std::shared_ptr<InterfaceList> list = std::make_shared<InterfaceList>();
+  list->version = current_->version + 1;
+  list->names.swap(names);
+  uint64_t version = list->version;
+  std::atomic_store(&current_,
+                    std::shared_ptr<const InterfaceList>(std::move(list)));
+  ++stats_.versions_published;
+  version_.store(version, std::memory_order_release);
+}
+
+// FakeInterfaceChangeSource
+FakeInterfaceChangeSource::FakeInterfaceChangeSource()
+    : observer_(NULL),
+      enumeration_fails_(false),
+      enumerations_(0) {
+}
+
+bool FakeInterfaceChangeSource::Enumerate(std::vector<std::string>& names) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++enumerations_;
+  if (enumeration_fails_) {
+    return false;
+  }
+  names = names_;
+  return true;
+}
+
+bool FakeInterfaceChangeSource::Start(InterfaceChangeObserver* observer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  observer_ = observer;
+  return true;
+}
+
+void FakeInterfaceChangeSource::Stop() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  observer_ = NULL;
+}
+
+void FakeInterfaceChangeSource::Plug(const std::string& name) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (std::find(names_.begin(), names_.end(), name) != names_.end()) {
+      return;
+    }
+    names_.push_back(name);
+  }
+  if (InterfaceChangeObserver* observer = Observer()) {
+    observer->OnInterfaceAdded(name);
+  }
+}
+
+void FakeInterfaceChangeSource::Unplug(const std::string& name) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string>::iterator it =
+        std::find(names_.begin(), names_.end(), name);
+    if (it == names_.end()) {
+      return;
+    }
+    names_.erase(it);
+  }
+  if (InterfaceChangeObserver* observer = Observer()) {
+    observer->OnInterfaceRemoved(name);
+  }
+}
+
+void FakeInterfaceChangeSource::Replace(const std::vector<std::string>& names) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    names_ = names;
+  }
+  if (InterfaceChangeObserver* observer = Observer()) {
+    observer->OnInterfacesInvalidated();
+  }
+}
+
+void FakeInterfaceChangeSource::SetEnumerationFails(bool fails) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  enumeration_fails_ = fails;
+}
+
+int FakeInterfaceChangeSource::EnumerationCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return enumerations_;
+}
+
+InterfaceChangeObserver* FakeInterfaceChangeSource::Observer() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return observer_;
+}
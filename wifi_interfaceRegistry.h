@@ -0,0 +1,140 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// One published set of wifi interfaces. Never modified once published; a
+// change publishes a new list with a higher version.
+struct InterfaceList {
+  uint64_t version;
+  std::vector<std::string> names;
+};
+
+// Receives interface changes from an InterfaceChangeSource, on any thread.
+class InterfaceChangeObserver {
+public:
+  virtual ~InterfaceChangeObserver() {}
+  virtual void OnInterfaceAdded(const std::string& name) = 0;
+  virtual void OnInterfaceRemoved(const std::string& name) = 0;
+  // Something changed but the source cannot say what; enumerate again.
+  virtual void OnInterfacesInvalidated() = 0;
+};
+
+// Where interfaces come from. WindowsNdisInterfaceSource watches the
+// NetworkCards registry key; FakeInterfaceChangeSource is driven by tests.
+class InterfaceChangeSource {
+public:
+  virtual ~InterfaceChangeSource() {}
+  // Full enumeration. Returns false if the interfaces could not be listed.
+  virtual bool Enumerate(std::vector<std::string>& names) = 0;
+  // Starts reporting changes to |observer| until Stop() returns.
+  virtual bool Start(InterfaceChangeObserver* observer) = 0;
+  virtual void Stop() = 0;
+};
+
+// Keeps the current interface list so scans no longer enumerate interfaces,
+// and no longer miss adapters plugged in after startup. The list is updated
+// from the change source's notifications: single additions and removals are
+// applied to the previous list, and only an invalidation enumerates again.
+//
+// Readers hold a std::shared_ptr<const InterfaceList> and call Sync() before
+// each scan. When nothing has changed that is one atomic load and no lock;
+// Current() and the refetch in Sync() are atomic shared_ptr loads and never
+// wait for a writer either.
+class InterfaceRegistry : private InterfaceChangeObserver {
+public:
+  struct Stats {
+    uint64_t enumerations;
+    // Additions and removals applied without enumerating.
+    uint64_t incremental_changes;
+    // Notifications that left the list as it was.
+    uint64_t unchanged;
+    uint64_t versions_published;
+  };
+
+  // Does not take ownership of |source|, which must outlive the registry.
+  explicit InterfaceRegistry(InterfaceChangeSource* source);
+  ~InterfaceRegistry();
+
+  // Enumerates once and starts listening for changes. Returns false if the
+  // first enumeration failed; the list is then empty until a change arrives.
+  bool Start();
+  void Stop();
+
+  // Version of the latest list; starts at 1 with an empty list.
+  uint64_t Version() const { return version_.load(std::memory_order_acquire); }
+  std::shared_ptr<const InterfaceList> Current() const;
+  // Points |*cached| at the latest list if it is empty or out of date, and
+  // returns true if it did. Lock-free when |*cached| is already current.
+  bool Sync(std::shared_ptr<const InterfaceList>* cached) const;
+  // Enumerates again now, without waiting for a notification.
+  bool Refresh();
+
+  Stats GetStats() const;
+
+private:
+  virtual void OnInterfaceAdded(const std::string& name);
+  virtual void OnInterfaceRemoved(const std::string& name);
+  virtual void OnInterfacesInvalidated();
+
+  // Publishes |names| as a new version unless they match the current list.
+  // Called with update_mutex_ held.
+  void Publish(std::vector<std::string>& names);
+
+  InterfaceRegistry(const InterfaceRegistry&);
+  InterfaceRegistry& operator=(const InterfaceRegistry&);
+
+  InterfaceChangeSource* source_;
+  bool started_;
+
+  // Serializes updates so lists are published in the order changes arrive.
+  // Enumeration happens under it, but readers never take it.
+  std::mutex update_mutex_;
+
+  // Guards stats_.
+  mutable std::mutex mutex_;
+  // Only accessed through std::atomic_load/std::atomic_store, except by
+  // Publish(), the only writer.
+  std::shared_ptr<const InterfaceList> current_;
+  // Stored after current_ changes, so a reader that sees a new version
+  // finds the matching list.
+  std::atomic<uint64_t> version_;
+  Stats stats_;
+};
+
+// Source for tests: the interface set is whatever the test says, and
+// changes are delivered on the calling thread.
+class FakeInterfaceChangeSource : public InterfaceChangeSource {
+public:
+  FakeInterfaceChangeSource();
+
+  virtual bool Enumerate(std::vector<std::string>& names);
+  virtual bool Start(InterfaceChangeObserver* observer);
+  virtual void Stop();
+
+  // Adds or removes one interface and reports exactly that change.
+  void Plug(const std::string& name);
+  void Unplug(const std::string& name);
+  // Replaces the whole set and reports only that something changed.
+  void Replace(const std::vector<std::string>& names);
+  void SetEnumerationFails(bool fails);
+
+  int EnumerationCount() const;
+
+private:
+  InterfaceChangeObserver* Observer() const;
+
+  mutable std::mutex mutex_;
+  std::vector<std::string> names_;
+  InterfaceChangeObserver* observer_;
+  bool enumeration_fails_;
+  int enumerations_;
+};
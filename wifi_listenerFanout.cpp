@@ -0,0 +1,178 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_listenerFanout.h"
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
+ListenerPolicy::ListenerPolicy()
+    : min_interval_ms(0),
+      change_threshold(1) {
+}
+
+ListenerFanout::ListenerFanout(int worker_threads)
+    : next_slot_(0),
+      stopping_(false) {
+  assert(worker_threads > 0);
+  memset(&stats_, 0, sizeof(stats_));
+  for (int i = 0; i < worker_threads; ++i) {
+    workers_.push_back(std::thread(&ListenerFanout::WorkerLoop, this));
+  }
+}
+
+ListenerFanout::~ListenerFanout() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_cv_.notify_all();
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    workers_[i].join();
+  }
+}
+
+void ListenerFanout::AddListener(ScanUpdateListener* listener,
+                                 const ListenerPolicy& policy) {
+  std::unique_ptr<Slot> slot(new Slot());
+  slot->listener = listener;
+  slot->policy = policy;
+  slot->busy = false;
+  slot->next_allowed = Clock::time_point();
+  std::lock_guard<std::mutex> lock(mutex_);
+  // A new listener gets the current scan straight away.
+  slot->seen_generation = latest_ ? latest_->generation - 1 : 0;
+  slots_.push_back(std::move(slot));
+  work_cv_.notify_one();
+}
+
+void ListenerFanout::RemoveListener(ScanUpdateListener* listener) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    if (slots_[i]->listener != listener) {
+      continue;
+    }
+    Slot* slot = slots_[i].get();
+    idle_cv_.wait(lock, [slot] { return !slot->busy; });
+    // The wait released the lock, so find the slot again.
+    slots_.erase(std::find_if(slots_.begin(), slots_.end(),
+                              [slot](const std::unique_ptr<Slot>& s) {
+                                return s.get() == slot;
+                              }));
+    return;
+  }
+}
+
+void ListenerFanout::Publish(const std::vector<AccessPoint>& accessPoints) {
+  std::shared_ptr<Snapshot> snapshot(new Snapshot());
+  snapshot->access_points = accessPoints;
+  snapshot->bssids.reserve(accessPoints.size());
+  for (size_t i = 0; i < accessPoints.size(); ++i) {
+    snapshot->bssids.push_back(ParseBssid(accessPoints[i].mac_address));
+  }
+  std::sort(snapshot->bssids.begin(), snapshot->bssids.end());
+
+  std::shared_ptr<const Snapshot> previous;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    snapshot->generation = latest_ ? latest_->generation + 1 : 1;
+    // Release the old snapshot outside the lock.
+    previous.swap(latest_);
+    latest_ = snapshot;
+    ++stats_.published;
+  }
+  work_cv_.notify_all();
+}
+
+ListenerFanout::Stats ListenerFanout::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+int ListenerFanout::CountChanges(const Snapshot& before, const Snapshot& after) {
+  // Size of the symmetric difference of two sorted BSSID lists.
+  int changes = 0;
+  size_t i = 0;
+  size_t j = 0;
+  while (i < before.bssids.size() && j < after.bssids.size()) {
+    if (before.bssids[i] < after.bssids[j]) {
+      ++changes;
+      ++i;
+    } else if (after.bssids[j] < before.bssids[i]) {
+      ++changes;
+      ++j;
+    } else {
+      ++i;
+      ++j;
+    }
+  }
+  return changes + static_cast<int>(before.bssids.size() - i) +
+         static_cast<int>(after.bssids.size() - j);
+}
+
+ListenerFanout::Slot* ListenerFanout::PickSlot(Clock::time_point now,
+                                               Clock::time_point* wake_at) {
+  *wake_at = Clock::time_point::max();
+  const size_t count = slots_.size();
+  // Round-robin so that one fast listener cannot starve the others.
+  for (size_t n = 0; n < count; ++n) {
+    size_t index = (next_slot_ + n) % count;
+    Slot* slot = slots_[index].get();
+    if (slot->busy || slot->seen_generation >= latest_->generation) {
+      continue;
+    }
+    if (now < slot->next_allowed) {
+      *wake_at = std::min(*wake_at, slot->next_allowed);
+      continue;
+    }
+    next_slot_ = index + 1;
+    return slot;
+  }
+  return NULL;
+}
+
+void ListenerFanout::WorkerLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    Clock::time_point wake_at = Clock::time_point::max();
+    Slot* slot = latest_ ? PickSlot(Clock::now(), &wake_at) : NULL;
+    if (!slot) {
+      if (wake_at == Clock::time_point::max()) {
+        work_cv_.wait(lock);
+      } else {
+        work_cv_.wait_until(lock, wake_at);
+      }
+      continue;
+    }
+
+    std::shared_ptr<const Snapshot> snapshot = latest_;
+    uint64_t previous = slot->seen_generation;
+    slot->seen_generation = snapshot->generation;
+    slot->busy = true;
+    lock.unlock();
+
+    // Only this worker touches a busy slot's delivery state.
+    bool deliver = !slot->last_delivered || slot->policy.change_threshold <= 0 ||
+        CountChanges(*slot->last_delivered, *snapshot) >= slot->policy.change_threshold;
+    if (deliver) {
+      slot->listener->OnScanUpdate(snapshot->access_points);
+      slot->last_delivered = snapshot;
+    }
+    const uint64_t generation = snapshot->generation;
+    // Drop our reference before relocking; it may be the last one.
+    snapshot.reset();
+
+    lock.lock();
+    stats_.coalesced += generation - previous - 1;
+    if (deliver) {
+      ++stats_.delivered;
+      slot->next_allowed = Clock::now() +
+          std::chrono::milliseconds(slot->policy.min_interval_ms);
+    } else {
+      ++stats_.below_threshold;
+    }
+    slot->busy = false;
+    idle_cv_.notify_all();
+  }
+}
@@ -0,0 +1,105 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "wifi_accessPoint.h"
+#include "wifi_bssid.h"
+
+// Called on a fan-out worker thread, never concurrently for one listener.
+class ScanUpdateListener {
+public:
+  virtual ~ScanUpdateListener() {}
+  virtual void OnScanUpdate(const std::vector<AccessPoint>& accessPoints) = 0;
+};
+
+struct ListenerPolicy {
+  ListenerPolicy();
+  // Minimum time between two deliveries to this listener.
+  int64_t min_interval_ms;
+  // Deliver only once at least this many BSSIDs have appeared or
+  // disappeared since the last delivery; 0 delivers every scan.
+  int change_threshold;
+};
+
+// Fans scans out to many listeners without making the scan thread wait on
+// them. Publish() only swaps in the latest scan and wakes the pool; a fixed
+// set of worker threads then delivers it to each listener whose interval has
+// elapsed and whose change threshold is met. A listener that is busy or
+// rate limited never builds a backlog: whatever it has missed is replaced by
+// the newest scan.
+class ListenerFanout {
+public:
+  struct Stats {
+    uint64_t published;
+    uint64_t delivered;
+    // Scans a listener never saw because a newer one replaced them.
+    uint64_t coalesced;
+    // Scans skipped because they changed too little.
+    uint64_t below_threshold;
+  };
+
+  explicit ListenerFanout(int worker_threads);
+  // Pending updates are dropped; in-progress callbacks are waited for.
+  ~ListenerFanout();
+
+  // |listener| is not owned and must stay alive until RemoveListener()
+  // returns.
+  void AddListener(ScanUpdateListener* listener, const ListenerPolicy& policy);
+  // Waits for an in-progress callback to this listener to finish, so it must
+  // not be called from that listener's own callback.
+  void RemoveListener(ScanUpdateListener* listener);
+
+  // Cost is independent of the number of listeners.
+  void Publish(const std::vector<AccessPoint>& accessPoints);
+
+  Stats GetStats() const;
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Snapshot {
+    uint64_t generation;
+    std::vector<AccessPoint> access_points;
+    // Sorted, for computing the change against a listener's last delivery.
+    std::vector<PackedBssid> bssids;
+  };
+
+  struct Slot {
+    ScanUpdateListener* listener;
+    ListenerPolicy policy;
+    bool busy;
+    // Newest generation this listener has been considered for.
+    uint64_t seen_generation;
+    Clock::time_point next_allowed;
+    std::shared_ptr<const Snapshot> last_delivered;
+  };
+
+  void WorkerLoop();
+  // Returns a slot ready for the latest snapshot, or NULL with |wake_at| set
+  // to when a rate-limited slot becomes eligible (Clock::time_point::max()
+  // if none). Called with |mutex_| held.
+  Slot* PickSlot(Clock::time_point now, Clock::time_point* wake_at);
+  static int CountChanges(const Snapshot& before, const Snapshot& after);
+
+  ListenerFanout(const ListenerFanout&);
+  ListenerFanout& operator=(const ListenerFanout&);
+
+  mutable std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable idle_cv_;
+  std::vector<std::unique_ptr<Slot> > slots_;
+  size_t next_slot_;
+  std::shared_ptr<const Snapshot> latest_;
+  bool stopping_;
+  Stats stats_;
+  std::vector<std::thread> workers_;
+};
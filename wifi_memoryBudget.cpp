@@ -0,0 +1,275 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_memoryBudget.h"
+#include <limits.h>
+#include <string.h>
+#include <algorithm>
+
+namespace {
+void RaisePeak(std::atomic<size_t>& peak, size_t value) {
+  size_t current = peak.load(std::memory_order_relaxed);
+  while (value > current &&
+         !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+  }
+}
+}  // namespace
+
+MemoryBudget::MemoryBudget(size_t limit_bytes)
+    : limit_(limit_bytes),
+      used_(0),
+      peak_(0),
+      reclaiming_(false) {
+  memset(&stats_, 0, sizeof(stats_));
+  for (int i = 0; i < kMaxComponents; ++i) {
+    Component& component = components_[i];
+    component.name = NULL;
+    component.priority = 0;
+    component.client = NULL;
+    component.in_use = false;
+    component.releases = 0;
+    component.released_bytes = 0;
+    component.bytes.store(0);
+    component.peak_bytes.store(0);
+  }
+}
+
+void MemoryBudget::SetLimit(size_t limit_bytes) {
+  limit_.store(limit_bytes);
+  if (used_.load() <= limit_bytes) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  WaitAndReclaim(lock, limit_bytes, INT_MAX, -1);
+}
+
+int MemoryBudget::Register(const char* name, int priority,
+                           MemoryBudgetClient* client) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (int i = 0; i < kMaxComponents; ++i) {
+    Component& component = components_[i];
+    if (component.in_use) {
+      continue;
+    }
+    component.name = name;
+    component.priority = priority;
+    component.client = client;
+    component.in_use = true;
+    component.releases = 0;
+    component.released_bytes = 0;
+    component.bytes.store(0);
+    component.peak_bytes.store(0);
+    return i;
+  }
+  return -1;
+}
+
+void MemoryBudget::Unregister(int id) {
+  if (id < 0 || id >= kMaxComponents) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  Component& component = components_[id];
+  used_.fetch_sub(component.bytes.exchange(0));
+  component.in_use = false;
+  component.client = NULL;
+}
+
+void MemoryBudget::Report(int id, size_t bytes) {
+  if (id < 0 || id >= kMaxComponents) {
+    return;
+  }
+  Component& component = components_[id];
+  size_t previous = component.bytes.exchange(bytes);
+  // Unsigned wraparound makes this right for shrinking too.
+  size_t used = used_.fetch_add(bytes - previous) + (bytes - previous);
+  RaisePeak(component.peak_bytes, bytes);
+  RaisePeak(peak_, used);
+
+  size_t limit = limit_.load();
+  if (used <= limit) {
+    return;
+  }
+  // A report made from ReleaseMemory(), or while another thread reclaims,
+  // leaves the reclaiming to that call.
+  bool expected = false;
+  if (!reclaiming_.compare_exchange_strong(expected, true)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  ReclaimLocked(limit, INT_MAX, -1);
+  reclaiming_.store(false);
+  reclaim_cv_.notify_all();
+}
+
+bool MemoryBudget::Reserve(int id, size_t bytes) {
+  if (id < 0 || id >= kMaxComponents) {
+    return false;
+  }
+  size_t limit = limit_.load();
+  if (bytes <= limit && Charge(id, bytes, limit - bytes)) {
+    return true;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (bytes <= limit) {
+    size_t promised = WaitAndReclaim(lock, limit - bytes,
+                                     components_[id].priority, id);
+    if (Charge(id, bytes, limit - bytes + promised)) {
+      return true;
+    }
+  }
+  ++stats_.denied_reservations;
+  return false;
+}
+
+bool MemoryBudget::Charge(int id, size_t bytes, size_t max_used) {
+  size_t used = used_.load();
+  do {
+    if (used > max_used) {
+      return false;
+    }
+  } while (!used_.compare_exchange_weak(used, used + bytes));
+  Component& component = components_[id];
+  RaisePeak(component.peak_bytes, component.bytes.fetch_add(bytes) + bytes);
+  RaisePeak(peak_, used + bytes);
+  return true;
+}
+
+void MemoryBudget::GetUsage(std::vector<ComponentUsage>* usage) const {
+  usage->clear();
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (int i = 0; i < kMaxComponents; ++i) {
+    const Component& component = components_[i];
+    if (!component.in_use) {
+      continue;
+    }
+    ComponentUsage entry = { component.name, component.priority,
+                             component.bytes.load(), component.peak_bytes.load(),
+                             component.releases, component.released_bytes };
+    usage->push_back(entry);
+  }
+  std::stable_sort(usage->begin(), usage->end(),
+                   [](const ComponentUsage& a, const ComponentUsage& b) {
+                     return a.priority < b.priority;
+                   });
+}
+
+MemoryBudget::Stats MemoryBudget::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats stats = stats_;
+  stats.used = used_.load();
+  stats.peak = peak_.load();
+  return stats;
+}
+
+size_t MemoryBudget::WaitAndReclaim(std::unique_lock<std::mutex>& lock,
+                                    size_t target, int max_priority,
+                                    int exclude) {
+  reclaim_cv_.wait(lock, [this] { return !reclaiming_.load(); });
+  if (used_.load() <= target) {
+    return 0;
+  }
+  reclaiming_.store(true);
+  size_t promised = ReclaimLocked(target, max_priority, exclude);
+  reclaiming_.store(false);
+  reclaim_cv_.notify_all();
+  return promised;
+}
+
+size_t MemoryBudget::ReclaimLocked(size_t target, int max_priority, int exclude) {
+  ++stats_.reclaims;
+  int order[kMaxComponents];
+  int count = 0;
+  for (int i = 0; i < kMaxComponents; ++i) {
+    const Component& component = components_[i];
+    if (component.in_use && i != exclude && component.priority <= max_priority) {
+      order[count++] = i;
+    }
+  }
+  std::stable_sort(order, order + count, [this](int a, int b) {
+    return components_[a].priority < components_[b].priority;
+  });
+
+  // Whatever a component says it released beyond what its report took off
+  // the total, it will free later.
+  size_t promised = 0;
+  for (int i = 0; i < count; ++i) {
+    size_t used = used_.load();
+    if (used <= target + promised) {
+      break;
+    }
+    Component& component = components_[order[i]];
+    if (!component.bytes.load()) {
+      continue;
+    }
+    size_t released = component.client->ReleaseMemory(used - target - promised);
+    size_t after = used_.load();
+    size_t dropped = used > after ? used - after : 0;
+    if (released > dropped) {
+      promised += released - dropped;
+      stats_.deferred_bytes += released - dropped;
+    }
+    ++component.releases;
+    component.released_bytes += released;
+    stats_.released_bytes += released;
+  }
+  if (used_.load() > limit_.load() + promised) {
+    ++stats_.over_budget;
+  }
+  return promised;
+}
+
+DeferredReleaseClient::DeferredReleaseClient()
+    : budget_(NULL),
+      budget_id_(-1),
+      release_requested_(0),
+      reclaimable_(0),
+      owner_(std::thread::id()) {
+}
+
+void DeferredReleaseClient::AttachBudget(MemoryBudget* budget, const char* name,
+                                         int priority) {
+  if (budget_) {
+    budget_->Unregister(budget_id_);
+  }
+  budget_ = budget;
+  budget_id_ = -1;
+  release_requested_.store(0);
+  if (budget_) {
+    budget_id_ = budget_->Register(name, priority, this);
+    ReportMemory();
+  }
+}
+
+void DeferredReleaseClient::ReportMemory() {
+  if (!budget_) {
+    return;
+  }
+  while (true) {
+    reclaimable_.store(ReclaimableMemory());
+    budget_->Report(budget_id_, MemoryUsage());
+    size_t requested = release_requested_.exchange(0);
+    if (!requested) {
+      break;
+    }
+    FreeMemory(requested);
+  }
+}
+
+size_t DeferredReleaseClient::ReleaseMemory(size_t bytes) {
+  if (owner_.load() == std::this_thread::get_id()) {
+    size_t before = MemoryUsage();
+    FreeMemory(bytes);
+    size_t after = MemoryUsage();
+    reclaimable_.store(ReclaimableMemory());
+    budget_->Report(budget_id_, after);
+    return before > after ? before - after : 0;
+  }
+  size_t promised = std::min(bytes, reclaimable_.load());
+  size_t requested = release_requested_.load();
+  while (requested < promised &&
+         !release_requested_.compare_exchange_weak(requested, promised)) {
+  }
+  return promised;
+}
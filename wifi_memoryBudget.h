@@ -0,0 +1,204 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class MemoryBudget;
+
+// Rough per-node cost of std::list and std::unordered_map: links plus the
+// allocation header. For components estimating their own usage.
+const size_t kMemoryNodeOverhead = 4 * sizeof(void*);
+
+// Implemented by components whose memory a MemoryBudget accounts for.
+class MemoryBudgetClient {
+public:
+  virtual ~MemoryBudgetClient() {}
+  // Frees what it can towards |bytes|, reports its new usage through
+  // MemoryBudget::Report() and returns how much it freed. Called on whatever
+  // thread pushed the budget over its limit, with the budget's registry
+  // locked, so it must not register, unregister or reserve. A component
+  // that may not be touched from that thread instead returns how much it
+  // will free on its own thread at its next opportunity, without reporting;
+  // the budget counts that as freed until the component reports again.
+  virtual size_t ReleaseMemory(size_t bytes) = 0;
+};
+
+// A MemoryBudgetClient for components that may only free memory on the
+// thread driving them. That is the thread of the last ClaimOwnership(),
+// which the component calls at the top of each public method that changes
+// it. A reclaim on that thread can only come from the component's own
+// report or from between its calls, so memory is freed at once; a reclaim
+// on any other thread is promised, up to what the last report called
+// reclaimable, and freed by the owner's next ReportMemory(). A component
+// that never claims ownership always defers.
+class DeferredReleaseClient : public MemoryBudgetClient {
+public:
+  DeferredReleaseClient();
+
+  // Estimated heap bytes held.
+  virtual size_t MemoryUsage() const = 0;
+
+protected:
+  // Registers with |budget| under |name| and |priority| and reports, leaving
+  // any budget attached before. NULL detaches; derived destructors must
+  // detach, since the budget may call FreeMemory() until then.
+  void AttachBudget(MemoryBudget* budget, const char* name, int priority);
+  MemoryBudget* Budget() const { return budget_; }
+  int BudgetId() const { return budget_id_; }
+
+  void ClaimOwnership() { owner_.store(std::this_thread::get_id()); }
+  // Whether a reclaim on another thread is waiting for ReportMemory().
+  bool ReleasePending() const { return release_requested_.load() != 0; }
+  // Reports usage, then frees what reclaims promised meanwhile, until
+  // nothing more is asked.
+  void ReportMemory();
+
+  // What FreeMemory() could free now; no more is ever promised.
+  virtual size_t ReclaimableMemory() const = 0;
+  // Frees what it can towards |bytes|. Only called on the owning thread.
+  virtual void FreeMemory(size_t bytes) = 0;
+
+private:
+  // MemoryBudgetClient:
+  size_t ReleaseMemory(size_t bytes);
+
+  DeferredReleaseClient(const DeferredReleaseClient&);
+  DeferredReleaseClient& operator=(const DeferredReleaseClient&);
+
+  MemoryBudget* budget_;
+  int budget_id_;
+  // Bytes promised to reclaims on other threads, freed by the next
+  // ReportMemory().
+  std::atomic<size_t> release_requested_;
+  // ReclaimableMemory() as of the last report.
+  std::atomic<size_t> reclaimable_;
+  std::atomic<std::thread::id> owner_;
+};
+
+// One memory limit shared by every scanner component that registers with
+// it. Components report their usage after each change; when the total goes
+// over the limit the budget asks components to release memory, lowest
+// priority first, until the total fits again. Components about to grow ask
+// Reserve() first, which reclaims from lower priorities to make room and
+// refuses if it cannot.
+class MemoryBudget {
+public:
+  // Reclamation order: caches are rebuilt cheaply, history costs some
+  // accuracy, and query buffers are needed for the next scan at all.
+  enum Priority {
+    PRIORITY_CACHE = 0,
+    PRIORITY_HISTORY = 1,
+    PRIORITY_RESULTS = 2,
+    PRIORITY_QUERY_BUFFER = 3
+  };
+
+  struct ComponentUsage {
+    const char* name;
+    int priority;
+    size_t bytes;
+    size_t peak_bytes;
+    uint64_t releases;
+    uint64_t released_bytes;
+  };
+
+  struct Stats {
+    size_t used;
+    size_t peak;
+    uint64_t reclaims;
+    uint64_t released_bytes;
+    // Part of released_bytes that components promised to free later, on
+    // their own thread, rather than at once.
+    uint64_t deferred_bytes;
+    uint64_t denied_reservations;
+    // Reclaims that could not bring usage back under the limit, even
+    // counting deferred releases.
+    uint64_t over_budget;
+  };
+
+  explicit MemoryBudget(size_t limit_bytes);
+
+  size_t Limit() const { return limit_.load(); }
+  // Reclaims straight away if usage is over the new limit.
+  void SetLimit(size_t limit_bytes);
+  size_t Used() const { return used_.load(); }
+
+  // Returns the component's id, or -1 if kMaxComponents are registered.
+  // |name| must outlive the budget; |client| must stay valid until
+  // Unregister() returns.
+  int Register(const char* name, int priority, MemoryBudgetClient* client);
+  // Drops the component and its usage from the total.
+  void Unregister(int id);
+
+  // Sets component |id|'s usage to |bytes|, reclaiming if the total is now
+  // over the limit. That may call the component's own ReleaseMemory(), so
+  // report outside any lock ReleaseMemory() takes.
+  void Report(int id, size_t bytes);
+  // Makes room for component |id| to grow by |bytes|, releasing memory from
+  // lower priority components if needed. If another thread is reclaiming,
+  // waits for it first, since that may make room by itself. Memory a
+  // component promised to free later counts as room. Returns false if even
+  // that is not enough; the component should then not grow. On success the
+  // bytes count as the component's until its next Report(), so concurrent
+  // reservations cannot claim the same room; a component that does not
+  // grow after all reports its actual usage to give them back. Call from
+  // the thread that reports for |id|.
+  bool Reserve(int id, size_t bytes);
+
+  // Registered components, in reclamation order.
+  void GetUsage(std::vector<ComponentUsage>* usage) const;
+  Stats GetStats() const;
+
+  static const int kMaxComponents = 32;
+
+private:
+  struct Component {
+    // Registration fields, guarded by mutex_.
+    const char* name;
+    int priority;
+    MemoryBudgetClient* client;
+    bool in_use;
+    uint64_t releases;
+    uint64_t released_bytes;
+    // Updated by Report() without the lock.
+    std::atomic<size_t> bytes;
+    std::atomic<size_t> peak_bytes;
+  };
+
+  // Waits out any reclaim in flight, then reclaims towards |target| if usage
+  // is above it. Returns the bytes components promised to free later.
+  size_t WaitAndReclaim(std::unique_lock<std::mutex>& lock, size_t target,
+                        int max_priority, int exclude);
+  // Asks components other than |exclude| with priority at most
+  // |max_priority| to release memory until usage, less what they promise to
+  // free later, is at most |target|. Returns that promised amount. Called
+  // with mutex_ held and reclaiming_ set.
+  size_t ReclaimLocked(size_t target, int max_priority, int exclude);
+  // Adds |bytes| to component |id| and the total if the total is at most
+  // |max_used|. Returns whether it did.
+  bool Charge(int id, size_t bytes, size_t max_used);
+
+  MemoryBudget(const MemoryBudget&);
+  MemoryBudget& operator=(const MemoryBudget&);
+
+  std::atomic<size_t> limit_;
+  std::atomic<size_t> used_;
+  std::atomic<size_t> peak_;
+  // Set while a thread is reclaiming, so the reports that clients make from
+  // ReleaseMemory() do not start another reclaim. Cleared with mutex_ held,
+  // and reclaim_cv_ notified, so Reserve() can wait for it.
+  std::atomic<bool> reclaiming_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable reclaim_cv_;
+  Component components_[kMaxComponents];
+  Stats stats_;
+};
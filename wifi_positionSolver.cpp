@@ -0,0 +1,344 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_positionSolver.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define WIFI_POSITION_SSE2 1
+#endif
+
+namespace {
+// Ranges below this are clamped so the Jacobian stays finite when the
+// estimate sits on top of an AP.
+const float kMinRangeM = 0.5f;
+// Levenberg damping added to the normal equations, relative to their trace.
+const float kDamping = 1e-3f;
+// Floor on the robust residual spread, as a fraction of the modelled
+// distance, so that a near-perfect fit does not reject everything else.
+const float kMinRelativeSigma = 0.05f;
+const int kMinTrilaterationAps = 3;
+// Scenes handed to a batch worker at a time.
+const size_t kBatchChunk = 32;
+
+struct NormalSums {
+  float jxx, jxy, jyy;
+  float jxr, jyr;
+  float wrr, w;
+};
+
+// Accumulates J^T W J, J^T W r and the weighted squared residual for the
+// range residuals r_i = |p - a_i| - d_i at p = (px, py).
+void AccumulateNormalSums(const float* x, const float* y, const float* d,
+                          const float* w, size_t n, float px, float py,
+                          NormalSums* sums) {
+  size_t i = 0;
+  float jxx = 0, jxy = 0, jyy = 0, jxr = 0, jyr = 0, wrr = 0, sw = 0;
+#ifdef WIFI_POSITION_SSE2
+  __m128 vjxx = _mm_setzero_ps(), vjxy = _mm_setzero_ps(), vjyy = _mm_setzero_ps();
+  __m128 vjxr = _mm_setzero_ps(), vjyr = _mm_setzero_ps();
+  __m128 vwrr = _mm_setzero_ps(), vsw = _mm_setzero_ps();
+  const __m128 vpx = _mm_set1_ps(px);
+  const __m128 vpy = _mm_set1_ps(py);
+  const __m128 vmin = _mm_set1_ps(kMinRangeM);
+  for (; i + 4 <= n; i += 4) {
+    __m128 dx = _mm_sub_ps(vpx, _mm_loadu_ps(x + i));
+    __m128 dy = _mm_sub_ps(vpy, _mm_loadu_ps(y + i));
+    __m128 r = _mm_max_ps(
+        _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy))), vmin);
+    __m128 jx = _mm_div_ps(dx, r);
+    __m128 jy = _mm_div_ps(dy, r);
+    __m128 res = _mm_sub_ps(r, _mm_loadu_ps(d + i));
+    __m128 wi = _mm_loadu_ps(w + i);
+    __m128 wjx = _mm_mul_ps(wi, jx);
+    __m128 wjy = _mm_mul_ps(wi, jy);
+    vjxx = _mm_add_ps(vjxx, _mm_mul_ps(wjx, jx));
+    vjxy = _mm_add_ps(vjxy, _mm_mul_ps(wjx, jy));
+    vjyy = _mm_add_ps(vjyy, _mm_mul_ps(wjy, jy));
+    vjxr = _mm_add_ps(vjxr, _mm_mul_ps(wjx, res));
+    vjyr = _mm_add_ps(vjyr, _mm_mul_ps(wjy, res));
+    vwrr = _mm_add_ps(vwrr, _mm_mul_ps(_mm_mul_ps(wi, res), res));
+    vsw = _mm_add_ps(vsw, wi);
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, vjxx); jxx = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  _mm_storeu_ps(lanes, vjxy); jxy = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  _mm_storeu_ps(lanes, vjyy); jyy = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  _mm_storeu_ps(lanes, vjxr); jxr = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  _mm_storeu_ps(lanes, vjyr); jyr = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  _mm_storeu_ps(lanes, vwrr); wrr = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  _mm_storeu_ps(lanes, vsw); sw = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+  for (; i < n; ++i) {
+    float dx = px - x[i];
+    float dy = py - y[i];
+    float r = std::max(sqrtf(dx * dx + dy * dy), kMinRangeM);
+    float jx = dx / r;
+    float jy = dy / r;
+    float res = r - d[i];
+    jxx += w[i] * jx * jx;
+    jxy += w[i] * jx * jy;
+    jyy += w[i] * jy * jy;
+    jxr += w[i] * jx * res;
+    jyr += w[i] * jy * res;
+    wrr += w[i] * res * res;
+    sw += w[i];
+  }
+  sums->jxx = jxx;
+  sums->jxy = jxy;
+  sums->jyy = jyy;
+  sums->jxr = jxr;
+  sums->jyr = jyr;
+  sums->wrr = wrr;
+  sums->w = sw;
+}
+
+float MedianInPlace(std::vector<float>& values) {
+  std::vector<float>::iterator middle = values.begin() + values.size() / 2;
+  std::nth_element(values.begin(), middle, values.end());
+  return *middle;
+}
+}  // namespace
+
+struct PositionSolver::Scratch {
+  std::vector<float> distance;
+  std::vector<float> weight;
+  std::vector<float> base_weight;
+  std::vector<float> errors;
+};
+
+void RssiObservations::Clear() {
+  x.clear();
+  y.clear();
+  rssi.clear();
+}
+
+void RssiObservations::Add(float ap_x, float ap_y, float ap_rssi) {
+  x.push_back(ap_x);
+  y.push_back(ap_y);
+  rssi.push_back(ap_rssi);
+}
+
+int BuildObservations(const std::vector<AccessPoint>& scan,
+                      const ApLocationMap& known, RssiObservations* out) {
+  out->Clear();
+  for (size_t i = 0; i < scan.size(); ++i) {
+    ApLocationMap::const_iterator it = known.find(ParseBssid(scan[i].mac_address));
+    if (it != known.end()) {
+      out->Add(it->second.x, it->second.y,
+               static_cast<float>(scan[i].radio_signal_strength));
+    }
+  }
+  return static_cast<int>(out->Size());
+}
+
+PositionSolverOptions::PositionSolverOptions()
+    : rssi_at_1m_dbm(-40),
+      path_loss_exponent(3),
+      max_iterations(10),
+      convergence_m(0.05f),
+      outlier_threshold(3),
+      outlier_rounds(4) {
+}
+
+PositionSolver::PositionSolver(const PositionSolverOptions& options)
+    : options_(options) {
+}
+
+void PositionSolver::ModelDistances(const RssiObservations& observations,
+                                    Scratch* scratch) const {
+  const size_t n = observations.Size();
+  // d = 10^((P0 - rssi) / (10 n)); measurement noise in dB makes the
+  // distance error proportional to d, hence weights of 1 / d^2.
+  const float scale = logf(10.0f) / (10.0f * options_.path_loss_exponent);
+  scratch->distance.resize(n);
+  scratch->base_weight.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    float d = expf((options_.rssi_at_1m_dbm - observations.rssi[i]) * scale);
+    d = std::max(d, kMinRangeM);
+    scratch->distance[i] = d;
+    scratch->base_weight[i] = 1.0f / (d * d);
+  }
+}
+
+bool PositionSolver::WeightedCentroid(const RssiObservations& observations,
+                                      PositionEstimate* estimate) const {
+  Scratch scratch;
+  return CentroidWith(observations, &scratch, estimate);
+}
+
+bool PositionSolver::CentroidWith(const RssiObservations& observations,
+                                  Scratch* scratch,
+                                  PositionEstimate* estimate) const {
+  memset(estimate, 0, sizeof(*estimate));
+  const size_t n = observations.Size();
+  if (!n) {
+    return false;
+  }
+  ModelDistances(observations, scratch);
+  double sx = 0, sy = 0, sw = 0;
+  for (size_t i = 0; i < n; ++i) {
+    float w = scratch->base_weight[i];
+    sx += w * observations.x[i];
+    sy += w * observations.y[i];
+    sw += w;
+  }
+  estimate->x = static_cast<float>(sx / sw);
+  estimate->y = static_cast<float>(sy / sw);
+  estimate->inliers = static_cast<int>(n);
+  estimate->valid = true;
+  return true;
+}
+
+bool PositionSolver::Trilaterate(const RssiObservations& observations,
+                                 PositionEstimate* estimate) const {
+  Scratch scratch;
+  return TrilaterateWith(observations, &scratch, estimate);
+}
+
+bool PositionSolver::TrilaterateWith(const RssiObservations& observations,
+                                     Scratch* scratch,
+                                     PositionEstimate* estimate) const {
+  if (!CentroidWith(observations, scratch, estimate)) {
+    return false;
+  }
+  const size_t n = observations.Size();
+  if (n < static_cast<size_t>(kMinTrilaterationAps)) {
+    return true;
+  }
+
+  const float* x = &observations.x[0];
+  const float* y = &observations.y[0];
+  const float* d = &scratch->distance[0];
+  scratch->weight = scratch->base_weight;
+  float* w = &scratch->weight[0];
+  int inliers = static_cast<int>(n);
+  float px = estimate->x;
+  float py = estimate->y;
+  NormalSums sums;
+
+  for (int round = 0; ; ++round) {
+    for (int iteration = 0; iteration < options_.max_iterations; ++iteration) {
+      AccumulateNormalSums(x, y, d, w, n, px, py, &sums);
+      float lambda = kDamping * (sums.jxx + sums.jyy);
+      float a = sums.jxx + lambda;
+      float b = sums.jxy;
+      float c = sums.jyy + lambda;
+      float det = a * c - b * b;
+      if (!(det > 0)) {
+        break;
+      }
+      float step_x = -(c * sums.jxr - b * sums.jyr) / det;
+      float step_y = -(a * sums.jyr - b * sums.jxr) / det;
+      px += step_x;
+      py += step_y;
+      if (step_x * step_x + step_y * step_y <
+          options_.convergence_m * options_.convergence_m) {
+        break;
+      }
+    }
+
+    if (round >= options_.outlier_rounds || inliers <= kMinTrilaterationAps) {
+      break;
+    }
+    // Robust spread of the relative range errors over current inliers.
+    scratch->errors.clear();
+    for (size_t i = 0; i < n; ++i) {
+      if (w[i] > 0) {
+        float dx = px - x[i];
+        float dy = py - y[i];
+        float r = std::max(sqrtf(dx * dx + dy * dy), kMinRangeM);
+        scratch->errors.push_back(fabsf(r - d[i]) / d[i]);
+      }
+    }
+    float sigma = std::max(1.4826f * MedianInPlace(scratch->errors),
+                           kMinRelativeSigma);
+    float limit = options_.outlier_threshold * sigma;
+    // Drop only the worst observation and refit: one gross outlier drags the
+    // fit towards itself and inflates the residuals of good APs, which must
+    // not be rejected on its account.
+    size_t worst = n;
+    float worst_error = limit;
+    for (size_t i = 0; i < n; ++i) {
+      if (w[i] > 0) {
+        float dx = px - x[i];
+        float dy = py - y[i];
+        float r = std::max(sqrtf(dx * dx + dy * dy), kMinRangeM);
+        float error = fabsf(r - d[i]) / d[i];
+        if (error > worst_error) {
+          worst_error = error;
+          worst = i;
+        }
+      }
+    }
+    if (worst == n) {
+      break;
+    }
+    w[worst] = 0;
+    --inliers;
+  }
+
+  AccumulateNormalSums(x, y, d, w, n, px, py, &sums);
+  estimate->x = px;
+  estimate->y = py;
+  estimate->rms_residual_m = sums.w > 0 ? sqrtf(sums.wrr / sums.w) : 0;
+  estimate->inliers = inliers;
+  estimate->valid = true;
+  return true;
+}
+
+bool PositionSolver::Solve(Method method, const RssiObservations& observations,
+                           PositionEstimate* estimate) const {
+  Scratch scratch;
+  return SolveWith(method, observations, &scratch, estimate);
+}
+
+bool PositionSolver::SolveWith(Method method,
+                               const RssiObservations& observations,
+                               Scratch* scratch,
+                               PositionEstimate* estimate) const {
+  if (method == TRILATERATION) {
+    return TrilaterateWith(observations, scratch, estimate);
+  }
+  return CentroidWith(observations, scratch, estimate);
+}
+
+void PositionSolver::SolveBatch(Method method,
+                                const std::vector<RssiObservations>& scenes,
+                                std::vector<PositionEstimate>* estimates,
+                                int threads) const {
+  estimates->resize(scenes.size());
+  if (threads <= 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  size_t chunks = (scenes.size() + kBatchChunk - 1) / kBatchChunk;
+  threads = static_cast<int>(std::min<size_t>(threads, chunks));
+
+  std::atomic<size_t> next_chunk(0);
+  PositionEstimate* out = estimates->empty() ? NULL : &(*estimates)[0];
+  auto worker = [&, out] {
+    Scratch scratch;
+    size_t chunk;
+    while ((chunk = next_chunk.fetch_add(1)) < chunks) {
+      size_t end = std::min(scenes.size(), (chunk + 1) * kBatchChunk);
+      for (size_t i = chunk * kBatchChunk; i < end; ++i) {
+        SolveWith(method, scenes[i], &scratch, &out[i]);
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (int t = 1; t < threads; ++t) {
+    pool.push_back(std::thread(worker));
+  }
+  worker();
+  for (size_t t = 0; t < pool.size(); ++t) {
+    pool[t].join();
+  }
+}
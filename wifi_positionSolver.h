@@ -0,0 +1,105 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+#include "wifi_accessPoint.h"
+#include "wifi_bssid.h"
+
+// Known AP position in a local planar frame, in metres. Callers project
+// geographic coordinates into such a frame around the area of interest.
+struct ApLocation {
+  float x;
+  float y;
+};
+
+typedef std::unordered_map<PackedBssid, ApLocation> ApLocationMap;
+
+// Structure-of-arrays observation set: one element per AP heard, so the
+// solver can process several APs per SIMD instruction.
+struct RssiObservations {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> rssi;
+
+  void Clear();
+  void Add(float ap_x, float ap_y, float ap_rssi);
+  size_t Size() const { return rssi.size(); }
+};
+
+// Fills |out| with the APs in |scan| whose location is known. Returns how
+// many were found.
+int BuildObservations(const std::vector<AccessPoint>& scan,
+                      const ApLocationMap& known, RssiObservations* out);
+
+struct PositionEstimate {
+  float x;
+  float y;
+  // Weighted RMS of (distance to AP - path-loss distance) over inliers.
+  float rms_residual_m;
+  int inliers;
+  bool valid;
+};
+
+struct PositionSolverOptions {
+  PositionSolverOptions();
+  // Log-distance model: rssi = rssi_at_1m - 10 * exponent * log10(d).
+  float rssi_at_1m_dbm;
+  float path_loss_exponent;
+  int max_iterations;
+  // Stop iterating once a step moves less than this.
+  float convergence_m;
+  // After each solve the observation with the largest residual is dropped
+  // if that exceeds this many robust standard deviations, and the solve is
+  // repeated, at most |outlier_rounds| times.
+  float outlier_threshold;
+  int outlier_rounds;
+};
+
+// Positions a receiver from RSSI observations of APs at known locations.
+//
+// WeightedCentroid() is cheap and never fails given one observation.
+// Trilaterate() converts RSSI to distance with the path-loss model and runs
+// damped Gauss-Newton from the centroid, rejecting the worst outlier by
+// median absolute deviation between rounds. The inner loop over APs uses SSE2
+// where available.
+class PositionSolver {
+public:
+  enum Method {
+    WEIGHTED_CENTROID,
+    TRILATERATION
+  };
+
+  explicit PositionSolver(const PositionSolverOptions& options);
+
+  bool WeightedCentroid(const RssiObservations& observations,
+                        PositionEstimate* estimate) const;
+  bool Trilaterate(const RssiObservations& observations,
+                   PositionEstimate* estimate) const;
+  bool Solve(Method method, const RssiObservations& observations,
+             PositionEstimate* estimate) const;
+
+  // Solves every scene, splitting the work over |threads| threads (0 means
+  // one per core). |estimates| is resized to match |scenes|.
+  void SolveBatch(Method method, const std::vector<RssiObservations>& scenes,
+                  std::vector<PositionEstimate>* estimates, int threads) const;
+
+private:
+  // Per-thread working arrays, reused across the scenes of a batch.
+  struct Scratch;
+
+  void ModelDistances(const RssiObservations& observations,
+                      Scratch* scratch) const;
+  bool CentroidWith(const RssiObservations& observations, Scratch* scratch,
+                    PositionEstimate* estimate) const;
+  bool TrilaterateWith(const RssiObservations& observations, Scratch* scratch,
+                       PositionEstimate* estimate) const;
+  bool SolveWith(Method method, const RssiObservations& observations,
+                 Scratch* scratch, PositionEstimate* estimate) const;
+
+  const PositionSolverOptions options_;
+};
@@ -0,0 +1,451 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_radioEnvironment.h"
+#include "wifi_bssIdList.h"
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+const int kGaussianTableBits = 12;
+const int kGaussianTableSize = 1 << kGaussianTableBits;
+const int kOuiPoolSize = 16;
+// Roughly one SSID per three BSSIDs, as in multi-radio enterprise deployments.
+const int kBssidsPerSsid = 3;
+const double kPi = 3.14159265358979323846;
+
+const int kChannels24[] = { 1, 6, 11 };
+const int kChannels5[] = { 36, 40, 44, 48, 149, 153, 157, 161 };
+
+// IE ids and suite selectors (IEEE 802.11-2016 9.4.2).
+const unsigned char kIeSsid = 0;
+const unsigned char kIeRsn = 48;
+const unsigned char kIeVendor = 221;
+const unsigned char kRsnOui[] = { 0x00, 0x0F, 0xAC };
+const unsigned char kMicrosoftOui[] = { 0x00, 0x50, 0xF2 };
+const unsigned char kCipherTkip = 2;
+const unsigned char kCipherCcmp = 4;
+const unsigned char kAkm8021x = 1;
+const unsigned char kAkmPsk = 2;
+const unsigned char kAkmSae = 8;
+const unsigned char kWpaOuiType = 1;
+const unsigned char kWmmOuiType = 2;
+const uint16_t kRsnCapabilityMfpCapable = 1 << 7;
+const uint16_t kRsnCapabilityMfpRequired = 1 << 6;
+const uint16_t kCapabilityEss = 1 << 0;
+const uint16_t kCapabilityPrivacy = 1 << 4;
+// Records are padded to this, as drivers do.
+const size_t kRecordAlignment = 4;
+
+void AppendSuite(const unsigned char oui[3], unsigned char type,
+                 std::vector<unsigned char>& out) {
+  out.insert(out.end(), oui, oui + 3);
+  out.push_back(type);
+}
+
+void AppendLe16(uint16_t value, std::vector<unsigned char>& out) {
+  out.push_back(static_cast<unsigned char>(value));
+  out.push_back(static_cast<unsigned char>(value >> 8));
+}
+
+// Version, group cipher, one pairwise cipher and one AKM: the body shared by
+// the RSN IE and the WPA vendor IE.
+void AppendSecurityBody(const unsigned char oui[3], unsigned char group,
+                        unsigned char pairwise, unsigned char akm,
+                        std::vector<unsigned char>& out) {
+  AppendLe16(1, out);
+  AppendSuite(oui, group, out);
+  AppendLe16(1, out);
+  AppendSuite(oui, pairwise, out);
+  AppendLe16(1, out);
+  AppendSuite(oui, akm, out);
+}
+
+// Appends IE |id| whose body the caller writes after the returned offset;
+// FinishIe() fills in the length.
+size_t BeginIe(unsigned char id, std::vector<unsigned char>& out) {
+  out.push_back(id);
+  out.push_back(0);
+  return out.size();
+}
+
+void FinishIe(size_t body_start, std::vector<unsigned char>& out) {
+  out[body_start - 1] = static_cast<unsigned char>(out.size() - body_start);
+}
+
+void BuildIes(const std::string& ssid, SimulatedSecurity security,
+              const unsigned char* extra_vendor_oui,
+              std::vector<unsigned char>& out) {
+  out.clear();
+  size_t body = BeginIe(kIeSsid, out);
+  out.insert(out.end(), ssid.begin(), ssid.end());
+  FinishIe(body, out);
+
+  if (security != SIM_SECURITY_OPEN) {
+    unsigned char akm = kAkmPsk;
+    if (security == SIM_SECURITY_WPA2_ENTERPRISE) {
+      akm = kAkm8021x;
+    } else if (security == SIM_SECURITY_WPA3_SAE) {
+      akm = kAkmSae;
+    }
+    unsigned char group = security == SIM_SECURITY_WPA_WPA2_MIXED ? kCipherTkip
+                                                                 : kCipherCcmp;
+    body = BeginIe(kIeRsn, out);
+    AppendSecurityBody(kRsnOui, group, kCipherCcmp, akm, out);
+    AppendLe16(security == SIM_SECURITY_WPA3_SAE
+                   ? kRsnCapabilityMfpCapable | kRsnCapabilityMfpRequired
+                   : 0,
+               out);
+    FinishIe(body, out);
+  }
+  if (security == SIM_SECURITY_WPA_WPA2_MIXED) {
+    body = BeginIe(kIeVendor, out);
+    AppendSuite(kMicrosoftOui, kWpaOuiType, out);
+    AppendSecurityBody(kMicrosoftOui, kCipherTkip, kCipherTkip, kAkmPsk, out);
+    FinishIe(body, out);
+  }
+
+  // WMM parameter element, present on nearly every modern AP.
+  body = BeginIe(kIeVendor, out);
+  AppendSuite(kMicrosoftOui, kWmmOuiType, out);
+  const unsigned char kWmmParameters[] = { 0x01, 0x01, 0x80, 0x00,
+                                           0x03, 0xA4, 0x00, 0x00,
+                                           0x27, 0xA4, 0x00, 0x00,
+                                           0x42, 0x43, 0x5E, 0x00,
+                                           0x62, 0x32, 0x2F, 0x00 };
+  out.insert(out.end(), kWmmParameters, kWmmParameters + sizeof(kWmmParameters));
+  FinishIe(body, out);
+
+  if (extra_vendor_oui) {
+    body = BeginIe(kIeVendor, out);
+    out.insert(out.end(), extra_vendor_oui, extra_vendor_oui + 3);
+    const unsigned char kPayload[] = { 0x01, 0x02, 0x03, 0x04 };
+    out.insert(out.end(), kPayload, kPayload + sizeof(kPayload));
+    FinishIe(body, out);
+  }
+}
+
+// Share of each SimulatedSecurity, roughly as surveyed in offices.
+const double kSecurityShare[SIM_SECURITY_COUNT] = { 0.15, 0.50, 0.15, 0.10, 0.10 };
+
+std::vector<float> BuildGaussianTable() {
+  // Box-Muller over a fixed seed. Built once and shared by every generator,
+  // so the cost of log/cos doesn't matter.
+  RadioRandom random(0x5eed5eed5eed5eedULL);
+  std::vector<float> table(kGaussianTableSize);
+  for (int i = 0; i < kGaussianTableSize; i += 2) {
+    double u1 = random.NextDouble();
+    double u2 = random.NextDouble();
+    if (u1 < 1e-12) {
+      u1 = 1e-12;
+    }
+    double r = sqrt(-2.0 * log(u1));
+    table[i] = static_cast<float>(r * cos(2.0 * kPi * u2));
+    table[i + 1] = static_cast<float>(r * sin(2.0 * kPi * u2));
+  }
+  return table;
+}
+
+const float* GaussianTable() {
+  static const std::vector<float> table = BuildGaussianTable();
+  return &table[0];
+}
+
+// Maps a probability onto the range of RadioRandom::Next().
+uint64_t ProbabilityThreshold(double p) {
+  if (p <= 0) {
+    return 0;
+  }
+  if (p >= 1) {
+    return ~static_cast<uint64_t>(0);
+  }
+  return static_cast<uint64_t>(p * 18446744073709551615.0);
+}
+
+// log2 accurate to about 0.01, which is far below the simulated noise.
+inline float FastLog2(float x) {
+  union {
+    float f;
+    uint32_t i;
+  } bits;
+  bits.f = x;
+  float exponent = static_cast<float>(static_cast<int>((bits.i >> 23) & 0xFF) - 127);
+  bits.i = (bits.i & 0x007FFFFF) | 0x3F800000;
+  float m = bits.f;
+  return exponent + (-0.34484843f * m + 2.02466578f) * m - 0.67487759f;
+}
+
+uint32_t ChannelToFrequencyKhz(int channel) {
+  if (channel <= 14) {
+    return (2407 + 5 * channel) * 1000;
+  }
+  return (5000 + 5 * channel) * 1000;
+}
+}  // namespace
+
+RadioRandom::RadioRandom(uint64_t seed) {
+  // splitmix64 to spread the seed over both words of state.
+  for (int i = 0; i < 2; ++i) {
+    uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    (i == 0 ? s0_ : s1_) = z ^ (z >> 31);
+  }
+  if (!s0_ && !s1_) {
+    s1_ = 1;
+  }
+}
+
+uint64_t RadioRandom::Next() {
+  uint64_t x = s0_;
+  const uint64_t y = s1_;
+  s0_ = y;
+  x ^= x << 23;
+  s1_ = x ^ y ^ (x >> 17) ^ (y >> 26);
+  return s1_ + y;
+}
+
+double RadioRandom::NextDouble() {
+  return (Next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+float RadioRandom::NextGaussian() {
+  return GaussianTable()[Next() >> (64 - kGaussianTableBits)];
+}
+
+RadioEnvironmentOptions::RadioEnvironmentOptions()
+    : seed(1),
+      access_point_count(200),
+      width_m(200.0),
+      height_m(200.0),
+      rssi_at_1m_dbm(-40.0),
+      path_loss_exponent(3.0),
+      noise_stddev_db(4.0),
+      sensitivity_dbm(-95),
+      receiver_speed_mps(1.4),
+      scan_interval_s(10.0),
+      appear_probability(0.01),
+      disappear_probability(0.01),
+      include_ies(true) {
+}
+
+RadioEnvironmentGenerator::RadioEnvironmentGenerator(
+    const RadioEnvironmentOptions& options)
+    : options_(options),
+      random_(options.seed),
+      scan_count_(0) {
+  GaussianTable();
+
+  unsigned char ouis[kOuiPoolSize][3];
+  for (int i = 0; i < kOuiPoolSize; ++i) {
+    uint64_t r = random_.Next();
+    // Globally administered, unicast.
+    ouis[i][0] = static_cast<unsigned char>(r) & 0xFC;
+    ouis[i][1] = static_cast<unsigned char>(r >> 8);
+    ouis[i][2] = static_cast<unsigned char>(r >> 16);
+  }
+  const uint32_t nic_salt = static_cast<uint32_t>(random_.Next());
+  const int ssid_count = options_.access_point_count / kBssidsPerSsid + 1;
+
+  aps_.resize(options_.access_point_count);
+  for (int i = 0; i < options_.access_point_count; ++i) {
+    SimulatedAccessPoint& ap = aps_[i];
+    const unsigned char* oui = ouis[random_.Next() % kOuiPoolSize];
+    // An odd multiplier is a bijection mod 2^24, so NIC parts are unique.
+    uint32_t nic = (static_cast<uint32_t>(i) * 0x9E3779u + nic_salt) & 0xFFFFFF;
+    ap.mac[0] = oui[0];
+    ap.mac[1] = oui[1];
+    ap.mac[2] = oui[2];
+    ap.mac[3] = static_cast<unsigned char>(nic >> 16);
+    ap.mac[4] = static_cast<unsigned char>(nic >> 8);
+    ap.mac[5] = static_cast<unsigned char>(nic);
+    ap.mac_address = MacAddressAsString(ap.mac);
+
+    char ssid[32];
+    sprintf(ssid, "sim-%d", static_cast<int>(random_.Next() % ssid_count));
+    ap.ssid = ssid;
+
+    ap.x = static_cast<float>(random_.NextDouble() * options_.width_m);
+    ap.y = static_cast<float>(random_.NextDouble() * options_.height_m);
+
+    int channel;
+    if (random_.NextDouble() < 0.7) {
+      channel = kChannels24[random_.Next() % (sizeof(kChannels24) / sizeof(int))];
+    } else {
+      channel = kChannels5[random_.Next() % (sizeof(kChannels5) / sizeof(int))];
+    }
+    ap.frequency_khz = ChannelToFrequencyKhz(channel);
+
+    double pick = random_.NextDouble();
+    int security = 0;
+    while (security < SIM_SECURITY_COUNT - 1 && pick >= kSecurityShare[security]) {
+      pick -= kSecurityShare[security];
+      ++security;
+    }
+    ap.security = static_cast<SimulatedSecurity>(security);
+    // A quarter of the APs also carry an IE of their chipset vendor.
+    const unsigned char* extra_vendor = (random_.Next() & 3) == 0 ? oui : NULL;
+    BuildIes(ap.ssid, ap.security, extra_vendor, ap.ies);
+    ap.active = true;
+  }
+
+  receiver_x_ = random_.NextDouble() * options_.width_m;
+  receiver_y_ = random_.NextDouble() * options_.height_m;
+  waypoint_x_ = receiver_x_;
+  waypoint_y_ = receiver_y_;
+
+  double margin_db = options_.rssi_at_1m_dbm - options_.sensitivity_dbm +
+                     3.0 * options_.noise_stddev_db;
+  double max_range = pow(10.0, margin_db / (10.0 * options_.path_loss_exponent));
+  max_range_sq_ = static_cast<float>(max_range * max_range);
+
+  ComputeVisible();
+}
+
+void RadioEnvironmentGenerator::Step() {
+  MoveReceiver();
+  UpdateActivity();
+  ComputeVisible();
+  ++scan_count_;
+}
+
+void RadioEnvironmentGenerator::MoveReceiver() {
+  double remaining = options_.receiver_speed_mps * options_.scan_interval_s;
+  while (remaining > 0) {
+    double dx = waypoint_x_ - receiver_x_;
+    double dy = waypoint_y_ - receiver_y_;
+    double distance = sqrt(dx * dx + dy * dy);
+    if (distance <= remaining) {
+      receiver_x_ = waypoint_x_;
+      receiver_y_ = waypoint_y_;
+      remaining -= distance;
+      waypoint_x_ = random_.NextDouble() * options_.width_m;
+      waypoint_y_ = random_.NextDouble() * options_.height_m;
+    } else {
+      receiver_x_ += dx / distance * remaining;
+      receiver_y_ += dy / distance * remaining;
+      remaining = 0;
+    }
+  }
+}
+
+void RadioEnvironmentGenerator::UpdateActivity() {
+  if (options_.appear_probability <= 0 && options_.disappear_probability <= 0) {
+    return;
+  }
+  // Compare raw 64-bit draws against precomputed thresholds; this runs for
+  // every AP on every scan.
+  const uint64_t appear = ProbabilityThreshold(options_.appear_probability);
+  const uint64_t disappear = ProbabilityThreshold(options_.disappear_probability);
+  for (size_t i = 0; i < aps_.size(); ++i) {
+    uint64_t r = random_.Next();
+    if (aps_[i].active ? r < disappear : r < appear) {
+      aps_[i].active = !aps_[i].active;
+    }
+  }
+}
+
+void RadioEnvironmentGenerator::ComputeVisible() {
+  visible_.clear();
+  const float rx = static_cast<float>(receiver_x_);
+  const float ry = static_cast<float>(receiver_y_);
+  const float p0 = static_cast<float>(options_.rssi_at_1m_dbm);
+  // 10 * n * log10(d) == 5 * n * log10(2) * log2(d^2)
+  const float k = static_cast<float>(5.0 * options_.path_loss_exponent * 0.30102999566);
+  const float sigma = static_cast<float>(options_.noise_stddev_db);
+  const int sensitivity = options_.sensitivity_dbm;
+
+  for (size_t i = 0; i < aps_.size(); ++i) {
+    const SimulatedAccessPoint& ap = aps_[i];
+    if (!ap.active) {
+      continue;
+    }
+    float dx = ap.x - rx;
+    float dy = ap.y - ry;
+    float d2 = dx * dx + dy * dy;
+    if (d2 > max_range_sq_) {
+      continue;
+    }
+    if (d2 < 1.0f) {
+      d2 = 1.0f;
+    }
+    float rssi = p0 - k * FastLog2(d2) + sigma * random_.NextGaussian();
+    int rounded = static_cast<int>(floorf(rssi + 0.5f));
+    if (rounded < sensitivity) {
+      continue;
+    }
+    VisibleEntry entry = { static_cast<uint32_t>(i), rounded };
+    visible_.push_back(entry);
+  }
+}
+
+void RadioEnvironmentGenerator::GetAccessPoints(std::vector<AccessPoint>& outData) const {
+  outData.resize(visible_.size());
+  for (size_t i = 0; i < visible_.size(); ++i) {
+    const SimulatedAccessPoint& ap = aps_[visible_[i].index];
+    outData[i].mac_address = ap.mac_address;
+    outData[i].radio_signal_strength = visible_[i].rssi;
+    outData[i].ssid = ap.ssid;
+  }
+}
+
+void RadioEnvironmentGenerator::GetBssIdList(std::vector<char>& outBuffer) const {
+  const size_t header = offsetof(NDIS_802_11_BSSID_LIST, Bssid);
+  const size_t ie_header = offsetof(NDIS_WLAN_BSSID_EX, IEs);
+  size_t size = header;
+  for (size_t i = 0; i < visible_.size(); ++i) {
+    size += RecordLength(aps_[visible_[i].index]);
+  }
+  outBuffer.assign(size < sizeof(NDIS_802_11_BSSID_LIST) ? sizeof(NDIS_802_11_BSSID_LIST) : size, 0);
+
+  NDIS_802_11_BSSID_LIST* list = reinterpret_cast<NDIS_802_11_BSSID_LIST*>(&outBuffer[0]);
+  list->NumberOfItems = static_cast<ULONG>(visible_.size());
+  char* record = &outBuffer[header];
+  for (size_t i = 0; i < visible_.size(); ++i) {
+    const SimulatedAccessPoint& ap = aps_[visible_[i].index];
+    // NDIS_WLAN_BSSID is a prefix of NDIS_WLAN_BSSID_EX up to SupportedRates,
+    // which is only longer in the latter.
+    NDIS_WLAN_BSSID_EX* entry = reinterpret_cast<NDIS_WLAN_BSSID_EX*>(record);
+    entry->Length = static_cast<ULONG>(RecordLength(ap));
+    memcpy(entry->MacAddress, ap.mac, sizeof(ap.mac));
+    entry->Ssid.SsidLength = static_cast<ULONG>(ap.ssid.size());
+    memcpy(entry->Ssid.Ssid, ap.ssid.data(), ap.ssid.size());
+    entry->Privacy = ap.security != SIM_SECURITY_OPEN;
+    entry->Rssi = visible_[i].rssi;
+    entry->NetworkTypeInUse = ap.frequency_khz < 3000000 ? Ndis802_11DS : Ndis802_11OFDM5;
+    entry->Configuration.Length = sizeof(NDIS_802_11_CONFIGURATION);
+    entry->Configuration.DSConfig = ap.frequency_khz;
+    entry->InfrastructureMode = Ndis802_11Infrastructure;
+    if (options_.include_ies) {
+      entry->IELength = static_cast<ULONG>(sizeof(NDIS_802_11_FIXED_IEs) + ap.ies.size());
+      NDIS_802_11_FIXED_IEs fixed;
+      memset(&fixed, 0, sizeof(fixed));
+      fixed.BeaconInterval = 100;
+      fixed.Capabilities = kCapabilityEss | (entry->Privacy ? kCapabilityPrivacy : 0);
+      memcpy(record + ie_header, &fixed, sizeof(fixed));
+      if (!ap.ies.empty()) {
+        memcpy(record + ie_header + sizeof(fixed), &ap.ies[0], ap.ies.size());
+      }
+    }
+    record += entry->Length;
+  }
+}
+
+size_t RadioEnvironmentGenerator::RecordLength(const SimulatedAccessPoint& ap) const {
+  if (!options_.include_ies) {
+    return sizeof(NDIS_WLAN_BSSID);
+  }
+  size_t length = offsetof(NDIS_WLAN_BSSID_EX, IEs) + sizeof(NDIS_802_11_FIXED_IEs) +
+                  ap.ies.size();
+  return (length + kRecordAlignment - 1) & ~(kRecordAlignment - 1);
+}
+
+bool RadioEnvironmentGenerator::QueryBssIdLists(std::vector<std::vector<char> >& outLists) {
+  Step();
+  outLists.push_back(std::vector<char>());
+  GetBssIdList(outLists.back());
+  return true;
+}
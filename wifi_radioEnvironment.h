@@ -0,0 +1,136 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "wifi_accessPoint.h"
+#include "wifi_scanPipeline.h"
+
+// Small, fast PRNG (xorshift128+) so generated scans are identical on every
+// platform and standard library for a given seed.
+class RadioRandom {
+public:
+  explicit RadioRandom(uint64_t seed);
+  uint64_t Next();
+  // Uniform in [0, 1).
+  double NextDouble();
+  // Standard normal, drawn from a precomputed table.
+  float NextGaussian();
+
+private:
+  uint64_t s0_;
+  uint64_t s1_;
+};
+
+struct RadioEnvironmentOptions {
+  RadioEnvironmentOptions();
+
+  uint64_t seed;
+  int access_point_count;
+  // Size of the area the APs are scattered over, in metres.
+  double width_m;
+  double height_m;
+  // Log-distance path loss: rssi = rssi_at_1m - 10 * exponent * log10(d).
+  double rssi_at_1m_dbm;
+  double path_loss_exponent;
+  double noise_stddev_db;
+  // APs weaker than this are not reported.
+  int sensitivity_dbm;
+  // The receiver walks between random waypoints at this speed.
+  double receiver_speed_mps;
+  double scan_interval_s;
+  // Per-scan probability that an absent AP comes up / a present AP goes away.
+  double appear_probability;
+  double disappear_probability;
+  // Emit NDIS_WLAN_BSSID_EX records carrying each AP's IEs. Without it the
+  // list holds bare NDIS_WLAN_BSSID records, as older drivers return.
+  bool include_ies;
+};
+
+// Security configuration of a simulated AP, as advertised in its IEs.
+enum SimulatedSecurity {
+  SIM_SECURITY_OPEN = 0,
+  SIM_SECURITY_WPA2_PSK,
+  SIM_SECURITY_WPA2_ENTERPRISE,
+  SIM_SECURITY_WPA3_SAE,
+  // WPA1 TKIP vendor IE alongside an RSN IE.
+  SIM_SECURITY_WPA_WPA2_MIXED,
+  SIM_SECURITY_COUNT
+};
+
+// Deterministic generator of scan sequences for load and scaling tests.
+// Each Step() advances time by one scan interval: the receiver moves, APs
+// appear or disappear and RSSIs are recomputed with fresh noise. The current
+// scan can then be read as AccessPoint records or as a raw
+// OID_802_11_BSSID_LIST response, so both the parser and everything above it
+// can be driven without an adapter.
+//
+// A generator is not thread-safe. Run one per thread with different seeds to
+// generate in parallel.
+class RadioEnvironmentGenerator : public ScanSource {
+public:
+  explicit RadioEnvironmentGenerator(const RadioEnvironmentOptions& options);
+
+  void Step();
+
+  // Number of APs in the current scan.
+  size_t VisibleCount() const { return visible_.size(); }
+  // Replaces |outData| with the current scan.
+  void GetAccessPoints(std::vector<AccessPoint>& outData) const;
+  // Replaces |outBuffer| with the current scan as an NDIS_802_11_BSSID_LIST
+  // (of NDIS_WLAN_BSSID_EX records, if include_ies is set).
+  void GetBssIdList(std::vector<char>& outBuffer) const;
+
+  // ScanSource: steps and returns the new scan as a single interface's list.
+  virtual bool QueryBssIdLists(std::vector<std::vector<char> >& outLists);
+
+  double ReceiverX() const { return receiver_x_; }
+  double ReceiverY() const { return receiver_y_; }
+  uint64_t ScanCount() const { return scan_count_; }
+
+  // Ground truth for positioning tests.
+  struct SimulatedAccessPoint {
+    unsigned char mac[6];
+    std::string mac_address;
+    std::string ssid;
+    float x;
+    float y;
+    // Channel centre frequency in kHz, as reported in DSConfig.
+    uint32_t frequency_khz;
+    SimulatedSecurity security;
+    // Variable IEs as broadcast: SSID, RSN and vendor specific (WPA, WMM
+    // and sometimes a second vendor's).
+    std::vector<unsigned char> ies;
+    bool active;
+  };
+  const std::vector<SimulatedAccessPoint>& AccessPoints() const { return aps_; }
+
+private:
+  struct VisibleEntry {
+    uint32_t index;
+    int rssi;
+  };
+
+  void MoveReceiver();
+  void UpdateActivity();
+  void ComputeVisible();
+  size_t RecordLength(const SimulatedAccessPoint& ap) const;
+
+  RadioEnvironmentOptions options_;
+  RadioRandom random_;
+  std::vector<SimulatedAccessPoint> aps_;
+  std::vector<VisibleEntry> visible_;
+
+  double receiver_x_;
+  double receiver_y_;
+  double waypoint_x_;
+  double waypoint_y_;
+  // Squared distance beyond which an AP cannot be heard even with +3 sigma
+  // noise, so far APs are skipped without a log.
+  float max_range_sq_;
+  uint64_t scan_count_;
+};
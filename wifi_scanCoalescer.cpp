@@ -0,0 +1,175 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_scanCoalescer.h"
+#include <string.h>
+#include <algorithm>
+
+ScanCoalescer::ScanCoalescer(AccessPointQuery* query)
+    : query_(query),
+      in_flight_(false),
+      waiters_(0),
+      started_(0),
+      finished_(0),
+      budget_(NULL),
+      budget_id_(-1),
+      memory_generation_(0) {
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+ScanCoalescer::~ScanCoalescer() {
+  AttachMemoryBudget(NULL);
+}
+
+void ScanCoalescer::AttachMemoryBudget(MemoryBudget* budget) {
+  if (budget_) {
+    budget_->Unregister(budget_id_);
+  }
+  budget_ = budget;
+  budget_id_ = -1;
+  if (budget_) {
+    budget_id_ = budget_->Register("scan results", MemoryBudget::PRIORITY_RESULTS, this);
+    ReportMemory();
+  }
+}
+
+size_t ScanCoalescer::MemoryUsage() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return MemoryUsageLocked();
+}
+
+size_t ScanCoalescer::MemoryUsageLocked() const {
+  size_t bytes = 0;
+  if (latest_) {
+    bytes += sizeof(Result) + AccessPointsMemoryUsage(latest_->access_points);
+  }
+  if (last_finished_ && last_finished_ != latest_) {
+    bytes += sizeof(Result) + AccessPointsMemoryUsage(last_finished_->access_points);
+  }
+  return bytes;
+}
+
+// Reports from outside mutex_, since the report may reclaim and call back
+// into ReleaseMemory().
+void ScanCoalescer::ReportMemory() {
+  if (!budget_) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    uint64_t generation = memory_generation_;
+    size_t usage = MemoryUsageLocked();
+    lock.unlock();
+    budget_->Report(budget_id_, usage);
+    lock.lock();
+    if (generation == memory_generation_) {
+      break;
+    }
+  }
+}
+
+// Results cannot be trimmed piecemeal, so whatever |bytes| is, the cached
+// one goes.
+size_t ScanCoalescer::ReleaseMemory(size_t bytes) {
+  (void)bytes;
+  size_t released;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t before = MemoryUsageLocked();
+    latest_.reset();
+    if (!waiters_) {
+      last_finished_.reset();
+    }
+    ++memory_generation_;
+    released = before - MemoryUsageLocked();
+  }
+  ReportMemory();
+  return released;
+}
+
+std::shared_ptr<const ScanCoalescer::Result> ScanCoalescer::Request(
+    int64_t max_age_ms) {
+  const Clock::duration max_age = std::chrono::milliseconds(max_age_ms);
+  std::unique_lock<std::mutex> lock(mutex_);
+  ++stats_.requests;
+  while (true) {
+    Clock::time_point now = Clock::now();
+    if (latest_ && now - latest_->issued <= max_age) {
+      ++stats_.served_from_cache;
+      return latest_;
+    }
+    if (!in_flight_) {
+      break;
+    }
+    const uint64_t awaited = started_;
+    if (now - in_flight_issued_ <= max_age) {
+      ++stats_.joined_in_flight;
+      ++waiters_;
+      done_cv_.wait(lock, [this, awaited] { return finished_ >= awaited; });
+      --waiters_;
+      return last_finished_;
+    }
+    // The running query started too long ago to satisfy this caller; wait
+    // for it to finish, then start another unless someone else already has.
+    done_cv_.wait(lock, [this, awaited] { return finished_ >= awaited; });
+  }
+
+  std::shared_ptr<Result> result(new Result());
+  result->sequence = ++started_;
+  result->issued = Clock::now();
+  result->restored = false;
+  in_flight_ = true;
+  in_flight_issued_ = result->issued;
+  ++stats_.device_queries;
+  lock.unlock();
+
+  result->succeeded = query_->QueryAccessPoints(result->access_points);
+  if (!result->succeeded) {
+    result->access_points.clear();
+  }
+
+  lock.lock();
+  in_flight_ = false;
+  finished_ = result->sequence;
+  last_finished_ = result;
+  if (result->succeeded) {
+    latest_ = result;
+  } else {
+    ++stats_.failed_queries;
+  }
+  ++memory_generation_;
+  done_cv_.notify_all();
+  lock.unlock();
+  ReportMemory();
+  return result;
+}
+
+std::shared_ptr<const ScanCoalescer::Result> ScanCoalescer::Latest() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return latest_;
+}
+
+void ScanCoalescer::Restore(std::vector<AccessPoint>& access_points,
+                            int64_t age_ms) {
+  std::shared_ptr<Result> result(new Result());
+  result->sequence = 0;
+  result->issued = Clock::now() - std::chrono::milliseconds(std::max<int64_t>(0, age_ms));
+  result->succeeded = true;
+  result->restored = true;
+  result->access_points.swap(access_points);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (latest_ && !latest_->restored) {
+      return;
+    }
+    latest_ = result;
+    ++memory_generation_;
+  }
+  ReportMemory();
+}
+
+ScanCoalescer::Stats ScanCoalescer::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
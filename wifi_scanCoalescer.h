@@ -0,0 +1,114 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "wifi_accessPoint.h"
+#include "wifi_memoryBudget.h"
+
+// One full device query. WindowsNdisAccessPointQuery is the real one.
+class AccessPointQuery {
+public:
+  virtual ~AccessPointQuery() {}
+  // Fills |outData| with every interface's APs. Returns false if the query
+  // failed.
+  virtual bool QueryAccessPoints(std::vector<AccessPoint>& outData) = 0;
+};
+
+// Lets components that want scans at different cadences share device
+// queries. A caller asks for results no older than some age: a cached result
+// that young is returned at once, a query already in flight that started
+// recently enough is waited for, and only otherwise does the caller run a
+// new query itself, which everyone arriving meanwhile then shares.
+//
+// A result's age is measured from when its query was issued, since the
+// driver may report APs it saw any time during the query.
+class ScanCoalescer : private MemoryBudgetClient {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Result {
+    uint64_t sequence;
+    Clock::time_point issued;
+    bool succeeded;
+    // Loaded from a warm-start file rather than queried by this process.
+    bool restored;
+    std::vector<AccessPoint> access_points;
+  };
+
+  struct Stats {
+    uint64_t requests;
+    uint64_t served_from_cache;
+    uint64_t joined_in_flight;
+    uint64_t device_queries;
+    uint64_t failed_queries;
+  };
+
+  // Does not take ownership of |query|. Queries are never run concurrently.
+  explicit ScanCoalescer(AccessPointQuery* query);
+  ~ScanCoalescer();
+
+  // Accounts the results it holds against |budget| as PRIORITY_RESULTS.
+  // When the budget is short the cached result is dropped, so the next
+  // request queries the device; callers still holding it are unaffected.
+  // Call before sharing the coalescer between threads. NULL detaches.
+  void AttachMemoryBudget(MemoryBudget* budget);
+  // Estimated heap bytes of the results held; see AccessPointsMemoryUsage().
+  size_t MemoryUsage() const;
+
+  // Returns a result issued at most |max_age_ms| ago, blocking while one is
+  // obtained. If the query that would have provided it failed, the result
+  // has succeeded == false and no APs; Latest() still has the last good one.
+  std::shared_ptr<const Result> Request(int64_t max_age_ms);
+  // The last successful result, or NULL. Never blocks on a query. Also NULL
+  // after the memory budget had the cached result dropped.
+  std::shared_ptr<const Result> Latest() const;
+
+  // Installs a scan saved by a previous run, taken |age_ms| ago, so Latest()
+  // has something before the first query finishes. Takes the contents of
+  // |access_points|. Ignored once a query has succeeded. Request() treats it
+  // like any cached result, so only callers whose max age it meets get it.
+  void Restore(std::vector<AccessPoint>& access_points, int64_t age_ms);
+
+  Stats GetStats() const;
+
+private:
+  ScanCoalescer(const ScanCoalescer&);
+  ScanCoalescer& operator=(const ScanCoalescer&);
+
+  size_t MemoryUsageLocked() const;
+  void ReportMemory();
+
+  // MemoryBudgetClient:
+  size_t ReleaseMemory(size_t bytes);
+
+  AccessPointQuery* query_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable done_cv_;
+  std::shared_ptr<const Result> latest_;
+  // Result of the most recently finished query, successful or not.
+  std::shared_ptr<const Result> last_finished_;
+  bool in_flight_;
+  Clock::time_point in_flight_issued_;
+  // Callers waiting to be handed last_finished_, which must stay set for
+  // them.
+  int waiters_;
+  // Sequence numbers of the last query started and the last one finished.
+  uint64_t started_;
+  uint64_t finished_;
+  Stats stats_;
+
+  MemoryBudget* budget_;
+  int budget_id_;
+  // Bumped with mutex_ held whenever the results held change, so a report
+  // that raced with a newer one is made again.
+  uint64_t memory_generation_;
+};
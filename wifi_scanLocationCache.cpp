@@ -0,0 +1,279 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_scanLocationCache.h"
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
+namespace {
+// RSSI weighting: one copy per kRssiWeightStepDb above kRssiWeightFloorDbm,
+// capped at kMaxRssiWeight copies.
+const int kRssiWeightFloorDbm = -90;
+const int kRssiWeightStepDb = 15;
+const int kMaxRssiWeight = 4;
+
+uint64_t SplitMix64(uint64_t* state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+int RssiWeight(int rssi) {
+  int weight = 1 + (rssi - kRssiWeightFloorDbm) / kRssiWeightStepDb;
+  return std::max(1, std::min(kMaxRssiWeight, weight));
+}
+}  // namespace
+
+ScanLocationCache::Options::Options()
+    : bands(16),
+      rows_per_band(4),
+      similarity_threshold(0.6),
+      weight_by_rssi(false),
+      capacity(4096),
+      seed(0x10ca7e5ULL) {
+}
+
+ScanLocationCache::ScanLocationCache(const Options& options)
+    : options_(options),
+      signature_size_(options.bands * options.rows_per_band),
+      lookup_generation_(0) {
+  assert(signature_size_ > 0 && options_.capacity > 0);
+  memset(&stats_, 0, sizeof(stats_));
+  uint64_t state = options_.seed;
+  a_.resize(signature_size_);
+  b_.resize(signature_size_);
+  for (int j = 0; j < signature_size_; ++j) {
+    a_[j] = SplitMix64(&state) | 1;
+    b_[j] = SplitMix64(&state);
+  }
+}
+
+ScanLocationCache::~ScanLocationCache() {
+  AttachMemoryBudget(NULL);
+}
+
+void ScanLocationCache::AttachMemoryBudget(MemoryBudget* budget) {
+  AttachBudget(budget, "location cache", MemoryBudget::PRIORITY_CACHE);
+}
+
+size_t ScanLocationCache::MemoryUsage() const {
+  size_t bytes = entries_.capacity() * sizeof(Entry) +
+                 (free_entries_.capacity() + candidates_.capacity()) * sizeof(uint32_t) +
+                 candidate_marks_.capacity() * sizeof(uint64_t);
+  // Each cached place holds a signature, an LRU node and one id per band.
+  bytes += lru_.size() * (kMemoryNodeOverhead + sizeof(uint32_t) +
+                          (signature_size_ + options_.bands) * sizeof(uint32_t));
+  bytes += buckets_.size() * (kMemoryNodeOverhead + sizeof(uint64_t) +
+                              sizeof(std::vector<uint32_t>)) +
+           buckets_.bucket_count() * sizeof(void*);
+  return bytes;
+}
+
+bool ScanLocationCache::ComputeSignature(const std::vector<AccessPoint>& scan,
+                                         Signature* signature) const {
+  signature->assign(signature_size_, 0xFFFFFFFFu);
+  bool any = false;
+  for (size_t i = 0; i < scan.size(); ++i) {
+    PackedBssid bssid = ParseBssid(scan[i].mac_address);
+    if (bssid == kInvalidBssid) {
+      continue;
+    }
+    any = true;
+    int copies = options_.weight_by_rssi ? RssiWeight(scan[i].radio_signal_strength) : 1;
+    for (int copy = 0; copy < copies; ++copy) {
+      // The copy number lives above the 48 BSSID bits.
+      uint64_t x = HashBssid(bssid | (static_cast<uint64_t>(copy) << 48));
+      for (int j = 0; j < signature_size_; ++j) {
+        uint32_t h = static_cast<uint32_t>((x * a_[j] + b_[j]) >> 32);
+        if (h < (*signature)[j]) {
+          (*signature)[j] = h;
+        }
+      }
+    }
+  }
+  return any;
+}
+
+uint64_t ScanLocationCache::BandKey(const Signature& signature, int band) const {
+  uint64_t key = static_cast<uint64_t>(band) * 0x9E3779B97F4A7C15ULL;
+  const int begin = band * options_.rows_per_band;
+  for (int r = 0; r < options_.rows_per_band; ++r) {
+    key = (key ^ signature[begin + r]) * 0x100000001B3ULL;
+  }
+  return key;
+}
+
+bool ScanLocationCache::Lookup(const std::vector<AccessPoint>& scan,
+                               CachedPosition* position, double* similarity) {
+  Signature signature;
+  if (!ComputeSignature(scan, &signature)) {
+    ++stats_.lookups;
+    if (similarity) {
+      *similarity = 0;
+    }
+    return false;
+  }
+  return Lookup(signature, position, similarity);
+}
+
+bool ScanLocationCache::Lookup(const Signature& signature,
+                               CachedPosition* position, double* similarity) {
+  ClaimOwnership();
+  ++stats_.lookups;
+  if (similarity) {
+    *similarity = 0;
+  }
+  if (static_cast<int>(signature.size()) != signature_size_) {
+    return false;
+  }
+  ++lookup_generation_;
+  if (candidate_marks_.size() < entries_.size()) {
+    candidate_marks_.resize(entries_.size(), 0);
+  }
+
+  // Gather each cached place that shares at least one band, once.
+  candidates_.clear();
+  for (int band = 0; band < options_.bands; ++band) {
+    std::unordered_map<uint64_t, std::vector<uint32_t> >::const_iterator bucket =
+        buckets_.find(BandKey(signature, band));
+    if (bucket == buckets_.end()) {
+      continue;
+    }
+    for (size_t i = 0; i < bucket->second.size(); ++i) {
+      uint32_t id = bucket->second[i];
+      if (candidate_marks_[id] != lookup_generation_) {
+        candidate_marks_[id] = lookup_generation_;
+        candidates_.push_back(id);
+      }
+    }
+  }
+
+  double best = 0;
+  int best_id = -1;
+  for (size_t c = 0; c < candidates_.size(); ++c) {
+    const Signature& other = entries_[candidates_[c]].signature;
+    int equal = 0;
+    for (int j = 0; j < signature_size_; ++j) {
+      equal += signature[j] == other[j];
+    }
+    double estimate = static_cast<double>(equal) / signature_size_;
+    if (estimate > best) {
+      best = estimate;
+      best_id = static_cast<int>(candidates_[c]);
+    }
+  }
+  stats_.candidates_compared += candidates_.size();
+
+  if (similarity) {
+    *similarity = best;
+  }
+  if (best_id < 0 || best < options_.similarity_threshold) {
+    return false;
+  }
+  Entry& entry = entries_[best_id];
+  lru_.splice(lru_.begin(), lru_, entry.lru_position);
+  *position = entry.position;
+  ++stats_.hits;
+  return true;
+}
+
+void ScanLocationCache::Insert(const std::vector<AccessPoint>& scan,
+                               const CachedPosition& position) {
+  Signature signature;
+  if (ComputeSignature(scan, &signature)) {
+    Insert(signature, position);
+  }
+}
+
+void ScanLocationCache::Insert(const Signature& signature,
+                               const CachedPosition& position) {
+  ClaimOwnership();
+  if (static_cast<int>(signature.size()) != signature_size_) {
+    return;
+  }
+  if (lru_.size() >= options_.capacity) {
+    EvictLeastRecentlyUsed();
+  }
+
+  uint32_t id = AllocateEntry();
+  Entry& entry = entries_[id];
+  entry.signature = signature;
+  entry.position = position;
+  entry.in_use = true;
+  lru_.push_front(id);
+  entry.lru_position = lru_.begin();
+  AddToBuckets(id);
+  ReportMemory();
+}
+
+uint32_t ScanLocationCache::AllocateEntry() {
+  if (!free_entries_.empty()) {
+    uint32_t id = free_entries_.back();
+    free_entries_.pop_back();
+    return id;
+  }
+  entries_.push_back(Entry());
+  return static_cast<uint32_t>(entries_.size() - 1);
+}
+
+void ScanLocationCache::EvictLeastRecentlyUsed() {
+  uint32_t victim = lru_.back();
+  RemoveFromBuckets(victim);
+  lru_.pop_back();
+  entries_[victim].in_use = false;
+  free_entries_.push_back(victim);
+  ++stats_.evictions;
+}
+
+size_t ScanLocationCache::ReclaimableMemory() const {
+  return lru_.empty() ? 0 : MemoryUsage();
+}
+
+void ScanLocationCache::FreeMemory(size_t bytes) {
+  size_t before = MemoryUsage();
+  size_t per_entry = std::max<size_t>(1, before / std::max<size_t>(1, lru_.size()));
+  size_t evict = std::min(lru_.size(), (bytes + per_entry - 1) / per_entry);
+  for (size_t i = 0; i < evict; ++i) {
+    EvictLeastRecentlyUsed();
+    // Evicted slots keep their signature buffers for reuse; give them back.
+    Signature().swap(entries_[free_entries_.back()].signature);
+  }
+  if (lru_.empty()) {
+    // Nothing left to index; drop the arrays too.
+    std::vector<Entry>().swap(entries_);
+    std::vector<uint32_t>().swap(free_entries_);
+    std::vector<uint32_t>().swap(candidates_);
+    std::vector<uint64_t>().swap(candidate_marks_);
+    std::unordered_map<uint64_t, std::vector<uint32_t> >().swap(buckets_);
+  }
+}
+
+void ScanLocationCache::AddToBuckets(uint32_t id) {
+  const Signature& signature = entries_[id].signature;
+  for (int band = 0; band < options_.bands; ++band) {
+    buckets_[BandKey(signature, band)].push_back(id);
+  }
+}
+
+void ScanLocationCache::RemoveFromBuckets(uint32_t id) {
+  const Signature& signature = entries_[id].signature;
+  for (int band = 0; band < options_.bands; ++band) {
+    std::unordered_map<uint64_t, std::vector<uint32_t> >::iterator bucket =
+        buckets_.find(BandKey(signature, band));
+    if (bucket == buckets_.end()) {
+      continue;
+    }
+    std::vector<uint32_t>& ids = bucket->second;
+    std::vector<uint32_t>::iterator it = std::find(ids.begin(), ids.end(), id);
+    if (it != ids.end()) {
+      *it = ids.back();
+      ids.pop_back();
+    }
+    if (ids.empty()) {
+      buckets_.erase(bucket);
+    }
+  }
+}
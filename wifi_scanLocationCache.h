@@ -0,0 +1,125 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stdint.h>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include "wifi_accessPoint.h"
+#include "wifi_bssid.h"
+#include "wifi_memoryBudget.h"
+
+struct CachedPosition {
+  double latitude;
+  double longitude;
+  double accuracy_m;
+};
+
+// Location cache keyed by scan similarity rather than exact scan contents.
+//
+// Each scan's BSSID set is reduced to a MinHash signature; the fraction of
+// equal signature slots estimates the Jaccard similarity of two sets. With
+// |weight_by_rssi| strong APs are entered several times, which approximates
+// weighted Jaccard so that the nearby APs dominate. Signatures are split into
+// bands and each band is hashed into a bucket (LSH), so a lookup only
+// compares against entries sharing at least one band instead of every
+// cached place.
+class ScanLocationCache : private DeferredReleaseClient {
+public:
+  struct Options {
+    Options();
+    int bands;
+    int rows_per_band;
+    // Minimum estimated similarity for a cached position to be returned.
+    double similarity_threshold;
+    bool weight_by_rssi;
+    // Least recently used places are evicted past this many entries.
+    size_t capacity;
+    uint64_t seed;
+  };
+
+  struct Stats {
+    uint64_t lookups;
+    uint64_t hits;
+    uint64_t candidates_compared;
+    uint64_t evictions;
+  };
+
+  typedef std::vector<uint32_t> Signature;
+
+  explicit ScanLocationCache(const Options& options);
+  ~ScanLocationCache();
+
+  // Accounts the cache against |budget| as PRIORITY_CACHE, which evicts
+  // least recently used places when the budget is short. A reclaim on the
+  // thread using the cache evicts at once; one on another thread is served
+  // at the end of the next Insert(). NULL detaches.
+  void AttachMemoryBudget(MemoryBudget* budget);
+  // Estimated heap bytes held, ignoring allocator overhead.
+  size_t MemoryUsage() const;
+
+  // Returns false for an empty scan.
+  bool ComputeSignature(const std::vector<AccessPoint>& scan,
+                        Signature* signature) const;
+
+  // Returns true and fills |position| if a cached place is similar enough.
+  // |similarity| (optional) receives the best estimate found. A signature
+  // not computed with these Options (of the wrong size) never matches.
+  bool Lookup(const std::vector<AccessPoint>& scan, CachedPosition* position,
+              double* similarity);
+  bool Lookup(const Signature& signature, CachedPosition* position,
+              double* similarity);
+
+  // Caches |position| for |scan|, typically after a network lookup missed.
+  // A signature of the wrong size is ignored.
+  void Insert(const std::vector<AccessPoint>& scan, const CachedPosition& position);
+  void Insert(const Signature& signature, const CachedPosition& position);
+
+  size_t Size() const { return lru_.size(); }
+  // LSH buckets holding at least one cached place.
+  size_t BucketCount() const { return buckets_.size(); }
+  const Stats& GetStats() const { return stats_; }
+
+private:
+  struct Entry {
+    Signature signature;
+    CachedPosition position;
+    std::list<uint32_t>::iterator lru_position;
+    bool in_use;
+  };
+
+  uint64_t BandKey(const Signature& signature, int band) const;
+  void AddToBuckets(uint32_t id);
+  void RemoveFromBuckets(uint32_t id);
+  uint32_t AllocateEntry();
+  void EvictLeastRecentlyUsed();
+
+  // DeferredReleaseClient:
+  size_t ReclaimableMemory() const;
+  void FreeMemory(size_t bytes);
+
+  const Options options_;
+  const int signature_size_;
+  // Multiply-shift hash family: slot j hashes x as (x * a_[j] + b_[j]) >> 32.
+  std::vector<uint64_t> a_;
+  std::vector<uint64_t> b_;
+
+  std::vector<Entry> entries_;
+  std::vector<uint32_t> free_entries_;
+  // Most recently used first.
+  std::list<uint32_t> lru_;
+  std::unordered_map<uint64_t, std::vector<uint32_t> > buckets_;
+
+  // Scratch space reused across lookups.
+  std::vector<uint32_t> candidates_;
+  std::vector<uint64_t> candidate_marks_;
+  uint64_t lookup_generation_;
+
+  Stats stats_;
+
+  ScanLocationCache(const ScanLocationCache&);
+  ScanLocationCache& operator=(const ScanLocationCache&);
+};
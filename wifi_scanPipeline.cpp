@@ -0,0 +1,174 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_scanPipeline.h"
+#include "wifi_bssIdList.h"
+#include <assert.h>
+#include <chrono>
+#include <unordered_map>
+
+namespace {
+const size_t kDefaultQueueCapacity = 8;
+const int kDefaultPollingInterval = 10000;  // 10s
+}  // namespace
+
+ScanPipeline::Options::Options()
+    : queue_capacity(kDefaultQueueCapacity),
+      overflow_policy(BatchQueue::DROP_OLDEST),
+      polling_interval_ms(kDefaultPollingInterval),
+      max_scans(0) {
+}
+
+ScanPipeline::ScanPipeline(ScanSource* source,
+                           ScanPipelineListener* listener,
+                           const Options& options)
+    : source_(source),
+      listener_(listener),
+      options_(options),
+      stop_requested_(false),
+      scans_queried_(0),
+      scans_delivered_(0) {
+  assert(source_ && listener_);
+  for (int i = 0; i < STAGE_COUNT; ++i) {
+    queues_[i].reset(new BatchQueue(options_.queue_capacity,
+                                    options_.overflow_policy));
+    upstream_done_[i] = false;
+  }
+}
+
+ScanPipeline::~ScanPipeline() {
+  Stop();
+}
+
+void ScanPipeline::Start() {
+  assert(threads_.empty());
+  stop_requested_ = false;
+  for (int i = 0; i < STAGE_COUNT; ++i) {
+    upstream_done_[i] = false;
+  }
+  // Start consumers first so the first scan never waits on thread creation.
+  threads_.push_back(std::thread(&ScanPipeline::DeliverLoop, this));
+  threads_.push_back(std::thread(&ScanPipeline::FilterLoop, this));
+  threads_.push_back(std::thread(&ScanPipeline::ParseLoop, this));
+  threads_.push_back(std::thread(&ScanPipeline::QueryLoop, this));
+}
+
+void ScanPipeline::Stop() {
+  stop_requested_ = true;
+  WaitUntilIdle();
+}
+
+void ScanPipeline::WaitUntilIdle() {
+  if (!options_.max_scans && !stop_requested_.load()) {
+    return;
+  }
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    threads_[i].join();
+  }
+  threads_.clear();
+}
+
+SpscQueueStats ScanPipeline::GetQueueStats(Stage stage) const {
+  assert(stage >= 0 && stage < STAGE_COUNT);
+  return queues_[stage]->GetStats();
+}
+
+void ScanPipeline::QueryLoop() {
+  uint64_t sequence = 0;
+  while (!stop_requested_.load(std::memory_order_relaxed)) {
+    if (options_.max_scans && sequence >= options_.max_scans) {
+      break;
+    }
+
+    std::unique_ptr<ScanBatch> batch(new ScanBatch());
+    batch->sequence = sequence++;
+    batch->query_succeeded = source_->QueryBssIdLists(batch->bss_id_lists);
+    scans_queried_.fetch_add(1, std::memory_order_relaxed);
+    if (!queues_[STAGE_PARSE]->Push(std::move(batch), &stop_requested_)) {
+      break;
+    }
+
+    if (options_.polling_interval_ms > 0) {
+      // Sleep in short slices so Stop() is not held up by a long interval.
+      std::chrono::steady_clock::time_point wake =
+          std::chrono::steady_clock::now() +
+          std::chrono::milliseconds(options_.polling_interval_ms);
+      while (!stop_requested_.load(std::memory_order_relaxed) &&
+             std::chrono::steady_clock::now() < wake) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+  }
+  upstream_done_[STAGE_PARSE].store(true, std::memory_order_release);
+}
+
+void ScanPipeline::ParseLoop() {
+  std::unique_ptr<ScanBatch> batch;
+  while (queues_[STAGE_PARSE]->Pop(&batch, &upstream_done_[STAGE_PARSE])) {
+    ParseBatch(*batch);
+    queues_[STAGE_FILTER]->Push(std::move(batch), NULL);
+  }
+  upstream_done_[STAGE_FILTER].store(true, std::memory_order_release);
+}
+
+void ScanPipeline::FilterLoop() {
+  std::unique_ptr<ScanBatch> batch;
+  while (queues_[STAGE_FILTER]->Pop(&batch, &upstream_done_[STAGE_FILTER])) {
+    FilterBatch(*batch);
+    queues_[STAGE_DELIVER]->Push(std::move(batch), NULL);
+  }
+  upstream_done_[STAGE_DELIVER].store(true, std::memory_order_release);
+}
+
+void ScanPipeline::DeliverLoop() {
+  std::unique_ptr<ScanBatch> batch;
+  while (queues_[STAGE_DELIVER]->Pop(&batch, &upstream_done_[STAGE_DELIVER])) {
+    if (!batch->query_succeeded) {
+      listener_->OnScanError();
+    } else {
+      listener_->OnScanAvailable(*batch);
+    }
+    scans_delivered_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void ScanPipeline::ParseBatch(ScanBatch& batch) {
+  for (size_t i = 0; i < batch.bss_id_lists.size(); ++i) {
+    std::vector<char>& list = batch.bss_id_lists[i];
+    if (list.size() < sizeof(NDIS_802_11_BSSID_LIST)) {
+      continue;
+    }
+    const NDIS_802_11_BSSID_LIST* bssid_list =
+        reinterpret_cast<const NDIS_802_11_BSSID_LIST*>(&list[0]);
+    GetDataFromBssIdList(*bssid_list, static_cast<int>(list.size()),
+                         batch.access_points);
+  }
+  // The raw responses can be large; don't carry them further down the line.
+  std::vector<std::vector<char> >().swap(batch.bss_id_lists);
+}
+
+void ScanPipeline::FilterBatch(ScanBatch& batch) {
+  // An AP visible to several interfaces is reported once, with the strongest
+  // signal any interface saw.
+  std::vector<AccessPoint>& aps = batch.access_points;
+  std::unordered_map<std::string, size_t> seen;
+  seen.reserve(aps.size());
+  size_t kept = 0;
+  for (size_t i = 0; i < aps.size(); ++i) {
+    std::pair<std::unordered_map<std::string, size_t>::iterator, bool> inserted =
+        seen.insert(std::make_pair(aps[i].mac_address, kept));
+    if (!inserted.second) {
+      AccessPoint& existing = aps[inserted.first->second];
+      if (aps[i].radio_signal_strength > existing.radio_signal_strength) {
+        existing.radio_signal_strength = aps[i].radio_signal_strength;
+      }
+      continue;
+    }
+    if (kept != i) {
+      aps[kept] = std::move(aps[i]);
+    }
+    ++kept;
+  }
+  aps.resize(kept);
+}
@@ -0,0 +1,119 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "wifi_accessPoint.h"
+#include "wifi_spscQueue.h"
+
+// One scan as it moves through the pipeline. The query stage fills
+// |bss_id_lists| with one raw OID_802_11_BSSID_LIST response per interface,
+// the parse stage turns them into |access_points|, and the filter stage
+// removes duplicate BSSIDs seen by more than one interface. The raw lists are
+// released once parsed.
+struct ScanBatch {
+  uint64_t sequence;
+  bool query_succeeded;
+  std::vector<std::vector<char> > bss_id_lists;
+  std::vector<AccessPoint> access_points;
+};
+
+// Producer of raw scan data. WindowsNdisScanSource is the real implementation;
+// tests and benchmarks plug in synthetic ones.
+class ScanSource {
+public:
+  virtual ~ScanSource() {}
+  // Appends one raw BSSID list per interface to |outLists|. Returns false if
+  // every interface failed.
+  virtual bool QueryBssIdLists(std::vector<std::vector<char> >& outLists) = 0;
+};
+
+// Consumer of finished scans. Called on the delivery thread only.
+class ScanPipelineListener {
+public:
+  virtual ~ScanPipelineListener() {}
+  virtual void OnScanAvailable(const ScanBatch& batch) = 0;
+  virtual void OnScanError() {}
+};
+
+// Runs device query, parsing, filtering and listener delivery on separate
+// threads connected by bounded SPSC queues, so a slow listener no longer
+// delays the next device query.
+//
+//   query -> [parse queue] -> parse -> [filter queue] -> filter
+//         -> [delivery queue] -> deliver
+class ScanPipeline {
+public:
+  typedef SpscQueue<ScanBatch> BatchQueue;
+
+  enum Stage {
+    STAGE_PARSE = 0,
+    STAGE_FILTER,
+    STAGE_DELIVER,
+    STAGE_COUNT
+  };
+
+  struct Options {
+    Options();
+    size_t queue_capacity;
+    // BACKPRESSURE slows the query stage down to the pace of the slowest
+    // consumer; DROP_OLDEST keeps querying and discards stale scans instead.
+    BatchQueue::OverflowPolicy overflow_policy;
+    // Delay between the end of one device query and the start of the next.
+    int polling_interval_ms;
+    // Stop after this many scans have been queried; 0 means run until Stop().
+    uint64_t max_scans;
+  };
+
+  // Neither |source| nor |listener| is owned; both must outlive the pipeline.
+  ScanPipeline(ScanSource* source, ScanPipelineListener* listener,
+               const Options& options);
+  ~ScanPipeline();
+
+  void Start();
+  // Stops querying, lets queued scans drain through to the listener and joins
+  // the stage threads.
+  void Stop();
+  // Blocks until the query stage has reached Options::max_scans and every
+  // queued scan has been delivered. Without max_scans the pipeline only
+  // finishes on Stop(), so this returns at once.
+  void WaitUntilIdle();
+
+  // Queue statistics for the queue feeding |stage|.
+  SpscQueueStats GetQueueStats(Stage stage) const;
+  uint64_t ScansQueried() const { return scans_queried_.load(); }
+  uint64_t ScansDelivered() const { return scans_delivered_.load(); }
+
+private:
+  void QueryLoop();
+  void ParseLoop();
+  void FilterLoop();
+  void DeliverLoop();
+
+  static void ParseBatch(ScanBatch& batch);
+  static void FilterBatch(ScanBatch& batch);
+
+  ScanPipeline(const ScanPipeline&);
+  ScanPipeline& operator=(const ScanPipeline&);
+
+  ScanSource* source_;
+  ScanPipelineListener* listener_;
+  const Options options_;
+
+  std::unique_ptr<BatchQueue> queues_[STAGE_COUNT];
+  std::atomic<bool> stop_requested_;
+  // Raised when the stage feeding queues_[stage] has exited. Each stage exits
+  // once that is set and its input queue has drained.
+  std::atomic<bool> upstream_done_[STAGE_COUNT];
+  std::vector<std::thread> threads_;
+
+  std::atomic<uint64_t> scans_queried_;
+  std::atomic<uint64_t> scans_delivered_;
+};
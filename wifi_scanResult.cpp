@@ -0,0 +1,167 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_scanResult.h"
+#include <algorithm>
+
+namespace {
+// The first Strongest() call sorts at least this much of the RSSI order, and
+// later calls at least double it, so small growing requests stay cheap.
+const size_t kMinRssiPrefix = 8;
+
+uint64_t HashSsid(const std::string& ssid) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < ssid.size(); ++i) {
+    hash = (hash ^ static_cast<unsigned char>(ssid[i])) * 1099511628211ULL;
+  }
+  return hash;
+}
+}  // namespace
+
+ScanResult::ScanResult(std::vector<AccessPoint>& access_points,
+                       const BssIdListIndex* index)
+    : rssi_sorted_(0) {
+  access_points_.swap(access_points);
+  const size_t count = access_points_.size();
+  bands_.resize(count, BAND_UNKNOWN);
+  channels_.resize(count, 0);
+  if (index) {
+    for (size_t i = 0; i < count && i < index->Count(); ++i) {
+      uint32_t frequency = index->FrequencyKhz(i);
+      bands_[i] = static_cast<uint8_t>(FrequencyToBand(frequency));
+      int channel = FrequencyToChannel(frequency);
+      channels_[i] = static_cast<uint8_t>(channel < kChannelsPerBand ? channel : 0);
+    }
+  }
+}
+
+size_t ScanResult::MemoryUsage() const {
+  const size_t count = access_points_.size();
+  size_t rssi_index = count * sizeof(uint32_t);
+  size_t ssid_index = count * (sizeof(uint64_t) + sizeof(uint32_t));
+  size_t channel_index = (BAND_COUNT * kChannelsPerBand + 1 + count) * sizeof(uint32_t);
+  return sizeof(*this) + AccessPointsMemoryUsage(access_points_) +
+         bands_.capacity() + channels_.capacity() + rssi_index + ssid_index +
+         channel_index;
+}
+
+const uint32_t* ScanResult::Strongest(size_t n, size_t* count) const {
+  const size_t size = access_points_.size();
+  const size_t wanted = std::min(n, size);
+  *count = wanted;
+  if (!wanted) {
+    return NULL;
+  }
+  if (rssi_sorted_.load(std::memory_order_acquire) < wanted) {
+    std::lock_guard<std::mutex> lock(rssi_mutex_);
+    size_t sorted = rssi_sorted_.load(std::memory_order_relaxed);
+    if (sorted < wanted) {
+      if (rssi_order_.empty()) {
+        rssi_order_.resize(size);
+        for (size_t i = 0; i < size; ++i) {
+          rssi_order_[i] = static_cast<uint32_t>(i);
+        }
+      }
+      size_t target = std::min(size, std::max(wanted, std::max(sorted * 2, kMinRssiPrefix)));
+      const std::vector<AccessPoint>& aps = access_points_;
+      // Readers only look at [0, sorted), which this leaves alone.
+      std::partial_sort(rssi_order_.begin() + sorted, rssi_order_.begin() + target,
+                        rssi_order_.end(), [&aps](uint32_t a, uint32_t b) {
+                          if (aps[a].radio_signal_strength != aps[b].radio_signal_strength) {
+                            return aps[a].radio_signal_strength > aps[b].radio_signal_strength;
+                          }
+                          return a < b;
+                        });
+      rssi_sorted_.store(target, std::memory_order_release);
+    }
+  }
+  return &rssi_order_[0];
+}
+
+void ScanResult::BuildSsidIndex() const {
+  // Ordering by hash first keeps most comparisons to integers; SSIDs only
+  // get compared when hashes are equal, which is almost always because the
+  // SSIDs are.
+  ssid_hashes_.resize(access_points_.size());
+  ssid_entries_.resize(access_points_.size());
+  for (size_t i = 0; i < access_points_.size(); ++i) {
+    ssid_hashes_[i] = HashSsid(access_points_[i].ssid);
+    ssid_entries_[i] = static_cast<uint32_t>(i);
+  }
+  const std::vector<AccessPoint>& aps = access_points_;
+  const std::vector<uint64_t>& hashes = ssid_hashes_;
+  std::sort(ssid_entries_.begin(), ssid_entries_.end(),
+            [&aps, &hashes](uint32_t a, uint32_t b) {
+              if (hashes[a] != hashes[b]) {
+                return hashes[a] < hashes[b];
+              }
+              int order = aps[a].ssid.compare(aps[b].ssid);
+              return order ? order < 0 : a < b;
+            });
+}
+
+const uint32_t* ScanResult::WithSsid(const std::string& ssid, size_t* count) const {
+  std::call_once(ssid_once_, &ScanResult::BuildSsidIndex, this);
+  const std::vector<AccessPoint>& aps = access_points_;
+  const std::vector<uint64_t>& hashes = ssid_hashes_;
+  const std::vector<uint32_t>& entries = ssid_entries_;
+  const uint64_t hash = HashSsid(ssid);
+  std::vector<uint32_t>::const_iterator begin = std::lower_bound(
+      entries.begin(), entries.end(), ssid,
+      [&](uint32_t entry, const std::string& value) {
+        if (hashes[entry] != hash) {
+          return hashes[entry] < hash;
+        }
+        return aps[entry].ssid < value;
+      });
+  std::vector<uint32_t>::const_iterator end = begin;
+  while (end != entries.end() && hashes[*end] == hash && aps[*end].ssid == ssid) {
+    ++end;
+  }
+  *count = end - begin;
+  return *count ? &*begin : NULL;
+}
+
+void ScanResult::BuildChannelIndex() const {
+  // Counting sort on band * kChannelsPerBand + channel.
+  const size_t buckets = BAND_COUNT * kChannelsPerBand;
+  channel_offsets_.assign(buckets + 1, 0);
+  for (size_t i = 0; i < access_points_.size(); ++i) {
+    ++channel_offsets_[bands_[i] * kChannelsPerBand + channels_[i] + 1];
+  }
+  for (size_t b = 0; b < buckets; ++b) {
+    channel_offsets_[b + 1] += channel_offsets_[b];
+  }
+  channel_entries_.resize(access_points_.size());
+  std::vector<uint32_t> next(channel_offsets_.begin(), channel_offsets_.end() - 1);
+  for (size_t i = 0; i < access_points_.size(); ++i) {
+    channel_entries_[next[bands_[i] * kChannelsPerBand + channels_[i]]++] =
+        static_cast<uint32_t>(i);
+  }
+}
+
+const uint32_t* ScanResult::OnChannel(WifiBand band, int channel,
+                                      size_t* count) const {
+  *count = 0;
+  if (band < 0 || band >= BAND_COUNT || channel < 0 || channel >= kChannelsPerBand) {
+    return NULL;
+  }
+  std::call_once(channel_once_, &ScanResult::BuildChannelIndex, this);
+  size_t bucket = band * kChannelsPerBand + channel;
+  *count = channel_offsets_[bucket + 1] - channel_offsets_[bucket];
+  return *count ? &channel_entries_[channel_offsets_[bucket]] : NULL;
+}
+
+const uint32_t* ScanResult::OnBand(WifiBand band, size_t* count) const {
+  *count = 0;
+  if (band < 0 || band >= BAND_COUNT) {
+    return NULL;
+  }
+  std::call_once(channel_once_, &ScanResult::BuildChannelIndex, this);
+  // A band's channel buckets are contiguous; within the band the entries are
+  // ordered by channel, then scan order.
+  size_t first = band * kChannelsPerBand;
+  *count = channel_offsets_[first + kChannelsPerBand] - channel_offsets_[first];
+  return *count ? &channel_entries_[channel_offsets_[first]] : NULL;
+}
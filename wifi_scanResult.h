@@ -0,0 +1,86 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "wifi_accessPoint.h"
+#include "wifi_bssIdListIndex.h"
+
+// One immutable scan plus secondary indexes that are built on first use and
+// then shared by every reader, so callers stop sorting or searching the AP
+// vector themselves. Share it as std::shared_ptr<const ScanResult>; all
+// queries are thread-safe. Building an index costs a few linear passes, so
+// this pays off once a scan gets more than a couple of queries (see
+// tests/scanResult_bench); a lone query is cheaper done by hand.
+//
+// Query results are entry indexes into AccessPoints(), valid for the
+// lifetime of the ScanResult.
+class ScanResult {
+public:
+  // Takes the contents of |access_points|. If |index| is non-NULL it must be
+  // the BssIdListIndex that produced them (entry i describing AP i) and
+  // supplies frequencies for the channel and band queries; otherwise every
+  // AP is on BAND_UNKNOWN, channel 0.
+  ScanResult(std::vector<AccessPoint>& access_points, const BssIdListIndex* index);
+
+  const std::vector<AccessPoint>& AccessPoints() const { return access_points_; }
+  size_t Size() const { return access_points_.size(); }
+
+  // Estimated heap bytes, counting every index as built so the figure does
+  // not change as readers build them. A ScanResult cannot give memory back;
+  // whoever holds it reports this to a MemoryBudget and drops it when asked.
+  size_t MemoryUsage() const;
+
+  // The |n| strongest APs, strongest first; fewer if the scan is smaller.
+  // Only as much of the RSSI order as has been asked for is sorted.
+  const uint32_t* Strongest(size_t n, size_t* count) const;
+
+  // Every AP broadcasting |ssid|, in scan order. NULL if none.
+  const uint32_t* WithSsid(const std::string& ssid, size_t* count) const;
+
+  // APs on |channel| of |band|, in scan order. NULL if none.
+  const uint32_t* OnChannel(WifiBand band, int channel, size_t* count) const;
+  // APs on |band|, by channel and then scan order. NULL if none.
+  const uint32_t* OnBand(WifiBand band, size_t* count) const;
+
+  int Channel(size_t i) const { return channels_[i]; }
+  WifiBand Band(size_t i) const { return static_cast<WifiBand>(bands_[i]); }
+
+private:
+  // Channel numbers stay below this in every band.
+  static const int kChannelsPerBand = 256;
+
+  void BuildSsidIndex() const;
+  void BuildChannelIndex() const;
+
+  ScanResult(const ScanResult&);
+  ScanResult& operator=(const ScanResult&);
+
+  std::vector<AccessPoint> access_points_;
+  std::vector<uint8_t> bands_;
+  std::vector<uint8_t> channels_;
+
+  // Entries by descending RSSI; the first |rssi_sorted_| are final and the
+  // rest are only known to be weaker.
+  mutable std::mutex rssi_mutex_;
+  mutable std::vector<uint32_t> rssi_order_;
+  mutable std::atomic<size_t> rssi_sorted_;
+
+  // Entries ordered by SSID hash, SSID and scan order, so each SSID's
+  // entries are contiguous and found by binary search.
+  mutable std::once_flag ssid_once_;
+  mutable std::vector<uint64_t> ssid_hashes_;
+  mutable std::vector<uint32_t> ssid_entries_;
+
+  // Entries bucketed by band * kChannelsPerBand + channel; bucket b is
+  // channel_entries_[channel_offsets_[b], channel_offsets_[b + 1]).
+  mutable std::once_flag channel_once_;
+  mutable std::vector<uint32_t> channel_offsets_;
+  mutable std::vector<uint32_t> channel_entries_;
+};
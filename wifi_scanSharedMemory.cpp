@@ -0,0 +1,320 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_scanSharedMemory.h"
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include "wifi_bssid.h"
+
+#if defined(XP_WIN) || defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+const uint32_t kRegionMagic = 0x4D485357;  // "WSHM"
+const uint32_t kRegionVersion = 1;
+// Spins on a busy region before yielding the rest of the time slice.
+const int kSpinsBeforeYield = 64;
+// A writer rewrites the records in microseconds; a region busy for this long
+// belongs to a writer that died or hung mid-update.
+const int kBusyTimeoutMs = 250;
+
+size_t RegionSize(uint32_t capacity) {
+  return sizeof(SharedScanRegion) +
+         (std::max<uint32_t>(capacity, 1) - 1) * sizeof(SharedScanRecord);
+}
+
+// Backs off while the writer is updating the region: spins, then yields,
+// and gives up once the region has been busy for kBusyTimeoutMs.
+class BusyBackoff {
+public:
+  BusyBackoff() : spins_(0), yielded_(false) {}
+
+  // Returns false when the reader should stop retrying.
+  bool Wait() {
+    if (++spins_ < kSpinsBeforeYield) {
+      return true;
+    }
+    spins_ = 0;
+    std::this_thread::yield();
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (!yielded_) {
+      yielded_ = true;
+      deadline_ = now + std::chrono::milliseconds(kBusyTimeoutMs);
+    }
+    return now < deadline_;
+  }
+
+private:
+  int spins_;
+  bool yielded_;
+  std::chrono::steady_clock::time_point deadline_;
+};
+
+void* MapRegion(const std::string& name, size_t size, bool create, void** handle,
+                size_t* mapped_size) {
+  *handle = NULL;
+#if defined(XP_WIN) || defined(_WIN32)
+  HANDLE mapping;
+  if (create) {
+    mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0,
+                                 static_cast<DWORD>(size), name.c_str());
+  } else {
+    mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+  }
+  if (!mapping) {
+    return NULL;
+  }
+  void* view = MapViewOfFile(mapping, create ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ,
+                             0, 0, create ? size : 0);
+  if (!view) {
+    CloseHandle(mapping);
+    return NULL;
+  }
+  if (!create) {
+    MEMORY_BASIC_INFORMATION info;
+    if (!VirtualQuery(view, &info, sizeof(info))) {
+      UnmapViewOfFile(view);
+      CloseHandle(mapping);
+      return NULL;
+    }
+    size = info.RegionSize;
+  }
+  *handle = mapping;
+  *mapped_size = size;
+  return view;
+#else
+  int fd = create ? shm_open(name.c_str(), O_CREAT | O_RDWR, 0644)
+                  : shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return NULL;
+  }
+  if (create) {
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+      close(fd);
+      return NULL;
+    }
+  } else {
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+      close(fd);
+      return NULL;
+    }
+    size = static_cast<size_t>(info.st_size);
+  }
+  void* view = mmap(NULL, size, create ? PROT_READ | PROT_WRITE : PROT_READ,
+                    MAP_SHARED, fd, 0);
+  // The mapping keeps the object alive; the descriptor is not needed.
+  close(fd);
+  if (view == MAP_FAILED) {
+    return NULL;
+  }
+  *mapped_size = size;
+  return view;
+#endif
+}
+
+void UnmapRegion(const void* view, size_t size, void* handle) {
+#if defined(XP_WIN) || defined(_WIN32)
+  (void)size;
+  UnmapViewOfFile(view);
+  CloseHandle(handle);
+#else
+  (void)handle;
+  munmap(const_cast<void*>(view), size);
+#endif
+}
+}  // namespace
+
+// SharedScanWriter
+
+SharedScanWriter::SharedScanWriter()
+    : region_(NULL),
+      region_size_(0),
+      handle_(NULL),
+      capacity_(0) {
+}
+
+SharedScanWriter::~SharedScanWriter() {
+  Close();
+}
+
+bool SharedScanWriter::Create(const std::string& name, uint32_t capacity) {
+  Close();
+  void* view = MapRegion(name, RegionSize(capacity), true, &handle_, &region_size_);
+  if (!view) {
+    return false;
+  }
+  name_ = name;
+  region_ = static_cast<SharedScanRegion*>(view);
+  capacity_ = capacity;
+  // A region taken over from an earlier writer may have a stale header;
+  // readers ignore it until the magic is written last.
+  region_->magic = 0;
+  region_->version = kRegionVersion;
+  region_->capacity = capacity;
+  region_->scan_number = 0;
+  region_->timestamp_ms = 0;
+  region_->count = 0;
+  region_->total_count = 0;
+  region_->sequence.store(region_->sequence.load() & ~1u, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  region_->magic = kRegionMagic;
+  return true;
+}
+
+void SharedScanWriter::Close() {
+  if (!region_) {
+    return;
+  }
+  UnmapRegion(region_, region_size_, handle_);
+#if !defined(XP_WIN) && !defined(_WIN32)
+  // Readers that already mapped the region keep their mapping.
+  shm_unlink(name_.c_str());
+#endif
+  region_ = NULL;
+  handle_ = NULL;
+}
+
+void SharedScanWriter::Publish(const std::vector<AccessPoint>& accessPoints,
+                               int64_t timestamp_ms) {
+  if (!region_) {
+    return;
+  }
+  staging_.clear();
+  for (size_t i = 0; i < accessPoints.size() && staging_.size() < capacity_; ++i) {
+    PackedBssid bssid = ParseBssid(accessPoints[i].mac_address);
+    if (bssid == kInvalidBssid) {
+      continue;
+    }
+    SharedScanRecord record;
+    memset(&record, 0, sizeof(record));
+    UnpackBssid(bssid, record.mac);
+    record.rssi = static_cast<int16_t>(accessPoints[i].radio_signal_strength);
+    record.ssid_length = static_cast<uint8_t>(
+        std::min(accessPoints[i].ssid.size(), sizeof(record.ssid)));
+    memcpy(record.ssid, accessPoints[i].ssid.data(), record.ssid_length);
+    staging_.push_back(record);
+  }
+
+  uint32_t sequence = region_->sequence.load(std::memory_order_relaxed);
+  region_->sequence.store(sequence + 1, std::memory_order_relaxed);
+  // Keep the record writes below from moving above the odd sequence.
+  std::atomic_thread_fence(std::memory_order_release);
+  if (!staging_.empty()) {
+    memcpy(region_->records, &staging_[0], staging_.size() * sizeof(SharedScanRecord));
+  }
+  region_->count = static_cast<uint32_t>(staging_.size());
+  region_->total_count = static_cast<uint32_t>(accessPoints.size());
+  region_->timestamp_ms = timestamp_ms;
+  ++region_->scan_number;
+  region_->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+// SharedScanReader
+
+SharedScanReader::SharedScanReader()
+    : region_(NULL),
+      region_size_(0),
+      handle_(NULL),
+      capacity_(0),
+      retries_(0) {
+}
+
+SharedScanReader::~SharedScanReader() {
+  Close();
+}
+
+bool SharedScanReader::Open(const std::string& name) {
+  Close();
+  void* view = MapRegion(name, 0, false, &handle_, &region_size_);
+  if (!view) {
+    return false;
+  }
+  region_ = static_cast<const SharedScanRegion*>(view);
+  if (region_size_ < sizeof(SharedScanRegion) || region_->magic != kRegionMagic ||
+      region_->version != kRegionVersion) {
+    Close();
+    return false;
+  }
+  // Another writer may take the region over later with a larger capacity,
+  // so read it once; the mapping and copy_ stay sized for this value.
+  capacity_ = region_->capacity;
+  if (RegionSize(capacity_) > region_size_) {
+    Close();
+    return false;
+  }
+  copy_.resize(std::max<uint32_t>(capacity_, 1));
+  return true;
+}
+
+void SharedScanReader::Close() {
+  if (region_) {
+    UnmapRegion(region_, region_size_, handle_);
+  }
+  region_ = NULL;
+  handle_ = NULL;
+  capacity_ = 0;
+}
+
+uint64_t SharedScanReader::LatestScanNumber() const {
+  if (!region_) {
+    return 0;
+  }
+  BusyBackoff backoff;
+  do {
+    uint32_t sequence = region_->sequence.load(std::memory_order_acquire);
+    uint64_t scan_number = region_->scan_number;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!(sequence & 1) &&
+        region_->sequence.load(std::memory_order_relaxed) == sequence) {
+      return scan_number;
+    }
+  } while (backoff.Wait());
+  return 0;
+}
+
+bool SharedScanReader::Read(SharedScanSnapshot* snapshot) {
+  if (!region_) {
+    return false;
+  }
+  uint32_t count;
+  BusyBackoff backoff;
+  while (true) {
+    uint32_t sequence = region_->sequence.load(std::memory_order_acquire);
+    if (!(sequence & 1)) {
+      snapshot->scan_number = region_->scan_number;
+      snapshot->timestamp_ms = region_->timestamp_ms;
+      snapshot->total_count = region_->total_count;
+      // Clamp before copying: a torn count is only caught afterwards.
+      count = std::min(region_->count, capacity_);
+      memcpy(&copy_[0], region_->records, count * sizeof(SharedScanRecord));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (region_->sequence.load(std::memory_order_relaxed) == sequence) {
+        break;
+      }
+    }
+    ++retries_;
+    if (!backoff.Wait()) {
+      return false;
+    }
+  }
+
+  snapshot->access_points.resize(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    AccessPoint& access_point = snapshot->access_points[i];
+    access_point.mac_address = FormatBssid(copy_[i].mac);
+    access_point.radio_signal_strength = copy_[i].rssi;
+    access_point.ssid.assign(copy_[i].ssid,
+                             std::min<size_t>(copy_[i].ssid_length, sizeof(copy_[i].ssid)));
+  }
+  return snapshot->scan_number != 0;
+}
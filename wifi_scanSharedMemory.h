@@ -0,0 +1,117 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "wifi_accessPoint.h"
+
+// Publishes scans from one scanner process to any number of local reader
+// processes through a named shared-memory region, so that they stop polling
+// the adapters themselves.
+//
+// The region holds a fixed-layout header and record array guarded by a
+// sequence lock: the writer makes the sequence odd, rewrites the records and
+// makes it even again; a reader copies the records between two loads of the
+// sequence and retries if it was odd or changed. Readers never block the
+// writer and make no system calls after mapping the region, other than
+// yielding while the writer is active.
+//
+// Region names follow the platform: "/name" for POSIX shared memory,
+// "Local\\name" (or "Global\\name") on Windows.
+
+struct SharedScanRecord {
+  unsigned char mac[6];
+  int16_t rssi;
+  uint8_t ssid_length;
+  char ssid[32];
+};
+
+struct SharedScanRegion {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t capacity;
+  // Even when stable, odd while the writer is updating the fields below.
+  std::atomic<uint32_t> sequence;
+  uint64_t scan_number;
+  int64_t timestamp_ms;
+  uint32_t count;
+  // APs in the scan, including any beyond |capacity| that were left out.
+  uint32_t total_count;
+  SharedScanRecord records[1];
+};
+
+struct SharedScanSnapshot {
+  uint64_t scan_number;
+  int64_t timestamp_ms;
+  uint32_t total_count;
+  std::vector<AccessPoint> access_points;
+};
+
+class SharedScanWriter {
+public:
+  SharedScanWriter();
+  // Unmaps and removes the region.
+  ~SharedScanWriter();
+
+  // Creates (or takes over) region |name| sized for |capacity| APs.
+  bool Create(const std::string& name, uint32_t capacity);
+  void Close();
+
+  // Only one thread may publish.
+  void Publish(const std::vector<AccessPoint>& accessPoints, int64_t timestamp_ms);
+
+private:
+  SharedScanWriter(const SharedScanWriter&);
+  SharedScanWriter& operator=(const SharedScanWriter&);
+
+  std::string name_;
+  SharedScanRegion* region_;
+  size_t region_size_;
+  // File mapping handle on Windows; unused elsewhere.
+  void* handle_;
+  uint32_t capacity_;
+  // Staging copy, filled outside the write window.
+  std::vector<SharedScanRecord> staging_;
+};
+
+class SharedScanReader {
+public:
+  SharedScanReader();
+  ~SharedScanReader();
+
+  bool Open(const std::string& name);
+  void Close();
+
+  // Number of the newest published scan (0 before the first), without
+  // copying it. Lets a reader skip Read() when nothing changed. Also 0 if the
+  // writer has been mid-update for a quarter of a second, as when it died
+  // there; Close() and Open() again to pick up a new writer.
+  uint64_t LatestScanNumber() const;
+
+  // Copies a consistent snapshot of the newest scan. Returns false if the
+  // region is not open, nothing has been published yet, or the writer has
+  // been mid-update for as long as above.
+  bool Read(SharedScanSnapshot* snapshot);
+
+  // Reads that had to be repeated because the writer was active.
+  uint64_t Retries() const { return retries_; }
+
+private:
+  SharedScanReader(const SharedScanReader&);
+  SharedScanReader& operator=(const SharedScanReader&);
+
+  const SharedScanRegion* region_;
+  size_t region_size_;
+  // File mapping handle on Windows; unused elsewhere.
+  void* handle_;
+  // Capacity validated against the mapping in Open(); the one in the region
+  // is not trusted after that.
+  uint32_t capacity_;
+  std::vector<SharedScanRecord> copy_;
+  uint64_t retries_;
+};
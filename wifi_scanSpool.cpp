@@ -0,0 +1,628 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_scanSpool.h"
+#include <string.h>
+#include <algorithm>
+
+#if defined(XP_WIN) || defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+const uint32_t kFileMagic = 0x4C505357;    // "WSPL"
+const uint32_t kFileVersion = 1;
+const uint32_t kRecordMagic = 0x43455257;  // "WREC"
+const uint32_t kPaddingMagic = 0x44415057; // "WPAD"
+// The ring starts one page in, so the header never shares a page with it.
+const uint64_t kHeaderPageSize = 4096;
+const uint64_t kMinCapacity = 4096;
+const uint64_t kRecordAlignment = 8;
+const size_t kMaxStringLength = 255;
+
+uint64_t AlignRecord(uint64_t size) {
+  return (size + kRecordAlignment - 1) & ~(kRecordAlignment - 1);
+}
+
+uint32_t Checksum(const char* data, size_t length, uint64_t sequence,
+                  int64_t timestamp_ms) {
+  // FNV-1a over the payload, then the fields that identify the record.
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+  }
+  uint64_t fields[2] = { sequence, static_cast<uint64_t>(timestamp_ms) };
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(fields);
+  for (size_t i = 0; i < sizeof(fields); ++i) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash ^ static_cast<uint32_t>(length);
+}
+
+void AppendString(const std::string& value, std::vector<char>& out) {
+  size_t length = std::min(value.size(), kMaxStringLength);
+  out.push_back(static_cast<char>(length));
+  out.insert(out.end(), value.begin(), value.begin() + length);
+}
+
+// Payload: uint16 count, then per AP an int16 RSSI and length-prefixed MAC
+// address and SSID.
+void EncodeReport(const std::vector<AccessPoint>& accessPoints,
+                  std::vector<char>& out) {
+  out.clear();
+  uint16_t count = static_cast<uint16_t>(std::min<size_t>(accessPoints.size(), 0xFFFF));
+  out.insert(out.end(), reinterpret_cast<const char*>(&count),
+             reinterpret_cast<const char*>(&count) + sizeof(count));
+  for (uint16_t i = 0; i < count; ++i) {
+    int16_t rssi = static_cast<int16_t>(accessPoints[i].radio_signal_strength);
+    out.insert(out.end(), reinterpret_cast<const char*>(&rssi),
+               reinterpret_cast<const char*>(&rssi) + sizeof(rssi));
+    AppendString(accessPoints[i].mac_address, out);
+    AppendString(accessPoints[i].ssid, out);
+  }
+}
+
+bool ReadString(const char*& cursor, const char* end, std::string& value) {
+  if (cursor >= end) {
+    return false;
+  }
+  size_t length = static_cast<unsigned char>(*cursor++);
+  if (static_cast<size_t>(end - cursor) < length) {
+    return false;
+  }
+  value.assign(cursor, length);
+  cursor += length;
+  return true;
+}
+
+bool DecodeReport(const char* data, size_t length,
+                  std::vector<AccessPoint>& accessPoints) {
+  const char* cursor = data;
+  const char* end = data + length;
+  uint16_t count;
+  if (length < sizeof(count)) {
+    return false;
+  }
+  memcpy(&count, cursor, sizeof(count));
+  cursor += sizeof(count);
+  accessPoints.resize(count);
+  for (uint16_t i = 0; i < count; ++i) {
+    int16_t rssi;
+    if (static_cast<size_t>(end - cursor) < sizeof(rssi)) {
+      return false;
+    }
+    memcpy(&rssi, cursor, sizeof(rssi));
+    cursor += sizeof(rssi);
+    accessPoints[i].radio_signal_strength = rssi;
+    if (!ReadString(cursor, end, accessPoints[i].mac_address) ||
+        !ReadString(cursor, end, accessPoints[i].ssid)) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+struct ScanSpool::FileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t capacity;
+  uint64_t head;
+  uint64_t head_sequence;
+};
+
+struct ScanSpool::RecordHeader {
+  uint32_t magic;
+  uint32_t length;
+  uint32_t checksum;
+  uint32_t reserved;
+  uint64_t sequence;
+  int64_t timestamp_ms;
+};
+
+ScanSpool::Options::Options()
+    : capacity_bytes(16 * 1024 * 1024),
+      flush_on_append(false) {
+}
+
+ScanSpool::ScanSpool()
+    : mapping_(NULL),
+      mapping_size_(0),
+#if defined(XP_WIN) || defined(_WIN32)
+      file_(INVALID_HANDLE_VALUE),
+      file_mapping_(NULL),
+#else
+      fd_(-1),
+#endif
+      header_(NULL),
+      ring_(NULL),
+      capacity_(0),
+      head_(0),
+      tail_(0),
+      head_sequence_(1),
+      next_sequence_(1) {
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+ScanSpool::~ScanSpool() {
+  Close();
+}
+
+bool ScanSpool::Open(const std::string& path, const Options& options) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (mapping_) {
+    FlushLocked();
+    UnmapFile();
+  }
+  options_ = options;
+  memset(&stats_, 0, sizeof(stats_));
+  uint64_t file_size = 0;
+  if (!OpenFile(path, &file_size)) {
+    return false;
+  }
+  if (file_size >= kHeaderPageSize && MapFile(kHeaderPageSize)) {
+    bool valid = HasValidHeader(file_size);
+    uint64_t capacity = header_->capacity;
+    UnmapFile();
+    if (valid && MapFile(kHeaderPageSize + capacity)) {
+      Recover();
+      return true;
+    }
+  }
+  uint64_t capacity = std::max(kMinCapacity,
+                               options.capacity_bytes & ~(kRecordAlignment - 1));
+  if (!MapFile(kHeaderPageSize + capacity)) {
+    CloseFile();
+    return false;
+  }
+  Initialize(capacity);
+  return true;
+}
+
+void ScanSpool::Close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (mapping_) {
+    FlushLocked();
+    UnmapFile();
+  }
+  CloseFile();
+}
+
+bool ScanSpool::HasValidHeader(uint64_t file_size) const {
+  const FileHeader* header = reinterpret_cast<const FileHeader*>(mapping_);
+  return header->magic == kFileMagic && header->version == kFileVersion &&
+         header->capacity >= kMinCapacity &&
+         header->capacity % kRecordAlignment == 0 &&
+         header->capacity <= file_size - kHeaderPageSize;
+}
+
+void ScanSpool::Initialize(uint64_t capacity) {
+  capacity_ = capacity;
+  head_ = tail_ = 0;
+  head_sequence_ = next_sequence_ = 1;
+  memset(header_, 0, sizeof(FileHeader));
+  header_->magic = kFileMagic;
+  header_->version = kFileVersion;
+  header_->capacity = capacity;
+  StoreHead();
+  FlushLocked();
+}
+
+void ScanSpool::Recover() {
+  capacity_ = header_->capacity;
+  head_ = header_->head;
+  head_sequence_ = header_->head_sequence;
+  uint64_t position = head_;
+  uint64_t sequence = head_sequence_;
+  while (true) {
+    uint64_t start = SkipPadding(position, sequence);
+    if (start - head_ >= capacity_ || !IsValidRecord(start, sequence)) {
+      break;
+    }
+    uint64_t end = RecordEnd(start);
+    if (end - head_ > capacity_) {
+      break;
+    }
+    position = end;
+    ++sequence;
+    ++stats_.recovered;
+  }
+  tail_ = position;
+  next_sequence_ = sequence;
+  stats_.records = stats_.recovered;
+}
+
+uint64_t ScanSpool::SkipPadding(uint64_t position, uint64_t sequence) const {
+  uint64_t offset = position % capacity_;
+  uint64_t remaining = capacity_ - offset;
+  if (remaining < sizeof(RecordHeader)) {
+    return position + remaining;
+  }
+  const RecordHeader* record = RecordAt(position);
+  if (record->magic == kPaddingMagic && record->sequence == sequence) {
+    return position + remaining;
+  }
+  return position;
+}
+
+const ScanSpool::RecordHeader* ScanSpool::RecordAt(uint64_t position) const {
+  return reinterpret_cast<const RecordHeader*>(ring_ + position % capacity_);
+}
+
+bool ScanSpool::IsValidRecord(uint64_t position, uint64_t sequence) const {
+  uint64_t offset = position % capacity_;
+  if (capacity_ - offset < sizeof(RecordHeader)) {
+    return false;
+  }
+  const RecordHeader* record = RecordAt(position);
+  if (record->magic != kRecordMagic || record->sequence != sequence ||
+      record->length > capacity_ - offset - sizeof(RecordHeader)) {
+    return false;
+  }
+  const char* payload = reinterpret_cast<const char*>(record + 1);
+  return record->checksum ==
+         Checksum(payload, record->length, record->sequence, record->timestamp_ms);
+}
+
+uint64_t ScanSpool::RecordEnd(uint64_t position) const {
+  return position + AlignRecord(sizeof(RecordHeader) + RecordAt(position)->length);
+}
+
+void ScanSpool::DropOldest() {
+  head_ = RecordEnd(SkipPadding(head_, head_sequence_));
+  ++head_sequence_;
+  --stats_.records;
+}
+
+void ScanSpool::StoreHead() {
+  header_->head = head_;
+  header_->head_sequence = head_sequence_;
+}
+
+bool ScanSpool::Append(const std::vector<AccessPoint>& accessPoints,
+                       int64_t timestamp_ms) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!mapping_) {
+    return false;
+  }
+  EncodeReport(accessPoints, encode_buffer_);
+  const uint64_t size = AlignRecord(sizeof(RecordHeader) + encode_buffer_.size());
+  if (size > capacity_) {
+    return false;
+  }
+
+  uint64_t padding;
+  bool evicted = false;
+  while (true) {
+    uint64_t remaining = capacity_ - tail_ % capacity_;
+    padding = remaining < size ? remaining : 0;
+    if (head_ == tail_ && padding) {
+      // Empty: start the next lap directly.
+      head_ = tail_ = tail_ + padding;
+      evicted = true;
+      continue;
+    }
+    if (tail_ - head_ + padding + size <= capacity_) {
+      break;
+    }
+    DropOldest();
+    ++stats_.evicted;
+    evicted = true;
+  }
+  if (evicted) {
+    StoreHead();
+  }
+
+  if (padding >= sizeof(RecordHeader)) {
+    RecordHeader pad;
+    memset(&pad, 0, sizeof(pad));
+    pad.magic = kPaddingMagic;
+    pad.sequence = next_sequence_;
+    memcpy(ring_ + tail_ % capacity_, &pad, sizeof(pad));
+  }
+  tail_ += padding;
+
+  // Payload first, header last, though the checksum is what makes a torn
+  // record detectable either way.
+  char* target = ring_ + tail_ % capacity_;
+  RecordHeader record;
+  memset(&record, 0, sizeof(record));
+  record.magic = kRecordMagic;
+  record.length = static_cast<uint32_t>(encode_buffer_.size());
+  record.sequence = next_sequence_;
+  record.timestamp_ms = timestamp_ms;
+  record.checksum = Checksum(encode_buffer_.empty() ? NULL : &encode_buffer_[0],
+                             encode_buffer_.size(), record.sequence, timestamp_ms);
+  if (!encode_buffer_.empty()) {
+    memcpy(target + sizeof(record), &encode_buffer_[0], encode_buffer_.size());
+  }
+  memcpy(target, &record, sizeof(record));
+
+  tail_ += size;
+  ++next_sequence_;
+  ++stats_.records;
+  ++stats_.appended;
+  if (options_.flush_on_append) {
+    FlushLocked();
+  }
+  return true;
+}
+
+size_t ScanSpool::Peek(size_t max_records, std::vector<SpooledReport>* batch,
+                       uint64_t* end_position) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  batch->clear();
+  uint64_t position = head_;
+  uint64_t sequence = head_sequence_;
+  while (mapping_ && batch->size() < max_records && position != tail_) {
+    uint64_t start = SkipPadding(position, sequence);
+    const RecordHeader* record = RecordAt(start);
+    batch->push_back(SpooledReport());
+    SpooledReport& report = batch->back();
+    report.sequence = record->sequence;
+    report.timestamp_ms = record->timestamp_ms;
+    DecodeReport(reinterpret_cast<const char*>(record + 1), record->length,
+                 report.access_points);
+    position = RecordEnd(start);
+    ++sequence;
+  }
+  *end_position = position;
+  return batch->size();
+}
+
+void ScanSpool::Acknowledge(uint64_t end_position) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!mapping_ || end_position <= head_ || end_position > tail_) {
+    return;
+  }
+  while (head_ < end_position) {
+    DropOldest();
+    ++stats_.acknowledged;
+  }
+  StoreHead();
+}
+
+void ScanSpool::Flush() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (mapping_) {
+    FlushLocked();
+  }
+}
+
+ScanSpool::Stats ScanSpool::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats stats = stats_;
+  stats.used_bytes = tail_ - head_;
+  stats.capacity_bytes = capacity_;
+  return stats;
+}
+
+#if defined(XP_WIN) || defined(_WIN32)
+
+bool ScanSpool::OpenFile(const std::string& path, uint64_t* file_size) {
+  CloseFile();
+  file_ = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL,
+                      OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file_ == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file_, &size)) {
+    CloseFile();
+    return false;
+  }
+  *file_size = static_cast<uint64_t>(size.QuadPart);
+  return true;
+}
+
+bool ScanSpool::MapFile(uint64_t size) {
+  // The mapping grows the file to |size| if it is shorter.
+  file_mapping_ = CreateFileMappingA(file_, NULL, PAGE_READWRITE,
+                                     static_cast<DWORD>(size >> 32),
+                                     static_cast<DWORD>(size), NULL);
+  if (!file_mapping_) {
+    return false;
+  }
+  mapping_ = static_cast<char*>(MapViewOfFile(file_mapping_, FILE_MAP_ALL_ACCESS,
+                                              0, 0, static_cast<SIZE_T>(size)));
+  if (!mapping_) {
+    CloseHandle(file_mapping_);
+    file_mapping_ = NULL;
+    return false;
+  }
+  mapping_size_ = size;
+  header_ = reinterpret_cast<FileHeader*>(mapping_);
+  ring_ = mapping_ + kHeaderPageSize;
+  return true;
+}
+
+void ScanSpool::UnmapFile() {
+  if (mapping_) {
+    UnmapViewOfFile(mapping_);
+    CloseHandle(file_mapping_);
+  }
+  mapping_ = NULL;
+  file_mapping_ = NULL;
+  header_ = NULL;
+  ring_ = NULL;
+  mapping_size_ = 0;
+}
+
+void ScanSpool::CloseFile() {
+  if (file_ != INVALID_HANDLE_VALUE) {
+    CloseHandle(file_);
+    file_ = INVALID_HANDLE_VALUE;
+  }
+}
+
+void ScanSpool::FlushLocked() {
+  FlushViewOfFile(mapping_, static_cast<SIZE_T>(mapping_size_));
+  FlushFileBuffers(file_);
+}
+
+#else
+
+bool ScanSpool::OpenFile(const std::string& path, uint64_t* file_size) {
+  CloseFile();
+  fd_ = open(path.c_str(), O_RDWR | O_CREAT, 0600);
+  if (fd_ < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd_, &info) != 0) {
+    CloseFile();
+    return false;
+  }
+  *file_size = static_cast<uint64_t>(info.st_size);
+  return true;
+}
+
+bool ScanSpool::MapFile(uint64_t size) {
+  struct stat info;
+  if (fstat(fd_, &info) != 0) {
+    return false;
+  }
+  if (static_cast<uint64_t>(info.st_size) < size &&
+      ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+    return false;
+  }
+  void* mapping = mmap(NULL, static_cast<size_t>(size), PROT_READ | PROT_WRITE,
+                       MAP_SHARED, fd_, 0);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+  mapping_ = static_cast<char*>(mapping);
+  mapping_size_ = size;
+  header_ = reinterpret_cast<FileHeader*>(mapping_);
+  ring_ = mapping_ + kHeaderPageSize;
+  return true;
+}
+
+void ScanSpool::UnmapFile() {
+  if (mapping_) {
+    munmap(mapping_, static_cast<size_t>(mapping_size_));
+  }
+  mapping_ = NULL;
+  header_ = NULL;
+  ring_ = NULL;
+  mapping_size_ = 0;
+}
+
+void ScanSpool::CloseFile() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+void ScanSpool::FlushLocked() {
+  msync(mapping_, static_cast<size_t>(mapping_size_), MS_SYNC);
+}
+
+#endif
+
+// SpoolUploader
+
+SpoolUploader::Options::Options()
+    : batch_records(500),
+      initial_backoff_ms(1000),
+      max_backoff_ms(5 * 60 * 1000),
+      idle_poll_ms(30 * 1000) {
+}
+
+SpoolUploader::SpoolUploader(ScanSpool* spool, SpoolUploadTransport* transport,
+                             const Options& options)
+    : spool_(spool),
+      transport_(transport),
+      options_(options),
+      stopping_(false),
+      kicked_(false),
+      jitter_state_(static_cast<uint64_t>(
+          Clock::now().time_since_epoch().count()) | 1) {
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+SpoolUploader::~SpoolUploader() {
+  Stop();
+}
+
+void SpoolUploader::Start() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!thread_.joinable()) {
+    stopping_ = false;
+    thread_ = std::thread(&SpoolUploader::UploadLoop, this);
+  }
+}
+
+void SpoolUploader::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void SpoolUploader::Kick() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    kicked_ = true;
+    stats_.backoff_ms = 0;
+  }
+  wake_cv_.notify_all();
+}
+
+SpoolUploader::Stats SpoolUploader::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void SpoolUploader::UploadLoop() {
+  std::vector<SpooledReport> batch;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    kicked_ = false;
+    lock.unlock();
+    uint64_t end_position = 0;
+    bool uploaded = false;
+    if (spool_->Peek(options_.batch_records, &batch, &end_position)) {
+      uploaded = transport_->Upload(batch);
+      if (uploaded) {
+        spool_->Acknowledge(end_position);
+      }
+    }
+    lock.lock();
+
+    int64_t wait_ms;
+    if (batch.empty()) {
+      wait_ms = options_.idle_poll_ms;
+    } else if (uploaded) {
+      ++stats_.batches;
+      stats_.reports += batch.size();
+      stats_.backoff_ms = 0;
+      continue;
+    } else {
+      ++stats_.failures;
+      stats_.backoff_ms = stats_.backoff_ms
+          ? std::min(stats_.backoff_ms * 2, options_.max_backoff_ms)
+          : options_.initial_backoff_ms;
+      // Wait between half and all of the backoff so that many clients
+      // recovering from the same outage do not retry in lockstep.
+      jitter_state_ ^= jitter_state_ << 13;
+      jitter_state_ ^= jitter_state_ >> 7;
+      jitter_state_ ^= jitter_state_ << 17;
+      int64_t half = stats_.backoff_ms / 2;
+      wait_ms = half + static_cast<int64_t>(jitter_state_ % static_cast<uint64_t>(half + 1));
+    }
+    wake_cv_.wait_for(lock, std::chrono::milliseconds(wait_ms),
+                      [this] { return stopping_ || kicked_; });
+  }
+}
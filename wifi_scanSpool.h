@@ -0,0 +1,186 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "wifi_accessPoint.h"
+
+struct SpooledReport {
+  uint64_t sequence;
+  int64_t timestamp_ms;
+  std::vector<AccessPoint> access_points;
+};
+
+// Crash-safe spool of scan reports waiting to be uploaded, kept in a
+// fixed-size memory-mapped ring file so that disk usage is bounded.
+//
+// File layout: one header page holding the ring capacity and the position
+// and sequence number of the oldest record, then the ring itself. Each record
+// carries its sequence number and a checksum; on open the spool walks forward
+// from the oldest record and stops at the first record that is torn, stale
+// (left over from an earlier lap of the ring) or out of sequence, which
+// recovers the write position without ever persisting it. When an append
+// does not fit, the oldest records are evicted.
+//
+// All methods are thread-safe.
+class ScanSpool {
+public:
+  struct Options {
+    Options();
+    // Size of the ring, excluding the header page. Ignored when an existing
+    // spool file is opened.
+    uint64_t capacity_bytes;
+    // Flush the mapping to disk after every append, which also survives an
+    // OS crash. Otherwise only Flush() and Close() do.
+    bool flush_on_append;
+  };
+
+  struct Stats {
+    uint64_t records;
+    uint64_t used_bytes;
+    uint64_t capacity_bytes;
+    uint64_t appended;
+    uint64_t evicted;
+    uint64_t acknowledged;
+    // Records found by the recovery walk when the file was opened.
+    uint64_t recovered;
+  };
+
+  ScanSpool();
+  ~ScanSpool();
+
+  // Opens |path|, creating it if missing or unusable.
+  bool Open(const std::string& path, const Options& options);
+  void Close();
+
+  // Returns false if the report can never fit in the ring.
+  bool Append(const std::vector<AccessPoint>& accessPoints, int64_t timestamp_ms);
+
+  // Copies up to |max_records| of the oldest reports into |batch| without
+  // removing them. Pass |end_position| to Acknowledge() once they have been
+  // delivered. Returns the number of reports copied.
+  size_t Peek(size_t max_records, std::vector<SpooledReport>* batch,
+              uint64_t* end_position);
+  // Removes every record before |end_position|. Records evicted in the
+  // meantime are skipped.
+  void Acknowledge(uint64_t end_position);
+
+  void Flush();
+  Stats GetStats() const;
+
+private:
+  struct FileHeader;
+  struct RecordHeader;
+
+  bool OpenFile(const std::string& path, uint64_t* file_size);
+  bool MapFile(uint64_t size);
+  void UnmapFile();
+  void CloseFile();
+  bool HasValidHeader(uint64_t file_size) const;
+  void Initialize(uint64_t capacity);
+  void Recover();
+
+  // Position of record |sequence|, which starts at or after |position|: a
+  // record that would not fit before the end of the ring starts at the
+  // beginning of the next lap instead.
+  uint64_t SkipPadding(uint64_t position, uint64_t sequence) const;
+  const RecordHeader* RecordAt(uint64_t position) const;
+  bool IsValidRecord(uint64_t position, uint64_t sequence) const;
+  uint64_t RecordEnd(uint64_t position) const;
+  void DropOldest();
+  void StoreHead();
+  void FlushLocked();
+
+  ScanSpool(const ScanSpool&);
+  ScanSpool& operator=(const ScanSpool&);
+
+  mutable std::mutex mutex_;
+  Options options_;
+  char* mapping_;
+  uint64_t mapping_size_;
+#if defined(XP_WIN) || defined(_WIN32)
+  void* file_;
+  void* file_mapping_;
+#else
+  int fd_;
+#endif
+  FileHeader* header_;
+  char* ring_;
+  uint64_t capacity_;
+  // Logical byte positions; the physical offset is position % capacity_.
+  uint64_t head_;
+  uint64_t tail_;
+  uint64_t head_sequence_;
+  uint64_t next_sequence_;
+  Stats stats_;
+  std::vector<char> encode_buffer_;
+};
+
+// Delivers batches of spooled reports, typically as one HTTP request.
+class SpoolUploadTransport {
+public:
+  virtual ~SpoolUploadTransport() {}
+  // Returns false if the batch should be retried later.
+  virtual bool Upload(const std::vector<SpooledReport>& batch) = 0;
+};
+
+// Drains a ScanSpool through a transport on its own thread, in large
+// batches, backing off exponentially (with jitter) while uploads fail.
+class SpoolUploader {
+public:
+  struct Options {
+    Options();
+    size_t batch_records;
+    int64_t initial_backoff_ms;
+    int64_t max_backoff_ms;
+    // How often an empty spool is checked again without a Kick().
+    int64_t idle_poll_ms;
+  };
+
+  struct Stats {
+    uint64_t batches;
+    uint64_t reports;
+    uint64_t failures;
+    int64_t backoff_ms;
+  };
+
+  // Neither |spool| nor |transport| is owned.
+  SpoolUploader(ScanSpool* spool, SpoolUploadTransport* transport,
+                const Options& options);
+  ~SpoolUploader();
+
+  void Start();
+  void Stop();
+  // Wakes the uploader now, e.g. after new reports or when connectivity
+  // returns; also clears the current backoff.
+  void Kick();
+
+  Stats GetStats() const;
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  void UploadLoop();
+
+  SpoolUploader(const SpoolUploader&);
+  SpoolUploader& operator=(const SpoolUploader&);
+
+  ScanSpool* spool_;
+  SpoolUploadTransport* transport_;
+  const Options options_;
+  mutable std::mutex mutex_;
+  std::condition_variable wake_cv_;
+  bool stopping_;
+  bool kicked_;
+  Stats stats_;
+  uint64_t jitter_state_;
+  std::thread thread_;
+};
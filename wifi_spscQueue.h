@@ -0,0 +1,178 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Counters kept by each SpscQueue. Read them with SpscQueue::GetStats(); they
+// are updated with relaxed atomics and are only approximately consistent
+// with each other.
+struct SpscQueueStats {
+  size_t capacity;
+  size_t depth;
+  size_t max_depth;
+  uint64_t pushed;
+  uint64_t popped;
+  uint64_t dropped;
+  uint64_t producer_waits;
+};
+
+// Bounded single-producer/single-consumer ring of owned T objects.
+//
+// When the ring is full the producer either waits for the consumer
+// (BACKPRESSURE) or discards the oldest queued item (DROP_OLDEST). Dropping
+// is done by the producer claiming the read slot with a compare-and-swap, so
+// the consumer also claims its slot that way; whoever wins the CAS owns the
+// item. Slots hold pointers, read before the CAS, so a losing side never
+// touches the payload.
+template <typename T>
+class SpscQueue {
+ public:
+  enum OverflowPolicy {
+    BACKPRESSURE,
+    DROP_OLDEST
+  };
+
+  SpscQueue(size_t capacity, OverflowPolicy policy)
+      : slots_(capacity),
+        policy_(policy),
+        read_(0),
+        write_(0),
+        max_depth_(0),
+        pushed_(0),
+        popped_(0),
+        dropped_(0),
+        producer_waits_(0) {
+    assert(capacity > 0);
+    for (size_t i = 0; i < slots_.size(); ++i) {
+      slots_[i].store(NULL, std::memory_order_relaxed);
+    }
+  }
+
+  ~SpscQueue() {
+    std::unique_ptr<T> item;
+    while (TryPop(&item)) {
+    }
+  }
+
+  // Producer side. Takes ownership of |item|. With BACKPRESSURE, waits while
+  // the ring is full and returns false (dropping |item|) only if |stop| is
+  // raised meanwhile. With DROP_OLDEST it never waits.
+  bool Push(std::unique_ptr<T> item, const std::atomic<bool>* stop) {
+    const uint64_t w = write_.load(std::memory_order_relaxed);
+    int spins = 0;
+    while (w - read_.load(std::memory_order_acquire) >= slots_.size()) {
+      if (policy_ == DROP_OLDEST) {
+        uint64_t r = read_.load(std::memory_order_acquire);
+        if (w - r < slots_.size()) {
+          break;
+        }
+        T* oldest = slots_[r % slots_.size()].load(std::memory_order_relaxed);
+        if (read_.compare_exchange_strong(r, r + 1,
+                                          std::memory_order_acq_rel)) {
+          delete oldest;
+          dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+        continue;
+      }
+      if (stop && stop->load(std::memory_order_relaxed)) {
+        return false;
+      }
+      if (spins++ == 0) {
+        producer_waits_.fetch_add(1, std::memory_order_relaxed);
+      }
+      Backoff(spins);
+    }
+
+    slots_[w % slots_.size()].store(item.release(), std::memory_order_relaxed);
+    write_.store(w + 1, std::memory_order_release);
+    pushed_.fetch_add(1, std::memory_order_relaxed);
+
+    size_t depth = static_cast<size_t>(w + 1 - read_.load(std::memory_order_relaxed));
+    if (depth > max_depth_.load(std::memory_order_relaxed)) {
+      max_depth_.store(depth, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  // Consumer side. Returns false if the ring is empty.
+  bool TryPop(std::unique_ptr<T>* out) {
+    while (true) {
+      uint64_t r = read_.load(std::memory_order_acquire);
+      if (r == write_.load(std::memory_order_acquire)) {
+        return false;
+      }
+      // The slot cannot be rewritten until read_ moves past r, so the pointer
+      // is valid if and only if the CAS wins. The producer may be dropping
+      // this very slot.
+      T* item = slots_[r % slots_.size()].load(std::memory_order_relaxed);
+      if (read_.compare_exchange_strong(r, r + 1, std::memory_order_acq_rel)) {
+        out->reset(item);
+        popped_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+  }
+
+  // Consumer side. Waits for an item until |stop| is raised and the ring has
+  // drained.
+  bool Pop(std::unique_ptr<T>* out, const std::atomic<bool>* stop) {
+    int spins = 0;
+    while (!TryPop(out)) {
+      if (stop && stop->load(std::memory_order_acquire)) {
+        return TryPop(out);
+      }
+      Backoff(++spins);
+    }
+    return true;
+  }
+
+  SpscQueueStats GetStats() const {
+    SpscQueueStats stats;
+    uint64_t w = write_.load(std::memory_order_relaxed);
+    uint64_t r = read_.load(std::memory_order_relaxed);
+    stats.capacity = slots_.size();
+    stats.depth = w > r ? static_cast<size_t>(w - r) : 0;
+    stats.max_depth = max_depth_.load(std::memory_order_relaxed);
+    stats.pushed = pushed_.load(std::memory_order_relaxed);
+    stats.popped = popped_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    stats.producer_waits = producer_waits_.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+ private:
+  // Spin briefly, then yield, then sleep so an idle stage costs nothing.
+  static void Backoff(int spins) {
+    if (spins < 64) {
+      return;
+    }
+    if (spins < 128) {
+      std::this_thread::yield();
+      return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  SpscQueue(const SpscQueue&);
+  SpscQueue& operator=(const SpscQueue&);
+
+  std::vector<std::atomic<T*> > slots_;
+  const OverflowPolicy policy_;
+  std::atomic<uint64_t> read_;
+  std::atomic<uint64_t> write_;
+  std::atomic<size_t> max_depth_;
+  std::atomic<uint64_t> pushed_;
+  std::atomic<uint64_t> popped_;
+  std::atomic<uint64_t> dropped_;
+  std::atomic<uint64_t> producer_waits_;
+};
@@ -0,0 +1,225 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_warmStart.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include "wifi_bssid.h"
+
+#if defined(XP_WIN) || defined(_WIN32)
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+const uint32_t kStateMagic = 0x54535757;  // "WWST"
+const uint32_t kStateVersion = 1;
+const size_t kMaxStringLength = 255;
+// A braced GUID is 38 characters.
+const size_t kMaxInterfaceNameLength = 64;
+const size_t kMacLength = 6;
+// Anything larger is not a state file this code wrote.
+const uint32_t kMaxBodyLength = 16 << 20;
+
+struct StateHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t body_length;
+  uint32_t checksum;
+  int64_t scan_time_ms;
+  uint32_t query_buffer_size;
+  uint16_t interface_count;
+  uint16_t access_point_count;
+};
+
+uint32_t Checksum(const char* data, size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+  }
+  return hash ^ static_cast<uint32_t>(length);
+}
+
+void AppendString(const std::string& value, std::vector<char>& out) {
+  size_t length = std::min(value.size(), kMaxStringLength);
+  out.push_back(static_cast<char>(length));
+  out.insert(out.end(), value.begin(), value.begin() + length);
+}
+
+// Reads one length-prefixed string, advancing |*p|. Returns false if it
+// runs past |end|.
+bool ReadString(const char** p, const char* end, std::string* value) {
+  if (*p >= end) {
+    return false;
+  }
+  size_t length = static_cast<unsigned char>(**p);
+  if (static_cast<size_t>(end - *p - 1) < length) {
+    return false;
+  }
+  value->assign(*p + 1, length);
+  *p += 1 + length;
+  return true;
+}
+
+bool ReplaceFile(const std::string& from, const std::string& to) {
+#if defined(XP_WIN) || defined(_WIN32)
+  return MoveFileExA(from.c_str(), to.c_str(),
+                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+  return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+}  // namespace
+
+WarmStartState::WarmStartState()
+    : query_buffer_size(0),
+      scan_time_ms(0) {
+}
+
+int64_t WarmStartNowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+bool IsValidInterfaceName(const std::string& name) {
+  if (name.empty() || name.size() > kMaxInterfaceNameLength) {
+    return false;
+  }
+  for (size_t i = 0; i < name.size(); ++i) {
+    char c = name[i];
+    if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+          (c >= 'A' && c <= 'Z') || c == '{' || c == '}' || c == '-' ||
+          c == '_')) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SaveWarmStartState(const std::string& path, const WarmStartState& state) {
+  // Body: interface names as length-prefixed strings, then per AP the six
+  // MAC bytes, an int16 RSSI and a length-prefixed SSID. APs whose MAC does
+  // not parse are left out.
+  std::vector<char> file(sizeof(StateHeader));
+  StateHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kStateMagic;
+  header.version = kStateVersion;
+  header.scan_time_ms = state.scan_time_ms;
+  header.query_buffer_size = state.query_buffer_size;
+
+  size_t interfaces = std::min<size_t>(state.interfaces.size(), 0xFFFF);
+  for (size_t i = 0; i < interfaces; ++i) {
+    AppendString(state.interfaces[i], file);
+  }
+  header.interface_count = static_cast<uint16_t>(interfaces);
+
+  for (size_t i = 0; i < state.access_points.size() &&
+                     header.access_point_count < 0xFFFF; ++i) {
+    const AccessPoint& ap = state.access_points[i];
+    PackedBssid bssid = ParseBssid(ap.mac_address);
+    if (bssid == kInvalidBssid) {
+      continue;
+    }
+    unsigned char mac[kMacLength];
+    UnpackBssid(bssid, mac);
+    file.insert(file.end(), mac, mac + kMacLength);
+    int16_t rssi = static_cast<int16_t>(ap.radio_signal_strength);
+    file.insert(file.end(), reinterpret_cast<const char*>(&rssi),
+                reinterpret_cast<const char*>(&rssi) + sizeof(rssi));
+    AppendString(ap.ssid, file);
+    ++header.access_point_count;
+  }
+
+  header.body_length = static_cast<uint32_t>(file.size() - sizeof(StateHeader));
+  header.checksum = Checksum(&file[sizeof(StateHeader)], header.body_length);
+  memcpy(&file[0], &header, sizeof(header));
+
+  std::string temp_path = path + ".tmp";
+  FILE* out = fopen(temp_path.c_str(), "wb");
+  if (!out) {
+    return false;
+  }
+  bool ok = fwrite(&file[0], 1, file.size(), out) == file.size() &&
+            fflush(out) == 0;
+#if defined(XP_WIN) || defined(_WIN32)
+  ok = ok && _commit(_fileno(out)) == 0;
+#else
+  ok = ok && fsync(fileno(out)) == 0;
+#endif
+  ok = fclose(out) == 0 && ok;
+  if (!ok || !ReplaceFile(temp_path, path)) {
+    remove(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool LoadWarmStartState(const std::string& path, WarmStartState* state) {
+  FILE* in = fopen(path.c_str(), "rb");
+  if (!in) {
+    return false;
+  }
+  std::vector<char> file;
+  long size = -1;
+  if (fseek(in, 0, SEEK_END) == 0) {
+    size = ftell(in);
+  }
+  bool ok = size >= static_cast<long>(sizeof(StateHeader)) &&
+            size <= static_cast<long>(sizeof(StateHeader) + kMaxBodyLength) &&
+            fseek(in, 0, SEEK_SET) == 0;
+  if (ok) {
+    file.resize(size);
+    ok = fread(&file[0], 1, file.size(), in) == file.size();
+  }
+  fclose(in);
+  if (!ok) {
+    return false;
+  }
+
+  StateHeader header;
+  memcpy(&header, &file[0], sizeof(header));
+  if (header.magic != kStateMagic || header.version != kStateVersion ||
+      header.body_length != file.size() - sizeof(StateHeader) ||
+      header.checksum != Checksum(&file[sizeof(StateHeader)], header.body_length)) {
+    return false;
+  }
+
+  WarmStartState loaded;
+  loaded.scan_time_ms = header.scan_time_ms;
+  loaded.query_buffer_size = header.query_buffer_size;
+  const char* p = &file[0] + sizeof(StateHeader);
+  const char* end = &file[0] + file.size();
+  loaded.interfaces.resize(header.interface_count);
+  for (size_t i = 0; i < loaded.interfaces.size(); ++i) {
+    if (!ReadString(&p, end, &loaded.interfaces[i]) ||
+        !IsValidInterfaceName(loaded.interfaces[i])) {
+      return false;
+    }
+  }
+  loaded.access_points.resize(header.access_point_count);
+  for (size_t i = 0; i < loaded.access_points.size(); ++i) {
+    AccessPoint& ap = loaded.access_points[i];
+    if (static_cast<size_t>(end - p) < kMacLength + sizeof(int16_t)) {
+      return false;
+    }
+    ap.mac_address = FormatBssid(reinterpret_cast<const unsigned char*>(p));
+    int16_t rssi;
+    memcpy(&rssi, p + kMacLength, sizeof(rssi));
+    ap.radio_signal_strength = rssi;
+    p += kMacLength + sizeof(rssi);
+    if (!ReadString(&p, end, &ap.ssid)) {
+      return false;
+    }
+  }
+  if (p != end) {
+    return false;
+  }
+  std::swap(*state, loaded);
+  return true;
+}
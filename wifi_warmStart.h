@@ -0,0 +1,43 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "wifi_accessPoint.h"
+
+// What the scanner knew when it last ran, so a restart can skip interface
+// enumeration and buffer regrowth and hand consumers the last scan at once,
+// marked stale by its timestamp, while the first live scan runs.
+struct WarmStartState {
+  WarmStartState();
+
+  std::vector<std::string> interfaces;
+  // OID query buffer size the last run settled on; 0 if unknown.
+  uint32_t query_buffer_size;
+  // Wall-clock time of the last scan, in ms since the Unix epoch.
+  int64_t scan_time_ms;
+  std::vector<AccessPoint> access_points;
+
+  // Age of the saved scan at |now_ms| (same clock as scan_time_ms).
+  int64_t ScanAgeMs(int64_t now_ms) const { return now_ms - scan_time_ms; }
+};
+
+int64_t WarmStartNowMs();
+
+// True if |name| can be an NDIS service name: a GUID or a short driver
+// name, nothing that could reach outside \Device\ once made a DOS
+// device path. A state file naming any other interface is rejected.
+bool IsValidInterfaceName(const std::string& name);
+
+// Writes |state| to a temporary file next to |path| and renames it into
+// place, so a crash mid-write leaves the previous state intact.
+bool SaveWarmStartState(const std::string& path, const WarmStartState& state);
+
+// Reads the whole file with a single read and decodes it. Returns false, and
+// leaves |state| untouched, if the file is missing, truncated, from another
+// format version, fails its checksum or names an invalid interface.
+bool LoadWarmStartState(const std::string& path, WarmStartState* state);
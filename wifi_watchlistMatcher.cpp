@@ -0,0 +1,162 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "wifi_watchlistMatcher.h"
+#include <limits.h>
+#include <string.h>
+#include <algorithm>
+
+WatchlistRule::WatchlistRule()
+    : min_hits(1),
+      min_rssi(INT_MIN) {
+}
+
+WatchlistMatcher::WatchlistMatcher()
+    : generation_(0) {
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+bool WatchlistMatcher::Add(WatchlistId id, const std::vector<PackedBssid>& bssids,
+                           const WatchlistRule& rule) {
+  if (slot_by_id_.count(id)) {
+    return false;
+  }
+  uint32_t slot;
+  if (!free_slots_.empty()) {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+  } else {
+    slot = static_cast<uint32_t>(watchlists_.size());
+    watchlists_.push_back(Watchlist());
+    hits_.push_back(0);
+    strongest_.push_back(0);
+    marks_.push_back(0);
+  }
+  Watchlist& watchlist = watchlists_[slot];
+  watchlist.id = id;
+  watchlist.rule = rule;
+  watchlist.bssids.clear();
+  for (size_t i = 0; i < bssids.size(); ++i) {
+    if (bssids[i] != kInvalidBssid) {
+      watchlist.bssids.push_back(bssids[i]);
+    }
+  }
+  std::sort(watchlist.bssids.begin(), watchlist.bssids.end());
+  watchlist.bssids.erase(std::unique(watchlist.bssids.begin(), watchlist.bssids.end()),
+                         watchlist.bssids.end());
+  watchlist.in_use = true;
+  for (size_t i = 0; i < watchlist.bssids.size(); ++i) {
+    postings_[watchlist.bssids[i]].push_back(slot);
+  }
+  slot_by_id_[id] = slot;
+  return true;
+}
+
+bool WatchlistMatcher::Remove(WatchlistId id) {
+  std::unordered_map<WatchlistId, uint32_t>::iterator found = slot_by_id_.find(id);
+  if (found == slot_by_id_.end()) {
+    return false;
+  }
+  uint32_t slot = found->second;
+  Watchlist& watchlist = watchlists_[slot];
+  for (size_t i = 0; i < watchlist.bssids.size(); ++i) {
+    std::unordered_map<PackedBssid, std::vector<uint32_t> >::iterator posting =
+        postings_.find(watchlist.bssids[i]);
+    std::vector<uint32_t>& slots = posting->second;
+    // Posting order does not matter, so swap the last entry into the hole.
+    std::vector<uint32_t>::iterator it = std::find(slots.begin(), slots.end(), slot);
+    *it = slots.back();
+    slots.pop_back();
+    if (slots.empty()) {
+      postings_.erase(posting);
+    }
+  }
+  watchlist.in_use = false;
+  watchlist.bssids.clear();
+  // Stale marks must not make a later owner of the slot look touched.
+  marks_[slot] = 0;
+  free_slots_.push_back(slot);
+  slot_by_id_.erase(found);
+  return true;
+}
+
+void WatchlistMatcher::Match(const std::vector<AccessPoint>& scan,
+                             std::vector<WatchlistMatch>& matches) {
+  observations_.clear();
+  for (size_t i = 0; i < scan.size(); ++i) {
+    Observation observation = { ParseBssid(scan[i].mac_address),
+                                scan[i].radio_signal_strength };
+    if (observation.bssid != kInvalidBssid) {
+      observations_.push_back(observation);
+    }
+  }
+  MatchObservations(matches);
+}
+
+void WatchlistMatcher::Match(const PackedBssid* bssids, const int* rssi,
+                             size_t count, std::vector<WatchlistMatch>& matches) {
+  observations_.clear();
+  for (size_t i = 0; i < count; ++i) {
+    Observation observation = { bssids[i], rssi[i] };
+    if (observation.bssid != kInvalidBssid) {
+      observations_.push_back(observation);
+    }
+  }
+  MatchObservations(matches);
+}
+
+void WatchlistMatcher::MatchObservations(std::vector<WatchlistMatch>& matches) {
+  matches.clear();
+  ++stats_.scans;
+
+  // Sorting puts repeats of a BSSID next to each other, strongest first.
+  std::sort(observations_.begin(), observations_.end(),
+            [](const Observation& a, const Observation& b) {
+              return a.bssid != b.bssid ? a.bssid < b.bssid : a.rssi > b.rssi;
+            });
+
+  ++generation_;
+  touched_.clear();
+  for (size_t i = 0; i < observations_.size(); ++i) {
+    const Observation& observation = observations_[i];
+    if (i > 0 && observations_[i - 1].bssid == observation.bssid) {
+      continue;
+    }
+    std::unordered_map<PackedBssid, std::vector<uint32_t> >::const_iterator posting =
+        postings_.find(observation.bssid);
+    if (posting == postings_.end()) {
+      continue;
+    }
+    const std::vector<uint32_t>& slots = posting->second;
+    stats_.postings_visited += slots.size();
+    for (size_t j = 0; j < slots.size(); ++j) {
+      uint32_t slot = slots[j];
+      if (observation.rssi < watchlists_[slot].rule.min_rssi) {
+        continue;
+      }
+      if (marks_[slot] != generation_) {
+        marks_[slot] = generation_;
+        hits_[slot] = 0;
+        strongest_[slot] = observation.rssi;
+        touched_.push_back(slot);
+      }
+      ++hits_[slot];
+      strongest_[slot] = std::max(strongest_[slot], observation.rssi);
+    }
+  }
+
+  for (size_t i = 0; i < touched_.size(); ++i) {
+    uint32_t slot = touched_[i];
+    const Watchlist& watchlist = watchlists_[slot];
+    if (hits_[slot] >= watchlist.rule.min_hits) {
+      WatchlistMatch match = { watchlist.id, hits_[slot], strongest_[slot] };
+      matches.push_back(match);
+    }
+  }
+  std::sort(matches.begin(), matches.end(),
+            [](const WatchlistMatch& a, const WatchlistMatch& b) {
+              return a.id < b.id;
+            });
+  stats_.matches += matches.size();
+}
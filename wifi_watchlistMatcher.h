@@ -0,0 +1,98 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+#include "wifi_accessPoint.h"
+#include "wifi_bssid.h"
+
+typedef uint32_t WatchlistId;
+
+struct WatchlistRule {
+  WatchlistRule();
+  // Distinct watched BSSIDs that must be in the scan.
+  uint32_t min_hits;
+  // Only APs at least this strong count as hits.
+  int min_rssi;
+};
+
+struct WatchlistMatch {
+  WatchlistId id;
+  uint32_t hits;
+  int strongest_rssi;
+};
+
+// Checks scans against many watchlists ("site A is any of these BSSIDs").
+//
+// Watchlists are compiled into an inverted index from packed BSSID to the
+// watchlists containing it, so a scan only visits the watchlists that share
+// a BSSID with it: matching cost grows with the scan and the postings of its
+// BSSIDs, not with the number of watchlists. Watchlists can be added and
+// removed between scans without rebuilding anything.
+class WatchlistMatcher {
+public:
+  struct Stats {
+    uint64_t scans;
+    // Inverted index entries visited while matching.
+    uint64_t postings_visited;
+    uint64_t matches;
+  };
+
+  WatchlistMatcher();
+
+  // Registers |bssids| under |id|. Invalid and repeated BSSIDs are ignored.
+  // Returns false if |id| is already registered.
+  bool Add(WatchlistId id, const std::vector<PackedBssid>& bssids,
+           const WatchlistRule& rule);
+  // Returns false if |id| is not registered.
+  bool Remove(WatchlistId id);
+  size_t Size() const { return slot_by_id_.size(); }
+
+  // Fills |matches| with every watchlist the scan satisfies, ordered by id.
+  // A BSSID reported more than once counts once, at its strongest RSSI.
+  void Match(const std::vector<AccessPoint>& scan,
+             std::vector<WatchlistMatch>& matches);
+  void Match(const PackedBssid* bssids, const int* rssi, size_t count,
+             std::vector<WatchlistMatch>& matches);
+
+  const Stats& GetStats() const { return stats_; }
+
+private:
+  struct Watchlist {
+    WatchlistId id;
+    WatchlistRule rule;
+    std::vector<PackedBssid> bssids;
+    bool in_use;
+  };
+
+  struct Observation {
+    PackedBssid bssid;
+    int rssi;
+  };
+
+  void MatchObservations(std::vector<WatchlistMatch>& matches);
+
+  WatchlistMatcher(const WatchlistMatcher&);
+  WatchlistMatcher& operator=(const WatchlistMatcher&);
+
+  std::vector<Watchlist> watchlists_;
+  std::vector<uint32_t> free_slots_;
+  std::unordered_map<WatchlistId, uint32_t> slot_by_id_;
+  // BSSID -> slots of the watchlists that contain it.
+  std::unordered_map<PackedBssid, std::vector<uint32_t> > postings_;
+
+  // Scratch space reused across scans. A slot's hit count is only valid if
+  // its mark equals the current generation, so nothing has to be cleared.
+  std::vector<Observation> observations_;
+  std::vector<uint32_t> hits_;
+  std::vector<int> strongest_;
+  std::vector<uint64_t> marks_;
+  std::vector<uint32_t> touched_;
+  uint64_t generation_;
+
+  Stats stats_;
+};
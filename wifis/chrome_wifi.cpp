@@ -29,6 +29,7 @@
 #include <string>
 #include <vector>
 #include "assert.h"
+#include "../wifi_bssIdList.h"
 
 // Taken from ndis.h for WinCE.
 #define NDIS_STATUS_INVALID_LENGTH   ((NDIS_STATUS)0xC0010014L)
@@ -78,12 +79,6 @@ typedef VOID (WINAPI* WlanFreeMemoryFunction)(PVOID pMemory);
 typedef DWORD (WINAPI* WlanCloseHandleFunction)(HANDLE hClientHandle,
                                                 PVOID pReserved);
 
-struct AccessPoint {
-  std::string mac_address;
-  int radio_signal_strength;
-  std::string ssid;
-};
-
 // define for compatibility with chromium code
 #define string16 std::wstring
 
@@ -230,62 +225,6 @@ bool WindowsNdisApi::GetInterfacesNDIS(std::vector<string16>* interface_service_
   RegCloseKey(network_cards_key);
   return true;
 }
-#define uint8 unsigned char
-
-#define MAC_AS_NUM_LEN 6
-static std::string MacAddressAsString(const unsigned char macAsNumber[MAC_AS_NUM_LEN])
-{
-  const int charlen = MAC_AS_NUM_LEN * 2;
-  std::string result = std::string(charlen, ' ');
-  const char hexmap[] = { '0', '1', '2', '3', '4', '5', '6', '7',
-    '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };  
-  for (int i = 0; i < MAC_AS_NUM_LEN; ++i) {
-    result[2 * i] = hexmap[(macAsNumber[i] & 0xF0) >> 4];
-    result[2 * i + 1] = hexmap[macAsNumber[i] & 0x0F];
-  }
-  return result;
-}
-
-bool ConvertToAccessPointData(const NDIS_WLAN_BSSID& data, AccessPoint& access_point_data) 
-{
-	access_point_data.mac_address = MacAddressAsString(data.MacAddress);
-	access_point_data.radio_signal_strength = data.Rssi;
-	// Note that _NDIS_802_11_SSID::Ssid::Ssid is not null-terminated.
-  const unsigned char* ssid = data.Ssid.Ssid;
-  size_t len = data.Ssid.SsidLength;
-  access_point_data.ssid = std::string(reinterpret_cast<const char*>(ssid), len);
-
-	return true;
-}
-
-int GetDataFromBssIdList(const NDIS_802_11_BSSID_LIST& bss_id_list,
-                         int list_size,
-                         std::vector<AccessPoint>& outData) 
-{
-  // Walk through the BSS IDs.
-  int found = 0;
-  const uint8* iterator = reinterpret_cast<const uint8*>(&bss_id_list.Bssid[0]);
-  const uint8* end_of_buffer =
-      reinterpret_cast<const uint8*>(&bss_id_list) + list_size;
-  for (int i = 0; i < static_cast<int>(bss_id_list.NumberOfItems); ++i) {
-    const NDIS_WLAN_BSSID *bss_id =
-        reinterpret_cast<const NDIS_WLAN_BSSID*>(iterator);
-    // Check that the length of this BSS ID is reasonable.
-    if (bss_id->Length < sizeof(NDIS_WLAN_BSSID) ||
-        iterator + bss_id->Length > end_of_buffer) {
-      break;
-    }
-    AccessPoint access_point_data;
-    if (ConvertToAccessPointData(*bss_id, access_point_data)) {
-      outData.push_back(access_point_data);
-      ++found;
-    }
-    // Move to the next BSS ID.
-    iterator += bss_id->Length;
-  }
-  return found;
-}
-
 
 bool WindowsNdisApi::GetInterfaceDataNDIS(HANDLE adapter_handle,
                                           std::vector<AccessPoint>& outData) {
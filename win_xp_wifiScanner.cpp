@@ -24,9 +24,13 @@
 //#include "content/browser/geolocation/wifi_data_provider_win.h"
 #include "win_xp_wifiScanner.h"
 #include "nsWifiAccessPoint.h"
+#include "wifi_allocationProfiler.h"
+#include "wifi_bssIdList.h"
 #include <windows.h>
 #include <winioctl.h>
 #include <wlanapi.h>
+#include <string.h>
+#include <algorithm>
 #include <string>
 #include <vector>
 #include "assert.h"
@@ -43,6 +47,10 @@ const int kMaximumBufferSize = 2 << 20;  // 2MB
 // Length for generic string buffers passed to Win32 APIs.
 const int kStringLength = 512;
 
+// Upper bound on released access points kept around for reuse.
+const int kMaxRecycledAccessPoints = 256;
+const size_t kRecycledAccessPointBytes = sizeof(nsWifiAccessPoint) + sizeof(void*);
+
 // The time periods, in milliseconds, between successive polls of the wifi data.
 const int kDefaultPollingInterval = 10000;  // 10s
 const int kNoChangePollingInterval = 120000;  // 2 mins
@@ -96,12 +104,31 @@ bool GetSystemDirectory(std::string* path);
 // WindowsNdisApi
 WindowsNdisApi::WindowsNdisApi(
     std::vector<std::string>* interface_service_names)
-    : _buffer(kInitialBufferSize) {
+    : _buffer(kInitialBufferSize),
+      registry_(NULL),
+      scan_needed_(0),
+      last_needed_(0),
+      recheck_interfaces_(false) {
   assert(!interface_service_names->empty());
-  interface_service_names_.swap(*interface_service_names);
+  std::shared_ptr<InterfaceList> list = std::make_shared<InterfaceList>();
+  list->version = 0;
+  list->names.swap(*interface_service_names);
+  interfaces_ = std::move(list);
+  memset(&update_stats_, 0, sizeof(update_stats_));
+}
+
+WindowsNdisApi::WindowsNdisApi(InterfaceRegistry* registry)
+    : _buffer(kInitialBufferSize),
+      registry_(registry),
+      scan_needed_(0),
+      last_needed_(0),
+      recheck_interfaces_(false) {
+  memset(&update_stats_, 0, sizeof(update_stats_));
+  SyncInterfaces();
 }
 
 WindowsNdisApi::~WindowsNdisApi() {
+  AttachMemoryBudget(NULL);
 }
 
 WindowsNdisApi* WindowsNdisApi::Create() {
@@ -112,19 +139,127 @@ WindowsNdisApi* WindowsNdisApi::Create() {
   return NULL;
 }
 
+WindowsNdisApi* WindowsNdisApi::Create(InterfaceRegistry* registry) {
+  return new WindowsNdisApi(registry);
+}
+
+WindowsNdisApi* WindowsNdisApi::Create(const WarmStartState& state) {
+  std::vector<std::string> interface_service_names;
+  for (size_t i = 0; i < state.interfaces.size(); ++i) {
+    const std::string& name = state.interfaces[i];
+    if (IsValidInterfaceName(name) &&
+        std::find(interface_service_names.begin(), interface_service_names.end(),
+                  name) == interface_service_names.end()) {
+      interface_service_names.push_back(name);
+    }
+  }
+  WindowsNdisApi* api;
+  if (interface_service_names.empty()) {
+    api = Create();
+  } else {
+    api = new WindowsNdisApi(&interface_service_names);
+    api->recheck_interfaces_ = true;
+  }
+  if (api && state.query_buffer_size > api->_buffer.size()) {
+    ResizeBuffer(state.query_buffer_size, api->_buffer);
+  }
+  return api;
+}
+
+void WindowsNdisApi::GetWarmStartState(WarmStartState* state) const {
+  state->interfaces = Interfaces()->names;
+  state->query_buffer_size = static_cast<uint32_t>(_buffer.size());
+}
+
+void WindowsNdisApi::AttachMemoryBudget(MemoryBudget* budget) {
+  AttachBudget(budget, "query buffer", MemoryBudget::PRIORITY_QUERY_BUFFER);
+}
+
+size_t WindowsNdisApi::MemoryUsage() const {
+  return _buffer.capacity() +
+         free_list_.Count() * kRecycledAccessPointBytes +
+         tracker_.MemoryUsage();
+}
+
+size_t WindowsNdisApi::BufferFloor() const {
+  return std::max<size_t>(kInitialBufferSize, last_needed_ + last_needed_ / 4);
+}
+
+size_t WindowsNdisApi::ReclaimableMemory() const {
+  size_t floor = BufferFloor();
+  return free_list_.Count() * kRecycledAccessPointBytes +
+         (_buffer.capacity() > floor ? _buffer.capacity() - floor : 0);
+}
+
+void WindowsNdisApi::FinishScan() {
+  if (scan_needed_) {
+    last_needed_ = scan_needed_;
+    scan_needed_ = 0;
+  }
+  ReportMemory();
+}
+
+void WindowsNdisApi::TrimIfRequested() {
+  if (ReleasePending()) {
+    ReportMemory();
+  }
+}
+
+void WindowsNdisApi::FreeMemory(size_t bytes) {
+  size_t released = 0;
+  while (released < bytes && free_list_.Count()) {
+    free_list_.RemoveObjectAt(free_list_.Count() - 1);
+    released += kRecycledAccessPointBytes;
+  }
+  size_t floor = BufferFloor();
+  if (released < bytes && _buffer.capacity() > floor) {
+    size_t shrink = std::min<size_t>(_buffer.capacity() - floor, bytes - released);
+    std::vector<char>(_buffer.capacity() - shrink).swap(_buffer);
+  }
+}
+
+void WindowsNdisApi::SyncInterfaces() {
+  if (recheck_interfaces_) {
+    // The saved list may name adapters removed since, or miss new ones.
+    // Enumerating is cheap next to the scan it precedes.
+    recheck_interfaces_ = false;
+    std::vector<std::string> names;
+    if (GetInterfacesNDIS(names) && !names.empty() &&
+        names != Interfaces()->names) {
+      std::shared_ptr<InterfaceList> list = std::make_shared<InterfaceList>();
+      list->version = 0;
+      list->names.swap(names);
+      std::atomic_store(&interfaces_,
+                        std::shared_ptr<const InterfaceList>(std::move(list)));
+    }
+  }
+  if (!registry_) {
+    return;
+  }
+  std::shared_ptr<const InterfaceList> list = Interfaces();
+  if (registry_->Sync(&list)) {
+    std::atomic_store(&interfaces_, list);
+  }
+}
+
 bool WindowsNdisApi::GetAccessPointData(nsCOMArray<nsWifiAccessPoint>& outData) {
   int interfaces_failed = 0;
   int interfaces_succeeded = 0;
+  memset(&update_stats_, 0, sizeof(update_stats_));
+  SyncInterfaces();
+  TrimIfRequested();
+  std::shared_ptr<const InterfaceList> interfaces = Interfaces();
+  const std::vector<std::string>& names = interfaces->names;
 
-  for (int i = 0; i < static_cast<int>(interface_service_names_.size()); ++i) {
+  for (int i = 0; i < static_cast<int>(names.size()); ++i) {
     // First, check that we have a DOS device for this adapter.
-    if (!DefineDosDeviceIfNotExists(interface_service_names_[i])) {
+    if (!DefineDosDeviceIfNotExists(names[i])) {
       continue;
     }
 
     // Get the handle to the device. This will fail if the named device is not
     // valid.
-    HANDLE adapter_handle = GetFileHandle(interface_service_names_[i]);
+    HANDLE adapter_handle = GetFileHandle(names[i]);
     if (adapter_handle == INVALID_HANDLE_VALUE) {
       continue;
     }
@@ -138,14 +273,97 @@ bool WindowsNdisApi::GetAccessPointData(nsCOMArray<nsWifiAccessPoint>& outData)
 
     // Clean up.
     CloseHandle(adapter_handle);
-    UndefineDosDevice(interface_service_names_[i]);
+    UndefineDosDevice(names[i]);
   }
+  FinishScan();
 
   // Return true if at least one interface succeeded, or at the very least none
   // failed.
   return interfaces_succeeded > 0 || interfaces_failed == 0;
 }
 
+bool WindowsNdisApi::GetBssIdLists(std::vector<std::vector<char> >& outLists) {
+  return QueryBssIdLists(&outLists, NULL);
+}
+
+bool WindowsNdisApi::GetAccessPoints(std::vector<AccessPoint>& outData) {
+  outData.clear();
+  return QueryBssIdLists(NULL, &outData);
+}
+
+bool WindowsNdisApi::QueryBssIdLists(std::vector<std::vector<char> >* lists,
+                                     std::vector<AccessPoint>* access_points) {
+  int interfaces_failed = 0;
+  int interfaces_succeeded = 0;
+  SyncInterfaces();
+  TrimIfRequested();
+  std::shared_ptr<const InterfaceList> interfaces = Interfaces();
+  const std::vector<std::string>& names = interfaces->names;
+
+  for (int i = 0; i < static_cast<int>(names.size()); ++i) {
+    if (!DefineDosDeviceIfNotExists(names[i])) {
+      continue;
+    }
+
+    HANDLE adapter_handle = GetFileHandle(names[i]);
+    if (adapter_handle == INVALID_HANDLE_VALUE) {
+      continue;
+    }
+
+    int result;
+    size_t returned;
+    if (QueryBuffer(adapter_handle, &result, &returned)) {
+      ++interfaces_succeeded;
+      if (result == ERROR_SUCCESS) {
+        scan_needed_ = std::max<size_t>(scan_needed_, returned);
+        if (lists) {
+          lists->push_back(std::vector<char>(_buffer.begin(),
+                                             _buffer.begin() + returned));
+        } else {
+          GetDataFromBssIdList(
+              *reinterpret_cast<const NDIS_802_11_BSSID_LIST*>(&_buffer[0]),
+              static_cast<int>(returned), *access_points);
+        }
+      }
+    } else {
+      ++interfaces_failed;
+    }
+
+    CloseHandle(adapter_handle);
+    UndefineDosDevice(names[i]);
+  }
+  FinishScan();
+
+  return interfaces_succeeded > 0 || interfaces_failed == 0;
+}
+
+bool WindowsNdisApi::GetInterfaceBssIdList(const std::string& name,
+                                           std::vector<char>& buffer,
+                                           bool* has_data,
+                                           MemoryBudget* budget,
+                                           int budget_id) {
+  *has_data = false;
+  if (!DefineDosDeviceIfNotExists(name)) {
+    return true;
+  }
+
+  HANDLE adapter_handle = GetFileHandle(name);
+  if (adapter_handle == INVALID_HANDLE_VALUE) {
+    return true;
+  }
+
+  if (buffer.size() < kInitialBufferSize) {
+    buffer.resize(kInitialBufferSize);
+  }
+  int result;
+  bool ok = QueryInterfaceNDIS(adapter_handle, buffer, &result, budget, budget_id);
+  *has_data = ok && result == ERROR_SUCCESS;
+
+  CloseHandle(adapter_handle);
+  UndefineDosDevice(name);
+  return ok;
+}
+
 bool WindowsNdisApi::GetInterfacesNDIS(std::vector<std::string>& interface_service_names_out) {
   HKEY network_cards_key = NULL;
   if (RegOpenKeyEx(
@@ -200,6 +418,81 @@ bool WindowsNdisApi::GetInterfacesNDIS(std::vector<std::string>& interface_servi
   RegCloseKey(network_cards_key);
   return true;
 }
+
+// WindowsNdisInterfaceSource
+WindowsNdisInterfaceSource::WindowsNdisInterfaceSource()
+    : network_cards_key_(NULL),
+      change_event_(NULL),
+      stop_event_(NULL) {
+}
+
+WindowsNdisInterfaceSource::~WindowsNdisInterfaceSource() {
+  Stop();
+}
+
+bool WindowsNdisInterfaceSource::Enumerate(std::vector<std::string>& names) {
+  names.clear();
+  return WindowsNdisApi::GetInterfacesNDIS(names);
+}
+
+bool WindowsNdisInterfaceSource::Start(InterfaceChangeObserver* observer) {
+  if (watcher_.joinable()) {
+    return true;
+  }
+  if (RegOpenKeyEx(
+      HKEY_LOCAL_MACHINE,
+      "Software\\Microsoft\\Windows NT\\CurrentVersion\\NetworkCards",
+      0,
+      KEY_NOTIFY,
+      &network_cards_key_) != ERROR_SUCCESS) {
+    network_cards_key_ = NULL;
+    return false;
+  }
+  change_event_ = CreateEvent(NULL, FALSE, FALSE, NULL);
+  stop_event_ = CreateEvent(NULL, TRUE, FALSE, NULL);
+  if (!change_event_ || !stop_event_) {
+    Stop();
+    return false;
+  }
+  watcher_ = std::thread(&WindowsNdisInterfaceSource::WatchLoop, this, observer);
+  return true;
+}
+
+void WindowsNdisInterfaceSource::Stop() {
+  if (watcher_.joinable()) {
+    SetEvent(stop_event_);
+    watcher_.join();
+  }
+  if (change_event_) {
+    CloseHandle(change_event_);
+    change_event_ = NULL;
+  }
+  if (stop_event_) {
+    CloseHandle(stop_event_);
+    stop_event_ = NULL;
+  }
+  if (network_cards_key_) {
+    RegCloseKey(network_cards_key_);
+    network_cards_key_ = NULL;
+  }
+}
+
+void WindowsNdisInterfaceSource::WatchLoop(InterfaceChangeObserver* observer) {
+  // The notification is tied to the registering thread, so it is renewed
+  // here after every change rather than once in Start().
+  HANDLE events[2] = { stop_event_, change_event_ };
+  while (true) {
+    if (RegNotifyChangeKeyValue(network_cards_key_, TRUE,
+                                REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET,
+                                change_event_, TRUE) != ERROR_SUCCESS) {
+      return;
+    }
+    if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0 + 1) {
+      return;
+    }
+    observer->OnInterfacesInvalidated();
+  }
+}
 #define uint8 unsigned char
 
 bool ConvertToAccessPointData(const NDIS_WLAN_BSSID& data, nsWifiAccessPoint* access_point_data) 
@@ -230,6 +523,7 @@ int GetDataFromBssIdList(const NDIS_802_11_BSSID_LIST& bss_id_list,
         iterator + bss_id->Length > end_of_buffer) {
       break;
     }
+    WIFI_ALLOCATION_SCOPE("nsWifiAccessPoint");
     nsWifiAccessPoint* ap = new nsWifiAccessPoint();
     if (ConvertToAccessPointData(*bss_id, ap)) {
       outData.AppendObject(ap);
@@ -244,12 +538,160 @@ int GetDataFromBssIdList(const NDIS_802_11_BSSID_LIST& bss_id_list,
 
 bool WindowsNdisApi::GetInterfaceDataNDIS(HANDLE adapter_handle,
                                           nsCOMArray<nsWifiAccessPoint>& outData) {
+  int result;
+  size_t returned;
+  if (!QueryBuffer(adapter_handle, &result, &returned)) {
+    return false;
+  }
+
+  if (result == ERROR_SUCCESS) {
+    scan_needed_ = std::max<size_t>(scan_needed_, returned);
+    NDIS_802_11_BSSID_LIST* bssid_list = 
+        reinterpret_cast<NDIS_802_11_BSSID_LIST*>(&_buffer[0]);
+    int found = GetDataFromBssIdList(*bssid_list, _buffer.size(), outData);
+    update_stats_.allocated += found;
+    update_stats_.addrefs += found;
+  }
+
+  return true;
+}
+
+class WindowsNdisApi::ComArray : public TrackedAccessPointArray {
+public:
+  ComArray(WindowsNdisApi* api, nsCOMArray<nsWifiAccessPoint>& array)
+      : api_(api), array_(array) {}
+
+  size_t Count() const { return array_.Count(); }
+  const void* ObjectAt(size_t i) const { return array_[i]; }
+  void Clear() { array_.Clear(); }
+
+  void Append(const NDIS_WLAN_BSSID& entry) {
+    WIFI_ALLOCATION_SCOPE("nsWifiAccessPoint");
+    nsRefPtr<nsWifiAccessPoint> ap = api_->TakeRecycledAccessPoint();
+    if (!ap) {
+      ap = new nsWifiAccessPoint();
+      ++api_->update_stats_.allocated;
+    }
+    ConvertToAccessPointData(entry, ap);
+    array_.AppendObject(ap);
+  }
+
+  void SetSignal(size_t i, int rssi) { array_[i]->setSignal(rssi); }
+
+  void SetSsid(size_t i, const NDIS_802_11_SSID& ssid) {
+    array_[i]->setSSID(reinterpret_cast<const char*>(ssid.Ssid), ssid.SsidLength);
+  }
+
+  void RemoveAt(size_t i) {
+    api_->RecycleAccessPoint(array_[i]);
+    int last = array_.Count() - 1;
+    if (static_cast<int>(i) != last) {
+      array_.ReplaceObjectAt(array_[last], i);
+    }
+    array_.RemoveObjectAt(last);
+  }
+
+private:
+  WindowsNdisApi* api_;
+  nsCOMArray<nsWifiAccessPoint>& array_;
+};
+
+bool WindowsNdisApi::UpdateAccessPointData(nsCOMArray<nsWifiAccessPoint>& ioData,
+                                           bool* changed) {
+  *changed = false;
+  SyncInterfaces();
+  TrimIfRequested();
+  ComArray array(this, ioData);
+  tracker_.BeginScan(array, &update_stats_, changed);
+
+  int interfaces_failed = 0;
+  int interfaces_succeeded = 0;
+
+  std::shared_ptr<const InterfaceList> interfaces = Interfaces();
+  const std::vector<std::string>& names = interfaces->names;
+  for (int i = 0; i < static_cast<int>(names.size()); ++i) {
+    if (!DefineDosDeviceIfNotExists(names[i])) {
+      continue;
+    }
+
+    HANDLE adapter_handle = GetFileHandle(names[i]);
+    if (adapter_handle == INVALID_HANDLE_VALUE) {
+      continue;
+    }
+
+    int result;
+    size_t returned;
+    if (QueryBuffer(adapter_handle, &result, &returned)) {
+      ++interfaces_succeeded;
+      if (result == ERROR_SUCCESS) {
+        scan_needed_ = std::max<size_t>(scan_needed_, returned);
+        NDIS_802_11_BSSID_LIST* bssid_list =
+            reinterpret_cast<NDIS_802_11_BSSID_LIST*>(&_buffer[0]);
+        tracker_.Merge(*bssid_list, _buffer.size(), array, changed);
+      }
+    } else {
+      ++interfaces_failed;
+    }
+
+    CloseHandle(adapter_handle);
+    UndefineDosDevice(names[i]);
+  }
+
+  // If every query failed, leave the previous result untouched rather than
+  // reporting every AP as gone.
+  bool failed = interfaces_succeeded == 0 && interfaces_failed > 0;
+  tracker_.EndScan(array, failed, changed);
+  FinishScan();
+  return !failed;
+}
+
+already_AddRefed<nsWifiAccessPoint> WindowsNdisApi::TakeRecycledAccessPoint() {
+  int count = free_list_.Count();
+  if (count == 0) {
+    return nullptr;
+  }
+  nsRefPtr<nsWifiAccessPoint> ap = free_list_[count - 1];
+  free_list_.RemoveObjectAt(count - 1);
+  ++update_stats_.recycled;
+  ++update_stats_.releases;
+  return ap.forget();
+}
+
+void WindowsNdisApi::RecycleAccessPoint(nsWifiAccessPoint* ap) {
+  if (free_list_.Count() >= kMaxRecycledAccessPoints) {
+    return;
+  }
+  // Only reuse objects that nobody outside the result array still holds;
+  // a listener may keep a reference to an AP from an earlier scan.
+  ap->AddRef();
+  nsrefcnt count = ap->Release();
+  if (count != 1) {
+    return;
+  }
+  free_list_.AppendObject(ap);
+  ++update_stats_.addrefs;
+}
+
+bool WindowsNdisApi::QueryBuffer(HANDLE adapter_handle, int* result_out,
+                                 size_t* returned_out) {
+  return QueryInterfaceNDIS(adapter_handle, _buffer, result_out, Budget(),
+                            BudgetId(), MemoryUsage() - _buffer.capacity(),
+                            returned_out);
+}
+
+bool WindowsNdisApi::QueryInterfaceNDIS(HANDLE adapter_handle,
+                                        std::vector<char>& buffer,
+                                        int* result_out,
+                                        MemoryBudget* budget,
+                                        int budget_id,
+                                        size_t other_bytes,
+                                        size_t* returned_out) {
   DWORD bytes_out;
   int result;
 
   while (true) {
     bytes_out = 0;
-    result = PerformQuery(adapter_handle, _buffer, &bytes_out);
+    result = PerformQuery(adapter_handle, buffer, &bytes_out);
     if (result == ERROR_GEN_FAILURE ||  // Returned by some Intel cards.
         result == ERROR_INSUFFICIENT_BUFFER ||
         result == ERROR_MORE_DATA ||
@@ -258,12 +700,28 @@ bool WindowsNdisApi::GetInterfaceDataNDIS(HANDLE adapter_handle,
       // The buffer we supplied is too small, so increase it. bytes_out should
       // provide the required buffer size, but this is not always the case.
       size_t newSize;
-      if (bytes_out > static_cast<DWORD>(_buffer.size())) {
+      if (bytes_out > static_cast<DWORD>(buffer.size())) {
         newSize = bytes_out;
       } else {
-        newSize = _buffer.size() * 2;
+        newSize = buffer.size() * 2;
+      }
+      // Past kMaximumBufferSize the resize fails anyway; reserving for it
+      // would only reclaim other components for nothing.
+      if (budget && newSize > buffer.capacity() && newSize <= kMaximumBufferSize &&
+          !budget->Reserve(budget_id, newSize - buffer.capacity())) {
+        return false;
       }
-      if (!ResizeBuffer(newSize, _buffer)) {
+      bool resized;
+      {
+        WIFI_ALLOCATION_SCOPE("query buffer");
+        resized = ResizeBuffer(newSize, buffer);
+      }
+      // The capacity may differ from what was reserved either way: a failed
+      // resize keeps the old allocation, and a vector may round up.
+      if (budget) {
+        budget->Report(budget_id, other_bytes + buffer.capacity());
+      }
+      if (!resized) {
         return false;
       }
     } else {
@@ -272,12 +730,10 @@ bool WindowsNdisApi::GetInterfaceDataNDIS(HANDLE adapter_handle,
     }
   }
 
-  if (result == ERROR_SUCCESS) {
-    NDIS_802_11_BSSID_LIST* bssid_list = 
-        reinterpret_cast<NDIS_802_11_BSSID_LIST*>(&_buffer[0]);
-    GetDataFromBssIdList(*bssid_list, _buffer.size(), outData);
+  *result_out = result;
+  if (returned_out) {
+    *returned_out = std::min<size_t>(bytes_out, buffer.size());
   }
-
   return true;
 }
 
@@ -370,3 +826,68 @@ bool ResizeBuffer(size_t requested_size, std::vector<char>& buffer) {
 }
 
 }  // namespace
+
+// WindowsNdisInterfaceBackend
+WindowsNdisInterfaceBackend::WindowsNdisInterfaceBackend(WindowsNdisApi* api)
+    : interfaces_(api->Interfaces()),
+      buffers_(interfaces_->names.size()),
+      budget_(NULL),
+      budget_ids_(buffers_.size(), -1) {
+}
+
+WindowsNdisInterfaceBackend::~WindowsNdisInterfaceBackend() {
+  AttachMemoryBudget(NULL);
+}
+
+void WindowsNdisInterfaceBackend::AttachMemoryBudget(MemoryBudget* budget) {
+  if (budget_) {
+    for (size_t i = 0; i < budget_ids_.size(); ++i) {
+      budget_->Unregister(budget_ids_[i]);
+    }
+  }
+  budget_ = budget;
+  budget_ids_.assign(buffers_.size(), -1);
+  if (budget_) {
+    for (size_t i = 0; i < buffers_.size(); ++i) {
+      budget_ids_[i] = budget_->Register("interface buffer",
+                                         MemoryBudget::PRIORITY_QUERY_BUFFER, this);
+      budget_->Report(budget_ids_[i], buffers_[i].capacity());
+    }
+  }
+}
+
+size_t WindowsNdisInterfaceBackend::ReleaseMemory(size_t bytes) {
+  (void)bytes;
+  return 0;
+}
+
+size_t WindowsNdisInterfaceBackend::InterfaceCount() const {
+  return interfaces_->names.size();
+}
+
+std::string WindowsNdisInterfaceBackend::InterfaceName(size_t index) const {
+  return index < interfaces_->names.size() ? interfaces_->names[index]
+                                           : std::string();
+}
+
+bool WindowsNdisInterfaceBackend::ScanInterface(size_t index,
+                                                std::vector<AccessPoint>& outData) {
+  if (index >= buffers_.size()) {
+    return false;
+  }
+  std::vector<char>& buffer = buffers_[index];
+  bool has_data;
+  int budget_id = budget_ids_[index];
+  if (!WindowsNdisApi::GetInterfaceBssIdList(interfaces_->names[index], buffer,
+                                             &has_data,
+                                             budget_id >= 0 ? budget_ : NULL,
+                                             budget_id)) {
+    return false;
+  }
+  outData.clear();
+  if (has_data) {
+    GetDataFromBssIdList(*reinterpret_cast<const NDIS_802_11_BSSID_LIST*>(&buffer[0]),
+                         static_cast<int>(buffer.size()), outData);
+  }
+  return true;
+}
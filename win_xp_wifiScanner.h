@@ -1,23 +1,238 @@
 #pragma once
 
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <thread>
 #include <vector>
+#include "nsAutoPtr.h"
 #include "nsCOMArray.h"
+#include "wifi_accessPointTracker.h"
+#include "wifi_bssid.h"
+#include "wifi_deadlineScanner.h"
+#include "wifi_interfaceRegistry.h"
+#include "wifi_memoryBudget.h"
+#include "wifi_scanCoalescer.h"
+#include "wifi_scanPipeline.h"
+#include "wifi_warmStart.h"
 
 class nsWifiAccessPoint;
 
-class WindowsNdisApi 
+class WindowsNdisApi : private DeferredReleaseClient
 {
 public:
   virtual ~WindowsNdisApi();
   static WindowsNdisApi* Create();
+  // Takes its interfaces from |registry|, which is not owned and must outlive
+  // the result. Unlike Create() this never fails: with no interfaces a scan
+  // simply finds nothing until the registry reports one. Scans made through
+  // GetAccessPointData, GetBssIdLists and UpdateAccessPointData pick up a
+  // changed list on their own; the per-interface calls below keep the list
+  // from the last of those.
+  static WindowsNdisApi* Create(InterfaceRegistry* registry);
+  // Starts from a previous run's state: its interface list, if any, is used
+  // without enumerating the registry, and the query buffer starts at the
+  // size that run needed. Invalid names are dropped, and the first scan
+  // enumerates once so adapters removed or added since are noticed before
+  // it queries them. Returns NULL like Create() if no saved name is left
+  // and enumeration fails.
+  static WindowsNdisApi* Create(const WarmStartState& state);
+  // Fills the interface list and query buffer size of |state|; the caller
+  // adds the scan it wants restored.
+  void GetWarmStartState(WarmStartState* state) const;
+  // Accounts the query buffer and the incremental update state against
+  // |budget| as PRIORITY_QUERY_BUFFER; the buffer only grows if the budget
+  // can make room. Memory the budget asks back is freed at the start of the
+  // next scan, on the scanning thread. NULL detaches.
+  void AttachMemoryBudget(MemoryBudget* budget);
+  size_t MemoryUsage() const;
   virtual bool GetAccessPointData(nsCOMArray<nsWifiAccessPoint>& outData);
+  // Like GetAccessPointData, but returns the unparsed OID_802_11_BSSID_LIST
+  // response of each interface so parsing can happen on another thread. Each
+  // list holds only the bytes the driver returned, not the whole buffer.
+  bool GetBssIdLists(std::vector<std::vector<char> >& outLists);
+  // Like GetBssIdLists, but parses each list straight out of the query
+  // buffer, so no copies are held beyond what the budget accounts for.
+  bool GetAccessPoints(std::vector<AccessPoint>& outData);
+  // Incremental alternative to GetAccessPointData. |ioData| should be the
+  // array filled by the previous call and left unmodified; any other array is
+  // noticed and refilled from scratch. APs seen last time are matched by
+  // BSSID and updated in place; only new APs are allocated, and vanished ones
+  // are removed and, if nobody else holds them, kept for reuse. Because
+  // objects are updated in place, a previously returned array cannot be used
+  // to detect changes; *changed reports whether anything was added, removed
+  // or updated. The matching is AccessPointTracker's, tested and benchmarked
+  // against rebuilding in tests/accessPointTracker_*.
+  bool UpdateAccessPointData(nsCOMArray<nsWifiAccessPoint>& ioData, bool* changed);
+  const AccessPointUpdateStats& LastUpdateStats() const { return update_stats_; }
 
-private:
+  // The interface list the next scan will use. Never modified once
+  // returned; a registry change replaces it, so callers on other threads
+  // keep a consistent list for as long as they hold it.
+  std::shared_ptr<const InterfaceList> Interfaces() const {
+    return std::atomic_load(&interfaces_);
+  }
+  // Queries interface |name| into the caller's |buffer| without touching any
+  // shared state, so different interfaces can be queried from different
+  // threads. *has_data is set if |buffer| now holds a BSSID list. Returns
+  // false if the buffer could not be grown enough. With a |budget|, the
+  // buffer only grows within it, as component |budget_id| holding nothing
+  // but |buffer|.
+  static bool GetInterfaceBssIdList(const std::string& name,
+                                    std::vector<char>& buffer, bool* has_data,
+                                    MemoryBudget* budget = NULL,
+                                    int budget_id = -1);
+
+  // Lists NDIS service names from the NetworkCards registry key.
   static bool GetInterfacesNDIS(std::vector<std::string>& interface_service_names_out);
+
+private:
+  // Lets AccessPointTracker drive an nsCOMArray, recycling through
+  // free_list_.
+  class ComArray;
+
   // Swaps in content of the vector passed
   explicit WindowsNdisApi(std::vector<std::string>* interface_service_names);
+  explicit WindowsNdisApi(InterfaceRegistry* registry);
+  // Publishes the registry's list if it changed since the last scan, or,
+  // after a warm start, the enumerated list if the saved one was stale.
+  void SyncInterfaces();
+  // Releases what the budget asked for since the last report, if anything.
+  void TrimIfRequested();
+  // Remembers how much buffer the scan just finished needed, then reports.
+  void FinishScan();
+  // Queries every interface into _buffer, then copies each BSSID list the
+  // driver returned into |lists| or parses it into |access_points|,
+  // whichever is not NULL.
+  bool QueryBssIdLists(std::vector<std::vector<char> >* lists,
+                       std::vector<AccessPoint>* access_points);
+  // The query buffer is never trimmed below what recent scans needed, plus
+  // headroom, so a release does not force the next scan to grow it again.
+  size_t BufferFloor() const;
+  // DeferredReleaseClient. Ownership is never claimed: a reclaim can come
+  // from this api's own reports mid-scan, with _buffer in use, so releases
+  // always wait for the next scan's first or last report.
+  size_t ReclaimableMemory() const;
+  // Frees recycled access points, then query buffer above BufferFloor(),
+  // until |bytes| are released or nothing more can be.
+  void FreeMemory(size_t bytes);
   bool GetInterfaceDataNDIS(HANDLE adapter_handle, nsCOMArray<nsWifiAccessPoint>& outData);
+  // QueryInterfaceNDIS into _buffer, within the budget if one is attached.
+  bool QueryBuffer(HANDLE adapter_handle, int* result_out, size_t* returned_out);
+  // Runs the OID query, growing |buffer| as needed. Returns false if the
+  // buffer could not be grown enough; otherwise *result_out holds the Win32
+  // code and *returned_out (optional) how many bytes of |buffer| the driver
+  // filled. With a |budget|, each growth is first reserved for component
+  // |budget_id|, and after the resize, whether or not it succeeded, the
+  // component reports |other_bytes| plus the buffer's capacity, which
+  // settles the reservation.
+  static bool QueryInterfaceNDIS(HANDLE adapter_handle,
+                                 std::vector<char>& buffer,
+                                 int* result_out,
+                                 MemoryBudget* budget = NULL,
+                                 int budget_id = -1,
+                                 size_t other_bytes = 0,
+                                 size_t* returned_out = NULL);
+  already_AddRefed<nsWifiAccessPoint> TakeRecycledAccessPoint();
+  void RecycleAccessPoint(nsWifiAccessPoint* ap);
   // NDIS variables.
-  std::vector<std::string> interface_service_names_;
   std::vector<char> _buffer;
+  InterfaceRegistry* registry_;
+  // Only accessed through std::atomic_load/std::atomic_store: scans replace
+  // it while per-interface queries on other threads may still be reading.
+  std::shared_ptr<const InterfaceList> interfaces_;
+
+  // Incremental update state.
+  AccessPointTracker tracker_;
+  nsCOMArray<nsWifiAccessPoint> free_list_;
+  AccessPointUpdateStats update_stats_;
+
+  // Most query buffer any interface needed in the scan in progress, and in
+  // the last scan that got an answer.
+  size_t scan_needed_;
+  size_t last_needed_;
+  // Set when the interfaces came from a warm-start file; cleared by the
+  // first scan.
+  bool recheck_interfaces_;
+};
+
+// Reports NDIS interfaces being added and removed by watching the
+// NetworkCards registry key. Windows only says that the key changed, so
+// every change is reported as an invalidation.
+class WindowsNdisInterfaceSource : public InterfaceChangeSource {
+public:
+  WindowsNdisInterfaceSource();
+  virtual ~WindowsNdisInterfaceSource();
+  virtual bool Enumerate(std::vector<std::string>& names);
+  virtual bool Start(InterfaceChangeObserver* observer);
+  virtual void Stop();
+private:
+  void WatchLoop(InterfaceChangeObserver* observer);
+
+  WindowsNdisInterfaceSource(const WindowsNdisInterfaceSource&);
+  WindowsNdisInterfaceSource& operator=(const WindowsNdisInterfaceSource&);
+
+  HKEY network_cards_key_;
+  HANDLE change_event_;
+  HANDLE stop_event_;
+  std::thread watcher_;
+};
+
+// Feeds a ScanPipeline from the NDIS interfaces.
+class WindowsNdisScanSource : public ScanSource {
+public:
+  // Does not take ownership of |api|.
+  explicit WindowsNdisScanSource(WindowsNdisApi* api) : api_(api) {}
+  virtual bool QueryBssIdLists(std::vector<std::vector<char> >& outLists) {
+    return api_->GetBssIdLists(outLists);
+  }
+private:
+  WindowsNdisApi* api_;
+};
+
+// Full NDIS query for a ScanCoalescer, so callers that used to call
+// GetAccessPointData on their own cadence can share device queries.
+class WindowsNdisAccessPointQuery : public AccessPointQuery {
+public:
+  // Does not take ownership of |api|.
+  explicit WindowsNdisAccessPointQuery(WindowsNdisApi* api) : api_(api) {}
+  virtual bool QueryAccessPoints(std::vector<AccessPoint>& outData) {
+    return api_->GetAccessPoints(outData);
+  }
+private:
+  WindowsNdisApi* api_;
+};
+
+// Lets a DeadlineScanner query each NDIS interface on its own thread. Each
+// interface gets its own buffer so concurrent queries never share one.
+// The backend keeps the interface list |api| had when it was created, so its
+// count, names and buffers stay in step however the registry changes; to
+// pick up a hot-plugged adapter, create a new backend and DeadlineScanner.
+class WindowsNdisInterfaceBackend : public InterfaceScanBackend,
+                                    private MemoryBudgetClient {
+public:
+  // Does not take ownership of |api|.
+  explicit WindowsNdisInterfaceBackend(WindowsNdisApi* api);
+  virtual ~WindowsNdisInterfaceBackend();
+  // Accounts each interface's buffer against |budget| as a
+  // PRIORITY_QUERY_BUFFER component of its own; a buffer only grows if the
+  // budget can make room. A buffer that finds the budget's registry full
+  // grows unaccounted. Call while no scan is running; NULL detaches.
+  void AttachMemoryBudget(MemoryBudget* budget);
+  virtual size_t InterfaceCount() const;
+  virtual std::string InterfaceName(size_t index) const;
+  virtual bool ScanInterface(size_t index, std::vector<AccessPoint>& outData);
+private:
+  // MemoryBudgetClient. The buffers may be in use on the scanning threads,
+  // so nothing is released.
+  size_t ReleaseMemory(size_t bytes);
+
+  WindowsNdisInterfaceBackend(const WindowsNdisInterfaceBackend&);
+  WindowsNdisInterfaceBackend& operator=(const WindowsNdisInterfaceBackend&);
+
+  std::shared_ptr<const InterfaceList> interfaces_;
+  std::vector<std::vector<char> > buffers_;
+  MemoryBudget* budget_;
+  // Budget component of each buffer, or -1.
+  std::vector<int> budget_ids_;
 };